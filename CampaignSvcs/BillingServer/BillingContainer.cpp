@@ -1357,11 +1357,101 @@ namespace CampaignSvcs
   BillingContainer::check_available_bid(const Bid& bid)
     throw(BillingProcessor::Exception)
   {
-    const Generics::Time now = bid.time;
+    State_var state = state_;
+    CInternalConfig_var config = get_config_(true); // only bound
+
+    return check_available_bid_(bid, state, config, nullptr);
+  }
 
+  void
+  BillingContainer::check_available_bids(
+    BidResultArray& results,
+    const BidArray& bids)
+    throw(BillingProcessor::Exception)
+  {
+    // state and config are fetched once for batch,
+    // account amounts are locked once per account
     State_var state = state_;
     CInternalConfig_var config = get_config_(true); // only bound
 
+    AccountAvailableMap account_checks;
+
+    results.clear();
+    results.reserve(bids.size());
+
+    for(auto bid_it = bids.begin(); bid_it != bids.end(); ++bid_it)
+    {
+      results.push_back(check_available_bid_(
+        *bid_it, state, config, &account_checks));
+    }
+  }
+
+  void
+  BillingContainer::confirm_bids(
+    BidResultArray& results,
+    BidAmountArray& amounts,
+    const BidArray& bids)
+    throw(BillingProcessor::Exception)
+  {
+    // each confirm change amounts that used by next confirms of account:
+    // bids are confirmed one by one in batch order inside account group,
+    // accounts amounts lock is acquired once per group
+    // (campaigns, ccgs of different accounts don't intersect)
+    assert(amounts.size() == bids.size());
+
+    State_var state = state_;
+    CInternalConfig_var config = get_config_(false);
+
+    AccountBidsMap account_bids;
+
+    for(std::size_t bid_i = 0; bid_i < bids.size(); ++bid_i)
+    {
+      if(!config && !amounts[bid_i].forced)
+      {
+        // throw config not bound
+        get_config_(true);
+      }
+
+      account_bids[bids[bid_i].account_id].push_back(bid_i);
+    }
+
+    results.assign(bids.size(), BidResult(false, RevenueDecimal::ZERO));
+
+    for(auto account_it = account_bids.begin();
+      account_it != account_bids.end(); ++account_it)
+    {
+      StateSyncPolicy::WriteGuard lock(state->accounts_lock);
+
+      for(auto bid_index_it = account_it->second.begin();
+        bid_index_it != account_it->second.end(); ++bid_index_it)
+      {
+        BidAmount& amount = amounts[*bid_index_it];
+
+        results[*bid_index_it] = confirm_bid_in_state_(
+          amount.account_amount,
+          amount.amount,
+          amount.imps,
+          amount.clicks,
+          bids[*bid_index_it],
+          amount.forced,
+          state,
+          config,
+          true // accounts_locked
+          );
+      }
+    }
+  }
+
+  BillingContainer::BidResult
+  BillingContainer::check_available_bid_(
+    const Bid& bid,
+    State* state,
+    const InternalConfig* config,
+    AccountAvailableMap* account_checks)
+    throw()
+  {
+    const Generics::Time now = bid.time;
+
     InternalConfig::ResolveResult resolve_result = config->resolve_bid(bid);
 
     // for advertiser id we check only that it is active
@@ -1384,11 +1474,34 @@ namespace CampaignSvcs
       return BidResult(false, RevenueDecimal::ZERO);
     }
 
-    if(!check_available_account_budget_(
-         state->accounts,
-         state->accounts_lock,
-         bid.account_id,
-         *resolve_result.account))
+    bool account_available;
+
+    {
+      AccountAvailableMap::iterator account_check_it;
+
+      if(account_checks &&
+        (account_check_it = account_checks->find(bid.account_id)) !=
+          account_checks->end())
+      {
+        account_available = account_check_it->second;
+      }
+      else
+      {
+        account_available = check_available_account_budget_(
+          state->accounts,
+          state->accounts_lock,
+          bid.account_id,
+          *resolve_result.account);
+
+        if(account_checks)
+        {
+          account_checks->insert(
+            std::make_pair(bid.account_id, account_available));
+        }
+      }
+    }
+
+    if(!account_available)
     {
 #     ifdef DEBUG_OUTPUT
       std::cerr << "check_available_bid(";
@@ -1483,11 +1596,37 @@ namespace CampaignSvcs
       ", time = " << bid.time.gm_ft() << std::endl;
 #   endif
 
-    const Generics::Time now = bid.time;
-
     State_var state = state_;
     CInternalConfig_var config = get_config_(!forced);
 
+    return confirm_bid_in_state_(
+      account_bid_amount,
+      bid_amount,
+      imps,
+      clicks,
+      bid,
+      forced,
+      state,
+      config,
+      false // accounts_locked
+      );
+  }
+
+  BillingContainer::BidResult
+  BillingContainer::confirm_bid_in_state_(
+    RevenueDecimal& account_bid_amount,
+    RevenueDecimal& bid_amount,
+    RevenueDecimal& imps,
+    RevenueDecimal& clicks,
+    const Bid& bid,
+    bool forced,
+    State* state,
+    const InternalConfig* config,
+    bool accounts_locked)
+    throw()
+  {
+    const Generics::Time now = bid.time;
+
     InternalConfig::ResolveResult resolve_result;
 
     if(config)
@@ -1539,15 +1678,24 @@ namespace CampaignSvcs
     // confirm amount for account
     if(!stop_confirm &&
       account_confirm_amount_holder.available_amount != RevenueDecimal::ZERO &&
-      !confirm_account_bid_(
-        state->accounts,
-        state->accounts_lock,
-        account_confirm_amount_holder.confirmed_amount,
-        account_confirm_amount_holder.available_amount,
-        bid.account_id,
-        *resolve_result.account,
-        now,
-        forced))
+      !(accounts_locked ?
+        confirm_account_bid_i_(
+          state->accounts,
+          account_confirm_amount_holder.confirmed_amount,
+          account_confirm_amount_holder.available_amount,
+          bid.account_id,
+          *resolve_result.account,
+          now,
+          forced) :
+        confirm_account_bid_(
+          state->accounts,
+          state->accounts_lock,
+          account_confirm_amount_holder.confirmed_amount,
+          account_confirm_amount_holder.available_amount,
+          bid.account_id,
+          *resolve_result.account,
+          now,
+          forced)))
     {
       if(!forced)
       {
@@ -1763,13 +1911,25 @@ namespace CampaignSvcs
 
     if(account_confirm_amount_holder.revert_amount != RevenueDecimal::ZERO)
     {
-      revert_confirmed_bid_(
-        state->accounts,
-        state->accounts_lock,
-        bid.account_id,
-        *resolve_result.account,
-        now,
-        account_confirm_amount_holder.revert_amount);
+      if(accounts_locked)
+      {
+        revert_confirmed_bid_i_(
+          state->accounts,
+          bid.account_id,
+          *resolve_result.account,
+          now,
+          account_confirm_amount_holder.revert_amount);
+      }
+      else
+      {
+        revert_confirmed_bid_(
+          state->accounts,
+          state->accounts_lock,
+          bid.account_id,
+          *resolve_result.account,
+          now,
+          account_confirm_amount_holder.revert_amount);
+      }
 
       account_confirm_amount_holder.confirmed_amount -=
         account_confirm_amount_holder.revert_amount;
@@ -1907,6 +2067,126 @@ namespace CampaignSvcs
     // TODO
   }
 
+  BillingContainer::BidResult
+  BillingContainer::lease_budget(
+    RevenueDecimal& account_amount,
+    RevenueDecimal& amount,
+    const Bid& bid)
+    throw(BillingProcessor::Exception)
+  {
+    // lease is possible only if bid is available (active flags, budgets)
+    const BidResult check_result = check_available_bid(bid);
+
+    if(!check_result.available)
+    {
+      return check_result;
+    }
+
+    // leased amount is confirmed as usual bid without imps and clicks,
+    // delivered imps and clicks will be pushed at lease return
+    RevenueDecimal imps = RevenueDecimal::ZERO;
+    RevenueDecimal clicks = RevenueDecimal::ZERO;
+
+    const BidResult confirm_result = confirm_bid(
+      account_amount,
+      amount,
+      imps,
+      clicks,
+      bid,
+      false);
+
+    return BidResult(confirm_result.available, check_result.goal_ctr);
+  }
+
+  void
+  BillingContainer::return_budget(
+    const RevenueDecimal& account_amount,
+    const RevenueDecimal& amount,
+    const RevenueDecimal& imps,
+    const RevenueDecimal& clicks,
+    const Bid& bid)
+    throw(BillingProcessor::Exception)
+  {
+    const Generics::Time now = bid.time;
+
+    State_var state = state_;
+    CInternalConfig_var config = get_config_(false);
+
+    InternalConfig::ResolveResult resolve_result;
+
+    if(config)
+    {
+      resolve_result = config->resolve_bid(bid);
+    }
+
+    // entity can be removed from config after lease
+    if(!resolve_result.account)
+    {
+      resolve_result.account = &InternalConfig::DEFAULT_FORCED_ACCOUNT_TRAITS;
+    }
+
+    if(!resolve_result.campaign)
+    {
+      resolve_result.campaign = &InternalConfig::DEFAULT_FORCED_CAMPAIGN_TRAITS;
+    }
+
+    if(!resolve_result.ccg)
+    {
+      resolve_result.ccg = &InternalConfig::DEFAULT_FORCED_CCG_TRAITS;
+    }
+
+    if(account_amount != RevenueDecimal::ZERO)
+    {
+      return_amount_(
+        state->accounts,
+        state->accounts_lock,
+        bid.account_id,
+        *resolve_result.account,
+        now,
+        account_amount);
+    }
+
+    if(amount != RevenueDecimal::ZERO)
+    {
+      return_amount_(
+        state->campaigns,
+        state->campaigns_lock,
+        bid.campaign_id,
+        *resolve_result.campaign,
+        now,
+        amount);
+
+      return_amount_(
+        state->ccgs,
+        state->ccgs_lock,
+        bid.ccg_id,
+        *resolve_result.ccg,
+        now,
+        amount);
+    }
+
+    if(imps != RevenueDecimal::ZERO || clicks != RevenueDecimal::ZERO)
+    {
+      // lease amount pushed into free amount distribution at lease
+      RevenueDecimal rate_amount = amount;
+      rate_amount.negate();
+
+      confirm_bid_rate_(
+        state->campaign_rate_goals,
+        state->campaign_rate_goals_lock,
+        state->ccg_rate_amounts,
+        state->ccg_rate_amounts_lock,
+        round_rate_(bid.ctr),
+        imps,
+        clicks,
+        rate_amount,
+        bid.campaign_id,
+        bid.ccg_id,
+        *resolve_result.campaign,
+        now);
+    }
+  }
+
   void
   BillingContainer::config(Config* new_config)
     throw()
@@ -2477,17 +2757,39 @@ namespace CampaignSvcs
     bool forced)
     throw()
   {
-    confirmed_amount = RevenueDecimal::ZERO;
+    StateSyncPolicy::WriteGuard lock(amounts_lock);
 
-    BillingContainer::State::AmountHolder_var new_amount_holder =
-      new BillingContainer::State::AmountHolder();
+    return confirm_account_bid_i_(
+      amounts,
+      confirmed_amount,
+      confirm_amount,
+      account_id,
+      account_config,
+      now,
+      forced);
+  }
+
+  template<
+    typename AmountMapType,
+    typename AccountDeliveryLimitsType
+    >
+  bool
+  BillingContainer::confirm_account_bid_i_(
+    AmountMapType& amounts,
+    RevenueDecimal& confirmed_amount,
+    const RevenueDecimal& confirm_amount,
+    unsigned long account_id,
+    const AccountDeliveryLimitsType& account_config,
+    const Generics::Time& now,
+    bool forced)
+    throw()
+  {
+    confirmed_amount = RevenueDecimal::ZERO;
 
     const Generics::Time adv_tz_now_date =
       DeliveryLimitsChecker<AccountDeliveryLimitsType>::get_date_in_adv_tz(
         account_config, now);
 
-    StateSyncPolicy::WriteGuard lock(amounts_lock);
-
     auto account_it = amounts.find(account_id);
 
     const RevenueDecimal account_total_amount = (
@@ -2501,6 +2803,8 @@ namespace CampaignSvcs
     {
       if(account_it == amounts.end())
       {
+        BillingContainer::State::AmountHolder_var new_amount_holder =
+          new BillingContainer::State::AmountHolder();
         account_it = amounts.insert(std::make_pair(account_id, new_amount_holder)).first;
       }
 
@@ -2590,6 +2894,29 @@ namespace CampaignSvcs
     const Generics::Time& now,
     const RevenueDecimal& confirm_amount)
     throw()
+  {
+    StateSyncPolicy::WriteGuard lock(amounts_lock);
+
+    revert_confirmed_bid_i_(
+      amounts,
+      object_id,
+      delivery_limits,
+      now,
+      confirm_amount);
+  }
+
+  template<
+    typename AmountMapType,
+    typename DeliveryLimitsType // CommonDeliveryLimits + DeliveryLimitsCalcHelper
+    >
+  void
+  BillingContainer::revert_confirmed_bid_i_(
+    const AmountMapType& amounts,
+    unsigned long object_id,
+    const DeliveryLimitsType& delivery_limits,
+    const Generics::Time& now,
+    const RevenueDecimal& confirm_amount)
+    throw()
   {
     RevenueDecimal revert_amount = confirm_amount;
     revert_amount.negate();
@@ -2599,18 +2926,46 @@ namespace CampaignSvcs
         delivery_limits,
         now);
 
-    bool add_amount_result;
-
-    {
-      StateSyncPolicy::WriteGuard lock(amounts_lock);
-      auto it = amounts.find(object_id);
-      assert(it != amounts.end());
+    auto it = amounts.find(object_id);
+    assert(it != amounts.end());
 
-      add_amount_result = it->second->add_amount(
-        adv_tz_now_date, revert_amount);
-    }
+    const bool add_amount_result = it->second->add_amount(
+      adv_tz_now_date, revert_amount);
 
     assert(add_amount_result); // overflow unexpected
+    (void)add_amount_result;
+  }
+
+  template<
+    typename AmountMapType,
+    typename DeliveryLimitsType // CommonDeliveryLimits + DeliveryLimitsCalcHelper
+    >
+  void
+  BillingContainer::return_amount_(
+    const AmountMapType& amounts,
+    StateSyncPolicy::Mutex& amounts_lock,
+    unsigned long object_id,
+    const DeliveryLimitsType& delivery_limits,
+    const Generics::Time& now,
+    const RevenueDecimal& return_amount)
+    throw()
+  {
+    RevenueDecimal revert_amount = return_amount;
+    revert_amount.negate();
+
+    Generics::Time adv_tz_now_date = DeliveryLimitsChecker<
+      DeliveryLimitsType>::get_date_in_adv_tz(
+        delivery_limits,
+        now);
+
+    StateSyncPolicy::WriteGuard lock(amounts_lock);
+    auto it = amounts.find(object_id);
+
+    // holder can be removed at amounts replace by stats
+    if(it != amounts.end())
+    {
+      it->second->add_amount(adv_tz_now_date, revert_amount);
+    }
   }
 
   template<
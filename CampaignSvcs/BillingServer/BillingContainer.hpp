@@ -22,6 +22,7 @@
 #define CAMPAIGNSVCS_BILLINGCONTAINER_HPP
 
 #include <list>
+#include <map>
 #include <vector>
 #include <string>
 #include <unordered_map>
@@ -59,6 +60,8 @@ namespace CampaignSvcs
       print(std::ostream& out) const throw();
     };
 
+    typedef std::vector<Bid> BidArray;
+
     struct BidResult
     {
       BidResult(bool available_val, const RevenueDecimal& goal_ctr_val)
@@ -68,6 +71,19 @@ namespace CampaignSvcs
       RevenueDecimal goal_ctr;
     };
 
+    typedef std::vector<BidResult> BidResultArray;
+
+    struct BidAmount
+    {
+      RevenueDecimal account_amount;
+      RevenueDecimal amount;
+      RevenueDecimal imps;
+      RevenueDecimal clicks;
+      bool forced;
+    };
+
+    typedef std::vector<BidAmount> BidAmountArray;
+
     // check_available_bid
     virtual BidResult
     check_available_bid(const Bid& bid)
@@ -84,6 +100,22 @@ namespace CampaignSvcs
       bool forced)
       throw(Exception) = 0;
 
+    // check_available_bids: batch variant of check_available_bid
+    virtual void
+    check_available_bids(
+      BidResultArray& results,
+      const BidArray& bids)
+      throw(Exception) = 0;
+
+    // confirm_bids: batch variant of confirm_bid,
+    // amounts is inout (contains remind amounts)
+    virtual void
+    confirm_bids(
+      BidResultArray& results,
+      BidAmountArray& amounts,
+      const BidArray& bids)
+      throw(Exception) = 0;
+
     // reserve_bid
     virtual bool
     reserve_bid(
@@ -91,6 +123,24 @@ namespace CampaignSvcs
       const RevenueDecimal& bid_amount)
       throw(Exception) = 0;
 
+    // lease_budget: confirm amount for spending on client side
+    virtual BidResult
+    lease_budget(
+      RevenueDecimal& account_amount, // inout, contains not leased amount
+      RevenueDecimal& amount,
+      const Bid& bid)
+      throw(Exception) = 0;
+
+    // return_budget: revert not spent part of lease
+    virtual void
+    return_budget(
+      const RevenueDecimal& account_amount,
+      const RevenueDecimal& amount,
+      const RevenueDecimal& imps,
+      const RevenueDecimal& clicks,
+      const Bid& bid)
+      throw(Exception) = 0;
+
   protected:
     virtual ~BillingProcessor() throw() = default;
   };
@@ -171,12 +221,41 @@ namespace CampaignSvcs
       bool forced)
       throw(BillingProcessor::Exception);
 
+    virtual void
+    check_available_bids(
+      BidResultArray& results,
+      const BidArray& bids)
+      throw(BillingProcessor::Exception);
+
+    virtual void
+    confirm_bids(
+      BidResultArray& results,
+      BidAmountArray& amounts,
+      const BidArray& bids)
+      throw(BillingProcessor::Exception);
+
     virtual bool
     reserve_bid(
       const Bid& bid,
       const RevenueDecimal& bid_amount)
       throw(BillingProcessor::Exception);
 
+    virtual BidResult
+    lease_budget(
+      RevenueDecimal& account_amount,
+      RevenueDecimal& amount,
+      const Bid& bid)
+      throw(BillingProcessor::Exception);
+
+    virtual void
+    return_budget(
+      const RevenueDecimal& account_amount,
+      const RevenueDecimal& amount,
+      const RevenueDecimal& imps,
+      const RevenueDecimal& clicks,
+      const Bid& bid)
+      throw(BillingProcessor::Exception);
+
     void
     clear_expired_reservation(const Generics::Time& time)
       throw(BillingProcessor::Exception);
@@ -221,6 +300,12 @@ namespace CampaignSvcs
 
     typedef std::set<unsigned long> IdSet;
 
+    // account id => account budget available
+    typedef std::unordered_map<unsigned long, bool> AccountAvailableMap;
+
+    // account id => indexes of batch bids
+    typedef std::map<unsigned long, std::vector<std::size_t> > AccountBidsMap;
+
   protected:
     virtual
     ~BillingContainer() throw() = default;
@@ -229,6 +314,30 @@ namespace CampaignSvcs
     get_config_(bool only_bound) const
       throw(BillingProcessor::Exception);
 
+    // account_checks: account budget check results shared by bids of batch
+    BidResult
+    check_available_bid_(
+      const Bid& bid,
+      State* state,
+      const InternalConfig* config,
+      AccountAvailableMap* account_checks)
+      throw();
+
+    // confirm_bid over fetched state and config,
+    // accounts_locked: state accounts_lock is held by caller
+    BidResult
+    confirm_bid_in_state_(
+      RevenueDecimal& account_bid_amount,
+      RevenueDecimal& bid_amount,
+      RevenueDecimal& imps,
+      RevenueDecimal& clicks,
+      const Bid& bid,
+      bool forced,
+      State* state,
+      const InternalConfig* config,
+      bool accounts_locked)
+      throw();
+
     // processor operation helpers
     template<
       typename AmountMapType,
@@ -288,6 +397,19 @@ namespace CampaignSvcs
       bool forced)
       throw();
 
+    // confirm_account_bid_ with amounts_lock held by caller
+    template<typename AmountMapType, typename AccountDeliveryLimitsType>
+    bool
+    confirm_account_bid_i_(
+      AmountMapType& amounts,
+      RevenueDecimal& confirmed_amount,
+      const RevenueDecimal& confirm_amount,
+      unsigned long account_id,
+      const AccountDeliveryLimitsType& account_config,
+      const Generics::Time& now,
+      bool forced)
+      throw();
+
     template<typename AmountMapType, typename DeliveryLimitsType>
     static bool
     confirm_bid_(
@@ -332,6 +454,29 @@ namespace CampaignSvcs
       const RevenueDecimal& confirm_amount)
       throw();
 
+    // revert_confirmed_bid_ with amounts_lock held by caller
+    template<typename AmountMapType, typename DeliveryLimitsType>
+    static void
+    revert_confirmed_bid_i_(
+      const AmountMapType& amounts,
+      unsigned long object_id,
+      const DeliveryLimitsType& delivery_limits,
+      const Generics::Time& now,
+      const RevenueDecimal& confirm_amount)
+      throw();
+
+    // revert amount if holder isn't replaced by stats
+    template<typename AmountMapType, typename DeliveryLimitsType>
+    static void
+    return_amount_(
+      const AmountMapType& amounts,
+      StateSyncPolicy::Mutex& amounts_lock,
+      unsigned long object_id,
+      const DeliveryLimitsType& delivery_limits,
+      const Generics::Time& now,
+      const RevenueDecimal& return_amount)
+      throw();
+
     // state merge operations
     template<
       typename AmountMapType,
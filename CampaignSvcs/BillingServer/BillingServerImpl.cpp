@@ -242,6 +242,233 @@ namespace CampaignSvcs
     return nullptr; // unreachable
   }
 
+  AdServer::CampaignSvcs::BillingServer::BidResultSeq*
+  BillingServerImpl::check_available_bids(
+    const AdServer::CampaignSvcs::BillingServer::CheckBidSeq& request_seq)
+    throw(AdServer::CampaignSvcs::BillingServer::NotReady,
+      AdServer::CampaignSvcs::BillingServer::ImplementationException)
+  {
+    static const char* FUN = "BillingServerImpl::check_available_bids()";
+
+    BillingProcessorHolder::Accessor billing_accessor =
+      get_accessor_();
+
+    try
+    {
+      BillingProcessor::BidArray bids(request_seq.length());
+
+      for(CORBA::ULong req_i = 0; req_i < request_seq.length(); ++req_i)
+      {
+        const AdServer::CampaignSvcs::BillingServer::CheckBidInfo& request_info =
+          request_seq[req_i];
+        BillingProcessor::Bid& bid = bids[req_i];
+        bid.time = CorbaAlgs::unpack_time(request_info.time);
+        bid.account_id = request_info.account_id;
+        bid.advertiser_id = request_info.advertiser_id;
+        bid.campaign_id = request_info.campaign_id;
+        bid.ccg_id = request_info.ccg_id;
+        bid.ctr = CorbaAlgs::unpack_decimal<RevenueDecimal>(request_info.ctr);
+        bid.optimize_campaign_ctr = request_info.optimize_campaign_ctr;
+      }
+
+      BillingProcessor::BidResultArray results;
+      billing_accessor->check_available_bids(results, bids);
+
+      AdServer::CampaignSvcs::BillingServer::BidResultSeq_var result_seq =
+        new AdServer::CampaignSvcs::BillingServer::BidResultSeq();
+      result_seq->length(results.size());
+
+      for(CORBA::ULong res_i = 0; res_i < results.size(); ++res_i)
+      {
+        result_seq[res_i].available = results[res_i].available;
+        result_seq[res_i].goal_ctr = CorbaAlgs::pack_decimal(
+          results[res_i].goal_ctr);
+      }
+
+      return result_seq._retn();
+    }
+    catch(const BillingProcessor::Exception& ex)
+    {
+      Stream::Error ostr;
+      ostr << FUN << ": Caught BillingProcessor::Exception: " << ex.what();
+      CORBACommons::throw_desc<AdServer::CampaignSvcs::
+        BillingServer::ImplementationException>(
+          ostr.str());
+    }
+
+    return nullptr; // unreachable
+  }
+
+  AdServer::CampaignSvcs::BillingServer::BidResultSeq*
+  BillingServerImpl::confirm_bids(
+    AdServer::CampaignSvcs::BillingServer::ConfirmBidSeq& request_seq)
+    throw(AdServer::CampaignSvcs::BillingServer::NotReady,
+      AdServer::CampaignSvcs::BillingServer::ImplementationException)
+  {
+    static const char* FUN = "BillingServerImpl::confirm_bids()";
+
+    BillingProcessorHolder::Accessor billing_accessor =
+      get_accessor_();
+
+    try
+    {
+      BillingProcessor::BidArray bids(request_seq.length());
+      BillingProcessor::BidAmountArray amounts(request_seq.length());
+
+      for(CORBA::ULong req_i = 0; req_i < request_seq.length(); ++req_i)
+      {
+        const AdServer::CampaignSvcs::BillingServer::ConfirmBidInfo& request_info =
+          request_seq[req_i];
+        BillingProcessor::Bid& bid = bids[req_i];
+        bid.time = CorbaAlgs::unpack_time(request_info.time);
+        bid.account_id = request_info.account_id;
+        bid.advertiser_id = request_info.advertiser_id;
+        bid.campaign_id = request_info.campaign_id;
+        bid.ccg_id = request_info.ccg_id;
+        bid.ctr = CorbaAlgs::unpack_decimal<RevenueDecimal>(request_info.ctr);
+
+        BillingProcessor::BidAmount& amount = amounts[req_i];
+        amount.account_amount =
+          CorbaAlgs::unpack_decimal<RevenueDecimal>(request_info.account_spent_budget);
+        amount.amount =
+          CorbaAlgs::unpack_decimal<RevenueDecimal>(request_info.spent_budget);
+        amount.imps =
+          CorbaAlgs::unpack_decimal<RevenueDecimal>(request_info.imps);
+        amount.clicks =
+          CorbaAlgs::unpack_decimal<RevenueDecimal>(request_info.clicks);
+        amount.forced = request_info.forced;
+      }
+
+      BillingProcessor::BidResultArray results;
+      billing_accessor->confirm_bids(results, amounts, bids);
+
+      AdServer::CampaignSvcs::BillingServer::BidResultSeq_var result_seq =
+        new AdServer::CampaignSvcs::BillingServer::BidResultSeq();
+      result_seq->length(results.size());
+
+      for(CORBA::ULong res_i = 0; res_i < results.size(); ++res_i)
+      {
+        // fill remind amounts
+        AdServer::CampaignSvcs::BillingServer::ConfirmBidInfo& request_info =
+          request_seq[res_i];
+        const BillingProcessor::BidAmount& amount = amounts[res_i];
+        request_info.account_spent_budget = CorbaAlgs::pack_decimal(amount.account_amount);
+        request_info.spent_budget = CorbaAlgs::pack_decimal(amount.amount);
+        request_info.imps = CorbaAlgs::pack_decimal(amount.imps);
+        request_info.clicks = CorbaAlgs::pack_decimal(amount.clicks);
+
+        result_seq[res_i].available = results[res_i].available;
+        result_seq[res_i].goal_ctr = CorbaAlgs::pack_decimal(
+          results[res_i].goal_ctr);
+      }
+
+      return result_seq._retn();
+    }
+    catch(const BillingProcessor::Exception& ex)
+    {
+      Stream::Error ostr;
+      ostr << FUN << ": Caught BillingProcessor::Exception: " << ex.what();
+      CORBACommons::throw_desc<AdServer::CampaignSvcs::
+        BillingServer::ImplementationException>(
+          ostr.str());
+    }
+
+    return nullptr; // unreachable
+  }
+
+  AdServer::CampaignSvcs::BillingServer::BidResultInfo*
+  BillingServerImpl::lease_budget(
+    AdServer::CampaignSvcs::BillingServer::LeaseBudgetInfo& request_info)
+    throw(AdServer::CampaignSvcs::BillingServer::NotReady,
+      AdServer::CampaignSvcs::BillingServer::ImplementationException)
+  {
+    static const char* FUN = "BillingServerImpl::lease_budget()";
+
+    BillingProcessorHolder::Accessor billing_accessor =
+      get_accessor_();
+
+    try
+    {
+      BillingProcessor::Bid bid;
+      bid.time = CorbaAlgs::unpack_time(request_info.time);
+      bid.account_id = request_info.account_id;
+      bid.advertiser_id = request_info.advertiser_id;
+      bid.campaign_id = request_info.campaign_id;
+      bid.ccg_id = request_info.ccg_id;
+      bid.ctr = CorbaAlgs::unpack_decimal<RevenueDecimal>(request_info.ctr);
+      bid.optimize_campaign_ctr = request_info.optimize_campaign_ctr;
+
+      RevenueDecimal account_amount =
+        CorbaAlgs::unpack_decimal<RevenueDecimal>(request_info.account_amount);
+      RevenueDecimal amount =
+        CorbaAlgs::unpack_decimal<RevenueDecimal>(request_info.amount);
+
+      const BillingProcessor::BidResult res = billing_accessor->lease_budget(
+        account_amount,
+        amount,
+        bid);
+
+      // fill not leased amounts
+      request_info.account_amount = CorbaAlgs::pack_decimal(account_amount);
+      request_info.amount = CorbaAlgs::pack_decimal(amount);
+
+      AdServer::CampaignSvcs::BillingServer::BidResultInfo_var bid_result =
+        new AdServer::CampaignSvcs::BillingServer::BidResultInfo();
+      bid_result->available = res.available;
+      bid_result->goal_ctr = CorbaAlgs::pack_decimal(res.goal_ctr);
+
+      return bid_result._retn();
+    }
+    catch(const BillingProcessor::Exception& ex)
+    {
+      Stream::Error ostr;
+      ostr << FUN << ": Caught BillingProcessor::Exception: " << ex.what();
+      CORBACommons::throw_desc<AdServer::CampaignSvcs::
+        BillingServer::ImplementationException>(
+          ostr.str());
+    }
+
+    return nullptr; // unreachable
+  }
+
+  void
+  BillingServerImpl::return_budget(
+    const AdServer::CampaignSvcs::BillingServer::ReturnBudgetInfo& request_info)
+    throw(AdServer::CampaignSvcs::BillingServer::NotReady,
+      AdServer::CampaignSvcs::BillingServer::ImplementationException)
+  {
+    static const char* FUN = "BillingServerImpl::return_budget()";
+
+    BillingProcessorHolder::Accessor billing_accessor =
+      get_accessor_();
+
+    try
+    {
+      BillingProcessor::Bid bid;
+      bid.time = CorbaAlgs::unpack_time(request_info.time);
+      bid.account_id = request_info.account_id;
+      bid.advertiser_id = request_info.advertiser_id;
+      bid.campaign_id = request_info.campaign_id;
+      bid.ccg_id = request_info.ccg_id;
+      bid.ctr = CorbaAlgs::unpack_decimal<RevenueDecimal>(request_info.ctr);
+
+      billing_accessor->return_budget(
+        CorbaAlgs::unpack_decimal<RevenueDecimal>(request_info.account_amount),
+        CorbaAlgs::unpack_decimal<RevenueDecimal>(request_info.amount),
+        CorbaAlgs::unpack_decimal<RevenueDecimal>(request_info.imps),
+        CorbaAlgs::unpack_decimal<RevenueDecimal>(request_info.clicks),
+        bid);
+    }
+    catch(const BillingProcessor::Exception& ex)
+    {
+      Stream::Error ostr;
+      ostr << FUN << ": Caught BillingProcessor::Exception: " << ex.what();
+      CORBACommons::throw_desc<AdServer::CampaignSvcs::
+        BillingServer::ImplementationException>(
+          ostr.str());
+    }
+  }
+
   void
   BillingServerImpl::add_amount(
     AdServer::CampaignSvcs::BillingServer::ConfirmBidRefSeq_out remainder_request_seq,
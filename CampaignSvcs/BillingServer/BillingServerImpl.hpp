@@ -85,12 +85,36 @@ namespace CampaignSvcs
       throw(AdServer::CampaignSvcs::BillingServer::NotReady,
         AdServer::CampaignSvcs::BillingServer::ImplementationException);
 
+    virtual AdServer::CampaignSvcs::BillingServer::BidResultSeq*
+    check_available_bids(
+      const AdServer::CampaignSvcs::BillingServer::CheckBidSeq& request_seq)
+      throw(AdServer::CampaignSvcs::BillingServer::NotReady,
+        AdServer::CampaignSvcs::BillingServer::ImplementationException);
+
+    virtual AdServer::CampaignSvcs::BillingServer::BidResultSeq*
+    confirm_bids(
+      AdServer::CampaignSvcs::BillingServer::ConfirmBidSeq& request_seq)
+      throw(AdServer::CampaignSvcs::BillingServer::NotReady,
+        AdServer::CampaignSvcs::BillingServer::ImplementationException);
+
     virtual bool
     reserve_bid(
       const AdServer::CampaignSvcs::BillingServer::ReserveBidInfo& request_info)
       throw(AdServer::CampaignSvcs::BillingServer::NotReady,
         AdServer::CampaignSvcs::BillingServer::ImplementationException);
 
+    virtual AdServer::CampaignSvcs::BillingServer::BidResultInfo*
+    lease_budget(
+      AdServer::CampaignSvcs::BillingServer::LeaseBudgetInfo& request_info)
+      throw(AdServer::CampaignSvcs::BillingServer::NotReady,
+        AdServer::CampaignSvcs::BillingServer::ImplementationException);
+
+    virtual void
+    return_budget(
+      const AdServer::CampaignSvcs::BillingServer::ReturnBudgetInfo& request_info)
+      throw(AdServer::CampaignSvcs::BillingServer::NotReady,
+        AdServer::CampaignSvcs::BillingServer::ImplementationException);
+
     virtual void
     add_amount(
       AdServer::CampaignSvcs::BillingServer::ConfirmBidRefSeq_out remainder_request_seq,
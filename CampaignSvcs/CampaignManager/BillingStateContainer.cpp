@@ -19,6 +19,7 @@
  */
 
 #include <Commons/CorbaAlgs.hpp>
+#include <Commons/DelegateTaskGoal.hpp>
 
 #include "BillingStateContainer.hpp"
 
@@ -37,8 +38,40 @@ namespace CampaignSvcs
     const Generics::Time MAX_SERVER_USE_TIME = Generics::Time(10);
     const Generics::Time MIN_SERVER_USE_TIME = Generics::Time(1) / 100; // 10 ms
     const Generics::Time REENABLE_INDEX_TIME = Generics::Time(10);
+    const unsigned long LEASE_TASK_THREADS = 5;
 
     const bool DEBUG_BILLING_SERVER_CALL_ = false;
+
+    // result holder for operations without result
+    struct NoCallResult
+    {};
+
+    template<typename ObjectType,
+      typename CallType,
+      typename CallResultType,
+      typename CallArgType>
+    void
+    call_object(
+      CallResultType& call_result,
+      ObjectType& object,
+      CallType call,
+      CallArgType& call_arg)
+    {
+      call_result = (object.*call)(call_arg);
+    }
+
+    template<typename ObjectType,
+      typename CallType,
+      typename CallArgType>
+    void
+    call_object(
+      NoCallResult& /*call_result*/,
+      ObjectType& object,
+      CallType call,
+      CallArgType& call_arg)
+    {
+      (object.*call)(call_arg);
+    }
   };
 
   class BillingStateContainer::RecheckCCGTask: public Generics::TaskGoal
@@ -62,20 +95,60 @@ namespace CampaignSvcs
     BillingStateContainer* billing_state_container_;
   };
 
+  // BillingStateContainer::LeaseConfig
+  BillingStateContainer::LeaseConfig::LeaseConfig() throw()
+    : size(100),
+      refill_size(20),
+      max_overspend(10),
+      return_period(10)
+  {}
+
+  // BillingStateContainer::CCGLease
+  BillingStateContainer::CCGLease::CCGLease(
+    unsigned long account_id_val,
+    unsigned long advertiser_id_val,
+    unsigned long campaign_id_val,
+    unsigned long ccg_id_val,
+    const RevenueDecimal& account_amount_val,
+    const RevenueDecimal& amount_val,
+    const RevenueDecimal& ctr_val)
+    throw()
+    : account_id(account_id_val),
+      advertiser_id(advertiser_id_val),
+      campaign_id(campaign_id_val),
+      ccg_id(ccg_id_val),
+      account_amount(account_amount_val),
+      amount(amount_val),
+      ctr(ctr_val),
+      bids(0),
+      spent_bids(0),
+      refill_planned(0),
+      imps(RevenueDecimal::ZERO),
+      clicks(RevenueDecimal::ZERO),
+      available(true),
+      goal_ctr(RevenueDecimal::ZERO),
+      service_index(-1)
+  {}
+
+  // BillingStateContainer
   BillingStateContainer::BillingStateContainer(
     Generics::ActiveObjectCallback* callback,
     Logging::Logger* logger,
     const CORBACommons::CorbaObjectRefList& billing_server_refs,
     unsigned long max_use_count,
-    bool optimize_campaign_ctr)
+    bool optimize_campaign_ctr,
+    const LeaseConfig* lease_config)
     throw()
     : logger_(ReferenceCounting::add_ref(logger)),
-      task_runner_(new Generics::TaskRunner(callback, 1)),
+      task_runner_(new Generics::TaskRunner(
+        callback, lease_config ? LEASE_TASK_THREADS : 1)),
       scheduler_(new Generics::Planner(callback)),
       max_use_count_(static_cast<long>(max_use_count)),
       max_try_count_(10),
       optimize_campaign_ctr_(optimize_campaign_ctr),
-      billing_server_count_(billing_server_refs.size())
+      billing_server_count_(billing_server_refs.size()),
+      lease_mode_(lease_config != nullptr),
+      lease_config_(lease_config ? *lease_config : LeaseConfig())
   {
     static const char* FUN = "BillingStateContainer::BillingStateContainer()";
 
@@ -114,6 +187,15 @@ namespace CampaignSvcs
     // push lopped RecheckCCGTask
     Generics::Task_var msg = new RecheckCCGTask(this, task_runner_);
     task_runner_->enqueue_task(msg);
+
+    if(lease_mode_)
+    {
+      Commons::make_goal_task(
+        std::bind(&BillingStateContainer::return_leases_, this),
+        task_runner_,
+        scheduler_,
+        lease_config_.return_period)->deliver();
+    }
   }
 
   BillingStateContainer::BidCheckResult
@@ -129,6 +211,17 @@ namespace CampaignSvcs
   {
     //std::cerr << "check_available_bid: ccg_id = " << ccg_id << std::endl;
 
+    if(lease_mode_)
+    {
+      // lease is created at first confirm, check remotely before it
+      CCGLease_var lease = get_lease_(ccg_id);
+
+      if(lease)
+      {
+        return check_lease_bid_(now, lease, ccg_setter);
+      }
+    }
+
     AdServer::CampaignSvcs::BillingServer::CheckBidInfo check_bid_info;
     check_bid_info.time = CorbaAlgs::pack_time(now);
     check_bid_info.account_id = account_id;
@@ -251,6 +344,39 @@ namespace CampaignSvcs
     const AvailableAndMinCTRSetter* ccg_setter)
     throw()
   {
+    if(lease_mode_ && spent_amount != RevenueDecimal::ZERO)
+    {
+      CCGLease_var lease = get_lease_(ccg_id);
+
+      if(!lease)
+      {
+        // bid amounts of ccg is known only at confirm:
+        // confirm first bid remotely and lease budget for next bids
+        create_lease_(
+          now,
+          account_id,
+          advertiser_id,
+          campaign_id,
+          ccg_id,
+          account_spent_amount,
+          spent_amount,
+          ctr);
+      }
+      else if(lease->account_amount == account_spent_amount &&
+        lease->amount == spent_amount)
+      {
+        BidCheckResult result;
+
+        if(confirm_lease_bid_(result, now, lease, imps, clicks))
+        {
+          return result;
+        }
+      }
+
+      // bid with other amounts (ccg config changed) or
+      // overspend limit reached: confirm remotely
+    }
+
     AdServer::CampaignSvcs::BillingServer::ConfirmBidInfo confirm_bid_info;
     confirm_bid_info.time = CorbaAlgs::pack_time(now);
     confirm_bid_info.account_id = account_id;
@@ -371,6 +497,267 @@ namespace CampaignSvcs
     return result;
   }
 
+  void
+  BillingStateContainer::check_available_bids(
+    BidCheckResultArray& results,
+    const Generics::Time& now,
+    const BidCheckArray& bids)
+    throw()
+  {
+    results.resize(bids.size());
+    std::vector<bool> checked(bids.size(), false);
+
+    // group bids by BillingServer that will be used for ccg
+    ServiceBidsMap service_bids;
+
+    for(std::size_t bid_i = 0; bid_i < bids.size(); ++bid_i)
+    {
+      const BidCheck& bid = bids[bid_i];
+
+      if(lease_mode_)
+      {
+        CCGLease_var lease = get_lease_(bid.ccg_id);
+
+        if(lease)
+        {
+          results[bid_i] = check_lease_bid_(now, lease, bid.ccg_setter);
+          checked[bid_i] = true;
+          continue;
+        }
+      }
+
+      const long service_index = get_service_index_(
+        nullptr, // switched
+        now,
+        bid.ccg_id,
+        nullptr, // disabled_indexes
+        bid.ccg_setter);
+
+      if(service_index != -1)
+      {
+        service_bids[service_index].push_back(bid_i);
+      }
+    }
+
+    for(auto service_it = service_bids.begin();
+      service_it != service_bids.end(); ++service_it)
+    {
+      const std::vector<std::size_t>& bid_indexes = service_it->second;
+
+      AdServer::CampaignSvcs::BillingServer::CheckBidSeq check_bid_seq;
+      check_bid_seq.length(bid_indexes.size());
+
+      for(CORBA::ULong req_i = 0; req_i < bid_indexes.size(); ++req_i)
+      {
+        const BidCheck& bid = bids[bid_indexes[req_i]];
+        AdServer::CampaignSvcs::BillingServer::CheckBidInfo& check_bid_info =
+          check_bid_seq[req_i];
+        check_bid_info.time = CorbaAlgs::pack_time(now);
+        check_bid_info.account_id = bid.account_id;
+        check_bid_info.advertiser_id = bid.advertiser_id;
+        check_bid_info.campaign_id = bid.campaign_id;
+        check_bid_info.ccg_id = bid.ccg_id;
+        check_bid_info.ctr = CorbaAlgs::pack_decimal(bid.ctr);
+        check_bid_info.optimize_campaign_ctr = optimize_campaign_ctr_;
+      }
+
+      AdServer::CampaignSvcs::BillingServer::BidResultSeq_var check_result_seq;
+
+      const bool success_called = billing_server_call_(
+        check_result_seq,
+        service_it->first,
+        &BillingServer::check_available_bids,
+        check_bid_seq) &&
+        check_result_seq->length() == bid_indexes.size();
+
+      for(CORBA::ULong req_i = 0; req_i < bid_indexes.size(); ++req_i)
+      {
+        const std::size_t bid_i = bid_indexes[req_i];
+
+        if(success_called && check_result_seq[req_i].available)
+        {
+          BidCheckResult& result = results[bid_i];
+          result.deactivate_account = false;
+          result.deactivate_advertiser = false;
+          result.deactivate_campaign = false;
+          result.deactivate_ccg = false;
+          result.available = true;
+          result.goal_ctr = CorbaAlgs::unpack_decimal<RevenueDecimal>(
+            check_result_seq[req_i].goal_ctr);
+          checked[bid_i] = true;
+        }
+        else
+        {
+          SyncPolicy::WriteGuard lock(lock_);
+          cache_[bids[bid_i].ccg_id].disabled_indexes.insert(
+            std::make_pair(service_it->first, now));
+        }
+      }
+    }
+
+    // not available on chosen server: check other servers
+    for(std::size_t bid_i = 0; bid_i < bids.size(); ++bid_i)
+    {
+      if(!checked[bid_i])
+      {
+        const BidCheck& bid = bids[bid_i];
+
+        results[bid_i] = check_available_bid(
+          now,
+          bid.account_id,
+          bid.advertiser_id,
+          bid.campaign_id,
+          bid.ccg_id,
+          bid.ctr,
+          bid.ccg_setter);
+      }
+    }
+  }
+
+  void
+  BillingStateContainer::confirm_bids(
+    BidCheckResultArray& results,
+    const Generics::Time& now,
+    const BidConfirmArray& bids)
+    throw()
+  {
+    results.resize(bids.size());
+    std::vector<bool> confirmed(bids.size(), false);
+
+    ServiceBidsMap service_bids;
+
+    for(std::size_t bid_i = 0; bid_i < bids.size(); ++bid_i)
+    {
+      const BidConfirm& bid = bids[bid_i];
+
+      if(lease_mode_ && bid.spent_amount != RevenueDecimal::ZERO)
+      {
+        CCGLease_var lease = get_lease_(bid.ccg_id);
+
+        if(!lease)
+        {
+          // lease creation and remote confirm done by confirm_bid
+          continue;
+        }
+
+        if(lease->account_amount == bid.account_spent_amount &&
+          lease->amount == bid.spent_amount &&
+          confirm_lease_bid_(results[bid_i], now, lease, bid.imps, bid.clicks))
+        {
+          confirmed[bid_i] = true;
+          continue;
+        }
+      }
+
+      const long service_index = get_service_index_(
+        nullptr, // switched
+        now,
+        bid.ccg_id,
+        nullptr, // disabled_indexes
+        nullptr);
+
+      if(service_index != -1)
+      {
+        service_bids[service_index].push_back(bid_i);
+      }
+    }
+
+    for(auto service_it = service_bids.begin();
+      service_it != service_bids.end(); ++service_it)
+    {
+      const std::vector<std::size_t>& bid_indexes = service_it->second;
+
+      AdServer::CampaignSvcs::BillingServer::ConfirmBidSeq confirm_bid_seq;
+      confirm_bid_seq.length(bid_indexes.size());
+
+      for(CORBA::ULong req_i = 0; req_i < bid_indexes.size(); ++req_i)
+      {
+        const BidConfirm& bid = bids[bid_indexes[req_i]];
+        AdServer::CampaignSvcs::BillingServer::ConfirmBidInfo& confirm_bid_info =
+          confirm_bid_seq[req_i];
+        confirm_bid_info.time = CorbaAlgs::pack_time(now);
+        confirm_bid_info.account_id = bid.account_id;
+        confirm_bid_info.advertiser_id = bid.advertiser_id;
+        confirm_bid_info.campaign_id = bid.campaign_id;
+        confirm_bid_info.ccg_id = bid.ccg_id;
+        confirm_bid_info.ctr = CorbaAlgs::pack_decimal(bid.ctr);
+        confirm_bid_info.account_spent_budget =
+          CorbaAlgs::pack_decimal(bid.account_spent_amount);
+        confirm_bid_info.spent_budget = CorbaAlgs::pack_decimal(bid.spent_amount);
+        confirm_bid_info.reserved_budget = CorbaAlgs::pack_decimal(RevenueDecimal::ZERO);
+        confirm_bid_info.imps = CorbaAlgs::pack_decimal(bid.imps);
+        confirm_bid_info.clicks = CorbaAlgs::pack_decimal(bid.clicks);
+        confirm_bid_info.forced = false;
+      }
+
+      AdServer::CampaignSvcs::BillingServer::BidResultSeq_var confirm_result_seq;
+
+      // confirm_bid_seq is inout, can be confirmed part of amounts
+      if(!billing_server_call_(
+           confirm_result_seq,
+           service_it->first,
+           &BillingServer::confirm_bids,
+           confirm_bid_seq) ||
+         confirm_result_seq->length() != bid_indexes.size())
+      {
+        // nothing confirmed: confirm_bid will use other servers
+        SyncPolicy::WriteGuard lock(lock_);
+        for(auto bid_it = bid_indexes.begin(); bid_it != bid_indexes.end(); ++bid_it)
+        {
+          cache_[bids[*bid_it].ccg_id].disabled_indexes.insert(
+            std::make_pair(service_it->first, now));
+        }
+
+        continue;
+      }
+
+      // confirm can't be rollbacked: use results as confirm_bid do it
+      for(CORBA::ULong req_i = 0; req_i < bid_indexes.size(); ++req_i)
+      {
+        const std::size_t bid_i = bid_indexes[req_i];
+        const bool available = confirm_result_seq[req_i].available;
+        const RevenueDecimal goal_ctr = CorbaAlgs::unpack_decimal<RevenueDecimal>(
+          confirm_result_seq[req_i].goal_ctr);
+
+        BidCheckResult& result = results[bid_i];
+        result.deactivate_account = false;
+        result.deactivate_advertiser = false;
+        result.deactivate_campaign = false;
+        result.deactivate_ccg = !available;
+        result.available = available;
+        result.goal_ctr = goal_ctr;
+        confirmed[bid_i] = true;
+
+        if(!available)
+        {
+          ccg_set_available_(
+            bids[bid_i].ccg_setter, bids[bid_i].ccg_id, false, goal_ctr, now);
+        }
+      }
+    }
+
+    for(std::size_t bid_i = 0; bid_i < bids.size(); ++bid_i)
+    {
+      if(!confirmed[bid_i])
+      {
+        const BidConfirm& bid = bids[bid_i];
+
+        results[bid_i] = confirm_bid(
+          now,
+          bid.account_id,
+          bid.advertiser_id,
+          bid.campaign_id,
+          bid.ccg_id,
+          bid.account_spent_amount,
+          bid.spent_amount,
+          bid.ctr,
+          bid.imps,
+          bid.clicks,
+          bid.ccg_setter);
+      }
+    }
+  }
+
   BillingStateContainer::BidCheckResult
   BillingStateContainer::reserve_bid(
     const Generics::Time& /*now*/,
@@ -501,7 +888,7 @@ namespace CampaignSvcs
 
       try
       {
-        call_result = ((*billing_server).*call)(call_arg);
+        call_object(call_result, *billing_server, call, call_arg);
         return true;
       }
       catch(const AdServer::CampaignSvcs::BillingServer::NotReady&)
@@ -745,5 +1132,446 @@ namespace CampaignSvcs
       }
     }
   }
+
+  BillingStateContainer::CCGLease_var
+  BillingStateContainer::get_lease_(unsigned long ccg_id) const
+    throw()
+  {
+    SyncPolicy::ReadGuard lock(leases_lock_);
+    auto it = leases_.find(ccg_id);
+    return it != leases_.end() ? it->second : CCGLease_var();
+  }
+
+  void
+  BillingStateContainer::create_lease_(
+    const Generics::Time& now,
+    unsigned long account_id,
+    unsigned long advertiser_id,
+    unsigned long campaign_id,
+    unsigned long ccg_id,
+    const RevenueDecimal& account_amount,
+    const RevenueDecimal& amount,
+    const RevenueDecimal& ctr)
+    throw()
+  {
+    CCGLease_var new_lease = new CCGLease(
+      account_id,
+      advertiser_id,
+      campaign_id,
+      ccg_id,
+      account_amount,
+      amount,
+      ctr);
+
+    {
+      SyncPolicy::WriteGuard lock(leases_lock_);
+      if(!leases_.insert(std::make_pair(ccg_id, new_lease)).second)
+      {
+        // created by concurrent confirm
+        return;
+      }
+    }
+
+    plan_refill_(new_lease, now);
+  }
+
+  BillingStateContainer::BidCheckResult
+  BillingStateContainer::check_lease_bid_(
+    const Generics::Time& now,
+    CCGLease* lease,
+    const AvailableAndMinCTRSetter* ccg_setter)
+    throw()
+  {
+    const int bids = lease->bids;
+
+    BidCheckResult result;
+    result.deactivate_account = false;
+    result.deactivate_advertiser = false;
+    result.deactivate_campaign = false;
+
+    {
+      SyncPolicy::ReadGuard lock(lease->lock);
+      result.available = lease->available;
+      result.goal_ctr = lease->goal_ctr;
+    }
+
+    // allow bids while confirms can be done over lease
+    result.available = result.available &&
+      bids + static_cast<long>(lease_config_.max_overspend) > 0;
+    result.deactivate_ccg = !result.available;
+
+    if(bids <= static_cast<long>(lease_config_.refill_size))
+    {
+      plan_refill_(lease, now);
+    }
+
+    if(!result.available)
+    {
+      ccg_set_available_(ccg_setter, lease->ccg_id, false, result.goal_ctr, now);
+    }
+
+    return result;
+  }
+
+  bool
+  BillingStateContainer::confirm_lease_bid_(
+    BidCheckResult& result,
+    const Generics::Time& now,
+    CCGLease* lease,
+    const RevenueDecimal& imps,
+    const RevenueDecimal& clicks)
+    throw()
+  {
+    const int prev_bids = lease->bids.exchange_and_add(-1);
+
+    if(prev_bids <= static_cast<long>(lease_config_.refill_size) + 1)
+    {
+      plan_refill_(lease, now);
+    }
+
+    if(prev_bids + static_cast<long>(lease_config_.max_overspend) <= 0)
+    {
+      // overspend limit reached
+      lease->bids += 1;
+      return false;
+    }
+
+    lease->spent_bids += 1;
+
+    {
+      DeliverySyncPolicy::WriteGuard lock(lease->delivery_lock);
+      lease->imps += imps;
+      lease->clicks += clicks;
+    }
+
+    result.deactivate_account = false;
+    result.deactivate_advertiser = false;
+    result.deactivate_campaign = false;
+    result.deactivate_ccg = false;
+    result.available = true;
+
+    {
+      SyncPolicy::ReadGuard lock(lease->lock);
+      result.goal_ctr = lease->goal_ctr;
+    }
+
+    return true;
+  }
+
+  void
+  BillingStateContainer::plan_refill_(
+    CCGLease* lease,
+    const Generics::Time& now)
+    throw()
+  {
+    static const char* FUN = "BillingStateContainer::plan_refill_()";
+
+    if(lease->refill_planned)
+    {
+      return;
+    }
+
+    {
+      SyncPolicy::WriteGuard lock(lease->lock);
+
+      if(lease->refill_planned ||
+        (!lease->available &&
+         now < lease->unavailable_time + REENABLE_INDEX_TIME))
+      {
+        return;
+      }
+
+      lease->refill_planned += 1;
+    }
+
+    try
+    {
+      task_runner_->enqueue_task(
+        Commons::make_delegate_task(
+          std::bind(
+            &BillingStateContainer::refill_lease_,
+            this,
+            CCGLease_var(ReferenceCounting::add_ref(lease)))));
+    }
+    catch(const eh::Exception& ex)
+    {
+      {
+        SyncPolicy::WriteGuard lock(lease->lock);
+        lease->refill_planned -= 1;
+      }
+
+      Stream::Error ostr;
+      ostr << FUN << ": Can't enqueue lease refill task. "
+        "eh::Exception caught:" << ex.what();
+
+      logger_->log(ostr.str(),
+        Logging::Logger::ERROR,
+        Aspect::BILLING_STATE_CONTAINER,
+        "ADS-IMPL-?");
+    }
+  }
+
+  void
+  BillingStateContainer::refill_lease_(const CCGLease_var& lease)
+    throw()
+  {
+    const Generics::Time now = Generics::Time::get_time_of_day();
+
+    // cover overspent bids by new lease
+    const int bids = lease->bids;
+    const unsigned long request_bids = lease_config_.size +
+      (bids < 0 ? static_cast<unsigned long>(-bids) : 0);
+    const RevenueDecimal request_account_amount = RevenueDecimal::mul(
+      lease->account_amount,
+      RevenueDecimal(false, request_bids, 0),
+      Generics::DMR_FLOOR);
+    const RevenueDecimal request_amount = RevenueDecimal::mul(
+      lease->amount,
+      RevenueDecimal(false, request_bids, 0),
+      Generics::DMR_FLOOR);
+
+    AdServer::CampaignSvcs::BillingServer::LeaseBudgetInfo lease_budget_info;
+    lease_budget_info.time = CorbaAlgs::pack_time(now);
+    lease_budget_info.account_id = lease->account_id;
+    lease_budget_info.advertiser_id = lease->advertiser_id;
+    lease_budget_info.campaign_id = lease->campaign_id;
+    lease_budget_info.ccg_id = lease->ccg_id;
+    lease_budget_info.ctr = CorbaAlgs::pack_decimal(lease->ctr);
+    lease_budget_info.optimize_campaign_ctr = optimize_campaign_ctr_;
+    lease_budget_info.account_amount = CorbaAlgs::pack_decimal(request_account_amount);
+    lease_budget_info.amount = CorbaAlgs::pack_decimal(request_amount);
+
+    AdServer::CampaignSvcs::BillingServer::BidResultInfo_var lease_result;
+    long service_index = -1;
+
+    for(unsigned long try_i = 0; try_i < max_try_count_; ++try_i)
+    {
+      service_index = get_service_index_(
+        nullptr, // switched
+        now,
+        lease->ccg_id,
+        nullptr, // disabled_indexes
+        nullptr);
+
+      if(service_index == -1)
+      {
+        break;
+      }
+
+      // lease_budget_info is inout, can be leased part of amount
+      if(lease_budget_(lease_result, service_index, lease_budget_info))
+      {
+        break;
+      }
+
+      SyncPolicy::WriteGuard lock(lock_);
+      cache_[lease->ccg_id].disabled_indexes.insert(
+        std::make_pair(service_index, now));
+      service_index = -1;
+    }
+
+    if(service_index == -1 || !lease_result)
+    {
+      // servers unavailable: bids over lease will be confirmed remotely
+      SyncPolicy::WriteGuard lock(lease->lock);
+      lease->refill_planned -= 1;
+      return;
+    }
+
+    const RevenueDecimal leased_account_amount = request_account_amount -
+      CorbaAlgs::unpack_decimal<RevenueDecimal>(lease_budget_info.account_amount);
+    const RevenueDecimal leased_amount = request_amount -
+      CorbaAlgs::unpack_decimal<RevenueDecimal>(lease_budget_info.amount);
+
+    const unsigned long leased_bids = RevenueDecimal::div(
+      leased_amount,
+      lease->amount).floor(0).integer<unsigned long>();
+
+    lease->bids += static_cast<int>(leased_bids);
+
+    // partial lease: return amount that isn't enough for whole bid
+    const RevenueDecimal leased_bids_decimal(false, leased_bids, 0);
+    const RevenueDecimal bids_account_amount = RevenueDecimal::mul(
+      lease->account_amount, leased_bids_decimal, Generics::DMR_FLOOR);
+    const RevenueDecimal bids_amount = RevenueDecimal::mul(
+      lease->amount, leased_bids_decimal, Generics::DMR_FLOOR);
+
+    {
+      SyncPolicy::WriteGuard lock(lease->lock);
+      lease->service_index = service_index;
+      lease->available = lease_result->available || leased_bids > 0;
+      lease->goal_ctr = CorbaAlgs::unpack_decimal<RevenueDecimal>(
+        lease_result->goal_ctr);
+      if(!lease->available)
+      {
+        lease->unavailable_time = now;
+      }
+    }
+
+    if(leased_account_amount > bids_account_amount ||
+      leased_amount > bids_amount)
+    {
+      return_lease_amount_(
+        lease,
+        now,
+        leased_account_amount > bids_account_amount ?
+          leased_account_amount - bids_account_amount : RevenueDecimal::ZERO,
+        leased_amount > bids_amount ?
+          leased_amount - bids_amount : RevenueDecimal::ZERO,
+        0,
+        0);
+    }
+
+    SyncPolicy::WriteGuard lock(lease->lock);
+    lease->refill_planned -= 1;
+  }
+
+  bool
+  BillingStateContainer::return_lease_amount_(
+    CCGLease* lease,
+    const Generics::Time& now,
+    const RevenueDecimal& account_amount,
+    const RevenueDecimal& amount,
+    const RevenueDecimal& imps,
+    const RevenueDecimal& clicks)
+    throw()
+  {
+    long service_index;
+
+    {
+      SyncPolicy::ReadGuard lock(lease->lock);
+      service_index = lease->service_index;
+    }
+
+    if(service_index == -1)
+    {
+      return false;
+    }
+
+    // return to server of last lease,
+    // amounts of servers will be corrected by stats
+    AdServer::CampaignSvcs::BillingServer::ReturnBudgetInfo return_budget_info;
+    return_budget_info.time = CorbaAlgs::pack_time(now);
+    return_budget_info.account_id = lease->account_id;
+    return_budget_info.advertiser_id = lease->advertiser_id;
+    return_budget_info.campaign_id = lease->campaign_id;
+    return_budget_info.ccg_id = lease->ccg_id;
+    return_budget_info.ctr = CorbaAlgs::pack_decimal(lease->ctr);
+    return_budget_info.account_amount = CorbaAlgs::pack_decimal(account_amount);
+    return_budget_info.amount = CorbaAlgs::pack_decimal(amount);
+    return_budget_info.imps = CorbaAlgs::pack_decimal(imps);
+    return_budget_info.clicks = CorbaAlgs::pack_decimal(clicks);
+
+    return return_budget_(service_index, return_budget_info);
+  }
+
+  void
+  BillingStateContainer::return_leases_() throw()
+  {
+    std::vector<CCGLease_var> leases;
+
+    {
+      SyncPolicy::ReadGuard lock(leases_lock_);
+      leases.reserve(leases_.size());
+      for(auto it = leases_.begin(); it != leases_.end(); ++it)
+      {
+        leases.push_back(it->second);
+      }
+    }
+
+    const Generics::Time now = Generics::Time::get_time_of_day();
+
+    for(auto it = leases.begin(); it != leases.end(); ++it)
+    {
+      CCGLease* lease = *it;
+
+      const int spent_bids = lease->spent_bids;
+      lease->spent_bids -= spent_bids;
+      RevenueDecimal imps;
+      RevenueDecimal clicks;
+
+      {
+        DeliverySyncPolicy::WriteGuard lock(lease->delivery_lock);
+        imps = lease->imps;
+        clicks = lease->clicks;
+        lease->imps = RevenueDecimal::ZERO;
+        lease->clicks = RevenueDecimal::ZERO;
+      }
+
+      // lease isn't used during period: return remainder
+      // active leases are renewed by refill
+      int return_bids = 0;
+
+      if(spent_bids == 0 && !lease->refill_planned)
+      {
+        // take available bids with CAS: counter can be decremented
+        // by concurrent confirms
+        int bids = lease->bids;
+        while(bids > 0 && !lease->bids.compare_and_swap(bids, 0))
+        {
+          bids = lease->bids;
+        }
+
+        return_bids = std::max(bids, 0);
+      }
+
+      if(return_bids == 0 &&
+         imps == RevenueDecimal::ZERO &&
+         clicks == RevenueDecimal::ZERO)
+      {
+        continue;
+      }
+
+      const RevenueDecimal return_bids_decimal(false, return_bids, 0);
+
+      if(!return_lease_amount_(
+           lease,
+           now,
+           RevenueDecimal::mul(
+             lease->account_amount, return_bids_decimal, Generics::DMR_FLOOR),
+           RevenueDecimal::mul(
+             lease->amount, return_bids_decimal, Generics::DMR_FLOOR),
+           imps,
+           clicks))
+      {
+        // keep not returned bids and delivery for next try
+        lease->bids += return_bids;
+
+        DeliverySyncPolicy::WriteGuard lock(lease->delivery_lock);
+        lease->imps += imps;
+        lease->clicks += clicks;
+      }
+    }
+  }
+
+  bool
+  BillingStateContainer::lease_budget_(
+    AdServer::CampaignSvcs::BillingServer::BidResultInfo_var& lease_result,
+    unsigned long service_index,
+    AdServer::CampaignSvcs::BillingServer::LeaseBudgetInfo& lease_budget_info)
+    throw()
+  {
+    return billing_server_call_(
+      lease_result,
+      service_index,
+      &BillingServer::lease_budget,
+      lease_budget_info);
+  }
+
+  bool
+  BillingStateContainer::return_budget_(
+    unsigned long service_index,
+    const AdServer::CampaignSvcs::BillingServer::ReturnBudgetInfo&
+      return_budget_info)
+    throw()
+  {
+    NoCallResult no_result;
+
+    return billing_server_call_(
+      no_result,
+      service_index,
+      &BillingServer::return_budget,
+      return_budget_info);
+  }
 }
 }
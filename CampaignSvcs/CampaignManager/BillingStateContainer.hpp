@@ -22,6 +22,8 @@
 #define CAMPAIGNMANAGER_BILLINGSTATECONTAINER_HPP_
 
 #include <deque>
+#include <map>
+#include <vector>
 
 #include <ReferenceCounting/ReferenceCounting.hpp>
 #include <ReferenceCounting/AtomicImpl.hpp>
@@ -37,6 +39,7 @@
 #include <CORBACommons/ObjectPool.hpp>
 
 #include <CampaignSvcs/CampaignCommons/CampaignTypes.hpp>
+#include <Commons/AtomicInt.hpp>
 #include <Commons/CorbaObject.hpp>
 
 #include <CampaignSvcs/BillingServer/BillingServer.hpp>
@@ -48,6 +51,11 @@ namespace CampaignSvcs
   // BillingStateContainer
   // wrapper for delivery limits checking (BillingServer)
   //
+  // lease mode: budget for number of bids is leased per ccg from BillingServer
+  // and spent locally (check_available_bid, confirm_bid don't call BillingServer),
+  // lease is refilled asynchronously when reminder is low,
+  // remainders of not used leases are returned periodically.
+  //
   // TODO: background deactivated campaigns checking (CompositeActiveObject for this)
   //
   class BillingStateContainer:
@@ -88,15 +96,55 @@ namespace CampaignSvcs
       RevenueDecimal goal_ctr;
     };
 
+    typedef std::vector<BidCheckResult> BidCheckResultArray;
+
+    struct BidCheck
+    {
+      unsigned long account_id;
+      unsigned long advertiser_id;
+      unsigned long campaign_id;
+      unsigned long ccg_id;
+      RevenueDecimal ctr;
+      const AvailableAndMinCTRSetter* ccg_setter;
+    };
+
+    typedef std::vector<BidCheck> BidCheckArray;
+
+    struct BidConfirm: public BidCheck
+    {
+      RevenueDecimal account_spent_amount;
+      RevenueDecimal spent_amount;
+      RevenueDecimal imps;
+      RevenueDecimal clicks;
+    };
+
+    typedef std::vector<BidConfirm> BidConfirmArray;
+
+    struct LeaseConfig
+    {
+      LeaseConfig() throw();
+
+      // number of bids leased by one call
+      unsigned long size;
+      // refill lease when reminder is less than refill_size bids
+      unsigned long refill_size;
+      // number of bids that can be confirmed over lease (while it is refilled)
+      unsigned long max_overspend;
+      // period of not used remainders return
+      Generics::Time return_period;
+    };
+
     /*
      * max_use_count : number of calls after that need to switch BillingServer
+     * lease_config : enable lease mode if defined
      */
     BillingStateContainer(
       Generics::ActiveObjectCallback* callback,
       Logging::Logger* logger,
       const CORBACommons::CorbaObjectRefList& billing_server_refs,
       unsigned long max_use_count,
-      bool optimize_campaign_ctr)
+      bool optimize_campaign_ctr,
+      const LeaseConfig* lease_config = nullptr)
       throw();
 
     BidCheckResult
@@ -125,6 +173,21 @@ namespace CampaignSvcs
       const AvailableAndMinCTRSetter* ccg_setter)
       throw();
 
+    // check bids of one request by one call for each used BillingServer
+    void
+    check_available_bids(
+      BidCheckResultArray& results,
+      const Generics::Time& now,
+      const BidCheckArray& bids)
+      throw();
+
+    void
+    confirm_bids(
+      BidCheckResultArray& results,
+      const Generics::Time& now,
+      const BidConfirmArray& bids)
+      throw();
+
     BidCheckResult
     reserve_bid(
       const Generics::Time& now,
@@ -139,6 +202,7 @@ namespace CampaignSvcs
 
   protected:
     typedef Sync::Policy::PosixThreadRW SyncPolicy;
+    typedef Sync::Policy::PosixThread DeliverySyncPolicy;
 
     typedef std::map<unsigned long, Generics::Time>
       DisabledIndexMap;
@@ -207,8 +271,61 @@ namespace CampaignSvcs
     typedef std::vector<BillingServerDescr> BillingServerDescrArray;
     typedef std::map<unsigned long, Generics::Time> CCGCheckTimeMap;
 
+    // service index => indexes of batch bids
+    typedef std::map<long, std::vector<std::size_t> > ServiceBidsMap;
+
     class RecheckCCGTask;
 
+    // budget leased for ccg, amounts confirmed on BillingServer
+    // at lease and spent by bids with fixed amount
+    struct CCGLease: public ReferenceCounting::AtomicImpl
+    {
+      CCGLease(
+        unsigned long account_id_val,
+        unsigned long advertiser_id_val,
+        unsigned long campaign_id_val,
+        unsigned long ccg_id_val,
+        const RevenueDecimal& account_amount_val,
+        const RevenueDecimal& amount_val,
+        const RevenueDecimal& ctr_val)
+        throw();
+
+      const unsigned long account_id;
+      const unsigned long advertiser_id;
+      const unsigned long campaign_id;
+      const unsigned long ccg_id;
+      // amounts of one bid
+      const RevenueDecimal account_amount;
+      const RevenueDecimal amount;
+      const RevenueDecimal ctr;
+
+      // available bids, negative if overspent
+      Algs::AtomicInt bids;
+      // spent bids since last return check
+      Algs::AtomicInt spent_bids;
+      // changed under lock
+      Algs::AtomicInt refill_planned;
+
+      // delivery since last return check (bids can have fractional
+      // imps, clicks), changed under delivery_lock
+      mutable DeliverySyncPolicy::Mutex delivery_lock;
+      RevenueDecimal imps;
+      RevenueDecimal clicks;
+
+      mutable SyncPolicy::Mutex lock;
+      bool available;
+      RevenueDecimal goal_ctr;
+      Generics::Time unavailable_time;
+      long service_index;
+
+    protected:
+      virtual
+      ~CCGLease() throw() = default;
+    };
+
+    typedef ReferenceCounting::SmartPtr<CCGLease> CCGLease_var;
+    typedef std::map<unsigned long, CCGLease_var> CCGLeaseMap;
+
   protected:
     virtual
     ~BillingStateContainer() throw() = default;
@@ -262,6 +379,77 @@ namespace CampaignSvcs
       const Generics::Time& now)
       throw();
 
+    // lease mode
+    CCGLease_var
+    get_lease_(unsigned long ccg_id) const
+      throw();
+
+    void
+    create_lease_(
+      const Generics::Time& now,
+      unsigned long account_id,
+      unsigned long advertiser_id,
+      unsigned long campaign_id,
+      unsigned long ccg_id,
+      const RevenueDecimal& account_amount,
+      const RevenueDecimal& amount,
+      const RevenueDecimal& ctr)
+      throw();
+
+    BidCheckResult
+    check_lease_bid_(
+      const Generics::Time& now,
+      CCGLease* lease,
+      const AvailableAndMinCTRSetter* ccg_setter)
+      throw();
+
+    bool
+    confirm_lease_bid_(
+      BidCheckResult& result,
+      const Generics::Time& now,
+      CCGLease* lease,
+      const RevenueDecimal& imps,
+      const RevenueDecimal& clicks)
+      throw();
+
+    void
+    plan_refill_(
+      CCGLease* lease,
+      const Generics::Time& now)
+      throw();
+
+    void
+    refill_lease_(const CCGLease_var& lease)
+      throw();
+
+    bool
+    return_lease_amount_(
+      CCGLease* lease,
+      const Generics::Time& now,
+      const RevenueDecimal& account_amount,
+      const RevenueDecimal& amount,
+      const RevenueDecimal& imps,
+      const RevenueDecimal& clicks)
+      throw();
+
+    void
+    return_leases_() throw();
+
+    // BillingServer calls of lease mode (overridden by tests)
+    virtual bool
+    lease_budget_(
+      AdServer::CampaignSvcs::BillingServer::BidResultInfo_var& lease_result,
+      unsigned long service_index,
+      AdServer::CampaignSvcs::BillingServer::LeaseBudgetInfo& lease_budget_info)
+      throw();
+
+    virtual bool
+    return_budget_(
+      unsigned long service_index,
+      const AdServer::CampaignSvcs::BillingServer::ReturnBudgetInfo&
+        return_budget_info)
+      throw();
+
   protected:
     Logging::Logger_var logger_;
     Generics::TaskRunner_var task_runner_;
@@ -281,6 +469,12 @@ namespace CampaignSvcs
 
     mutable SyncPolicy::Mutex add_recheck_ccgs_lock_;
     CCGCheckTimeMap add_recheck_ccgs_;
+
+    const bool lease_mode_;
+    const LeaseConfig lease_config_;
+
+    mutable SyncPolicy::Mutex leases_lock_;
+    CCGLeaseMap leases_;
   };
 
   typedef ReferenceCounting::QualPtr<BillingStateContainer>
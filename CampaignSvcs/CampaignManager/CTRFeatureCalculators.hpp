@@ -21,6 +21,7 @@
 #ifndef CTRFEATURECALCULATORS_HPP_
 #define CTRFEATURECALCULATORS_HPP_
 
+#include <vector>
 #include <eh/Exception.hpp>
 #include <ReferenceCounting/AtomicImpl.hpp>
 #include <ReferenceCounting/SmartPtr.hpp>
@@ -29,6 +30,7 @@
 #include <CampaignSvcs/CampaignCommons/CampaignTypes.hpp>
 
 #include "CampaignSelectParams.hpp"
+#include "CTRMurmurHash.hpp"
 
 namespace AdServer
 {
@@ -40,32 +42,72 @@ namespace CampaignSvcs
   {
     typedef std::vector<std::pair<uint32_t, uint32_t> > HashArray;
 
-    typedef Generics::GnuHashTable<
-      Generics::NumericHashAdapter<uint32_t>, uint32_t>
-      HashMap;
+    // HashMap
+    // hash mapping (feature index => weight index), filled once at config
+    // load and looked up for each evaluated feature: flat open addressing
+    // table (linear probing) instead of node based hash table,
+    // key 0 is kept out of table (used as empty cell marker)
+    class HashMap
+    {
+    public:
+      HashMap() throw();
+
+      // keep first value for duplicate key
+      void
+      insert(uint32_t key, uint32_t value) throw(eh::Exception);
+
+      bool
+      find(uint32_t& value, uint32_t key) const throw();
+
+      std::size_t
+      size() const throw();
+
+    protected:
+      struct Cell
+      {
+        uint32_t key;
+        uint32_t value;
+      };
+
+      typedef std::vector<Cell> CellArray;
+
+    protected:
+      std::size_t
+      cell_index_(uint32_t key) const throw();
+
+      void
+      rehash_(unsigned long capacity_bits) throw(eh::Exception);
+
+    protected:
+      CellArray cells_;
+      unsigned long capacity_bits_;
+      std::size_t size_;
+      bool zero_key_defined_;
+      uint32_t zero_key_value_;
+    };
 
     struct FeatureWeightTable: public std::vector<float>
     {
       unsigned long shifter;
     };
 
-    struct Murmur32v3Adapter: public Generics::Murmur32v3Hasher
+    struct Murmur32v3Adapter: public Murmur32v3BatchHasher
     {
       Murmur32v3Adapter(std::size_t hash_seed)
-        : Generics::Murmur32v3Hasher(hash_seed)
+        : Murmur32v3BatchHasher(hash_seed)
       {}
 
       template <typename Value>
       void
       add(const Value& value) throw ()
       {
-        Generics::Murmur32v3Hasher::add(&value, sizeof(value));
+        Murmur32v3BatchHasher::add(&value, sizeof(value));
       }
 
       void
       add(const std::string& value) throw()
       {
-        Generics::Murmur32v3Hasher::add(value.data(), value.size());
+        Murmur32v3BatchHasher::add(value.data(), value.size());
       }
     };
 
@@ -127,19 +169,10 @@ namespace CampaignSvcs
 
         if(hash_mapping)
         {
-          auto it = hash_mapping->find(index);
-          if(it != hash_mapping->end())
-          {
-            index = it->second;
-            return true;
-          }
-        }
-        else
-        {
-          return true;
+          return hash_mapping->find(index, index);
         }
 
-        return false;
+        return true;
       }
 
       float
@@ -298,6 +331,32 @@ namespace CampaignSvcs
       {}
 
     protected:
+      static const std::size_t HASH_BATCH_SIZE = 32;
+
+      // hashes of next (up to HASH_BATCH_SIZE) elements added to
+      // hash_adapter state, it is moved to first not processed element
+      template<typename IteratorType>
+      static std::size_t
+      eval_hashes_batch_(
+        uint32_t* hashes,
+        IteratorType& it,
+        const IteratorType& end,
+        const Murmur32v3Adapter& hash_adapter)
+        throw()
+      {
+        uint32_t values[HASH_BATCH_SIZE];
+        std::size_t count = 0;
+
+        for(; it != end && count < HASH_BATCH_SIZE; ++it, ++count)
+        {
+          values[count] = static_cast<uint32_t>(*it);
+        }
+
+        hash_adapter.finalize_batch(hashes, values, count);
+
+        return count;
+      }
+
       float
       eval_final_(
         Murmur32v3Adapter& hash_adapter,
@@ -308,12 +367,18 @@ namespace CampaignSvcs
         float result_weight = 0;
         if(!elements.empty())
         {
-          for(auto it = elements.begin(); it != elements.end(); ++it)
+          uint32_t hashes[HASH_BATCH_SIZE];
+          auto it = elements.begin();
+
+          while(it != elements.end())
           {
-            // need local hasher
-            Murmur32v3Adapter hash_adapter_copy(hash_adapter);
-            hash_adapter_copy.add(static_cast<uint32_t>(*it));
-            result_weight += weight_(hash_mapping, hash_adapter_copy.finalize());
+            const std::size_t count = eval_hashes_batch_(
+              hashes, it, elements.end(), hash_adapter);
+
+            for(std::size_t i = 0; i < count; ++i)
+            {
+              result_weight += weight_(hash_mapping, hashes[i]);
+            }
           }
         }
         else
@@ -336,15 +401,21 @@ namespace CampaignSvcs
       {
         if(!elements.empty())
         {
-          for(auto it = elements.begin(); it != elements.end(); ++it)
+          uint32_t hashes[HASH_BATCH_SIZE];
+          auto it = elements.begin();
+
+          while(it != elements.end())
           {
-            // need local hasher
-            Murmur32v3Adapter hash_adapter_copy(hash_adapter);
-            hash_adapter_copy.add(static_cast<uint32_t>(*it));
-            uint32_t index;
-            if(hash_index_(index, hash_mapping, hash_adapter_copy.finalize()))
+            const std::size_t count = eval_hashes_batch_(
+              hashes, it, elements.end(), hash_adapter);
+
+            for(std::size_t i = 0; i < count; ++i)
             {
-              result_hashes.push_back(std::make_pair(index, 1));
+              uint32_t index;
+              if(hash_index_(index, hash_mapping, hashes[i]))
+              {
+                result_hashes.push_back(std::make_pair(index, 1));
+              }
             }
           }
         }
@@ -777,4 +848,134 @@ namespace CampaignSvcs
 }
 }
 
+namespace AdServer
+{
+namespace CampaignSvcs
+{
+  namespace CTR
+  {
+    // HashMap
+    inline
+    HashMap::HashMap() throw()
+      : capacity_bits_(0),
+        size_(0),
+        zero_key_defined_(false),
+        zero_key_value_(0)
+    {}
+
+    inline
+    std::size_t
+    HashMap::cell_index_(uint32_t key) const throw()
+    {
+      // keys can be shifted hashes: mix all bits (fibonacci hashing)
+      return static_cast<uint32_t>(key * 2654435769U) >>
+        (32 - capacity_bits_);
+    }
+
+    inline
+    void
+    HashMap::rehash_(unsigned long capacity_bits) throw(eh::Exception)
+    {
+      CellArray old_cells(1UL << capacity_bits, Cell{0, 0});
+      old_cells.swap(cells_);
+      capacity_bits_ = capacity_bits;
+
+      const std::size_t mask = cells_.size() - 1;
+
+      for(auto cell_it = old_cells.begin(); cell_it != old_cells.end(); ++cell_it)
+      {
+        if(cell_it->key != 0)
+        {
+          std::size_t i = cell_index_(cell_it->key);
+          while(cells_[i].key != 0)
+          {
+            i = (i + 1) & mask;
+          }
+          cells_[i] = *cell_it;
+        }
+      }
+    }
+
+    inline
+    void
+    HashMap::insert(uint32_t key, uint32_t value) throw(eh::Exception)
+    {
+      if(key == 0)
+      {
+        if(!zero_key_defined_)
+        {
+          zero_key_defined_ = true;
+          zero_key_value_ = value;
+          ++size_;
+        }
+
+        return;
+      }
+
+      // keep load factor <= 0.5
+      if((size_ + 1) * 2 > cells_.size())
+      {
+        rehash_(capacity_bits_ ? capacity_bits_ + 1 : 4);
+      }
+
+      const std::size_t mask = cells_.size() - 1;
+      std::size_t i = cell_index_(key);
+
+      while(cells_[i].key != 0)
+      {
+        if(cells_[i].key == key)
+        {
+          return;
+        }
+
+        i = (i + 1) & mask;
+      }
+
+      cells_[i].key = key;
+      cells_[i].value = value;
+      ++size_;
+    }
+
+    inline
+    bool
+    HashMap::find(uint32_t& value, uint32_t key) const throw()
+    {
+      if(key == 0)
+      {
+        value = zero_key_value_;
+        return zero_key_defined_;
+      }
+
+      if(cells_.empty())
+      {
+        return false;
+      }
+
+      const std::size_t mask = cells_.size() - 1;
+      std::size_t i = cell_index_(key);
+
+      while(cells_[i].key != 0)
+      {
+        if(cells_[i].key == key)
+        {
+          value = cells_[i].value;
+          return true;
+        }
+
+        i = (i + 1) & mask;
+      }
+
+      return false;
+    }
+
+    inline
+    std::size_t
+    HashMap::size() const throw()
+    {
+      return size_;
+    }
+  }
+}
+}
+
 #endif /*CTRFEATURECALCULATORS_HPP_*/
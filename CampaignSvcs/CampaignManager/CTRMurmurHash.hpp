@@ -0,0 +1,309 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CTRMURMURHASH_HPP_
+#define CTRMURMURHASH_HPP_
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
+namespace AdServer
+{
+namespace CampaignSvcs
+{
+  namespace CTR
+  {
+    // Murmur32v3BatchHasher
+    // incremental MurmurHash3 (x86_32) with open state, result is bit exact
+    // with Generics::Murmur32v3Hasher (trained models are keyed by it).
+    // Open state allow to finalize hashes for few values added to common
+    // prefix by one batch (SIMD) pass: array features add each array
+    // element to hash of other feature parts.
+    class Murmur32v3BatchHasher
+    {
+    public:
+      Murmur32v3BatchHasher(std::size_t hash_seed) throw();
+
+      void
+      add(const void* data, std::size_t size) throw();
+
+      std::size_t
+      finalize() const throw();
+
+      // result[i] = hash of (current state + values[i]),
+      // equal to copy of hasher with add(values[i]) and finalize()
+      void
+      finalize_batch(
+        uint32_t* result,
+        const uint32_t* values,
+        std::size_t count) const
+        throw();
+
+    protected:
+      static uint32_t
+      rotl_(uint32_t x, int r) throw();
+
+      static uint32_t
+      mix_block_(uint32_t k1) throw();
+
+      static uint32_t
+      fmix_(uint32_t h) throw();
+
+      void
+      finalize_batch_scalar_(
+        uint32_t* result,
+        const uint32_t* values,
+        std::size_t count) const
+        throw();
+
+    protected:
+      uint32_t h1_;
+      uint32_t tail_; // unprocessed bytes (little endian)
+      uint32_t tail_size_;
+      uint32_t length_;
+    };
+  }
+}
+}
+
+namespace AdServer
+{
+namespace CampaignSvcs
+{
+  namespace CTR
+  {
+    namespace Murmur32v3
+    {
+      const uint32_t C1 = 0xcc9e2d51;
+      const uint32_t C2 = 0x1b873593;
+      const uint32_t M = 5;
+      const uint32_t N = 0xe6546b64;
+      const uint32_t F1 = 0x85ebca6b;
+      const uint32_t F2 = 0xc2b2ae35;
+    }
+
+    inline
+    Murmur32v3BatchHasher::Murmur32v3BatchHasher(std::size_t hash_seed)
+      throw()
+      : h1_(static_cast<uint32_t>(hash_seed)),
+        tail_(0),
+        tail_size_(0),
+        length_(0)
+    {}
+
+    inline
+    uint32_t
+    Murmur32v3BatchHasher::rotl_(uint32_t x, int r) throw()
+    {
+      return (x << r) | (x >> (32 - r));
+    }
+
+    inline
+    uint32_t
+    Murmur32v3BatchHasher::mix_block_(uint32_t k1) throw()
+    {
+      k1 *= Murmur32v3::C1;
+      k1 = rotl_(k1, 15);
+      return k1 * Murmur32v3::C2;
+    }
+
+    inline
+    uint32_t
+    Murmur32v3BatchHasher::fmix_(uint32_t h) throw()
+    {
+      h ^= h >> 16;
+      h *= Murmur32v3::F1;
+      h ^= h >> 13;
+      h *= Murmur32v3::F2;
+      h ^= h >> 16;
+      return h;
+    }
+
+    inline
+    void
+    Murmur32v3BatchHasher::add(const void* data, std::size_t size) throw()
+    {
+      const unsigned char* buf = static_cast<const unsigned char*>(data);
+      const unsigned char* end = buf + size;
+      length_ += size;
+
+      // complete pending block
+      for(; tail_size_ && buf != end; ++buf)
+      {
+        tail_ |= static_cast<uint32_t>(*buf) << (8 * tail_size_);
+
+        if(++tail_size_ == 4)
+        {
+          h1_ ^= mix_block_(tail_);
+          h1_ = rotl_(h1_, 13) * Murmur32v3::M + Murmur32v3::N;
+          tail_ = 0;
+          tail_size_ = 0;
+        }
+      }
+
+      for(; end - buf >= 4; buf += 4)
+      {
+        const uint32_t k1 = static_cast<uint32_t>(buf[0]) |
+          (static_cast<uint32_t>(buf[1]) << 8) |
+          (static_cast<uint32_t>(buf[2]) << 16) |
+          (static_cast<uint32_t>(buf[3]) << 24);
+        h1_ ^= mix_block_(k1);
+        h1_ = rotl_(h1_, 13) * Murmur32v3::M + Murmur32v3::N;
+      }
+
+      for(; buf != end; ++buf)
+      {
+        tail_ |= static_cast<uint32_t>(*buf) << (8 * tail_size_);
+        ++tail_size_;
+      }
+    }
+
+    inline
+    std::size_t
+    Murmur32v3BatchHasher::finalize() const throw()
+    {
+      uint32_t h = h1_;
+
+      if(tail_size_)
+      {
+        h ^= mix_block_(tail_);
+      }
+
+      return fmix_(h ^ length_);
+    }
+
+    inline
+    void
+    Murmur32v3BatchHasher::finalize_batch_scalar_(
+      uint32_t* result,
+      const uint32_t* values,
+      std::size_t count) const
+      throw()
+    {
+      for(std::size_t i = 0; i < count; ++i)
+      {
+        Murmur32v3BatchHasher hasher(*this);
+        hasher.add(&values[i], sizeof(values[i]));
+        result[i] = hasher.finalize();
+      }
+    }
+
+#if defined(__SSE2__)
+    namespace Murmur32v3
+    {
+      // 32 bit lanes multiplication (SSE2 have only 32x32=>64 for 2 lanes)
+      inline
+      __m128i
+      mul(__m128i a, __m128i b) throw()
+      {
+        const __m128i even = _mm_mul_epu32(a, b);
+        const __m128i odd = _mm_mul_epu32(
+          _mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+        return _mm_unpacklo_epi32(
+          _mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+          _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+      }
+
+      template<int R>
+      inline
+      __m128i
+      rotl(__m128i x) throw()
+      {
+        return _mm_or_si128(_mm_slli_epi32(x, R), _mm_srli_epi32(x, 32 - R));
+      }
+
+      inline
+      __m128i
+      mix_block(__m128i k1) throw()
+      {
+        return mul(rotl<15>(mul(k1, _mm_set1_epi32(C1))), _mm_set1_epi32(C2));
+      }
+    }
+
+    inline
+    void
+    Murmur32v3BatchHasher::finalize_batch(
+      uint32_t* result,
+      const uint32_t* values,
+      std::size_t count) const
+      throw()
+    {
+      // SSE2 path: values are little endian words (x86)
+      using namespace Murmur32v3;
+
+      // value bytes complete pending block (tail_size_ bytes) and
+      // rest of value bytes (tail_size_ bytes) become new tail
+      const __m128i tail = _mm_set1_epi32(tail_);
+      const __m128i h1 = _mm_set1_epi32(h1_);
+      const __m128i length = _mm_set1_epi32(length_ + sizeof(uint32_t));
+      const __m128i block_shift = _mm_cvtsi32_si128(8 * tail_size_);
+      const __m128i tail_shift = _mm_cvtsi32_si128(32 - 8 * tail_size_);
+
+      std::size_t i = 0;
+
+      for(; i + 4 <= count; i += 4)
+      {
+        const __m128i value = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(values + i));
+
+        __m128i h = _mm_xor_si128(
+          h1,
+          mix_block(_mm_or_si128(tail, _mm_sll_epi32(value, block_shift))));
+        h = _mm_add_epi32(
+          mul(rotl<13>(h), _mm_set1_epi32(M)),
+          _mm_set1_epi32(N));
+
+        if(tail_size_)
+        {
+          h = _mm_xor_si128(h, mix_block(_mm_srl_epi32(value, tail_shift)));
+        }
+
+        h = _mm_xor_si128(h, length);
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+        h = mul(h, _mm_set1_epi32(F1));
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+        h = mul(h, _mm_set1_epi32(F2));
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), h);
+      }
+
+      finalize_batch_scalar_(result + i, values + i, count - i);
+    }
+#else
+    inline
+    void
+    Murmur32v3BatchHasher::finalize_batch(
+      uint32_t* result,
+      const uint32_t* values,
+      std::size_t count) const
+      throw()
+    {
+      finalize_batch_scalar_(result, values, count);
+    }
+#endif
+  }
+}
+}
+
+#endif /*CTRMURMURHASH_HPP_*/
@@ -1559,33 +1559,7 @@ namespace CampaignSvcs
       if(model.method == MM_XGBOOST)
       {
         opt_hashes_.clear();
-
-        // push candidate level direct features
-        if(model.push_campaign_freq || model.push_campaign_freq_log)
-        {
-          uint32_t imps = 0;
-
-          CampaignSelectParams::CampaignImpsMap::const_iterator it =
-            calculation_->request_params_->campaign_imps.find(
-              creative->campaign->campaign_group_id);
-          if(it != calculation_->request_params_->campaign_imps.end())
-          {
-            imps = it->second;
-          }
-
-          if(model.push_campaign_freq)
-          {
-            opt_hashes_.push_back(std::make_pair(CTR::BF_CAMPAIGN_FREQ_ID, imps));
-          }
-
-          if(model.push_campaign_freq_log)
-          {
-            opt_hashes_.push_back(
-              std::make_pair(
-                CTR::BF_CAMPAIGN_FREQ_LOG_ID,
-                static_cast<uint32_t>(Generics::BitAlgs::highest_bit_32(imps + 1))));
-          }
-        }
+        push_opt_hashes_(opt_hashes_, model, creative);
 
         model_ctr = calculation_->xgboost_eval_ctr_(
           model,
@@ -1625,6 +1599,41 @@ namespace CampaignSvcs
     return model_ctr;
   }
 
+  void
+  CTRProvider::CalculationContext::push_opt_hashes_(
+    CTR::HashArray& opt_hashes,
+    const Model& model,
+    const Creative* creative)
+    const throw()
+  {
+    // push candidate level direct features
+    if(model.push_campaign_freq || model.push_campaign_freq_log)
+    {
+      uint32_t imps = 0;
+
+      CampaignSelectParams::CampaignImpsMap::const_iterator it =
+        calculation_->request_params_->campaign_imps.find(
+          creative->campaign->campaign_group_id);
+      if(it != calculation_->request_params_->campaign_imps.end())
+      {
+        imps = it->second;
+      }
+
+      if(model.push_campaign_freq)
+      {
+        opt_hashes.push_back(std::make_pair(CTR::BF_CAMPAIGN_FREQ_ID, imps));
+      }
+
+      if(model.push_campaign_freq_log)
+      {
+        opt_hashes.push_back(
+          std::make_pair(
+            CTR::BF_CAMPAIGN_FREQ_LOG_ID,
+            static_cast<uint32_t>(Generics::BitAlgs::highest_bit_32(imps + 1))));
+      }
+    }
+  }
+
   std::pair<RevenueDecimal, const CTRProvider::Algorithm*>
   CTRProvider::CalculationContext::get_ctr_(
     const Creative* creative,
@@ -1702,6 +1711,155 @@ namespace CampaignSvcs
     return get_ctr_(creative, 0).first;
   }
 
+  void
+  CTRProvider::CalculationContext::get_ctrs(
+    CTRArray& ctrs,
+    const ConstCreativeArray& creatives) const
+    throw(Overflow)
+  {
+    static const char* FUN = "CTRProvider::CalculationContext::get_ctrs()";
+
+    // candidates of one XGBoost model, request and auction level hashes
+    // are shared by all rows
+    struct XGBoostBatchRow
+    {
+      std::size_t creative_index;
+      HashArrayHolder_var candidate_hashes;
+      CTR::HashArray opt_hashes;
+    };
+
+    struct XGBoostBatch
+    {
+      const Model* model;
+      HashArrayHolder_var request_hashes;
+      HashArrayHolder_var auction_hashes;
+      std::vector<XGBoostBatchRow> rows;
+    };
+
+    typedef std::map<unsigned long, XGBoostBatch> XGBoostBatchMap;
+
+    ctrs.assign(creatives.size(), RevenueDecimal::ZERO);
+
+    XGBoostBatchMap xgboost_batches;
+
+    for(std::size_t creative_i = 0; creative_i < creatives.size(); ++creative_i)
+    {
+      const Creative* creative = creatives[creative_i];
+      const long alg_index = calculation_->select_alg_index_(creative);
+
+      if(alg_index < 0)
+      {
+        // default algorithm
+        ctrs[creative_i] = creative->campaign->ctr;
+        continue;
+      }
+
+      const Algorithm* algorithm =
+        calculation_->ctr_provider_->ctr_algorithms_[alg_index];
+
+      for(ModelList::const_iterator model_it = algorithm->models.begin();
+        model_it != algorithm->models.end();
+        ++model_it)
+      {
+        const Model& model = **model_it;
+
+        if(model.method == MM_XGBOOST && model.max_feature_type == FT_CANDIDATE)
+        {
+          XGBoostBatch& batch = xgboost_batches[model.model_id];
+
+          if(batch.rows.empty())
+          {
+            batch.model = &model;
+            batch.request_hashes = get_features_hashes_(
+              *algorithm,
+              model,
+              FT_REQUEST,
+              *(calculation_->request_params_),
+              0, // tag size
+              0 // creative
+              );
+            batch.auction_hashes = get_features_hashes_(
+              *algorithm,
+              model,
+              FT_AUCTION,
+              *(calculation_->request_params_),
+              tag_size_,
+              0 // creative
+              );
+            batch.rows.reserve(creatives.size());
+          }
+
+          batch.rows.push_back(XGBoostBatchRow());
+          XGBoostBatchRow& row = batch.rows.back();
+          row.creative_index = creative_i;
+          row.candidate_hashes = get_features_hashes_(
+            *algorithm,
+            model,
+            FT_CANDIDATE,
+            *(calculation_->request_params_),
+            tag_size_,
+            creative);
+          push_opt_hashes_(row.opt_hashes, model, creative);
+        }
+        else
+        {
+          ctrs[creative_i] += RevenueDecimal::mul(
+            get_model_ctr_(*algorithm, model, creative),
+            model.weight,
+            Generics::DMR_FLOOR);
+        }
+      }
+    }
+
+    CTR::XGBoostPredictorPool::BatchRowArray batch_rows;
+    CTR::XGBoostPredictorPool::PredictionArray predictions;
+
+    for(XGBoostBatchMap::const_iterator batch_it = xgboost_batches.begin();
+        batch_it != xgboost_batches.end(); ++batch_it)
+    {
+      const XGBoostBatch& batch = batch_it->second;
+
+      batch_rows.clear();
+      for(auto row_it = batch.rows.begin(); row_it != batch.rows.end(); ++row_it)
+      {
+        batch_rows.push_back(CTR::XGBoostPredictorPool::BatchRow(
+          row_it->candidate_hashes.in(),
+          &row_it->opt_hashes));
+      }
+
+      calculation_->get_xgboost_predictor_(*batch.model)->predict(
+        predictions,
+        batch_rows,
+        batch.request_hashes ? *batch.request_hashes :
+          calculation_->ctr_provider_->empty_hash_array_,
+        batch.auction_hashes.in());
+
+      assert(predictions.size() == batch.rows.size());
+
+      for(std::size_t row_i = 0; row_i < batch.rows.size(); ++row_i)
+      {
+        RevenueDecimal model_ctr;
+
+        try
+        {
+          model_ctr = Calculation::adapt_ctr_(predictions[row_i]);
+        }
+        catch(const RevenueDecimal::Overflow& ex)
+        {
+          Stream::Error ostr;
+          ostr << FUN << ": overflow on ctr=" << predictions[row_i] <<
+            " got from XGBoostPredictor ";
+          throw CTRProvider::Overflow(ostr);
+        }
+
+        ctrs[batch.rows[row_i].creative_index] += RevenueDecimal::mul(
+          model_ctr,
+          batch.model->weight,
+          Generics::DMR_FLOOR);
+      }
+    }
+  }
+
   void
   CTRProvider::CalculationContext::get_ctr_details(
     CTRList& ctrs,
@@ -2020,6 +2178,29 @@ namespace CampaignSvcs
     }
   }
 
+  CTR::XGBoostPredictorPool::Predictor*
+  CTRProvider::Calculation::get_xgboost_predictor_(const Model& model)
+    const
+    throw()
+  {
+    auto model_predictor_it = model_xgboost_predictors_.find(model.model_id);
+
+    if(model_predictor_it != model_xgboost_predictors_.end())
+    {
+      return model_predictor_it->second.in();
+    }
+
+    assert(model.xgboost_predictor_pool.in());
+
+    CTR::XGBoostPredictorPool::Predictor_var new_xgboost_predictor =
+      model.xgboost_predictor_pool->get_predictor();
+
+    model_xgboost_predictors_.insert(
+      std::make_pair(model.model_id, new_xgboost_predictor));
+
+    return new_xgboost_predictor.in();
+  }
+
   RevenueDecimal
   CTRProvider::Calculation::xgboost_eval_ctr_(
     const Model& model,
@@ -2032,28 +2213,7 @@ namespace CampaignSvcs
   {
     static const char* FUN = "CTRProvider::xgboost_eval_ctr_()";
 
-    auto model_predictor_it = model_xgboost_predictors_.find(model.model_id);
-
-    CTR::XGBoostPredictorPool::Predictor* xgboost_predictor;
-
-    if(model_predictor_it != model_xgboost_predictors_.end())
-    {
-      xgboost_predictor = model_predictor_it->second.in();
-    }
-    else
-    {
-      assert(model.xgboost_predictor_pool.in());
-
-      CTR::XGBoostPredictorPool::Predictor_var new_xgboost_predictor =
-        model.xgboost_predictor_pool->get_predictor();
-
-      model_xgboost_predictors_.insert(
-        std::make_pair(model.model_id, new_xgboost_predictor));
-
-      xgboost_predictor = new_xgboost_predictor.in();
-    }
-
-    float ctr = xgboost_predictor->predict(
+    float ctr = get_xgboost_predictor_(model)->predict(
       hashes,
       add_hashes1,
       add_hashes2,
@@ -2327,7 +2487,7 @@ namespace CampaignSvcs
           throw InvalidConfig(ostr);
         }
 
-        res->insert(std::make_pair(orig_hash, result_hash));
+        res->insert(orig_hash, result_hash);
       }
     }
 
@@ -356,6 +356,8 @@ namespace CampaignSvcs
     {
     public:
       typedef std::list<RevenueDecimal> CTRList;
+      typedef std::vector<RevenueDecimal> CTRArray;
+      typedef std::vector<const Creative*> ConstCreativeArray;
 
     public:
       CalculationContext(
@@ -367,6 +369,14 @@ namespace CampaignSvcs
       get_ctr(const Creative* creative) const
         throw(Overflow);
 
+      // eval ctr for all candidates at once (equal to get_ctr for each),
+      // candidate dependent XGBoost models evaluated with one predictor call
+      void
+      get_ctrs(
+        CTRArray& ctrs,
+        const ConstCreativeArray& creatives) const
+        throw(Overflow);
+
       bool
       check_rate(
         const Creative* creative,
@@ -402,6 +412,13 @@ namespace CampaignSvcs
         const Creative* creative)
         const throw(Overflow);
 
+      void
+      push_opt_hashes_(
+        CTR::HashArray& opt_hashes,
+        const Model& model,
+        const Creative* creative)
+        const throw();
+
       // Vanga & XGBoost specific methods
       CTRProvider::HashArrayHolder_var
       get_features_hashes_(
@@ -543,6 +560,11 @@ namespace CampaignSvcs
       eval_ctr_(float weight)
         throw(Overflow);
 
+      CTR::XGBoostPredictorPool::Predictor*
+      get_xgboost_predictor_(const Model& model)
+        const
+        throw();
+
       RevenueDecimal
       xgboost_eval_ctr_(
         const Model& model,
@@ -44,6 +44,8 @@
 
 #include "CreativeTemplate.hpp"
 #include "CreativeTemplateArgs.hpp"
+#include "DomainSet.hpp"
+#include "FixedRevenue.hpp"
 #include "GeoChannelIndex.hpp"
 #include "BillingStateContainer.hpp"
 
@@ -136,6 +138,7 @@ namespace CampaignSvcs
     {
     public:
       RevenueDecimal rate;
+      FixedRevenue::Value fixed_rate = FixedRevenue::INVALID;
       unsigned long currency_id;
       unsigned long currency_exchange_id;
       unsigned long effective_date;
@@ -624,6 +627,7 @@ namespace CampaignSvcs
       unsigned long flags;
       char marketplace;
       RevenueDecimal adjustment;
+      FixedRevenue::Value fixed_adjustment = FixedRevenue::INVALID;
 
       TagPricings tag_pricings;
       CountryTagPricingMap country_tag_pricings;
@@ -651,7 +655,7 @@ namespace CampaignSvcs
 
       // duplicate rejected_categories in other view
       //   for fast ccg keyword exclusion detection
-      StringSet exclude_creative_domains;
+      DomainSet exclude_creative_domains;
       StringSet tag_pricing_countries;
 
     protected:
@@ -932,6 +936,10 @@ namespace CampaignSvcs
       CreativeList creatives;          /**< Campaign creatives */
       OrderSetIdSet opt_order_sets;
       RevenueDecimal base_min_ctr_goal;
+      // FixedRevenue images of ctr, click_sys_revenue
+      // for candidates ranking, INVALID if not filled
+      FixedRevenue::Value fixed_ctr;
+      FixedRevenue::Value fixed_click_sys_revenue;
 
     protected:
       typedef Sync::Policy::PosixSpinThread GoalCTRSyncPolicy;
@@ -1360,6 +1368,8 @@ namespace CampaignSvcs
     Campaign::Campaign() throw()
       : ctr_modifiable(false),
         base_min_ctr_goal(RevenueDecimal::ZERO),
+        fixed_ctr(FixedRevenue::INVALID),
+        fixed_click_sys_revenue(FixedRevenue::INVALID),
         available_(1),
         int_min_ctr_goal_(0)
     {}
@@ -18,8 +18,19 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+
+#include <tao/CDR.h>
+#include <tao/AnyTypeCode/TypeCode.h>
+
+#include <eh/Errno.hpp>
+
 #include <Generics/Time.hpp>
 #include <Generics/Proc.hpp>
+#include <Generics/MMap.hpp>
 #include <String/StringManip.hpp>
 #include <String/UTF8Case.hpp>
 #include <Stream/MemoryStream.hpp>
@@ -106,6 +117,65 @@ namespace CampaignSvcs
       ExtRevenueDecimal(false, 100, 0),
       Generics::DMR_FLOOR);
 
+    /* config snapshot file:
+     *   SnapshotHeader, for each portion:
+     *   uint64_t size, CDR encoded CampaignConfigUpdateInfo
+     *   (aligned to 8 bytes for decode from mapped memory) */
+    const char SNAPSHOT_MAGIC[8] = { 'C', 'M', 'C', 'F', 'G', 'S', 'N', 'P' };
+
+    // increment only at changes of snapshot file layout (header, portion
+    // framing); CampaignConfigUpdateInfo (CampaignSvcs IDL) changes are
+    // detected by schema hash, snapshots with other version or schema
+    // hash are ignored
+    const uint32_t SNAPSHOT_VERSION = 2;
+
+    const std::size_t SNAPSHOT_ALIGN = 8;
+
+    const Generics::Time SNAPSHOT_SAVE_PERIOD(300);
+
+    struct SnapshotHeader
+    {
+      char magic[sizeof(SNAPSHOT_MAGIC)];
+      uint32_t version;
+      uint32_t byte_order;
+      uint32_t portions;
+      uint32_t schema_hash;
+    };
+
+    // hash of CDR encoded CampaignConfigUpdateInfo type code:
+    // type code contains names and types of all (nested) fields
+    uint32_t
+    calc_snapshot_schema_hash() throw (eh::Exception)
+    {
+      TAO_OutputCDR cdr;
+
+      if(!(cdr << _tc_CampaignConfigUpdateInfo))
+      {
+        throw eh::Exception(
+          "calc_snapshot_schema_hash(): can't encode type code");
+      }
+
+      std::size_t hash_value = 0;
+
+      {
+        Generics::Murmur32v3Hash hasher(hash_value);
+
+        for(const ACE_Message_Block* mb = cdr.begin(); mb; mb = mb->cont())
+        {
+          hasher.add(mb->rd_ptr(), mb->length());
+        }
+      }
+
+      return static_cast<uint32_t>(hash_value);
+    }
+
+    uint32_t
+    snapshot_schema_hash() throw (eh::Exception)
+    {
+      static const uint32_t SCHEMA_HASH = calc_snapshot_schema_hash();
+      return SCHEMA_HASH;
+    }
+
     CreativeTemplateFactory::Handler::Type
     adopt_template_type(AdServer::CampaignSvcs::CreativeTemplateType type_val)
     {
@@ -142,7 +212,8 @@ namespace CampaignSvcs
     const char* template_file_dir,
     const std::string& service_index,
     const CreativeInstantiateRuleMap& creative_rules,
-    bool drop_https_safe)
+    bool drop_https_safe,
+    const char* snapshot_file)
     throw(Exception)
     : logger_(ReferenceCounting::add_ref(logger)),
       domain_parser_(ReferenceCounting::add_ref(domain_parser)),
@@ -152,6 +223,7 @@ namespace CampaignSvcs
       SERVICE_INDEX_(hash_calc(service_index)),
       creative_rules_(creative_rules),
       drop_https_safe_(drop_https_safe),
+      snapshot_file_(snapshot_file ? snapshot_file : ""),
       file_access_manager_(Generics::Time(120))
   {
     static const char* FUN = "CampaignConfigSource::CampaignConfigSource()";
@@ -296,6 +368,7 @@ namespace CampaignSvcs
           Generics::Time now = Generics::Time::get_time_of_day();
           CampaignConfig_var new_config = new CampaignConfig();
           ConfigUpdateLinks config_update_links;
+          ConfigUpdateInfoList snapshot_update_infos;
 
           for(unsigned long portion = 0; portion < PORTIONS_NUMBER; ++portion)
           {
@@ -356,57 +429,29 @@ namespace CampaignSvcs
               config_update_links,
               *update_info,
               old_config);
-          }
-
-          if (logger_->log_level() >= Logging::Logger::TRACE)
-          {
-            logger_->stream(Logging::Logger::TRACE,
-              Aspect::CAMPAIGN_CONFIG_SOURCE) <<
-              FUN << ": link config entities.";
-          }
-
-          link_config_update_(config_update_links, *new_config);
-
-          if (logger_->log_level() >= Logging::Logger::TRACE)
-          {
-            logger_->stream(Logging::Logger::TRACE,
-              Aspect::CAMPAIGN_CONFIG_SOURCE) <<
-              FUN << ": apply campaign limitations.";
-          }
-
-          apply_campaign_limitations_(*new_config, now);
-
-          if (logger_->log_level() >= Logging::Logger::TRACE)
-          {
-            logger_->stream(Logging::Logger::TRACE,
-              Aspect::CAMPAIGN_CONFIG_SOURCE) <<
-              FUN << ": check creative file references.";
-          }
 
-          check_creative_files_option_(*new_config);
-
-          if (logger_->log_level() >= Logging::Logger::TRACE)
-          {
-            logger_->stream(Logging::Logger::TRACE,
-              Aspect::CAMPAIGN_CONFIG_SOURCE) <<
-              FUN << ": check creative template files.";
-          }
-
-          check_creative_template_files_(*new_config);
-
-          if (logger_->log_level() >= Logging::Logger::TRACE)
-          {
-            logger_->stream(Logging::Logger::TRACE,
-              Aspect::CAMPAIGN_CONFIG_SOURCE) <<
-              FUN << ": preinstantiate creative tokens.";
+            if(!snapshot_file_.empty())
+            {
+              snapshot_update_infos.emplace_back(update_info._retn());
+            }
           }
 
-          preinstantiate_creative_tokens_(*new_config);
+          finalize_config_(*new_config, config_update_links, old_config, now);
 
-          if(!old_config ||
-             old_config->geo_channels.in() != new_config->geo_channels.in())
+          if(!snapshot_file_.empty() &&
+             snapshot_save_required_(*new_config, now))
           {
-            new_config->geo_channels->close();
+            try
+            {
+              save_snapshot_(snapshot_update_infos, *new_config);
+              set_snapshot_state_(*new_config, now);
+            }
+            catch(const Exception& ex)
+            {
+              logger_->stream(Logging::Logger::WARNING,
+                Aspect::CAMPAIGN_CONFIG_SOURCE) << FUN <<
+                ": can't save config snapshot: " << ex.what();
+            }
           }
 
           if (logger_->log_level() >= Logging::Logger::TRACE)
@@ -459,6 +504,374 @@ namespace CampaignSvcs
     return CampaignConfig_var();
   }
 
+  void
+  CampaignConfigSource::finalize_config_(
+    CampaignConfig& new_config,
+    const ConfigUpdateLinks& config_update_links,
+    const CampaignConfig* old_config,
+    const Generics::Time& now)
+    throw(Exception)
+  {
+    static const char* FUN = "CampaignConfigSource::finalize_config_()";
+
+    if (logger_->log_level() >= Logging::Logger::TRACE)
+    {
+      logger_->stream(Logging::Logger::TRACE,
+        Aspect::CAMPAIGN_CONFIG_SOURCE) <<
+        FUN << ": link config entities.";
+    }
+
+    link_config_update_(config_update_links, new_config);
+
+    if (logger_->log_level() >= Logging::Logger::TRACE)
+    {
+      logger_->stream(Logging::Logger::TRACE,
+        Aspect::CAMPAIGN_CONFIG_SOURCE) <<
+        FUN << ": apply campaign limitations.";
+    }
+
+    apply_campaign_limitations_(new_config, now);
+
+    if (logger_->log_level() >= Logging::Logger::TRACE)
+    {
+      logger_->stream(Logging::Logger::TRACE,
+        Aspect::CAMPAIGN_CONFIG_SOURCE) <<
+        FUN << ": check creative file references.";
+    }
+
+    check_creative_files_option_(new_config);
+
+    if (logger_->log_level() >= Logging::Logger::TRACE)
+    {
+      logger_->stream(Logging::Logger::TRACE,
+        Aspect::CAMPAIGN_CONFIG_SOURCE) <<
+        FUN << ": check creative template files.";
+    }
+
+    check_creative_template_files_(new_config);
+
+    if (logger_->log_level() >= Logging::Logger::TRACE)
+    {
+      logger_->stream(Logging::Logger::TRACE,
+        Aspect::CAMPAIGN_CONFIG_SOURCE) <<
+        FUN << ": preinstantiate creative tokens.";
+    }
+
+    preinstantiate_creative_tokens_(new_config);
+
+    if(!old_config ||
+       old_config->geo_channels.in() != new_config.geo_channels.in())
+    {
+      new_config.geo_channels->close();
+    }
+  }
+
+  CampaignConfig_var
+  CampaignConfigSource::load_snapshot() throw (Exception)
+  {
+    static const char* FUN = "CampaignConfigSource::load_snapshot()";
+
+    if(snapshot_file_.empty() ||
+       ::access(snapshot_file_.c_str(), F_OK) != 0)
+    {
+      return CampaignConfig_var();
+    }
+
+    try
+    {
+      const Generics::Time now = Generics::Time::get_time_of_day();
+
+      // portions decoded directly from mapped file without copy
+      Generics::MMapFile mmap_file(snapshot_file_.c_str());
+      const char* buf = static_cast<const char*>(mmap_file.memory());
+      const std::size_t buf_size = mmap_file.length();
+
+      SnapshotHeader header;
+
+      if(buf_size < sizeof(header))
+      {
+        Stream::Error ostr;
+        ostr << FUN << ": snapshot file '" << snapshot_file_ <<
+          "' is truncated";
+        throw Exception(ostr);
+      }
+
+      ::memcpy(&header, buf, sizeof(header));
+
+      if(::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+         header.version != SNAPSHOT_VERSION ||
+         header.schema_hash != snapshot_schema_hash())
+      {
+        logger_->stream(Logging::Logger::NOTICE,
+          Aspect::CAMPAIGN_CONFIG_SOURCE) << FUN <<
+          ": snapshot file '" << snapshot_file_ <<
+          "' saved by other version, ignored";
+        return CampaignConfig_var();
+      }
+
+      CampaignConfig_var new_config = new CampaignConfig();
+      ConfigUpdateLinks config_update_links;
+      std::size_t pos = sizeof(header);
+
+      for(uint32_t portion = 0; portion < header.portions; ++portion)
+      {
+        uint64_t portion_size;
+
+        if(buf_size < pos + sizeof(portion_size))
+        {
+          Stream::Error ostr;
+          ostr << FUN << ": snapshot file '" << snapshot_file_ <<
+            "' is truncated";
+          throw Exception(ostr);
+        }
+
+        ::memcpy(&portion_size, buf + pos, sizeof(portion_size));
+        pos += sizeof(portion_size);
+
+        if(buf_size - pos < portion_size)
+        {
+          Stream::Error ostr;
+          ostr << FUN << ": snapshot file '" << snapshot_file_ <<
+            "' is truncated";
+          throw Exception(ostr);
+        }
+
+        CampaignConfigUpdateInfo update_info;
+
+        {
+          TAO_InputCDR cdr(buf + pos, portion_size, header.byte_order);
+
+          if(!(cdr >> update_info))
+          {
+            Stream::Error ostr;
+            ostr << FUN << ": can't decode portion #" << portion <<
+              " of snapshot file '" << snapshot_file_ << "'";
+            throw Exception(ostr);
+          }
+        }
+
+        pos += (portion_size + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+
+        apply_config_update_(
+          *new_config,
+          config_update_links,
+          update_info,
+          0);
+      }
+
+      finalize_config_(*new_config, config_update_links, 0, now);
+
+      // snapshot is actual for loaded config
+      set_snapshot_state_(*new_config, now);
+
+      if (logger_->log_level() >= Logging::Logger::TRACE)
+      {
+        logger_->stream(Logging::Logger::TRACE,
+          Aspect::CAMPAIGN_CONFIG_SOURCE) <<
+          FUN << ": config loaded from snapshot '" << snapshot_file_ <<
+          "' (master stamp = " << new_config->master_stamp.get_gm_time() <<
+          ") in " << (Generics::Time::get_time_of_day() - now) << ": " <<
+          new_config->campaigns.size() << " campaigns, " <<
+          new_config->tags.size() << " tags.";
+      }
+
+      return new_config;
+    }
+    catch(const Exception&)
+    {
+      throw;
+    }
+    catch(const eh::Exception& ex)
+    {
+      Stream::Error ostr;
+      ostr << FUN << ": can't load snapshot file '" << snapshot_file_ <<
+        "': " << ex.what();
+      throw Exception(ostr);
+    }
+  }
+
+  void
+  CampaignConfigSource::save_snapshot_(
+    ConfigUpdateInfoList& update_infos,
+    const CampaignConfig& new_config)
+    throw(Exception)
+  {
+    static const char* FUN = "CampaignConfigSource::save_snapshot_()";
+
+    static const char ZERO_PADDING[SNAPSHOT_ALIGN] = { 0 };
+
+    const std::string tmp_file = snapshot_file_ + ".tmp";
+
+    try
+    {
+      std::ofstream ostr(
+        tmp_file.c_str(),
+        std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+
+      if(!ostr.is_open())
+      {
+        Stream::Error err;
+        err << FUN << ": can't open file '" << tmp_file << "'";
+        throw Exception(err);
+      }
+
+      SnapshotHeader header;
+      ::memset(&header, 0, sizeof(header));
+      ::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+      header.version = SNAPSHOT_VERSION;
+      header.schema_hash = snapshot_schema_hash();
+      header.byte_order = ACE_CDR_BYTE_ORDER;
+      header.portions = update_infos.size();
+
+      ostr.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+      bool first_portion = true;
+
+      for(ConfigUpdateInfoList::iterator it = update_infos.begin();
+          it != update_infos.end(); ++it, first_portion = false)
+      {
+        // geo channels received only at changes:
+        // save actual geo channels as full update
+        if(first_portion)
+        {
+          fill_snapshot_geo_channels_(*it->ptr(), new_config);
+        }
+        else
+        {
+          (*it)->activate_geo_channels.length(0);
+        }
+
+        (*it)->geo_channels_timestamp = CorbaAlgs::pack_time(
+          new_config.geo_channels_timestamp);
+
+        TAO_OutputCDR cdr;
+
+        if(!(cdr << *it->ptr()))
+        {
+          Stream::Error err;
+          err << FUN << ": can't encode config portion";
+          throw Exception(err);
+        }
+
+        const uint64_t portion_size = cdr.total_length();
+        ostr.write(
+          reinterpret_cast<const char*>(&portion_size),
+          sizeof(portion_size));
+
+        for(const ACE_Message_Block* mb = cdr.begin(); mb; mb = mb->cont())
+        {
+          ostr.write(mb->rd_ptr(), mb->length());
+        }
+
+        ostr.write(
+          ZERO_PADDING,
+          (SNAPSHOT_ALIGN - portion_size % SNAPSHOT_ALIGN) % SNAPSHOT_ALIGN);
+      }
+
+      ostr.close();
+
+      if(!ostr)
+      {
+        Stream::Error err;
+        err << FUN << ": can't write file '" << tmp_file << "'";
+        throw Exception(err);
+      }
+
+      if(::rename(tmp_file.c_str(), snapshot_file_.c_str()) != 0)
+      {
+        eh::throw_errno_exception<Exception>(
+          FUN, ": can't rename file '", tmp_file,
+          "' to '", snapshot_file_, "'");
+      }
+    }
+    catch(const Exception&)
+    {
+      ::unlink(tmp_file.c_str());
+      throw;
+    }
+    catch(const eh::Exception& ex)
+    {
+      ::unlink(tmp_file.c_str());
+      Stream::Error err;
+      err << FUN << ": eh::Exception caught: " << ex.what();
+      throw Exception(err);
+    }
+  }
+
+  bool
+  CampaignConfigSource::snapshot_save_required_(
+    const CampaignConfig& new_config,
+    const Generics::Time& now) const
+    throw()
+  {
+    SnapshotSyncPolicy::ReadGuard lock(snapshot_lock_);
+
+    if(snapshot_save_time_ == Generics::Time::ZERO)
+    {
+      return true;
+    }
+
+    // master stamp is changed at each campaign server reload (even if
+    // content isn't changed): save changed config not often than once
+    // per SNAPSHOT_SAVE_PERIOD
+    return (new_config.master_stamp != snapshot_master_stamp_ ||
+      new_config.geo_channels_timestamp != snapshot_geo_channels_timestamp_) &&
+      now >= snapshot_save_time_ + SNAPSHOT_SAVE_PERIOD;
+  }
+
+  void
+  CampaignConfigSource::set_snapshot_state_(
+    const CampaignConfig& config,
+    const Generics::Time& now)
+    throw()
+  {
+    SnapshotSyncPolicy::WriteGuard lock(snapshot_lock_);
+    snapshot_master_stamp_ = config.master_stamp;
+    snapshot_geo_channels_timestamp_ = config.geo_channels_timestamp;
+    snapshot_save_time_ = now;
+  }
+
+  void
+  CampaignConfigSource::fill_snapshot_geo_channels_(
+    CampaignConfigUpdateInfo& update_info,
+    const CampaignConfig& config)
+    throw(eh::Exception)
+  {
+    if(!config.geo_channels.in())
+    {
+      update_info.activate_geo_channels.length(0);
+      return;
+    }
+
+    const GeoChannelIndex::GeoChannelMap& geo_channels =
+      config.geo_channels->channels();
+
+    update_info.activate_geo_channels.length(geo_channels.size());
+    CORBA::ULong i = 0;
+
+    for(GeoChannelIndex::GeoChannelMap::const_iterator it =
+          geo_channels.begin();
+        it != geo_channels.end(); ++it, ++i)
+    {
+      GeoChannelInfo& geo_channel_info = update_info.activate_geo_channels[i];
+      geo_channel_info.channel_id = it->second;
+      geo_channel_info.country << it->first.country();
+      geo_channel_info.timestamp = CorbaAlgs::pack_time(
+        config.geo_channels_timestamp);
+
+      if(it->first.region().empty() && it->first.city().empty())
+      {
+        geo_channel_info.geoip_targets.length(0);
+      }
+      else
+      {
+        geo_channel_info.geoip_targets.length(1);
+        geo_channel_info.geoip_targets[0].region << it->first.region();
+        geo_channel_info.geoip_targets[0].city << it->first.city();
+      }
+    }
+  }
+
   unsigned long
   CampaignConfigSource::filter_not_exist_fc_(
     unsigned long fc_id, const FreqCapMap& freq_caps_map)
@@ -716,6 +1129,11 @@ namespace CampaignSvcs
           cmp_it->second->ctr = RevenueDecimal::ZERO;
         }
 
+        cmp_it->second->fixed_ctr = FixedRevenue::from_decimal(
+          cmp_it->second->ctr);
+        cmp_it->second->fixed_click_sys_revenue = FixedRevenue::from_decimal(
+          cmp_it->second->click_sys_revenue);
+
         for(CreativeList::iterator cr_it = cmp_it->second->creatives.begin();
             cr_it != cmp_it->second->creatives.end();
             ++cr_it)
@@ -1865,6 +2283,7 @@ namespace CampaignSvcs
       p_currency->currency_exchange_id = currency_info.currency_exchange_id;
       p_currency->effective_date = currency_info.effective_date;
       p_currency->rate = CorbaAlgs::unpack_decimal<RevenueDecimal>(currency_info.rate);
+      p_currency->fixed_rate = FixedRevenue::from_decimal(p_currency->rate);
       p_currency->timestamp = CorbaAlgs::unpack_time(currency_info.timestamp);
       p_currency->fraction = currency_info.fraction_digits;
       p_currency->currency_code = currency_info.currency_code;
@@ -2476,6 +2895,7 @@ namespace CampaignSvcs
 
       p_tag->adjustment = CorbaAlgs::unpack_decimal<RevenueDecimal>(
         tag_info.adjustment);
+      p_tag->fixed_adjustment = FixedRevenue::from_decimal(p_tag->adjustment);
 
       p_tag->cost_coef = CorbaAlgs::unpack_decimal<RevenueDecimal>(
         tag_info.cost_coef);
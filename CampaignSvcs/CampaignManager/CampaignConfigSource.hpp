@@ -22,11 +22,15 @@
 #ifndef _CAMPAIGNCONFIGSOURCE_HPP_
 #define _CAMPAIGNCONFIGSOURCE_HPP_
 
+#include <list>
+
 #include <eh/Exception.hpp>
 #include <Logger/Logger.hpp>
 #include <CORBACommons/CorbaAdapters.hpp>
 #include <CORBACommons/ObjectPool.hpp>
 #include <Generics/FileCache.hpp>
+#include <Generics/Time.hpp>
+#include <Sync/SyncPolicy.hpp>
 
 #include <CampaignSvcs/CampaignServer/CampaignServerPool.hpp>
 #include <CampaignSvcs/CampaignManager/CampaignManager_s.hpp>
@@ -59,13 +63,26 @@ namespace AdServer
         const char* template_file_dir,
         const std::string& service_index,
         const CreativeInstantiateRuleMap& creative_rules,
-        bool drop_https_safe = false)
+        bool drop_https_safe = false,
+        const char* snapshot_file = 0)
         throw(Exception);
 
+      /**
+       * Load full config from campaign server,
+       * if snapshot file defined received config saved into it
+       */
       CampaignConfig_var
       update(const CampaignConfig* old_config) throw (Exception);
 
-    private:
+      /**
+       * Build config from snapshot saved by update (without campaign server
+       * requests), return null if snapshot file isn't defined, don't exist
+       * or saved by other version
+       */
+      CampaignConfig_var
+      load_snapshot() throw (Exception);
+
+    protected:
       struct TraceLevel
       {
         enum
@@ -78,6 +95,8 @@ namespace AdServer
 
       typedef std::map<std::string, StringSet> SizeAppFormatSet;
 
+      typedef std::list<CampaignConfigUpdateInfo_var> ConfigUpdateInfoList;
+
       typedef std::map<std::string, SizeAppFormatSet>
         CreativeFormatTemplateMap_;
 
@@ -162,7 +181,7 @@ namespace AdServer
         BlockChannelMap block_channels;
       };
 
-    private:
+    protected:
       virtual
       ~CampaignConfigSource() throw ()
       {}
@@ -185,6 +204,36 @@ namespace AdServer
       static void
       fill_tag_pricings_(Tag* tag) throw();
 
+      void finalize_config_(
+        CampaignConfig& new_config,
+        const ConfigUpdateLinks& config_update_links,
+        const CampaignConfig* old_config,
+        const Generics::Time& now)
+        throw(Exception);
+
+      void save_snapshot_(
+        ConfigUpdateInfoList& update_infos,
+        const CampaignConfig& new_config)
+        throw(Exception);
+
+      bool
+      snapshot_save_required_(
+        const CampaignConfig& new_config,
+        const Generics::Time& now) const
+        throw();
+
+      void
+      set_snapshot_state_(
+        const CampaignConfig& config,
+        const Generics::Time& now)
+        throw();
+
+      static void
+      fill_snapshot_geo_channels_(
+        CampaignConfigUpdateInfo& update_info,
+        const CampaignConfig& config)
+        throw(eh::Exception);
+
       void apply_config_update_(
         CampaignConfig& new_config,
         ConfigUpdateLinks& config_update_links,
@@ -425,6 +474,8 @@ namespace AdServer
         throw();
 
     private:
+      typedef Sync::Policy::PosixThread SnapshotSyncPolicy;
+
       Logging::Logger_var logger_;
       DomainParser_var domain_parser_;
       CORBACommons::CorbaClientAdapter_var corba_client_adapter_;
@@ -435,6 +486,13 @@ namespace AdServer
       const unsigned SERVICE_INDEX_;
       const CreativeInstantiateRuleMap creative_rules_;
       const bool drop_https_safe_;
+      const std::string snapshot_file_;
+
+      // state of last saved (or loaded) snapshot
+      mutable SnapshotSyncPolicy::Mutex snapshot_lock_;
+      Generics::Time snapshot_master_stamp_;
+      Generics::Time snapshot_geo_channels_timestamp_;
+      Generics::Time snapshot_save_time_;
 
       CampaignServerPoolPtr campaign_servers_;
       Generics::FileAccessCacheManager file_access_manager_;
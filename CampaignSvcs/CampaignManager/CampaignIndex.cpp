@@ -19,9 +19,13 @@
  */
 
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
 
 #include <HTTP/UrlAddress.hpp>
 #include <Generics/Rand.hpp>
+#include <Generics/ThreadRunner.hpp>
 
 #include <Commons/Algs.hpp>
 #include "CampaignIndex.hpp"
@@ -30,6 +34,18 @@ namespace
 {
   const unsigned long INDEXING_PROGRESS_PRECISSION = 10;
 
+  // full reindexing used if more then 1/N campaigns changed
+  const unsigned long INCREMENTAL_INDEXING_MAX_REINDEX_SHARE = 2;
+
+  // parallel indexing: campaigns shards number per thread
+  // (shards are picked by free threads for balance load)
+  const unsigned long INDEXING_SHARDS_PER_THREAD = 4;
+  const unsigned long INDEXING_SHARD_MIN_SIZE = 10;
+
+  // compiled targeting is used only for lists, that expensive
+  // to check by check_campaign for each cell
+  const unsigned long CELL_LIST_FILTER_MIN_SIZE = 32;
+
   std::string
   campaign_flags_to_str(unsigned long flags) throw (eh::Exception)
   {
@@ -116,58 +132,141 @@ namespace AdServer
     /** campaign index functions */
     bool CampaignIndex::index_campaigns(
       IndexingProgress* indexing_progress,
-      Generics::ActiveObject* interrupter)
+      Generics::ActiveObject* interrupter,
+      const CampaignIndex* prev_index,
+      unsigned long threads)
       throw(eh::Exception)
     {
+      /* fill main index */
+      cell_holder_ = new CampaignSelectionCellListHolder();
+      campaign_cell_holder_ = new CampaignCellListHolder();
+
+      ConstCampaignPtrArray index_campaigns;
+
+      // templates state is fixed before indexing: if template file
+      // changed while indexing, next relink will see difference
+      fill_template_availability_(template_availability_);
+
+      if(prev_index && relink_index_(index_campaigns, *prev_index))
+      {
+        if(logger_->log_level() >= Logging::Logger::TRACE)
+        {
+          Stream::Error ostr;
+          ostr << "Campaign index relinked: " << index_campaigns.size() <<
+            "/" << campaign_config_->campaigns.size() <<
+            " campaigns will be reindexed";
+          logger_->log(
+            ostr.str(),
+            Logging::Logger::TRACE,
+            Aspect::CAMPAIGN_SELECTION_INDEX);
+        }
+      }
+      else
+      {
+        index_campaigns.clear();
+        index_campaigns.reserve(campaign_config_->campaigns.size());
+
+        for(CampaignConfig::CampaignMap::const_iterator cmp_it =
+              campaign_config_->campaigns.begin();
+            cmp_it != campaign_config_->campaigns.end(); ++cmp_it)
+        {
+          index_campaigns.push_back(cmp_it->second);
+        }
+      }
+
       if(indexing_progress)
       {
         IndexingProgress::SyncPolicy::WriteGuard guard(indexing_progress->lock);
-        indexing_progress->common_campaign_count = campaign_config_->campaigns.size();
+        indexing_progress->common_campaign_count = index_campaigns.size();
+        indexing_progress->loaded_campaign_count = 0;
       }
 
-      /* fill main index */
-      cell_holder_ = new CampaignSelectionCellListHolder();
-      campaign_cell_holder_ = new CampaignCellListHolder();
+      Generics::Timer timer;
+      timer.start();
+
+      const bool result = threads > 1 &&
+        index_campaigns.size() > threads * INDEXING_SHARD_MIN_SIZE ?
+        index_campaigns_parallel_(
+          index_campaigns,
+          threads,
+          indexing_progress,
+          interrupter) :
+        index_campaigns_(
+          index_campaigns.begin(),
+          index_campaigns.end(),
+          indexing_progress,
+          interrupter);
+
+      if(result)
+      {
+        compile_filters_();
+      }
+
+      timer.stop();
+
+      if(logger_->log_level() >= Logging::Logger::TRACE)
+      {
+        Stream::Error ostr;
+        ostr << "Campaign index construct time : " << timer.elapsed_time();
+        logger_->log(
+          ostr.str(),
+          Logging::Logger::TRACE,
+          Aspect::CAMPAIGN_SELECTION_INDEX);
+      }
+
+      cell_holder_.reset();
+      campaign_cell_holder_.reset();
+      tag_campaign_approve_.clear();
+
+      return result;
+    }
 
+    bool CampaignIndex::index_campaigns_(
+      ConstCampaignPtrArray::const_iterator campaigns_begin,
+      ConstCampaignPtrArray::const_iterator campaigns_end,
+      IndexingProgress* indexing_progress,
+      Generics::ActiveObject* interrupter)
+      throw(eh::Exception)
+    {
       std::set<unsigned long> progress_campaigns;
       unsigned long i = 0;
 
-      Generics::Timer timer;
-      timer.start();
-
-      for(CampaignConfig::CampaignMap::const_iterator cmp_it =
-            campaign_config_->campaigns.begin();
-          cmp_it != campaign_config_->campaigns.end(); ++cmp_it, ++i)
+      for(ConstCampaignPtrArray::const_iterator cmp_it = campaigns_begin;
+          cmp_it != campaigns_end; ++cmp_it, ++i)
       {
-        if(indexing_progress && i % INDEXING_PROGRESS_PRECISSION == 0)
+        if(i % INDEXING_PROGRESS_PRECISSION == 0)
         {
           if(interrupter && !interrupter->active())
           {
             return false;
           }
 
-          IndexingProgress::SyncPolicy::WriteGuard guard(indexing_progress->lock);
-          indexing_progress->loaded_campaign_count = i;
+          if(indexing_progress && i > 0)
+          {
+            IndexingProgress::SyncPolicy::WriteGuard guard(indexing_progress->lock);
+            indexing_progress->loaded_campaign_count +=
+              INDEXING_PROGRESS_PRECISSION;
+          }
         }
 
         // check active outside of index_campaign for correct working of selection trace
         // for inactive campaigns
-        if(cmp_it->second->account->is_active() &&
-          cmp_it->second->is_active())
+        if((*cmp_it)->account->is_active() &&
+          (*cmp_it)->is_active())
         {
-          index_campaign(cmp_it->second);
+          index_campaign(*cmp_it);
         }
 
         if(logger_->log_level() >= Logging::Logger::TRACE)
         {
-          progress_campaigns.insert(cmp_it->first);
+          progress_campaigns.insert((*cmp_it)->campaign_id);
 
           if(i % INDEXING_PROGRESS_PRECISSION == 0)
           {
             Stream::Dynamic ostr(4096);
 
             ostr << "Campaign index constructed for " << i << "/"
-              << campaign_config_->campaigns.size() << " campaigns: ";
+              << (campaigns_end - campaigns_begin) << " campaigns: ";
 
             for(std::set<unsigned long>::const_iterator pit =
                   progress_campaigns.begin();
@@ -187,25 +286,847 @@ namespace AdServer
         }
       }
 
-      timer.stop();
+      if(indexing_progress && i > 0)
+      {
+        IndexingProgress::SyncPolicy::WriteGuard guard(indexing_progress->lock);
+        indexing_progress->loaded_campaign_count +=
+          (i - 1) % INDEXING_PROGRESS_PRECISSION + 1;
+      }
 
-      if(logger_->log_level() >= Logging::Logger::TRACE)
+      return true;
+    }
+
+    /* IndexShardJob: index campaign shards, that isn't indexed yet */
+    class CampaignIndex::IndexShardJob: public Generics::ThreadJob
+    {
+    public:
+      struct Shard
+      {
+        ConstCampaignPtrArray::const_iterator campaigns_begin;
+        ConstCampaignPtrArray::const_iterator campaigns_end;
+        CampaignIndex_var index;
+        bool indexed;
+      };
+
+      typedef std::vector<Shard> ShardArray;
+
+    public:
+      IndexShardJob(
+        ShardArray& shards,
+        IndexingProgress* indexing_progress,
+        Generics::ActiveObject* interrupter)
+        throw()
+        : shards_(shards),
+          indexing_progress_(indexing_progress),
+          interrupter_(interrupter),
+          next_shard_i_(0)
+      {}
+
+      virtual void
+      work() throw()
+      {
+        Shard* shard;
+
+        while((shard = next_shard_()) != 0)
+        {
+          try
+          {
+            CampaignIndex& index = *shard->index;
+            index.cell_holder_ = new CampaignSelectionCellListHolder();
+            index.campaign_cell_holder_ = new CampaignCellListHolder();
+
+            shard->indexed = index.index_campaigns_(
+              shard->campaigns_begin,
+              shard->campaigns_end,
+              indexing_progress_,
+              interrupter_);
+
+            index.cell_holder_.reset();
+            index.campaign_cell_holder_.reset();
+            index.tag_campaign_approve_.clear();
+          }
+          catch(const eh::Exception& ex)
+          {
+            SyncPolicy::WriteGuard guard(lock_);
+            error_ = ex.what();
+          }
+        }
+      }
+
+      const std::string&
+      error() const throw()
+      {
+        return error_;
+      }
+
+    protected:
+      virtual
+      ~IndexShardJob() throw() = default;
+
+      Shard*
+      next_shard_() throw()
+      {
+        SyncPolicy::WriteGuard guard(lock_);
+
+        if(next_shard_i_ < shards_.size() && error_.empty())
+        {
+          return &shards_[next_shard_i_++];
+        }
+
+        return 0;
+      }
+
+    private:
+      ShardArray& shards_;
+      IndexingProgress* indexing_progress_;
+      Generics::ActiveObject* interrupter_;
+
+      SyncPolicy::Mutex lock_;
+      unsigned long next_shard_i_;
+      std::string error_;
+    };
+
+    bool
+    CampaignIndex::index_campaigns_parallel_(
+      const ConstCampaignPtrArray& campaigns,
+      unsigned long threads,
+      IndexingProgress* indexing_progress,
+      Generics::ActiveObject* interrupter)
+      throw(Exception, eh::Exception)
+    {
+      // shards is continuous campaign ranges:
+      // merge in shards order keep single thread insertion order
+      const unsigned long shards_count = std::min(
+        threads * INDEXING_SHARDS_PER_THREAD,
+        campaigns.size() / INDEXING_SHARD_MIN_SIZE);
+
+      IndexShardJob::ShardArray shards(shards_count);
+
+      for(unsigned long shard_i = 0; shard_i < shards_count; ++shard_i)
+      {
+        IndexShardJob::Shard& shard = shards[shard_i];
+        shard.campaigns_begin = campaigns.begin() +
+          campaigns.size() * shard_i / shards_count;
+        shard.campaigns_end = campaigns.begin() +
+          campaigns.size() * (shard_i + 1) / shards_count;
+        shard.index = new CampaignIndex(campaign_config_, logger_);
+        shard.indexed = false;
+      }
+
+      ReferenceCounting::SmartPtr<IndexShardJob> job(
+        new IndexShardJob(shards, indexing_progress, interrupter));
+
+      {
+        Generics::ThreadRunner thread_runner(job.in(), threads);
+        thread_runner.start();
+        thread_runner.wait_for_completion();
+      }
+
+      if(!job->error().empty())
       {
         Stream::Error ostr;
-        ostr << "Campaign index construct time : " << timer.elapsed_time();
-        logger_->log(
-          ostr.str(),
-          Logging::Logger::TRACE,
-          Aspect::CAMPAIGN_SELECTION_INDEX);
+        ostr << "CampaignIndex::index_campaigns_parallel_(): "
+          "can't index shard: " << job->error();
+        throw Exception(ostr);
       }
 
-      cell_holder_.reset();
-      campaign_cell_holder_.reset();
-      tag_campaign_approve_.clear();
+      MergeContext merge_context;
+
+      for(IndexShardJob::ShardArray::const_iterator shard_it = shards.begin();
+          shard_it != shards.end(); ++shard_it)
+      {
+        if(!shard_it->indexed)
+        {
+          return false;
+        }
+
+        merge_shard_(merge_context, *shard_it->index);
+      }
+
+      return true;
+    }
+
+    void
+    CampaignIndex::merge_shard_(
+      MergeContext& merge_context,
+      const CampaignIndex& shard)
+      throw(eh::Exception)
+    {
+      for(OrderedCampaignMap::const_iterator shard_node_it =
+            shard.ordered_campaigns_.begin();
+          shard_node_it != shard.ordered_campaigns_.end(); ++shard_node_it)
+      {
+        const IndexNode& shard_node = shard_node_it->second;
+        IndexNode& node = ordered_campaigns_[shard_node_it->first];
+
+        node.wg_display_campaigns = merge_cell_lists_(
+          merge_context,
+          node.wg_display_campaigns,
+          shard_node.wg_display_campaigns);
+        node.display_campaigns = merge_cell_lists_(
+          merge_context,
+          node.display_campaigns,
+          shard_node.display_campaigns);
+        node.text_campaigns = merge_cell_lists_(
+          merge_context,
+          node.text_campaigns,
+          shard_node.text_campaigns);
+        node.keyword_campaigns = merge_cell_lists_(
+          merge_context,
+          node.keyword_campaigns,
+          shard_node.keyword_campaigns);
+        node.wg_display_random_campaigns = merge_cell_lists_(
+          merge_context,
+          node.wg_display_random_campaigns,
+          shard_node.wg_display_random_campaigns);
+        node.display_random_campaigns = merge_cell_lists_(
+          merge_context,
+          node.display_random_campaigns,
+          shard_node.display_random_campaigns);
+        node.text_random_campaigns = merge_cell_lists_(
+          merge_context,
+          node.text_random_campaigns,
+          shard_node.text_random_campaigns);
+        node.keyword_random_campaigns = merge_cell_lists_(
+          merge_context,
+          node.keyword_random_campaigns,
+          shard_node.keyword_random_campaigns);
+        node.lost_wg_campaigns = merge_cell_lists_(
+          merge_context,
+          node.lost_wg_campaigns,
+          shard_node.lost_wg_campaigns);
+        node.lost_campaigns = merge_cell_lists_(
+          merge_context,
+          node.lost_campaigns,
+          shard_node.lost_campaigns);
+      }
+    }
+
+    CampaignSelectionCellList_var
+    CampaignIndex::merge_cell_lists_(
+      MergeContext& merge_context,
+      const CampaignSelectionCellList* left,
+      const CampaignSelectionCellList* right)
+      throw(eh::Exception)
+    {
+      if(!right)
+      {
+        return ReferenceCounting::add_ref(left);
+      }
+
+      const SelectionCellListMergeMap::key_type merge_key(left, right);
+
+      SelectionCellListMergeMap::const_iterator merged_it =
+        merge_context.selection_cell_lists.find(merge_key);
+
+      if(merged_it != merge_context.selection_cell_lists.end())
+      {
+        return merged_it->second;
+      }
+
+      // right cells inserted after left cells with equal ecpm
+      // (as at sequential insertion)
+      ReferenceCounting::SmartPtr<CampaignSelectionCellList> new_cell_list(
+        new CampaignSelectionCellList());
+
+      if(left)
+      {
+        std::merge(
+          left->begin(),
+          left->end(),
+          right->begin(),
+          right->end(),
+          std::back_inserter(
+            static_cast<std::list<ConstCampaignSelectionCell_var>&>(
+              *new_cell_list)),
+          [](const ConstCampaignSelectionCell_var& lhs,
+             const ConstCampaignSelectionCell_var& rhs)
+          {
+            return campaign_selection_cell_less_pred(lhs, rhs);
+          });
+      }
+      else
+      {
+        new_cell_list->assign(right->begin(), right->end());
+      }
+
+      CampaignSelectionCellList_var result = cell_holder_->pack(new_cell_list);
+      merge_context.selection_cell_lists.insert(
+        std::make_pair(merge_key, result));
+
+      return result;
+    }
+
+    CampaignCellList_var
+    CampaignIndex::merge_cell_lists_(
+      MergeContext& merge_context,
+      const CampaignCellList* left,
+      const CampaignCellList* right)
+      throw(eh::Exception)
+    {
+      if(!right)
+      {
+        return ReferenceCounting::add_ref(left);
+      }
+
+      const CellListMergeMap::key_type merge_key(left, right);
+
+      CellListMergeMap::const_iterator merged_it =
+        merge_context.cell_lists.find(merge_key);
+
+      if(merged_it != merge_context.cell_lists.end())
+      {
+        return merged_it->second;
+      }
+
+      ReferenceCounting::SmartPtr<CampaignCellList> new_cell_list(
+        new CampaignCellList());
+
+      if(left)
+      {
+        std::merge(
+          left->begin(),
+          left->end(),
+          right->begin(),
+          right->end(),
+          std::back_inserter(
+            static_cast<std::list<ConstCampaignCell_var>&>(*new_cell_list)),
+          [](const ConstCampaignCell_var& lhs,
+             const ConstCampaignCell_var& rhs)
+          {
+            return campaign_cell_less_pred(lhs, rhs);
+          });
+      }
+      else
+      {
+        new_cell_list->assign(right->begin(), right->end());
+      }
+
+      CampaignCellList_var result = campaign_cell_holder_->pack(new_cell_list);
+      merge_context.cell_lists.insert(std::make_pair(merge_key, result));
+
+      return result;
+    }
+
+    bool
+    CampaignIndex::tag_index_state_equal_(
+      const Tag* left,
+      const Tag* right)
+      throw()
+    {
+      if(left->timestamp != right->timestamp ||
+         left->tag_pricings_timestamp != right->tag_pricings_timestamp ||
+         left->site->timestamp != right->site->timestamp ||
+         left->site->account->timestamp != right->site->account->timestamp ||
+         left->sizes.size() != right->sizes.size() ||
+         left->tag_pricings.size() != right->tag_pricings.size())
+      {
+        return false;
+      }
+
+      for(Tag::SizeMap::const_iterator left_size_it = left->sizes.begin(),
+            right_size_it = right->sizes.begin();
+          left_size_it != left->sizes.end();
+          ++left_size_it, ++right_size_it)
+      {
+        if(left_size_it->first != right_size_it->first)
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    bool
+    CampaignIndex::creative_index_state_equal_(
+      const Creative* left,
+      const Creative* right)
+      throw()
+    {
+      // creative fields used at indexing can be changed
+      // at config linking without campaign timestamp change
+      if(left->ccid != right->ccid ||
+         left->status != right->status ||
+         left->defined_content_category != right->defined_content_category ||
+         left->categories != right->categories ||
+         left->click_categories != right->click_categories ||
+         left->sizes.size() != right->sizes.size())
+      {
+        return false;
+      }
+
+      for(Creative::SizeMap::const_iterator left_size_it = left->sizes.begin();
+          left_size_it != left->sizes.end(); ++left_size_it)
+      {
+        Creative::SizeMap::const_iterator right_size_it =
+          right->sizes.find(left_size_it->first);
+
+        if(right_size_it == right->sizes.end() ||
+           left_size_it->second.up_expand_space !=
+             right_size_it->second.up_expand_space ||
+           left_size_it->second.right_expand_space !=
+             right_size_it->second.right_expand_space ||
+           left_size_it->second.down_expand_space !=
+             right_size_it->second.down_expand_space ||
+           left_size_it->second.left_expand_space !=
+             right_size_it->second.left_expand_space ||
+           left_size_it->second.expandable !=
+             right_size_it->second.expandable ||
+           left_size_it->second.available_appformats !=
+             right_size_it->second.available_appformats)
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    bool
+    CampaignIndex::campaign_index_state_equal_(
+      const Campaign* left,
+      const Campaign* right)
+      throw()
+    {
+      if(left->timestamp != right->timestamp ||
+         left->account->timestamp != right->account->timestamp ||
+         left->advertiser->timestamp != right->advertiser->timestamp ||
+         left->is_active() != right->is_active() ||
+         left->account->is_active() != right->account->is_active() ||
+         left->ecpm_ != right->ecpm_ ||
+         left->ctr != right->ctr ||
+         left->click_sys_revenue != right->click_sys_revenue)
+      {
+        return false;
+      }
+
+      const CreativeList& left_creatives = left->get_creatives();
+      const CreativeList& right_creatives = right->get_creatives();
+
+      if(left_creatives.size() != right_creatives.size())
+      {
+        return false;
+      }
+
+      for(CreativeList::const_iterator left_cr_it = left_creatives.begin(),
+            right_cr_it = right_creatives.begin();
+          left_cr_it != left_creatives.end();
+          ++left_cr_it, ++right_cr_it)
+      {
+        if(!creative_index_state_equal_(*left_cr_it, *right_cr_it))
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    void
+    CampaignIndex::fill_template_availability_(
+      TemplateAvailabilityMap& template_availability) const
+      throw(eh::Exception)
+    {
+      const CreativeTemplateMap& creative_templates =
+        campaign_config_->creative_templates;
+
+      template_availability.clear();
+
+      for(CreativeTemplateMap::const_iterator templ_it =
+            creative_templates.begin();
+          templ_it != creative_templates.end(); ++templ_it)
+      {
+        bool available = false;
+
+        try
+        {
+          CreativeTemplate c_template;
+          Template_var templ = creative_templates.get(
+            templ_it->first, c_template);
+          available = templ.in() && c_template.status == 'A';
+        }
+        catch(const eh::Exception&)
+        {
+          // problem is logged by indexing (creative_available_by_templates_)
+        }
+
+        template_availability.insert(
+          std::make_pair(templ_it->first, available));
+      }
+    }
+
+    bool
+    CampaignIndex::template_availability_equal_(
+      const TemplateAvailabilityMap& left,
+      const TemplateAvailabilityMap& right)
+      throw()
+    {
+      if(left.size() != right.size())
+      {
+        return false;
+      }
+
+      for(TemplateAvailabilityMap::const_iterator left_it = left.begin();
+          left_it != left.end(); ++left_it)
+      {
+        TemplateAvailabilityMap::const_iterator right_it =
+          right.find(left_it->first);
+
+        if(right_it == right.end() || right_it->second != left_it->second)
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    bool
+    CampaignIndex::fill_tag_pricing_relink_(
+      TagPricingRelinkMap& tag_pricings,
+      const CampaignConfig& prev_config,
+      const CampaignConfig& new_config)
+      throw(eh::Exception)
+    {
+      if(prev_config.currency_exchange_id != new_config.currency_exchange_id ||
+         prev_config.tags.size() != new_config.tags.size())
+      {
+        return false;
+      }
+
+      tag_pricings[&Tag::TagPricing::DEFAULT] = &Tag::TagPricing::DEFAULT;
+
+      for(TagMap::const_iterator prev_tag_it = prev_config.tags.begin(),
+            new_tag_it = new_config.tags.begin();
+          prev_tag_it != prev_config.tags.end();
+          ++prev_tag_it, ++new_tag_it)
+      {
+        if(prev_tag_it->first != new_tag_it->first ||
+           !tag_index_state_equal_(prev_tag_it->second, new_tag_it->second))
+        {
+          return false;
+        }
+
+        for(Tag::TagPricings::const_iterator
+              prev_tp_it = prev_tag_it->second->tag_pricings.begin(),
+              new_tp_it = new_tag_it->second->tag_pricings.begin();
+            prev_tp_it != prev_tag_it->second->tag_pricings.end();
+            ++prev_tp_it, ++new_tp_it)
+        {
+          if(prev_tp_it->first < new_tp_it->first ||
+             new_tp_it->first < prev_tp_it->first ||
+             prev_tp_it->second.site_rate_id != new_tp_it->second.site_rate_id ||
+             prev_tp_it->second.cpm != new_tp_it->second.cpm ||
+             prev_tp_it->second.revenue_share != new_tp_it->second.revenue_share)
+          {
+            return false;
+          }
+
+          tag_pricings[&prev_tp_it->second] = &new_tp_it->second;
+        }
+      }
 
       return true;
     }
 
+    bool
+    CampaignIndex::relink_index_(
+      ConstCampaignPtrArray& reindex_campaigns,
+      const CampaignIndex& prev_index)
+      throw(Exception, eh::Exception)
+    {
+      const CampaignConfig& prev_config = *prev_index.campaign_config_;
+      RelinkContext relink_context;
+
+      // creatives availability depends on templates,
+      // that isn't linked to campaigns: reindex all if they changed
+      if(!template_availability_equal_(
+           prev_index.template_availability_, template_availability_) ||
+         !fill_tag_pricing_relink_(
+           relink_context.tag_pricings, prev_config, *campaign_config_))
+      {
+        return false;
+      }
+
+      for(CampaignConfig::CampaignMap::const_iterator cmp_it =
+            campaign_config_->campaigns.begin();
+          cmp_it != campaign_config_->campaigns.end(); ++cmp_it)
+      {
+        CampaignConfig::CampaignMap::const_iterator prev_cmp_it =
+          prev_config.campaigns.find(cmp_it->first);
+
+        if(prev_cmp_it != prev_config.campaigns.end() &&
+           campaign_index_state_equal_(prev_cmp_it->second, cmp_it->second))
+        {
+          relink_context.campaigns.insert(
+            std::make_pair(cmp_it->first, cmp_it->second.in()));
+        }
+        else
+        {
+          reindex_campaigns.push_back(cmp_it->second);
+        }
+      }
+
+      if(reindex_campaigns.size() * INCREMENTAL_INDEXING_MAX_REINDEX_SHARE >
+           campaign_config_->campaigns.size())
+      {
+        // relink have no sense, if most part of campaigns changed
+        reindex_campaigns.clear();
+        return false;
+      }
+
+      for(OrderedCampaignMap::const_iterator node_it =
+            prev_index.ordered_campaigns_.begin();
+          node_it != prev_index.ordered_campaigns_.end(); ++node_it)
+      {
+        const IndexNode& prev_node = node_it->second;
+        IndexNode node;
+
+        node.wg_display_campaigns = relink_cell_list_(
+          relink_context, prev_node.wg_display_campaigns);
+        node.display_campaigns = relink_cell_list_(
+          relink_context, prev_node.display_campaigns);
+        node.text_campaigns = relink_cell_list_(
+          relink_context, prev_node.text_campaigns);
+        node.keyword_campaigns = relink_cell_list_(
+          relink_context, prev_node.keyword_campaigns);
+        node.wg_display_random_campaigns = relink_cell_list_(
+          relink_context, prev_node.wg_display_random_campaigns);
+        node.display_random_campaigns = relink_cell_list_(
+          relink_context, prev_node.display_random_campaigns);
+        node.text_random_campaigns = relink_cell_list_(
+          relink_context, prev_node.text_random_campaigns);
+        node.keyword_random_campaigns = relink_cell_list_(
+          relink_context, prev_node.keyword_random_campaigns);
+        node.lost_wg_campaigns = relink_cell_list_(
+          relink_context, prev_node.lost_wg_campaigns);
+        node.lost_campaigns = relink_cell_list_(
+          relink_context, prev_node.lost_campaigns);
+
+        if(node.wg_display_campaigns.in() ||
+           node.display_campaigns.in() ||
+           node.text_campaigns.in() ||
+           node.keyword_campaigns.in() ||
+           node.wg_display_random_campaigns.in() ||
+           node.display_random_campaigns.in() ||
+           node.text_random_campaigns.in() ||
+           node.keyword_random_campaigns.in() ||
+           node.lost_wg_campaigns.in() ||
+           node.lost_campaigns.in())
+        {
+          ordered_campaigns_[node_it->first] = node;
+        }
+      }
+
+      return true;
+    }
+
+    CampaignSelectionCellList_var
+    CampaignIndex::relink_cell_list_(
+      RelinkContext& relink_context,
+      const CampaignSelectionCellList* cell_list)
+      throw(Exception, eh::Exception)
+    {
+      if(!cell_list)
+      {
+        return CampaignSelectionCellList_var();
+      }
+
+      SelectionCellListRelinkMap::const_iterator relinked_it =
+        relink_context.selection_cell_lists.find(cell_list);
+
+      if(relinked_it != relink_context.selection_cell_lists.end())
+      {
+        return relinked_it->second;
+      }
+
+      ReferenceCounting::SmartPtr<CampaignSelectionCellList> new_cell_list(
+        new CampaignSelectionCellList());
+
+      for(CampaignSelectionCellList::const_iterator cell_it = cell_list->begin();
+          cell_it != cell_list->end(); ++cell_it)
+      {
+        CampaignRelinkMap::const_iterator cmp_it =
+          relink_context.campaigns.find((*cell_it)->campaign->campaign_id);
+
+        if(cmp_it != relink_context.campaigns.end())
+        {
+          TagPricingRelinkMap::const_iterator tp_it =
+            relink_context.tag_pricings.find((*cell_it)->tag_pricing);
+
+          if(tp_it == relink_context.tag_pricings.end())
+          {
+            Stream::Error ostr;
+            ostr << "CampaignIndex::relink_cell_list_(): "
+              "can't relink tag pricing for ccg_id = " <<
+              cmp_it->first;
+            throw Exception(ostr);
+          }
+
+          // campaign and tag pricing isn't changed: keep ecpm
+          CampaignSelectionCell_var cell(new CampaignSelectionCell());
+          cell->campaign = ReferenceCounting::add_ref(cmp_it->second);
+          cell->tag_pricing = tp_it->second;
+          cell->ecpm = (*cell_it)->ecpm;
+          new_cell_list->push_back(ReferenceCounting::add_ref(cell.in()));
+        }
+      }
+
+      CampaignSelectionCellList_var result;
+
+      if(!new_cell_list->empty())
+      {
+        result = cell_holder_->pack(new_cell_list);
+      }
+
+      relink_context.selection_cell_lists.insert(
+        std::make_pair(cell_list, result));
+
+      return result;
+    }
+
+    CampaignCellList_var
+    CampaignIndex::relink_cell_list_(
+      RelinkContext& relink_context,
+      const CampaignCellList* cell_list)
+      throw(Exception, eh::Exception)
+    {
+      if(!cell_list)
+      {
+        return CampaignCellList_var();
+      }
+
+      CellListRelinkMap::const_iterator relinked_it =
+        relink_context.cell_lists.find(cell_list);
+
+      if(relinked_it != relink_context.cell_lists.end())
+      {
+        return relinked_it->second;
+      }
+
+      ReferenceCounting::SmartPtr<CampaignCellList> new_cell_list(
+        new CampaignCellList());
+
+      for(CampaignCellList::const_iterator cell_it = cell_list->begin();
+          cell_it != cell_list->end(); ++cell_it)
+      {
+        CampaignRelinkMap::const_iterator cmp_it =
+          relink_context.campaigns.find((*cell_it)->campaign->campaign_id);
+
+        if(cmp_it != relink_context.campaigns.end())
+        {
+          CampaignCell_var cell(new CampaignCell(cmp_it->second));
+          new_cell_list->push_back(ReferenceCounting::add_ref(cell.in()));
+        }
+      }
+
+      CampaignCellList_var result;
+
+      if(!new_cell_list->empty())
+      {
+        result = campaign_cell_holder_->pack(new_cell_list);
+      }
+
+      relink_context.cell_lists.insert(std::make_pair(cell_list, result));
+
+      return result;
+    }
+
+    void
+    CampaignIndex::compile_filters_() throw(eh::Exception)
+    {
+      CompileContext compile_context;
+
+      for(OrderedCampaignMap::iterator node_it = ordered_campaigns_.begin();
+          node_it != ordered_campaigns_.end(); ++node_it)
+      {
+        IndexNode& node = node_it->second;
+
+        node.filters.wg_display_campaigns = compile_filter_(
+          compile_context, node.wg_display_campaigns);
+        node.filters.display_campaigns = compile_filter_(
+          compile_context, node.display_campaigns);
+        node.filters.text_campaigns = compile_filter_(
+          compile_context, node.text_campaigns);
+        node.filters.keyword_campaigns = compile_filter_(
+          compile_context, node.keyword_campaigns);
+        node.filters.wg_display_random_campaigns = compile_filter_(
+          compile_context, node.wg_display_random_campaigns);
+        node.filters.display_random_campaigns = compile_filter_(
+          compile_context, node.display_random_campaigns);
+        node.filters.text_random_campaigns = compile_filter_(
+          compile_context, node.text_random_campaigns);
+        node.filters.keyword_random_campaigns = compile_filter_(
+          compile_context, node.keyword_random_campaigns);
+      }
+    }
+
+    CampaignSelectionCellListFilter_var
+    CampaignIndex::compile_filter_(
+      CompileContext& compile_context,
+      const CampaignSelectionCellList* cell_list)
+      throw(eh::Exception)
+    {
+      if(!cell_list || cell_list->size() < CELL_LIST_FILTER_MIN_SIZE)
+      {
+        return CampaignSelectionCellListFilter_var();
+      }
+
+      SelectionCellListFilterMap::const_iterator filter_it =
+        compile_context.selection_cell_lists.find(cell_list);
+
+      if(filter_it != compile_context.selection_cell_lists.end())
+      {
+        return filter_it->second;
+      }
+
+      CampaignSelectionCellListFilter_var result(
+        new CampaignSelectionCellListFilter(*cell_list));
+
+      if(result->empty())
+      {
+        result.reset();
+      }
+
+      compile_context.selection_cell_lists.insert(
+        std::make_pair(cell_list, result));
+
+      return result;
+    }
+
+    CampaignCellListFilter_var
+    CampaignIndex::compile_filter_(
+      CompileContext& compile_context,
+      const CampaignCellList* cell_list)
+      throw(eh::Exception)
+    {
+      if(!cell_list || cell_list->size() < CELL_LIST_FILTER_MIN_SIZE)
+      {
+        return CampaignCellListFilter_var();
+      }
+
+      CellListFilterMap::const_iterator filter_it =
+        compile_context.cell_lists.find(cell_list);
+
+      if(filter_it != compile_context.cell_lists.end())
+      {
+        return filter_it->second;
+      }
+
+      CampaignCellListFilter_var result(
+        new CampaignCellListFilter(*cell_list));
+
+      if(result->empty())
+      {
+        result.reset();
+      }
+
+      compile_context.cell_lists.insert(std::make_pair(cell_list, result));
+
+      return result;
+    }
+
     void
     CampaignIndex::index_for_status_(
       const Campaign* campaign,
@@ -980,6 +1901,9 @@ namespace AdServer
           
         IndexNode& index_node = ordered_campaigns_[key_hash];
 
+        // node lists changed: compiled targeting isn't actual
+        index_node.filters = IndexNode::Filters();
+
         if(text_candidate)
         {
           CampaignCell_var cell(new CampaignCell(campaign));
@@ -1439,11 +2363,30 @@ namespace AdServer
         return true;
       }
 
-      Generics::ExtendedTime ex_time(current_time_val.get_gm_time());
       return campaign->weekly_run_intervals.contains(
-        (ex_time.tm_wday + 6) % 7 * 60 * 24 +
+        week_minute_(current_time_val));
+    }
+
+    unsigned long
+    CampaignIndex::week_minute_(const Generics::Time& time) throw()
+    {
+      Generics::ExtendedTime ex_time(time.get_gm_time());
+      return (ex_time.tm_wday + 6) % 7 * 60 * 24 +
         ex_time.tm_hour * 60 +
-        ex_time.tm_min);
+        ex_time.tm_min;
+    }
+
+    void
+    CampaignIndex::Key::init_filter(
+      const Generics::Time& time,
+      unsigned long colo_id_val,
+      const AdServer::Commons::UserId& user_id)
+      throw()
+    {
+      filter = true;
+      week_hour = week_minute_(time) / 60;
+      colo_id = colo_id_val;
+      user_group = user_id.hash() % MAX_TARGET_USERS_GROUPS;
     }
 
     bool
@@ -1465,7 +2408,7 @@ namespace AdServer
       }
 
       return false;
-    }     
+    }
 
     bool
     CampaignIndex::check_tag_domain_exclusion(
@@ -1473,14 +2416,30 @@ namespace AdServer
       const Tag* tag)
       throw()
     {
+      if(tag->exclude_creative_domains.empty())
+      {
+        return true;
+      }
+
       try
       {
         HTTP::BrowserAddress url(url_val);
-        std::string check_domain = url.host().substr(
-          url.host().compare(0, 4, "www.") == 0 ? 4 : 0).str();
-        String::AsciiStringManip::to_lower(check_domain);
-        return tag->exclude_creative_domains.find(check_domain) ==
-          tag->exclude_creative_domains.end();
+        const String::SubString check_domain = url.host().substr(
+          url.host().compare(0, 4, "www.") == 0 ? 4 : 0);
+
+        // lower case copy only for hosts with upper case letters
+        for(String::SubString::ConstPointer ch = check_domain.begin();
+            ch != check_domain.end(); ++ch)
+        {
+          if(*ch >= 'A' && *ch <= 'Z')
+          {
+            std::string lower_check_domain = check_domain.str();
+            String::AsciiStringManip::to_lower(lower_check_domain);
+            return !tag->exclude_creative_domains.contains(lower_check_domain);
+          }
+        }
+
+        return !tag->exclude_creative_domains.contains(check_domain);
       }
       catch(...)
       {}
@@ -1934,7 +2893,7 @@ namespace AdServer
           }
 
           // filter creatives by search_order_set_id
-          ConstCreativePtrList new_creatives;
+          ConstCreativePtrList new_creatives(creatives.get_allocator());
 
           for(ConstCreativePtrList::const_iterator cr_it =
                 creatives.begin();
@@ -1984,6 +2943,85 @@ namespace AdServer
         less_pred);
     }
 
+    template<
+      typename ResultContainerType,
+      typename ListFieldType,
+      typename FilterFieldType,
+      typename LessPredType>
+    void
+    CampaignIndex::merge_lists_(
+      ResultContainerType& result,
+      const Key& key,
+      const IndexNodeList& nodes,
+      ListFieldType IndexNode::* list_field,
+      FilterFieldType IndexNode::Filters::* filter_field,
+      const LessPredType& less_pred)
+    {
+      if(!key.filter)
+      {
+        merge_lists_(result, nodes, list_field, less_pred);
+        return;
+      }
+
+      if(nodes.size() == 1)
+      {
+        select_cells_(result, key, *nodes.front(), list_field, filter_field);
+        return;
+      }
+
+      typedef std::vector<typename ResultContainerType::value_type>
+        CellPtrArray;
+
+      std::vector<CellPtrArray> node_cells(nodes.size());
+      std::vector<Algs::IteratorRange<
+        typename CellPtrArray::const_iterator> > ranges;
+      ranges.reserve(nodes.size());
+
+      typename std::vector<CellPtrArray>::iterator cells_it = node_cells.begin();
+
+      for(IndexNodeList::const_iterator ll_it = nodes.begin();
+          ll_it != nodes.end(); ++ll_it, ++cells_it)
+      {
+        select_cells_(*cells_it, key, **ll_it, list_field, filter_field);
+        ranges.push_back(Algs::iterator_range(
+          cells_it->begin(),
+          cells_it->end()));
+      }
+
+      Algs::custom_merge_n(
+        ranges.begin(),
+        ranges.end(),
+        std::back_inserter(result),
+        less_pred);
+    }
+
+    template<
+      typename ResultContainerType,
+      typename ListFieldType,
+      typename FilterFieldType>
+    void
+    CampaignIndex::select_cells_(
+      ResultContainerType& result,
+      const Key& key,
+      const IndexNode& node,
+      ListFieldType IndexNode::* list_field,
+      FilterFieldType IndexNode::Filters::* filter_field)
+    {
+      const FilterFieldType& filter = node.filters.*filter_field;
+
+      if(filter)
+      {
+        filter->select(result, key.week_hour, key.colo_id, key.user_group);
+      }
+      else if(node.*list_field)
+      {
+        std::copy(
+          (node.*list_field)->begin(),
+          (node.*list_field)->end(),
+          std::back_inserter(result));
+      }
+    }
+
     void
     CampaignIndex::get_index_nodes_(
       IndexNodeList& result_nodes,
@@ -2019,6 +3057,34 @@ namespace AdServer
       }
     }
 
+    void
+    CampaignIndex::get_tag_countries(TagCountryMap& result) const
+      throw(eh::Exception)
+    {
+      for(OrderedCampaignMap::const_iterator it = ordered_campaigns_.begin();
+          it != ordered_campaigns_.end(); ++it)
+      {
+        const IndexNode& node = it->second;
+
+        if((node.wg_display_campaigns && !node.wg_display_campaigns->empty()) ||
+           (node.display_campaigns && !node.display_campaigns->empty()) ||
+           (node.text_campaigns && !node.text_campaigns->empty()) ||
+           (node.keyword_campaigns && !node.keyword_campaigns->empty()) ||
+           (node.wg_display_random_campaigns &&
+             !node.wg_display_random_campaigns->empty()) ||
+           (node.display_random_campaigns &&
+             !node.display_random_campaigns->empty()) ||
+           (node.text_random_campaigns && !node.text_random_campaigns->empty()) ||
+           (node.keyword_random_campaigns && !node.keyword_random_campaigns->empty()))
+        {
+          const KeyHashAdapter& key = it->first;
+          result[key.tag_id].insert(std::string(
+            key.country_code,
+            key.country_code[0] ? (key.country_code[1] ? 2 : 1) : 0));
+        }
+      }
+    }
+
     void
     CampaignIndex::get_random_campaigns(
       const Key& request_params,
@@ -2034,26 +3100,34 @@ namespace AdServer
 
       merge_lists_(
         wg_display_campaign_cell_list,
+        request_params,
         index_nodes,
         &IndexNode::wg_display_random_campaigns,
+        &IndexNode::Filters::wg_display_random_campaigns,
         campaign_selection_cell_less_pred);
 
       merge_lists_(
         display_campaign_cell_list,
+        request_params,
         index_nodes,
         &IndexNode::display_random_campaigns,
+        &IndexNode::Filters::display_random_campaigns,
         campaign_selection_cell_less_pred);
 
       merge_lists_(
         text_campaign_cell_list,
+        request_params,
         index_nodes,
         &IndexNode::text_random_campaigns,
+        &IndexNode::Filters::text_random_campaigns,
         campaign_cell_less_pred);
 
       merge_lists_(
         keyword_campaign_cell_list,
+        request_params,
         index_nodes,
         &IndexNode::keyword_random_campaigns,
+        &IndexNode::Filters::keyword_random_campaigns,
         campaign_cell_less_pred);
     }
 
@@ -2074,26 +3148,34 @@ namespace AdServer
 
       merge_lists_(
         result_wg_campaign_cell_list,
+        request_params,
         index_nodes,
         &IndexNode::wg_display_campaigns,
+        &IndexNode::Filters::wg_display_campaigns,
         campaign_selection_cell_less_pred);
 
       merge_lists_(
         result_campaign_cell_list,
+        request_params,
         index_nodes,
         &IndexNode::display_campaigns,
+        &IndexNode::Filters::display_campaigns,
         campaign_selection_cell_less_pred);
 
       merge_lists_(
         result_text_campaign_cell_list,
+        request_params,
         index_nodes,
         &IndexNode::text_campaigns,
+        &IndexNode::Filters::text_campaigns,
         campaign_cell_less_pred);
 
       merge_lists_(
         result_keyword_campaign_cell_list,
+        request_params,
         index_nodes,
         &IndexNode::keyword_campaigns,
+        &IndexNode::Filters::keyword_campaigns,
         campaign_cell_less_pred);
       
       if(result_lost_wg_campaign_cell_list)
@@ -2308,9 +3390,56 @@ namespace AdServer
 
       ostr << "=== Campaign Tree ===" << std::endl <<
         "(match-type, colo-id, tid, country, app-format)" << std::endl;
+
+      // print nodes in key order: output independent of hash table history
+      typedef std::vector<OrderedCampaignMap::const_iterator> NodeIteratorArray;
+
+      NodeIteratorArray nodes;
+      nodes.reserve(ordered_campaigns_.size());
+
       for(OrderedCampaignMap::const_iterator it = ordered_campaigns_.begin();
           it != ordered_campaigns_.end(); ++it)
       {
+        nodes.push_back(it);
+      }
+
+      std::sort(
+        nodes.begin(),
+        nodes.end(),
+        [](const OrderedCampaignMap::const_iterator& left,
+           const OrderedCampaignMap::const_iterator& right)
+        {
+          const KeyHashAdapter& left_key = left->first;
+          const KeyHashAdapter& right_key = right->first;
+
+          if(left_key.tag_id != right_key.tag_id)
+          {
+            return left_key.tag_id < right_key.tag_id;
+          }
+
+          if(left_key.match_status_type != right_key.match_status_type)
+          {
+            return left_key.match_status_type < right_key.match_status_type;
+          }
+
+          const int country_cmp = ::strncmp(
+            left_key.country_code,
+            right_key.country_code,
+            sizeof(left_key.country_code));
+
+          if(country_cmp != 0)
+          {
+            return country_cmp < 0;
+          }
+
+          return left_key.app_format < right_key.app_format;
+        });
+
+      for(NodeIteratorArray::const_iterator node_it = nodes.begin();
+          node_it != nodes.end(); ++node_it)
+      {
+        const OrderedCampaignMap::const_iterator& it = *node_it;
+
         ostr << "(" << decode_match_status_type_(it->first.match_status_type) <<
           ", " <<
           it->first.tag_id << ", " <<
@@ -21,6 +21,12 @@
 #ifndef _CAMPAIGN_INDEX_HPP_
 #define _CAMPAIGN_INDEX_HPP_
 
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+#include <unordered_map>
+
 #include <eh/Exception.hpp>
 #include <Generics/CRC.hpp>
 #include <Generics/GnuHashTable.hpp>
@@ -28,6 +34,7 @@
 #include <Logger/Logger.hpp>
 
 #include <Commons/Containers.hpp>
+#include <Commons/MonotonicBuffer.hpp>
 
 #include "CampaignManagerDeclarations.hpp"
 #include "CampaignConfig.hpp"
@@ -188,6 +195,84 @@ namespace AdServer
       CampaignCellListHolder, ReferenceCounting::PolicyAssert>
       CampaignCellListHolder_var;
 
+    // CellListFilter
+    //   compiled targeting of cells list: dense bitsets over small enumerable
+    //   request dimensions (hour of week, colocation, user group),
+    //   bit i of dimension value row is set if i-th cell of list can pass
+    //   check_campaign for this value (row is superset of exact check).
+    //   Dimension that isn't targeted by any cell isn't stored.
+    template<typename CellType>
+    class CellListFilter: public ReferenceCounting::AtomicImpl
+    {
+    public:
+      static const unsigned long WEEK_HOURS = 7 * 24;
+
+      template<typename CellListType>
+      explicit
+      CellListFilter(const CellListType& cell_list)
+        throw(eh::Exception);
+
+      // filter pass all cells
+      bool
+      empty() const throw();
+
+      // push cells allowed for request dimensions into result
+      // (in list order)
+      template<typename ResultContainerType>
+      void
+      select(
+        ResultContainerType& result,
+        unsigned long week_hour,
+        unsigned long colo_id,
+        unsigned long user_group)
+        const
+        throw(eh::Exception);
+
+    protected:
+      virtual
+      ~CellListFilter() throw()
+      {}
+
+    private:
+      typedef uint64_t Word;
+      typedef std::vector<Word> WordArray;
+      typedef std::unordered_map<unsigned long, WordArray> ColoWordArrayMap;
+
+      static const unsigned long WORD_BITS = sizeof(Word) * 8;
+
+      void
+      clear_bit_(
+        WordArray& rows,
+        unsigned long row_i,
+        unsigned long cell_i)
+        throw();
+
+    private:
+      std::vector<const CellType*> cells_;
+      const unsigned long words_;
+      const Word tail_mask_;
+
+      WordArray week_hours_;
+      WordArray user_groups_;
+      // cells without colocation targeting
+      WordArray any_colo_;
+      ColoWordArrayMap colos_;
+    };
+
+    typedef CellListFilter<CampaignSelectionCell>
+      CampaignSelectionCellListFilter;
+
+    typedef ReferenceCounting::SmartPtr<
+      const CampaignSelectionCellListFilter, ReferenceCounting::PolicyAssert>
+      CampaignSelectionCellListFilter_var;
+
+    typedef CellListFilter<CampaignCell>
+      CampaignCellListFilter;
+
+    typedef ReferenceCounting::SmartPtr<
+      const CampaignCellListFilter, ReferenceCounting::PolicyAssert>
+      CampaignCellListFilter_var;
+
     /**
      * CampaignSelectionIndex
      * implement next campaign filters:
@@ -205,6 +290,10 @@ namespace AdServer
      *     2. campaign & ccg freq caps
      *     3. weekly run intervals
      *
+     *   get_campaigns prefilter (if enabled in key, see Key::init_filter):
+     *     weekly run intervals, colocations, user groups
+     *     by compiled targeting bitsets of candidate lists
+     *
      *   filter_creatives:
      *     1. creative freq caps
      *     2. click url match
@@ -228,7 +317,12 @@ namespace AdServer
       typedef std::deque<const CampaignSelectionCell*>
         CampaignSelectionCellPtrList;
       typedef std::deque<const CampaignCell*> CampaignCellPtrList;
-      typedef std::list<const Creative*> ConstCreativePtrList;
+      // default constructed list use heap,
+      // selection lists are allocated in request arena
+      typedef std::list<
+        const Creative*,
+        AdServer::Commons::ArenaAllocator<const Creative*> >
+        ConstCreativePtrList;
 
     public:
       CampaignIndex(
@@ -241,10 +335,19 @@ namespace AdServer
         Logging::Logger* logger)
         throw();
 
+      /* prev_index: index built for previous configuration,
+       * if it defined and tags (with sites and publishers) isn't changed
+       * only changed campaigns will be indexed,
+       * cells of other campaigns relinked to actual configuration
+       * threads: campaigns partitioned into shards indexed in parallel,
+       * shard indexes merged in campaigns order (result is equal to
+       * single thread indexing) */
       bool
       index_campaigns(
         IndexingProgress* indexing_progress = 0,
-        Generics::ActiveObject* interrupter = 0)
+        Generics::ActiveObject* interrupter = 0,
+        const CampaignIndex* prev_index = 0,
+        unsigned long threads = 1)
         throw(eh::Exception);
 
       ConstCampaignConfig_var
@@ -252,17 +355,37 @@ namespace AdServer
 
       struct Key
       {
-        Key(const Tag* tag_val): tag(tag_val) {}
+        Key(const Tag* tag_val)
+          : tag(tag_val),
+            filter(false),
+            week_hour(0),
+            colo_id(0),
+            user_group(0)
+        {}
+
+        /* enable candidates prefiltering by compiled targeting,
+         * arguments must be equal to check_campaign arguments */
+        void
+        init_filter(
+          const Generics::Time& time,
+          unsigned long colo_id_val,
+          const AdServer::Commons::UserId& user_id)
+          throw();
 
         const Tag* tag;
         std::string country_code;
         std::string format;
-        //unsigned long colo_id;
         UserStatus user_status;
         bool none_user_status;
         bool test_request;
         unsigned long tag_delivery_factor;
         unsigned long ccg_delivery_factor;
+
+        // request dimensions of compiled targeting
+        bool filter;
+        unsigned long week_hour;
+        unsigned long colo_id;
+        unsigned long user_group;
       };
 
       struct TraceParams
@@ -290,6 +413,15 @@ namespace AdServer
       unsigned long
       size() const throw();
 
+      typedef std::map<unsigned long, std::set<std::string> >
+        TagCountryMap;
+
+      /* collect for each tag countries, that have indexed campaigns
+       * for any user status (used for bid eligibility precheck) */
+      void
+      get_tag_countries(TagCountryMap& result) const
+        throw(eh::Exception);
+
       static bool
       match_domain(
         const std::string& domain,
@@ -471,6 +603,23 @@ namespace AdServer
 
         CampaignCellList_var lost_wg_campaigns;
         CampaignCellList_var lost_campaigns;
+
+        // compiled targeting of big candidate lists
+        // (lost lists don't pass check_campaign)
+        struct Filters
+        {
+          CampaignSelectionCellListFilter_var wg_display_campaigns;
+          CampaignSelectionCellListFilter_var display_campaigns;
+          CampaignCellListFilter_var text_campaigns;
+          CampaignCellListFilter_var keyword_campaigns;
+
+          CampaignSelectionCellListFilter_var wg_display_random_campaigns;
+          CampaignSelectionCellListFilter_var display_random_campaigns;
+          CampaignCellListFilter_var text_random_campaigns;
+          CampaignCellListFilter_var keyword_random_campaigns;
+        };
+
+        Filters filters;
       };
 
       typedef std::list<const IndexNode*> IndexNodeList;
@@ -523,7 +672,178 @@ namespace AdServer
 
       typedef Sync::Policy::PosixThread SyncPolicy;
 
+      typedef std::vector<const Campaign*> ConstCampaignPtrArray;
+
+      // incremental indexing: previous index cells relink helpers
+      typedef std::unordered_map<unsigned long, const Campaign*>
+        CampaignRelinkMap;
+
+      typedef std::unordered_map<
+        const Tag::TagPricing*, const Tag::TagPricing*>
+        TagPricingRelinkMap;
+
+      typedef std::map<
+        const CampaignSelectionCellList*, CampaignSelectionCellList_var>
+        SelectionCellListRelinkMap;
+
+      typedef std::map<const CampaignCellList*, CampaignCellList_var>
+        CellListRelinkMap;
+
+      // availability of creative templates (status 'A' and valid file)
+      // that index was built with
+      typedef Generics::GnuHashTable<CreativeTemplateKey, bool>
+        TemplateAvailabilityMap;
+
+      struct RelinkContext
+      {
+        CampaignRelinkMap campaigns;
+        TagPricingRelinkMap tag_pricings;
+        SelectionCellListRelinkMap selection_cell_lists;
+        CellListRelinkMap cell_lists;
+      };
+
+      typedef std::map<
+        std::pair<const CampaignSelectionCellList*, const CampaignSelectionCellList*>,
+        CampaignSelectionCellList_var>
+        SelectionCellListMergeMap;
+
+      typedef std::map<
+        std::pair<const CampaignCellList*, const CampaignCellList*>,
+        CampaignCellList_var>
+        CellListMergeMap;
+
+      struct MergeContext
+      {
+        SelectionCellListMergeMap selection_cell_lists;
+        CellListMergeMap cell_lists;
+      };
+
+      // cell lists are shared between index nodes: compile each list once
+      typedef std::unordered_map<
+        const CampaignSelectionCellList*, CampaignSelectionCellListFilter_var>
+        SelectionCellListFilterMap;
+
+      typedef std::unordered_map<
+        const CampaignCellList*, CampaignCellListFilter_var>
+        CellListFilterMap;
+
+      struct CompileContext
+      {
+        SelectionCellListFilterMap selection_cell_lists;
+        CellListFilterMap cell_lists;
+      };
+
+      class IndexShardJob;
+
     private:
+      bool
+      index_campaigns_(
+        ConstCampaignPtrArray::const_iterator campaigns_begin,
+        ConstCampaignPtrArray::const_iterator campaigns_end,
+        IndexingProgress* indexing_progress,
+        Generics::ActiveObject* interrupter)
+        throw(eh::Exception);
+
+      /* parallel indexing help methods */
+      bool
+      index_campaigns_parallel_(
+        const ConstCampaignPtrArray& campaigns,
+        unsigned long threads,
+        IndexingProgress* indexing_progress,
+        Generics::ActiveObject* interrupter)
+        throw(Exception, eh::Exception);
+
+      void
+      merge_shard_(
+        MergeContext& merge_context,
+        const CampaignIndex& shard)
+        throw(eh::Exception);
+
+      CampaignSelectionCellList_var
+      merge_cell_lists_(
+        MergeContext& merge_context,
+        const CampaignSelectionCellList* left,
+        const CampaignSelectionCellList* right)
+        throw(eh::Exception);
+
+      CampaignCellList_var
+      merge_cell_lists_(
+        MergeContext& merge_context,
+        const CampaignCellList* left,
+        const CampaignCellList* right)
+        throw(eh::Exception);
+
+      /* incremental indexing help methods */
+      bool
+      relink_index_(
+        ConstCampaignPtrArray& reindex_campaigns,
+        const CampaignIndex& prev_index)
+        throw(Exception, eh::Exception);
+
+      static bool
+      fill_tag_pricing_relink_(
+        TagPricingRelinkMap& tag_pricings,
+        const CampaignConfig& prev_config,
+        const CampaignConfig& new_config)
+        throw(eh::Exception);
+
+      void
+      fill_template_availability_(
+        TemplateAvailabilityMap& template_availability) const
+        throw(eh::Exception);
+
+      static bool
+      template_availability_equal_(
+        const TemplateAvailabilityMap& left,
+        const TemplateAvailabilityMap& right)
+        throw();
+
+      static bool
+      tag_index_state_equal_(
+        const Tag* left,
+        const Tag* right)
+        throw();
+
+      static bool
+      campaign_index_state_equal_(
+        const Campaign* left,
+        const Campaign* right)
+        throw();
+
+      static bool
+      creative_index_state_equal_(
+        const Creative* left,
+        const Creative* right)
+        throw();
+
+      CampaignSelectionCellList_var
+      relink_cell_list_(
+        RelinkContext& relink_context,
+        const CampaignSelectionCellList* cell_list)
+        throw(Exception, eh::Exception);
+
+      CampaignCellList_var
+      relink_cell_list_(
+        RelinkContext& relink_context,
+        const CampaignCellList* cell_list)
+        throw(Exception, eh::Exception);
+
+      /* compiled targeting help methods */
+      void
+      compile_filters_() throw(eh::Exception);
+
+      static CampaignSelectionCellListFilter_var
+      compile_filter_(
+        CompileContext& compile_context,
+        const CampaignSelectionCellList* cell_list)
+        throw(eh::Exception);
+
+      static CampaignCellListFilter_var
+      compile_filter_(
+        CompileContext& compile_context,
+        const CampaignCellList* cell_list)
+        throw(eh::Exception);
+
       /* campaign indexing help methods */
       void
       preindex_for_tag_(
@@ -675,6 +995,9 @@ namespace AdServer
         const Generics::Time& current_time)
         const;
 
+      static unsigned long
+      week_minute_(const Generics::Time& time) throw();
+
       void
       get_index_nodes_(
         IndexNodeList& result_nodes,
@@ -693,6 +1016,32 @@ namespace AdServer
         ListFieldType IndexNode::* list_field,
         const LessPredType& less_pred);
 
+      template<
+        typename ResultContainerType,
+        typename ListFieldType,
+        typename FilterFieldType,
+        typename LessPredType>
+      static void
+      merge_lists_(
+        ResultContainerType& result,
+        const Key& key,
+        const IndexNodeList& nodes,
+        ListFieldType IndexNode::* list_field,
+        FilterFieldType IndexNode::Filters::* filter_field,
+        const LessPredType& less_pred);
+
+      template<
+        typename ResultContainerType,
+        typename ListFieldType,
+        typename FilterFieldType>
+      static void
+      select_cells_(
+        ResultContainerType& result,
+        const Key& key,
+        const IndexNode& node,
+        ListFieldType IndexNode::* list_field,
+        FilterFieldType IndexNode::Filters::* filter_field);
+
       static
       std::string
       decode_match_status_type_(
@@ -705,6 +1054,7 @@ namespace AdServer
 
       ConstCampaignConfig_var campaign_config_;
       OrderedCampaignMap ordered_campaigns_;
+      TemplateAvailabilityMap template_availability_;
 
       // indexing temporary helpers
       TagCampaignApproveMap tag_campaign_approve_;
@@ -904,6 +1254,181 @@ namespace AdServer
         ins_it, ReferenceCounting::add_ref(ins));
     }
 
+    // CellListFilter
+    template<typename CellType>
+    template<typename CellListType>
+    CellListFilter<CellType>::CellListFilter(const CellListType& cell_list)
+      throw(eh::Exception)
+      : words_((cell_list.size() + WORD_BITS - 1) / WORD_BITS),
+        tail_mask_(cell_list.size() % WORD_BITS ?
+          (Word(1) << (cell_list.size() % WORD_BITS)) - 1 : ~Word(0))
+    {
+      cells_.reserve(cell_list.size());
+
+      for(typename CellListType::const_iterator cell_it = cell_list.begin();
+          cell_it != cell_list.end(); ++cell_it)
+      {
+        const unsigned long cell_i = cells_.size();
+        const Campaign* campaign = (*cell_it)->campaign;
+
+        cells_.push_back(*cell_it);
+
+        // rows are initialized when first targeted cell appear:
+        // all previous cells pass dimension
+        if(!campaign->weekly_run_intervals.empty())
+        {
+          if(week_hours_.empty())
+          {
+            week_hours_.assign(WEEK_HOURS * words_, ~Word(0));
+          }
+
+          bool allowed_hours[WEEK_HOURS] = { false };
+
+          for(WeeklyRunIntervalSet::const_iterator int_it =
+                campaign->weekly_run_intervals.begin();
+              int_it != campaign->weekly_run_intervals.end(); ++int_it)
+          {
+            // interval contains [min, max) and min
+            const unsigned long last_hour = int_it->max > int_it->min ?
+              (int_it->max - 1) / 60 : int_it->min / 60;
+
+            for(unsigned long hour = int_it->min / 60;
+                hour <= last_hour && hour < WEEK_HOURS; ++hour)
+            {
+              allowed_hours[hour] = true;
+            }
+          }
+
+          for(unsigned long hour = 0; hour < WEEK_HOURS; ++hour)
+          {
+            if(!allowed_hours[hour])
+            {
+              clear_bit_(week_hours_, hour, cell_i);
+            }
+          }
+        }
+
+        if(campaign->start_user_group_id > 0 ||
+           campaign->end_user_group_id < MAX_TARGET_USERS_GROUPS)
+        {
+          if(user_groups_.empty())
+          {
+            user_groups_.assign(MAX_TARGET_USERS_GROUPS * words_, ~Word(0));
+          }
+
+          for(unsigned long group = 0; group < MAX_TARGET_USERS_GROUPS; ++group)
+          {
+            if(group < campaign->start_user_group_id ||
+               group >= campaign->end_user_group_id)
+            {
+              clear_bit_(user_groups_, group, cell_i);
+            }
+          }
+        }
+
+        if(!campaign->colocations.empty())
+        {
+          if(any_colo_.empty())
+          {
+            any_colo_.assign(words_, ~Word(0));
+          }
+
+          clear_bit_(any_colo_, 0, cell_i);
+
+          for(ColoIdSet::const_iterator colo_it = campaign->colocations.begin();
+              colo_it != campaign->colocations.end(); ++colo_it)
+          {
+            WordArray& colo_row = colos_[*colo_it];
+
+            if(colo_row.empty())
+            {
+              colo_row.assign(words_, 0);
+            }
+
+            colo_row[cell_i / WORD_BITS] |= Word(1) << (cell_i % WORD_BITS);
+          }
+        }
+      }
+    }
+
+    template<typename CellType>
+    bool
+    CellListFilter<CellType>::empty() const throw()
+    {
+      return week_hours_.empty() && user_groups_.empty() && any_colo_.empty();
+    }
+
+    template<typename CellType>
+    template<typename ResultContainerType>
+    void
+    CellListFilter<CellType>::select(
+      ResultContainerType& result,
+      unsigned long week_hour,
+      unsigned long colo_id,
+      unsigned long user_group)
+      const
+      throw(eh::Exception)
+    {
+      const Word* week_row = week_hours_.empty() ? 0 :
+        &week_hours_[(week_hour < WEEK_HOURS ? week_hour : WEEK_HOURS - 1) *
+          words_];
+      const Word* group_row = user_groups_.empty() ? 0 :
+        &user_groups_[user_group % MAX_TARGET_USERS_GROUPS * words_];
+      const Word* any_colo_row = any_colo_.empty() ? 0 : &any_colo_[0];
+      const Word* colo_row = 0;
+
+      if(any_colo_row)
+      {
+        typename ColoWordArrayMap::const_iterator colo_it =
+          colos_.find(colo_id);
+
+        if(colo_it != colos_.end())
+        {
+          colo_row = &colo_it->second[0];
+        }
+      }
+
+      for(unsigned long word_i = 0; word_i < words_; ++word_i)
+      {
+        Word word = word_i + 1 < words_ ? ~Word(0) : tail_mask_;
+
+        if(week_row)
+        {
+          word &= week_row[word_i];
+        }
+
+        if(group_row)
+        {
+          word &= group_row[word_i];
+        }
+
+        if(any_colo_row)
+        {
+          word &= any_colo_row[word_i] | (colo_row ? colo_row[word_i] : 0);
+        }
+
+        const CellType* const* word_cells = &cells_[word_i * WORD_BITS];
+
+        while(word)
+        {
+          result.push_back(word_cells[__builtin_ctzll(word)]);
+          word &= word - 1;
+        }
+      }
+    }
+
+    template<typename CellType>
+    void
+    CellListFilter<CellType>::clear_bit_(
+      WordArray& rows,
+      unsigned long row_i,
+      unsigned long cell_i)
+      throw()
+    {
+      rows[row_i * words_ + cell_i / WORD_BITS] &=
+        ~(Word(1) << (cell_i % WORD_BITS));
+    }
+
     // CampaignIndex
     inline
     ConstCampaignConfig_var
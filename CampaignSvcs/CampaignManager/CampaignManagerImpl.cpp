@@ -168,7 +168,8 @@ namespace AdServer
     CampaignManagerImpl::AdSlotContext::AdSlotContext() throw ()
       : test_request(false),
         request_blacklisted(false),
-        publisher_account_id(0)
+        publisher_account_id(0),
+        deadline(Generics::Time::ZERO)
     {}
 
     /**
@@ -211,6 +212,8 @@ namespace AdServer
         campaign_manager_logger_(
           ReferenceCounting::add_ref(campaign_manager_logger)),
         creative_instantiate_(creative_instantiate),
+        config_snapshot_checked_(false),
+        configuration_state_(new ConfigurationState()),
         task_runner_(new Generics::TaskRunner(callback_, PARALLEL_TASKS_COUNT)),
         update_task_runner_(new Generics::TaskRunner(callback_, UPDATE_TASKS_COUNT)),
         scheduler_(new Generics::Planner(callback_)),
@@ -332,7 +335,9 @@ namespace AdServer
           campaign_manager_config_.service_index(),
           creative_instantiate_.creative_rules,
           campaign_manager_config_.Creative().drop_https_safe().present() &&
-            *campaign_manager_config_.Creative().drop_https_safe()
+            *campaign_manager_config_.Creative().drop_https_safe(),
+          campaign_manager_config_.config_snapshot_file().present() ?
+            campaign_manager_config_.config_snapshot_file()->c_str() : 0
           );
 
         add_child_object(campaign_config_source_);
@@ -351,13 +356,28 @@ namespace AdServer
       {
         try
         {
+          std::unique_ptr<BillingStateContainer::LeaseConfig> lease_config;
+
+          if(campaign_manager_config_.Billing()->BudgetLease().present())
+          {
+            const xsd::AdServer::Configuration::BudgetLeaseType& budget_lease_config =
+              *campaign_manager_config_.Billing()->BudgetLease();
+            lease_config.reset(new BillingStateContainer::LeaseConfig());
+            lease_config->size = budget_lease_config.size();
+            lease_config->refill_size = budget_lease_config.refill_size();
+            lease_config->max_overspend = budget_lease_config.max_overspend();
+            lease_config->return_period = Generics::Time(
+              budget_lease_config.return_period());
+          }
+
           BillingStateContainer_var billing_state_container = new BillingStateContainer(
             callback_,
             logger,
             Config::CorbaConfigReader::read_multi_corba_ref(
               campaign_manager_config_.Billing()->BillingServerCorbaRef()),
             100, // max use count
-            campaign_manager_config_.Billing()->optimize_campaign_ctr());
+            campaign_manager_config_.Billing()->optimize_campaign_ctr(),
+            lease_config.get());
 
           if(campaign_manager_config_.Billing()->check_bids())
           {
@@ -528,6 +548,10 @@ namespace AdServer
 
       try
       {
+        // caller time budget is converted to deadline by own clock
+        const Generics::Time deadline = CorbaAlgs::unpack_time_budget(
+          request_params.time_budget,
+          Generics::Time::get_time_of_day());
         Generics::Timer process_timer;
         process_timer.start();
         hostname << campaign_manager_config_.host();
@@ -671,6 +695,7 @@ namespace AdServer
 
           AdSlotContext ad_slot_context;
           ad_slot_context.request_blacklisted = request_blacklisted;
+          ad_slot_context.deadline = deadline;
 
           ad_slot_context.test_request =
           filtered_request_params.common_info.test_request;
@@ -3106,10 +3131,6 @@ namespace AdServer
       AuctionType auction_type = AT_MAX_ECPM;
       AuctionType second_auction_type = AT_MAX_ECPM;
 
-      // weightening campaigns
-      CampaignSelector::WeightedCampaignPtr weighted_campaign;
-      CampaignSelector::WeightedCampaignKeywordListPtr weighted_campaign_keywords;
-
       CampaignSelector campaign_selector(
         config_index, ctr_provider_.get(), conv_rate_provider_.get());
       CampaignSelectParams_var campaign_select_params_ptr(new CampaignSelectParams(
@@ -3125,6 +3146,12 @@ namespace AdServer
 
       CampaignSelectParams& campaign_select_params = *campaign_select_params_ptr;
 
+      // weightening campaigns
+      // weighted campaign is allocated in campaign_select_params arena,
+      // must be destroyed before it
+      CampaignSelector::WeightedCampaignPtr weighted_campaign;
+      CampaignSelector::WeightedCampaignKeywordListPtr weighted_campaign_keywords;
+
       {
         ChannelIdHashSet triggered_channels(
           request_params.channels.get_buffer(),
@@ -3142,6 +3169,7 @@ namespace AdServer
           request_params.common_info.user_status);
         campaign_select_params.test_request = ad_slot_context.test_request;
         campaign_select_params.time = CorbaAlgs::unpack_time(request_params.common_info.time);
+        campaign_select_params.deadline = ad_slot_context.deadline;
         campaign_select_params.tag_delivery_factor = request_params.tag_delivery_factor;
         campaign_select_params.random = request_params.common_info.random;
         campaign_select_params.random2 = Generics::safe_rand(RANDOM_PARAM_MAX);
@@ -3367,31 +3395,65 @@ namespace AdServer
         */
       }
 
-      if(check_billing_state_container_)
+      if(check_billing_state_container_ && (
+           weighted_campaign_keywords.get() || weighted_campaign.get()))
       {
+        // check all selected campaigns by one call
+        BillingStateContainer::BidCheckArray bid_checks;
+
+        if(weighted_campaign_keywords.get())
+        {
+          for(CampaignSelector::WeightedCampaignKeywordList::const_iterator cmp_it =
+              weighted_campaign_keywords->begin();
+            cmp_it != weighted_campaign_keywords->end(); ++cmp_it)
+          {
+            BillingStateContainer::BidCheck bid_check;
+            bid_check.account_id = cmp_it->campaign->advertiser->bill_account_id();
+            bid_check.advertiser_id = cmp_it->campaign->advertiser->not_bill_account_id();
+            bid_check.campaign_id = cmp_it->campaign->campaign_group_id;
+            bid_check.ccg_id = cmp_it->campaign->campaign_id;
+            bid_check.ctr = cmp_it->ctr;
+            bid_check.ccg_setter = cmp_it->campaign;
+            bid_checks.push_back(bid_check);
+          }
+        }
+
+        if(weighted_campaign.get())
+        {
+          BillingStateContainer::BidCheck bid_check;
+          bid_check.account_id = weighted_campaign->campaign->advertiser->bill_account_id();
+          bid_check.advertiser_id =
+            weighted_campaign->campaign->advertiser->not_bill_account_id();
+          bid_check.campaign_id = weighted_campaign->campaign->campaign_group_id;
+          bid_check.ccg_id = weighted_campaign->campaign->campaign_id;
+          bid_check.ctr = weighted_campaign->ctr;
+          bid_check.ccg_setter = weighted_campaign->campaign;
+          bid_checks.push_back(bid_check);
+        }
+
+        BillingStateContainer::BidCheckResultArray check_results;
+
+        check_billing_state_container_->check_available_bids(
+          check_results,
+          campaign_select_params.time,
+          bid_checks);
+
+        BillingStateContainer::BidCheckResultArray::const_iterator
+          check_result_it = check_results.begin();
+
         if(weighted_campaign_keywords.get())
         {
-          // TODO: one call for all keywords
           // clear weighted_campaign_keywords if showing not allowed
           bool available = true;
 
           for(CampaignSelector::WeightedCampaignKeywordList::const_iterator cmp_it =
               weighted_campaign_keywords->begin();
-            cmp_it != weighted_campaign_keywords->end(); ++cmp_it)
+            cmp_it != weighted_campaign_keywords->end();
+            ++cmp_it, ++check_result_it)
           {
-            const BillingStateContainer::BidCheckResult check_result =
-              check_billing_state_container_->check_available_bid(
-                campaign_select_params.time,
-                cmp_it->campaign->advertiser->bill_account_id(),
-                cmp_it->campaign->advertiser->not_bill_account_id(),
-                cmp_it->campaign->campaign_group_id,
-                cmp_it->campaign->campaign_id,
-                cmp_it->ctr,
-                cmp_it->campaign);
-
             available &= apply_check_available_bid_result_(
               cmp_it->campaign,
-              check_result,
+              *check_result_it,
               cmp_it->ctr);
           }
 
@@ -3404,19 +3466,9 @@ namespace AdServer
         if(weighted_campaign.get())
         {
           // clear weighted_campaign if showing not allowed
-          const BillingStateContainer::BidCheckResult check_result =
-            check_billing_state_container_->check_available_bid(
-              campaign_select_params.time,
-              weighted_campaign->campaign->advertiser->bill_account_id(),
-              weighted_campaign->campaign->advertiser->not_bill_account_id(),
-              weighted_campaign->campaign->campaign_group_id,
-              weighted_campaign->campaign->campaign_id,
-              weighted_campaign->ctr,
-              weighted_campaign->campaign);
-
           if(!apply_check_available_bid_result_(
                weighted_campaign->campaign,
-               check_result,
+               *check_result_it,
                weighted_campaign->ctr))
           {
             weighted_campaign.reset(nullptr);
@@ -3613,6 +3665,11 @@ namespace AdServer
           Aspect::CAMPAIGN_MANAGER);
       }
 
+      if(logger_->log_level() >= TraceLevel::MIDDLE)
+      {
+        log_creative_templates_stats_();
+      }
+
       if(next_flush != Generics::Time::ZERO)
       {
         try
@@ -3636,6 +3693,75 @@ namespace AdServer
       }
     }
 
+    void
+    CampaignManagerImpl::log_creative_templates_stats_() throw()
+    {
+      static const char* FUN =
+        "CampaignManagerImpl::log_creative_templates_stats_()";
+
+      try
+      {
+        CampaignConfig_var config = configuration();
+
+        if(!config)
+        {
+          return;
+        }
+
+        CreativeTemplateMap::StatsMap stats;
+        config->creative_templates.get_stats(stats);
+
+        // slow templates first
+        typedef std::multimap<
+          Generics::Time,
+          CreativeTemplateMap::StatsMap::const_iterator,
+          std::greater<Generics::Time> > SortedStatsMap;
+
+        SortedStatsMap sorted_stats;
+
+        for(CreativeTemplateMap::StatsMap::const_iterator it = stats.begin();
+            it != stats.end(); ++it)
+        {
+          if(it->second.instantiations)
+          {
+            sorted_stats.insert(std::make_pair(it->second.time, it));
+          }
+        }
+
+        if(!sorted_stats.empty())
+        {
+          Stream::Error ostr;
+          ostr << FUN << ": creative templates instantiation time:";
+
+          for(SortedStatsMap::const_iterator it = sorted_stats.begin();
+              it != sorted_stats.end(); ++it)
+          {
+            const Template::Stats& templ_stats = it->second->second;
+
+            ostr << std::endl << "  " << it->second->first.file <<
+              ": instantiations = " << templ_stats.instantiations <<
+              ", time = " << templ_stats.time <<
+              ", average = " << templ_stats.time / templ_stats.instantiations <<
+              ", max = " << templ_stats.max_time;
+          }
+
+          logger_->log(
+            ostr.str(),
+            TraceLevel::MIDDLE,
+            Aspect::CAMPAIGN_MANAGER);
+        }
+      }
+      catch(const eh::Exception& ex)
+      {
+        Stream::Error ostr;
+        ostr << FUN << ": eh::Exception caught: " << ex.what();
+        logger_->log(
+          ostr.str(),
+          Logging::Logger::WARNING,
+          Aspect::CAMPAIGN_MANAGER);
+      }
+    }
+
     AdServer::CampaignSvcs::CampaignManager::ChannelSearchResultSeq*
     CampaignManagerImpl::get_channel_links(
       const AdServer::CampaignSvcs::ChannelIdSeq& channels,
@@ -4801,6 +4927,94 @@ namespace AdServer
       return 0; // never reach
     }
 
+    namespace
+    {
+      void
+      fill_bid_eligibility_tag_keys(
+        AdServer::CampaignSvcs::CampaignManager::BidEligibilityTagKeySeq& result,
+        const CampaignConfig::IdTagMap& tag_keys)
+        throw(eh::Exception)
+      {
+        result.length(tag_keys.size());
+        CORBA::ULong res_i = 0;
+
+        for(CampaignConfig::IdTagMap::const_iterator it = tag_keys.begin();
+            it != tag_keys.end(); ++it, ++res_i)
+        {
+          AdServer::CampaignSvcs::CampaignManager::BidEligibilityTagKeyInfo&
+            res_key = result[res_i];
+          res_key.id = it->first.id;
+          res_key.size << it->first.size;
+          res_key.tag_ids.length(it->second.size());
+          for(CORBA::ULong tag_i = 0; tag_i < it->second.size(); ++tag_i)
+          {
+            res_key.tag_ids[tag_i] = it->second[tag_i]->tag_id;
+          }
+        }
+      }
+    }
+
+    AdServer::CampaignSvcs::CampaignManager::BidEligibilityInfo*
+    CampaignManagerImpl::get_bid_eligibility(
+      const AdServer::CampaignSvcs::TimestampInfo& known_version)
+      throw (AdServer::CampaignSvcs::CampaignManager::ImplementationException,
+        AdServer::CampaignSvcs::CampaignManager::NotReady)
+    {
+      static const char* FUN = "CampaignManagerImpl::get_bid_eligibility()";
+
+      try
+      {
+        CampaignIndex_var config_index = configuration_index();
+
+        if(!config_index)
+        {
+          throw AdServer::CampaignSvcs::CampaignManager::NotReady(
+            "Campaign index isn't constructed");
+        }
+
+        ConstCampaignConfig_var config = config_index->configuration();
+
+        AdServer::CampaignSvcs::CampaignManager::BidEligibilityInfo_var result =
+          new AdServer::CampaignSvcs::CampaignManager::BidEligibilityInfo();
+        result->version = CorbaAlgs::pack_time(config->master_stamp);
+        result->changed = known_version.length() == 0 ||
+          CorbaAlgs::unpack_time(known_version) != config->master_stamp;
+
+        if(result->changed)
+        {
+          fill_bid_eligibility_tag_keys(result->site_tags, config->site_tags);
+          fill_bid_eligibility_tag_keys(result->account_tags, config->account_tags);
+
+          CampaignIndex::TagCountryMap tag_countries;
+          config_index->get_tag_countries(tag_countries);
+
+          result->tags.length(tag_countries.size());
+          CORBA::ULong tag_i = 0;
+          for(CampaignIndex::TagCountryMap::const_iterator tag_it =
+                tag_countries.begin();
+              tag_it != tag_countries.end(); ++tag_it, ++tag_i)
+          {
+            result->tags[tag_i].tag_id = tag_it->first;
+            CorbaAlgs::fill_sequence(
+              tag_it->second.begin(),
+              tag_it->second.end(),
+              result->tags[tag_i].countries);
+          }
+        }
+
+        return result._retn();
+      }
+      catch (const eh::Exception& e)
+      {
+        Stream::Error ostr;
+        ostr << FUN << ": Caught eh::Exception: " << e.what();
+        CORBACommons::throw_desc<
+          CampaignSvcs::CampaignManager::ImplementationException>(
+            ostr.str());
+      }
+      return 0; // never reach
+    }
+
     AdServer::CampaignSvcs::StringSeq*
     CampaignManagerImpl::get_pub_pixels(
       const char* country,
@@ -5062,6 +5276,12 @@ namespace AdServer
     {
       if(confirm_billing_state_container_)
       {
+        // confirm all creatives by one call
+        BillingStateContainer::BidConfirmArray bid_confirms;
+        std::vector<const Campaign*> confirm_campaigns;
+        bid_confirms.reserve(creatives.size());
+        confirm_campaigns.reserve(creatives.size());
+
         // resolve id's and rate
         for(ConfirmCreativeAmountArray::const_iterator cc_it = creatives.begin();
           cc_it != creatives.end(); ++cc_it)
@@ -5123,24 +5343,43 @@ namespace AdServer
               }
             }
 
-            const BillingStateContainer::BidCheckResult check_result =
-              confirm_billing_state_container_->confirm_bid(
-                now,
-                campaign->advertiser ? campaign->advertiser->bill_account_id() : 0,
-                campaign->advertiser ? campaign->advertiser->not_bill_account_id() : 0,
-                campaign->campaign_group_id,
-                campaign->campaign_id,
-                campaign->account && campaign->account->invoice_commision() ?
-                  amount + comm_amount : amount, // account amount
-                campaign->account && campaign->account->cost_is_gross() ?
-                  amount + comm_amount : amount,
-                cc_it->ctr,
-                RevenueDecimal(false, rate_type == CR_CPM ? 1 : 0, 0),
-                RevenueDecimal(false, rate_type == CR_CPC ? 1 : 0, 0),
-                campaign);
+            BillingStateContainer::BidConfirm bid_confirm;
+            bid_confirm.account_id =
+              campaign->advertiser ? campaign->advertiser->bill_account_id() : 0;
+            bid_confirm.advertiser_id =
+              campaign->advertiser ? campaign->advertiser->not_bill_account_id() : 0;
+            bid_confirm.campaign_id = campaign->campaign_group_id;
+            bid_confirm.ccg_id = campaign->campaign_id;
+            bid_confirm.ctr = cc_it->ctr;
+            bid_confirm.ccg_setter = campaign;
+            bid_confirm.account_spent_amount =
+              campaign->account && campaign->account->invoice_commision() ?
+                amount + comm_amount : amount; // account amount
+            bid_confirm.spent_amount =
+              campaign->account && campaign->account->cost_is_gross() ?
+                amount + comm_amount : amount;
+            bid_confirm.imps = RevenueDecimal(false, rate_type == CR_CPM ? 1 : 0, 0);
+            bid_confirm.clicks = RevenueDecimal(false, rate_type == CR_CPC ? 1 : 0, 0);
+            bid_confirms.push_back(bid_confirm);
+            confirm_campaigns.push_back(campaign);
+          }
+        }
 
+        if(!bid_confirms.empty())
+        {
+          BillingStateContainer::BidCheckResultArray check_results;
+
+          confirm_billing_state_container_->confirm_bids(
+            check_results,
+            now,
+            bid_confirms);
+
+          for(std::size_t confirm_i = 0; confirm_i < check_results.size(); ++confirm_i)
+          {
             apply_check_available_bid_result_(
-              campaign, check_result, RevenueDecimal::ZERO);
+              confirm_campaigns[confirm_i],
+              check_results[confirm_i],
+              RevenueDecimal::ZERO);
           }
         }
       } // if(confirm_billing_state_container_)
@@ -42,6 +42,7 @@
 #include <Commons/CorbaAlgs.hpp>
 #include <Commons/IPCrypter.hpp>
 #include <Commons/SecToken.hpp>
+#include <Commons/SnapshotHolder.hpp>
 #include <Commons/TextTemplateCache.hpp>
 #include <LogCommons/AdRequestLogger.hpp>
 #include <Commons/Kafka/KafkaProducer.hpp>
@@ -301,6 +302,12 @@ namespace AdServer
         throw (AdServer::CampaignSvcs::CampaignManager::ImplementationException,
           AdServer::CampaignSvcs::CampaignManager::NotReady);
 
+      virtual AdServer::CampaignSvcs::CampaignManager::BidEligibilityInfo*
+      get_bid_eligibility(
+        const AdServer::CampaignSvcs::TimestampInfo& known_version)
+        throw (AdServer::CampaignSvcs::CampaignManager::ImplementationException,
+          AdServer::CampaignSvcs::CampaignManager::NotReady);
+
       virtual AdServer::CampaignSvcs::StringSeq*
       get_pub_pixels(
         const char* country,
@@ -397,6 +404,8 @@ namespace AdServer
         std::string tag_size;
         std::string tns_counter_device_type;
         unsigned long publisher_account_id;
+        // request processing deadline, zero if not defined
+        Generics::Time deadline;
 
         AdSlotContext() throw ();
       };
@@ -477,6 +486,22 @@ namespace AdServer
 
       typedef Sync::Policy::PosixThread SyncPolicy;
 
+      // config and index built for it are replaced together:
+      // request never see index of other config
+      struct ConfigurationState: public ReferenceCounting::AtomicImpl
+      {
+        CampaignConfig_var configuration;
+        CampaignIndex_var configuration_index;
+
+      protected:
+        virtual
+        ~ConfigurationState() throw () = default;
+      };
+
+      typedef AdServer::Commons::SnapshotHolder<ConfigurationState>
+        ConfigurationStateHolder;
+      typedef ConfigurationStateHolder::Object_var ConfigurationState_var;
+
       struct InstantiateParams
       {
         InstantiateParams(
@@ -985,6 +1010,8 @@ namespace AdServer
 
       void flush_logs() throw();
 
+      void log_creative_templates_stats_() throw();
+
       static AdRequestType
       reduce_request_type_(CORBA::ULong request_type)
         throw();
@@ -1156,6 +1183,8 @@ namespace AdServer
       TokenToParamMap token_to_parameters_;
 
       CampaignConfigSource_var campaign_config_source_;
+      // config snapshot loading tried (only at first check_config)
+      bool config_snapshot_checked_;
       BillingStateContainer_var check_billing_state_container_;
       BillingStateContainer_var confirm_billing_state_container_;
       ReferenceCounting::PtrHolder<ConstCTRProvider_var> ctr_provider_;
@@ -1163,9 +1192,9 @@ namespace AdServer
 
       mutable SyncPolicy::Mutex lock_;
 
-      CampaignConfig_var configuration_;
+      // read by each request without lock_
+      ConfigurationStateHolder configuration_state_;
       IndexingProgress indexing_progress_;
-      CampaignIndex_var configuration_index_;
       PassbackTemplateMap passback_templates_;
 
       Generics::TaskRunner_var task_runner_;
@@ -1197,8 +1226,8 @@ namespace CampaignSvcs
     CampaignConfig_var res;
 
     {
-      SyncPolicy::ReadGuard guard(lock_);
-      res = configuration_;
+      ConfigurationStateHolder::ReadGuard guard(configuration_state_);
+      res = guard->configuration;
     }
 
     if(required && !res)
@@ -1214,8 +1243,8 @@ namespace CampaignSvcs
   CampaignIndex_var
   CampaignManagerImpl::configuration_index() const throw(eh::Exception)
   {
-    SyncPolicy::ReadGuard guard(lock_);
-    return configuration_index_;
+    ConfigurationStateHolder::ReadGuard guard(configuration_state_);
+    return guard->configuration_index;
   }
 
   inline
@@ -24,6 +24,7 @@
 #include <string>
 #include <Commons/Containers.hpp>
 #include <Commons/UserInfoManip.hpp>
+#include <Commons/MonotonicBuffer.hpp>
 
 #include <ReferenceCounting/DefaultImpl.hpp>
 
@@ -50,6 +51,11 @@ namespace CampaignSvcs
     typedef std::map<unsigned long, unsigned long>
       CampaignImpsMap;
 
+    // first arena block is part of request params,
+    // usual selection don't allocate arena blocks on heap
+    static const std::size_t ARENA_INLINE_SIZE = 16 * 1024;
+    static const std::size_t ARENA_BLOCK_SIZE = 16 * 1024;
+
     CampaignSelectParams(
       bool profiling_available_val,
       const FreqCapIdSet& full_freq_caps_val,
@@ -86,9 +92,17 @@ namespace CampaignSvcs
         secure(false),
         filter_empty_destination(filter_dest),
         tag_visibility(tag_visibility_val),
-        tag_predicted_viewability(tag_predicted_viewability_val)
+        tag_predicted_viewability(tag_predicted_viewability_val),
+        arena(&arena_block_, sizeof(arena_block_), ARENA_BLOCK_SIZE)
     {}
 
+    // allocator for request scoped selection containers
+    AdServer::Commons::ArenaAllocator<char>
+    allocator() const throw()
+    {
+      return AdServer::Commons::ArenaAllocator<char>(&arena);
+    }
+
     bool profiling_available;
     FreqCapIdSet full_freq_caps;
     SeqOrderMap seq_orders;
@@ -142,9 +156,19 @@ namespace CampaignSvcs
     int tag_visibility;
     int tag_predicted_viewability;
 
+    // request processing deadline, selection is stopped without bid
+    // after it; zero if not defined
+    Generics::Time deadline;
+
+    // candidates, creative lists and auction containers of selection,
+    // released with request params
+    mutable AdServer::Commons::MonotonicBuffer arena;
+
   private:
     ~CampaignSelectParams() throw()
     {}
+
+    std::aligned_storage<ARENA_INLINE_SIZE>::type arena_block_;
   };
 
   typedef ReferenceCounting::SmartPtr<CampaignSelectParams> CampaignSelectParams_var;
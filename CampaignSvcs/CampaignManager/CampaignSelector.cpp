@@ -56,7 +56,7 @@ namespace AdServer
     typedef std::list<CampaignKeywordCreative>
       CampaignKeywordCreativeList;
 
-    typedef std::map<RevenueDecimal, CampaignKeywordCreativeList>
+    typedef std::map<FixedRevenue::Value, CampaignKeywordCreativeList>
       CPCKeywordCreativeMap;
 
     struct TextSelectionBySize
@@ -93,13 +93,18 @@ namespace AdServer
       RevenueDecimal conv_rate;
     };
 
-    typedef std::list<SizedCreativeHolder> SizedCreativeHolderList;
+    typedef std::list<
+      SizedCreativeHolder,
+      AdServer::Commons::ArenaAllocator<SizedCreativeHolder> >
+      SizedCreativeHolderList;
 
     struct CTRWeightedCampaignHolder
     {
       CTRWeightedCampaignHolder(
-        CampaignSelector::WeightedCampaignPtr&& weighted_campaign_val)
-          : weighted_campaign(std::move(weighted_campaign_val))
+        CampaignSelector::WeightedCampaignPtr&& weighted_campaign_val,
+        const AdServer::Commons::ArenaAllocator<char>& allocator)
+          : weighted_campaign(std::move(weighted_campaign_val)),
+            cur_creatives(allocator)
       {}
 
       CTRWeightedCampaignHolder(CTRWeightedCampaignHolder&& init)
@@ -112,13 +117,42 @@ namespace AdServer
       SizedCreativeHolderList cur_creatives;
     };
 
-    typedef std::list<CTRWeightedCampaignHolder> CTRWeightedCampaignHolderList;
+    typedef std::list<
+      CTRWeightedCampaignHolder,
+      AdServer::Commons::ArenaAllocator<CTRWeightedCampaignHolder> >
+      CTRWeightedCampaignHolderList;
+
+    // creative of campaign candidate available for tag size
+    // (ctr evaluated for all such creatives at once)
+    struct SizedCandidate
+    {
+      SizedCandidate(
+        CTRWeightedCampaignHolder* holder_val,
+        const Creative* creative_val,
+        const RevenueDecimal& conv_rate_val)
+        : holder(holder_val),
+          creative(creative_val),
+          conv_rate(conv_rate_val)
+      {}
+
+      CTRWeightedCampaignHolder* holder;
+      const Creative* creative;
+      RevenueDecimal conv_rate;
+    };
+
+    typedef std::vector<
+      SizedCandidate,
+      AdServer::Commons::ArenaAllocator<SizedCandidate> >
+      SizedCandidateArray;
 
     /**
      * Weighted function that calculate weights in list for random_select method.
      */
     namespace
     {
+      const FixedRevenue::Value FIXED_ECPM_FACTOR =
+        FixedRevenue::from_decimal(ECPM_FACTOR);
+
       inline unsigned long
       balance_function(const Creative* creative) throw ()
       {
@@ -195,13 +229,21 @@ namespace AdServer
     {
       RevenueDecimal max_ctr = RevenueDecimal::ZERO;
       const Creative* max_ctr_creative = 0;
-      CampaignIndex::ConstCreativePtrList equal_creatives;
+      CampaignIndex::ConstCreativePtrList equal_creatives(
+        available_creatives.get_allocator());
+
+      const CTRProvider::CalculationContext::ConstCreativeArray ctr_creatives(
+        available_creatives.begin(), available_creatives.end());
+      CTRProvider::CalculationContext::CTRArray ctrs;
+      ctr_calculation_context->get_ctrs(ctrs, ctr_creatives);
+
+      std::size_t creative_i = 0;
 
       for(CampaignIndex::ConstCreativePtrList::const_iterator creative_it =
             available_creatives.begin();
-          creative_it != available_creatives.end(); ++creative_it)
+          creative_it != available_creatives.end(); ++creative_it, ++creative_i)
       {
-        RevenueDecimal cur_ctr = ctr_calculation_context->get_ctr(*creative_it);
+        const RevenueDecimal& cur_ctr = ctrs[creative_i];
 
         if(cur_ctr > max_ctr)
         {
@@ -250,6 +292,52 @@ namespace AdServer
       return max_ctr;
     }
 
+    RevenueDecimal
+    CampaignSelector::ctr_campaign_ecpm_(
+      const Campaign* campaign,
+      const RevenueDecimal& ctr)
+      throw()
+    {
+      FixedRevenue::Value ecpm;
+
+      if(FixedRevenue::mul(
+           ecpm, FixedRevenue::from_decimal(ctr), FIXED_ECPM_FACTOR) &&
+         FixedRevenue::mul(ecpm, campaign->fixed_click_sys_revenue, ecpm))
+      {
+        return FixedRevenue::to_decimal(ecpm);
+      }
+
+      return RevenueDecimal::mul(
+        campaign->click_sys_revenue,
+        RevenueDecimal::mul(ctr, ECPM_FACTOR, Generics::DMR_FLOOR),
+        Generics::DMR_FLOOR);
+    }
+
+    RevenueDecimal
+    CampaignSelector::ctr_campaign_keyword_ecpm_(
+      const CampaignKeyword* campaign_keyword,
+      const RevenueDecimal& ctr)
+      throw()
+    {
+      const Currency* currency = campaign_keyword->campaign->account->currency;
+      FixedRevenue::Value ecpm;
+
+      if(FixedRevenue::mul(
+           ecpm, FIXED_ECPM_FACTOR, FixedRevenue::from_decimal(ctr)) &&
+         FixedRevenue::mul(
+           ecpm, ecpm, FixedRevenue::from_decimal(campaign_keyword->max_cpc)) &&
+         FixedRevenue::div(ecpm, ecpm, currency->fixed_rate))
+      {
+        return FixedRevenue::to_decimal(ecpm);
+      }
+
+      return currency->to_system_currency(
+        RevenueDecimal::mul(
+          RevenueDecimal::mul(ECPM_FACTOR, ctr, Generics::DMR_FLOOR),
+          campaign_keyword->max_cpc,
+          Generics::DMR_FLOOR));
+    }
+
     RevenueDecimal
     CampaignSelector::default_campaign_ecpm_(
       const Tag* tag,
@@ -258,6 +346,18 @@ namespace AdServer
     {
       if(campaign->use_ctr())
       {
+        FixedRevenue::Value ecpm;
+
+        if(FixedRevenue::mul(ecpm, campaign->fixed_ctr, FIXED_ECPM_FACTOR) &&
+           FixedRevenue::mul(ecpm, ecpm, tag->fixed_adjustment) &&
+           FixedRevenue::mul(
+             ecpm,
+             std::min(ecpm, FIXED_ECPM_FACTOR),
+             campaign->fixed_click_sys_revenue))
+        {
+          return FixedRevenue::to_decimal(ecpm);
+        }
+
         return RevenueDecimal::mul(
           std::min(
             RevenueDecimal::mul(
@@ -289,10 +389,7 @@ namespace AdServer
           ctr_calculation_context,
           available_creatives);
 
-        return RevenueDecimal::mul(
-          campaign->click_sys_revenue,
-          RevenueDecimal::mul(ctr, ECPM_FACTOR, Generics::DMR_FLOOR),
-          Generics::DMR_FLOOR);
+        return ctr_campaign_ecpm_(campaign, ctr);
       }
       else
       {
@@ -312,13 +409,9 @@ namespace AdServer
     {
       if(campaign_keyword)
       {
-        return campaign_keyword->campaign->
-          account->currency->to_system_currency(
-            RevenueDecimal::mul(
-              RevenueDecimal::mul(
-                ECPM_FACTOR, campaign_keyword->ctr, Generics::DMR_FLOOR),
-              campaign_keyword->max_cpc,
-              Generics::DMR_FLOOR));
+        return ctr_campaign_keyword_ecpm_(
+          campaign_keyword,
+          campaign_keyword->ctr);
       }
 
       return default_campaign_ecpm_(
@@ -343,12 +436,7 @@ namespace AdServer
           ctr_calculation_context,
           available_creatives);
 
-        return campaign_keyword->campaign->
-          account->currency->to_system_currency(
-            RevenueDecimal::mul(
-              RevenueDecimal::mul(ECPM_FACTOR, ctr, Generics::DMR_FLOOR),
-              campaign_keyword->max_cpc,
-              Generics::DMR_FLOOR));
+        return ctr_campaign_keyword_ecpm_(campaign_keyword, ctr);
       }
 
       return campaign_ecpm_(
@@ -438,26 +526,38 @@ namespace AdServer
       const Tag* tag, const Creative* creative)
       throw()
     {
-      typedef std::list<const Tag::Size*> TagSizePtrList;
-
-      TagSizePtrList available_sizes;
+      // two passes over tag sizes instead of collecting available sizes:
+      // method is called for each display candidate
+      unsigned long available_sizes_count = 0;
 
       for(Tag::SizeMap::const_iterator ts_it = tag->sizes.begin();
           ts_it != tag->sizes.end(); ++ts_it)
       {
-        Creative::SizeMap::const_iterator cs_it =
-          creative->sizes.find(ts_it->first);
-        if(cs_it != creative->sizes.end())
+        if(creative->sizes.find(ts_it->first) != creative->sizes.end())
         {
-          available_sizes.push_back(ts_it->second);
+          ++available_sizes_count;
         }
       }
 
-      assert(!available_sizes.empty());
+      assert(available_sizes_count > 0);
+
+      unsigned long pos = Generics::safe_rand(available_sizes_count);
 
-      TagSizePtrList::const_iterator as_it = available_sizes.begin();
-      std::advance(as_it, Generics::safe_rand(available_sizes.size()));
-      return *as_it;
+      for(Tag::SizeMap::const_iterator ts_it = tag->sizes.begin();
+          ts_it != tag->sizes.end(); ++ts_it)
+      {
+        if(creative->sizes.find(ts_it->first) != creative->sizes.end())
+        {
+          if(pos == 0)
+          {
+            return ts_it->second;
+          }
+
+          --pos;
+        }
+      }
+
+      return 0;
     }
 
     void
@@ -526,7 +626,8 @@ namespace AdServer
              matched_channels))
         {
           // collect ads lost auction obviously (ecpm < result ecpm)
-          CampaignIndex::ConstCreativePtrList available_creatives;
+          CampaignIndex::ConstCreativePtrList available_creatives(
+            request_params.allocator());
 
           campaign_selection_index_->filter_creatives(
             key,
@@ -598,8 +699,10 @@ namespace AdServer
 
       assert(ctr_calculation);
 
-      CTRWeightedCampaignHolderList unknown_ctr_campaign_candidates;
-      CTRWeightedCampaignHolderList known_ctr_campaign_candidates;
+      CTRWeightedCampaignHolderList unknown_ctr_campaign_candidates(
+        request_params.allocator());
+      CTRWeightedCampaignHolderList known_ctr_campaign_candidates(
+        request_params.allocator());
 
       // step 1: filter all campaigns without ecpm checking
       for(CampaignIndex::CampaignSelectionCellPtrList::const_iterator cmp_it =
@@ -621,7 +724,8 @@ namespace AdServer
              matched_channels))
         {
           // get available creatives for all request_params.tag_sizes (filtered tag sizes)
-          CampaignIndex::ConstCreativePtrList available_creatives;
+          CampaignIndex::ConstCreativePtrList available_creatives(
+            request_params.allocator());
 
           filter_creatives_(
             available_creatives,
@@ -636,18 +740,20 @@ namespace AdServer
               (*cmp_it)->campaign->bid_strategy == BS_MIN_CTR_GOAL)
             {
               unknown_ctr_campaign_candidates.push_back(
-                std::move(CTRWeightedCampaignHolder(
-                  std::move(WeightedCampaignPtr(new WeightedCampaign(
+                CTRWeightedCampaignHolder(
+                  AdServer::Commons::make_arena_ptr<WeightedCampaign>(
+                    &request_params.arena,
                     tag,
                     (*cmp_it)->tag_pricing,
-                    0, // tag_size
+                    nullptr, // tag_size
                     (*cmp_it)->campaign,
                     nullptr, // result creative
                     available_creatives, // clear available_creatives
                     RevenueDecimal::ZERO,
                     RevenueDecimal::ZERO, // ctr will be inited after
                     RevenueDecimal::ZERO // conv rate will be inited after
-                    ))))));
+                    ),
+                  request_params.allocator()));
             }
             else
             {
@@ -669,17 +775,20 @@ namespace AdServer
               try
               {
                 known_ctr_campaign_candidates.push_back(
-                  WeightedCampaignPtr(new WeightedCampaign(
-                    tag,
-                    (*cmp_it)->tag_pricing,
-                    nullptr, // tag size
-                    (*cmp_it)->campaign,
-                    nullptr, // result creative
-                    available_creatives, // clear available_creatives
-                    current_ecpm,
-                    (*cmp_it)->campaign->ctr,
-                    RevenueDecimal::ZERO // conv rate will be inited after
-                    )));
+                  CTRWeightedCampaignHolder(
+                    AdServer::Commons::make_arena_ptr<WeightedCampaign>(
+                      &request_params.arena,
+                      tag,
+                      (*cmp_it)->tag_pricing,
+                      nullptr, // tag size
+                      (*cmp_it)->campaign,
+                      nullptr, // result creative
+                      available_creatives, // clear available_creatives
+                      current_ecpm,
+                      (*cmp_it)->campaign->ctr,
+                      RevenueDecimal::ZERO // conv rate will be inited after
+                      ),
+                    request_params.allocator()));
               }
               catch(const RevenueDecimal::Overflow&)
               {}
@@ -705,7 +814,12 @@ namespace AdServer
         }
 
         // fetch unknown_ctr_campaign_candidates
-        // filter creatives by ctr with known size 
+        // filter creatives by ctr with known size:
+        // collect creatives available by size and rate, eval ctr for all
+        // of them at once, then select creatives by ecpm in the same order
+        SizedCandidateArray sized_candidates(request_params.allocator());
+        CTRProvider::CalculationContext::ConstCreativeArray ctr_creatives;
+
         for(CTRWeightedCampaignHolderList::iterator wit =
               unknown_ctr_campaign_candidates.begin();
             wit != unknown_ctr_campaign_candidates.end();
@@ -737,40 +851,9 @@ namespace AdServer
                  conv_rate_calculation_context->check_rate(
                    *creative_it, &conv_rate, &rate_creative_dependent))
               {
-                RevenueDecimal ctr = ctr_calculation_context->get_ctr(*creative_it);
-
-                RevenueDecimal ecpm = wit->weighted_campaign->campaign->use_ctr() ?
-                  RevenueDecimal::mul(
-                    wit->weighted_campaign->campaign->click_sys_revenue,
-                    RevenueDecimal::mul(ctr, ECPM_FACTOR, Generics::DMR_FLOOR),
-                    Generics::DMR_FLOOR) :
-                  // CPM campaign with BS_MIN_CTR_GOAL
-                  default_campaign_ecpm_(tag, wit->weighted_campaign->campaign);
-
-                // select creative with max ecpm for all auction types
-                // fill ecpm and (tag_size, creative) candidates
-                if((!check_min_ecpm || check_min_ecpm_(
-                     wit->weighted_campaign->tag_pricing,
-                     request_params.min_ecpm,
-                     ecpm)) &&
-                   (wit->weighted_campaign->campaign->bid_strategy != BS_MIN_CTR_GOAL ||
-                    ctr >= wit->weighted_campaign->campaign->min_ctr_goal()))
-                {
-                  if(ecpm > wit->weighted_campaign->ecpm)
-                  {
-                    wit->weighted_campaign->ecpm = ecpm;
-                    wit->weighted_campaign->ctr = ctr;
-                    wit->weighted_campaign->conv_rate = conv_rate;
-                    wit->cur_creatives.clear();
-                    wit->cur_creatives.push_back(
-                      SizedCreativeHolder(tag_size_it->second, *creative_it, conv_rate));
-                  }
-                  else if(ecpm == wit->weighted_campaign->ecpm)
-                  {
-                    wit->cur_creatives.push_back(
-                      SizedCreativeHolder(tag_size_it->second, *creative_it, conv_rate));
-                  }
-                }
+                sized_candidates.push_back(
+                  SizedCandidate(&*wit, *creative_it, conv_rate));
+                ctr_creatives.push_back(*creative_it);
               }
 
               rate_checked = !rate_creative_dependent;
@@ -778,6 +861,48 @@ namespace AdServer
           }
         }
 
+        CTRProvider::CalculationContext::CTRArray ctrs;
+        ctr_calculation_context->get_ctrs(ctrs, ctr_creatives);
+
+        for(SizedCandidateArray::size_type candidate_i = 0;
+            candidate_i < sized_candidates.size(); ++candidate_i)
+        {
+          CTRWeightedCampaignHolder* wit = sized_candidates[candidate_i].holder;
+          const Creative* creative = sized_candidates[candidate_i].creative;
+          const RevenueDecimal& conv_rate = sized_candidates[candidate_i].conv_rate;
+          const RevenueDecimal& ctr = ctrs[candidate_i];
+
+          RevenueDecimal ecpm = wit->weighted_campaign->campaign->use_ctr() ?
+            ctr_campaign_ecpm_(wit->weighted_campaign->campaign, ctr) :
+            // CPM campaign with BS_MIN_CTR_GOAL
+            default_campaign_ecpm_(tag, wit->weighted_campaign->campaign);
+
+          // select creative with max ecpm for all auction types
+          // fill ecpm and (tag_size, creative) candidates
+          if((!check_min_ecpm || check_min_ecpm_(
+               wit->weighted_campaign->tag_pricing,
+               request_params.min_ecpm,
+               ecpm)) &&
+             (wit->weighted_campaign->campaign->bid_strategy != BS_MIN_CTR_GOAL ||
+              ctr >= wit->weighted_campaign->campaign->min_ctr_goal()))
+          {
+            if(ecpm > wit->weighted_campaign->ecpm)
+            {
+              wit->weighted_campaign->ecpm = ecpm;
+              wit->weighted_campaign->ctr = ctr;
+              wit->weighted_campaign->conv_rate = conv_rate;
+              wit->cur_creatives.clear();
+              wit->cur_creatives.push_back(
+                SizedCreativeHolder(tag_size_it->second, creative, conv_rate));
+            }
+            else if(ecpm == wit->weighted_campaign->ecpm)
+            {
+              wit->cur_creatives.push_back(
+                SizedCreativeHolder(tag_size_it->second, creative, conv_rate));
+            }
+          }
+        }
+
         // fetch known_ctr_campaign_candidates
         // not eval
         for(CTRWeightedCampaignHolderList::iterator wit =
@@ -918,7 +1043,8 @@ namespace AdServer
           }
 
           // get available creatives for eval ecpm
-          CampaignIndex::ConstCreativePtrList available_creatives;
+          CampaignIndex::ConstCreativePtrList available_creatives(
+            request_params.allocator());
 
           filter_creatives_(
             available_creatives,
@@ -935,7 +1061,8 @@ namespace AdServer
             try
             {
               result_campaign_candidates.push_back(
-                WeightedCampaignPtr(new WeightedCampaign(
+                AdServer::Commons::make_arena_ptr<WeightedCampaign>(
+                  &request_params.arena,
                   tag,
                   (*cmp_it)->tag_pricing,
                   select_tag_size_(tag, result_creative),
@@ -945,7 +1072,7 @@ namespace AdServer
                   current_ecpm,
                   (*cmp_it)->campaign->ctr,
                   RevenueDecimal::ZERO // conv rate
-                  )));
+                  ));
             }
             catch(const RevenueDecimal::Overflow&)
             {}
@@ -1022,7 +1149,8 @@ namespace AdServer
             continue;
           }
 
-          CampaignIndex::ConstCreativePtrList available_creatives;
+          CampaignIndex::ConstCreativePtrList available_creatives(
+            request_params.allocator());
 
           filter_creatives_(
             available_creatives,
@@ -1041,7 +1169,8 @@ namespace AdServer
             try
             {
               result_campaign_candidates.push_back(
-                WeightedCampaignPtr(new WeightedCampaign(
+                AdServer::Commons::make_arena_ptr<WeightedCampaign>(
+                  &request_params.arena,
                   tag,
                   (*cmp_it)->tag_pricing,
                   select_tag_size_(tag, result_creative),
@@ -1051,7 +1180,7 @@ namespace AdServer
                   current_ecpm,
                   (*cmp_it)->campaign->ctr,
                   RevenueDecimal::ZERO // conv rate
-                  )));
+                  ));
             }
             catch(const RevenueDecimal::Overflow&)
             {}
@@ -1148,7 +1277,8 @@ namespace AdServer
         else
         {
           // for non default CTR algorithm we need to check available creatives
-          CampaignIndex::ConstCreativePtrList available_creatives;
+          CampaignIndex::ConstCreativePtrList available_creatives(
+            request_params.allocator());
 
           filter_creatives_(
             available_creatives,
@@ -1197,7 +1327,8 @@ namespace AdServer
 
           if(ctr_calculation_context)
           {
-            CampaignIndex::ConstCreativePtrList available_creatives;
+            CampaignIndex::ConstCreativePtrList available_creatives(
+              request_params.allocator());
 
             filter_creatives_(
               available_creatives,
@@ -1260,7 +1391,8 @@ namespace AdServer
     {
       if(ctr_calculation == 0 && auction_type == AT_MAX_ECPM)
       {
-        WeightedCampaignList random_select_campaigns;
+        WeightedCampaignList random_select_campaigns(
+          request_params.allocator());
 
         get_max_display_campaign_candidates_(
           random_select_campaigns,
@@ -1316,7 +1448,8 @@ namespace AdServer
       }
       else
       {
-        WeightedCampaignList random_select_campaigns;
+        WeightedCampaignList random_select_campaigns(
+          request_params.allocator());
         CampaignIndex::CampaignSelectionCellPtrList get_all_display_lost_campaigns;
 
         get_all_display_campaign_candidates_(
@@ -1401,8 +1534,14 @@ namespace AdServer
             }
             else // ctr_calculation_context defined
             {
+              typedef std::list<
+                WeightedCampaignList::iterator,
+                AdServer::Commons::ArenaAllocator<WeightedCampaignList::iterator> >
+                WeightedCampaignIteratorList;
+
               RevenueDecimal max_ecpm_margin = RevenueDecimal::ZERO;
-              std::list<WeightedCampaignList::iterator> max_ecpm_campaigns;
+              WeightedCampaignIteratorList max_ecpm_campaigns(
+                request_params.allocator());
 
               for(WeightedCampaignList::iterator it =
                     random_select_campaigns.begin();
@@ -1433,7 +1572,7 @@ namespace AdServer
               unsigned long pos =
                 request_params.random2 % max_ecpm_campaigns.size();
 
-              std::list<WeightedCampaignList::iterator>::iterator cmp_it_it =
+              WeightedCampaignIteratorList::iterator cmp_it_it =
                 max_ecpm_campaigns.begin();
 
               std::advance(cmp_it_it, pos);
@@ -1506,9 +1645,13 @@ namespace AdServer
       {
         try
         {
+          // actual ecpm is non negative: FixedRevenue image is defined
+          assert(kit->actual_ecpm.is_nonnegative());
+
           /* insert into random position for mixing
            * campaign positions with one cost */
-          WeightedCampaignKeywordList& lst = cpc_keyword_map[kit->actual_ecpm];
+          WeightedCampaignKeywordList& lst = cpc_keyword_map[
+            FixedRevenue::from_decimal(kit->actual_ecpm)];
 
           if(!lst.empty())
           {
@@ -1861,7 +2004,8 @@ namespace AdServer
 
           if(!filtered)
           {
-            CampaignIndex::ConstCreativePtrList available_creatives;
+            CampaignIndex::ConstCreativePtrList available_creatives(
+              request_params.allocator());
             // creative can be already selected by max ecpm - use it
             const Creative* creative_candidate = sub_cit->creative;
 
@@ -2647,7 +2791,8 @@ namespace AdServer
         {
           if(cmp_it->creative == 0)
           {
-            CampaignIndex::ConstCreativePtrList available_creatives;
+            CampaignIndex::ConstCreativePtrList available_creatives(
+              request_params.allocator());
             const Creative* creative_candidate = 0;
 
             // need to select creatives available only for selected tag
@@ -2691,7 +2836,8 @@ namespace AdServer
                    cmp_it->campaign->bid_strategy == BS_MIN_CTR_GOAL)) ||
                  conv_rate_calculation_context)
               {
-                CampaignIndex::ConstCreativePtrList max_ecpm_available_creatives;
+                CampaignIndex::ConstCreativePtrList max_ecpm_available_creatives(
+                  request_params.allocator());
 
                 change_ecpm = ctr_calculation_context && cmp_it->campaign->use_ctr();
 
@@ -2820,7 +2966,8 @@ namespace AdServer
         keyword_check_campaigns);
 
       // get WG display candidates (have priority over all other campaigns)
-      WeightedCampaignList wg_display_campaign_candidates;
+      WeightedCampaignList wg_display_campaign_candidates(
+        request_params.allocator());
 
       get_all_display_campaign_candidates_(
         wg_display_campaign_candidates,
@@ -2856,7 +3003,8 @@ namespace AdServer
          )
       {
         // get OIX display candidates
-        WeightedCampaignList display_campaign_candidates;
+        WeightedCampaignList display_campaign_candidates(
+          request_params.allocator());
 
         get_all_display_campaign_candidates_(
           display_campaign_candidates,
@@ -3090,7 +3238,8 @@ namespace AdServer
         collect_lost ? &lost_campaigns : 0);
 
       // get WG display candidates (have priority over all other campaigns)
-      WeightedCampaignList wg_display_campaign_candidates;
+      WeightedCampaignList wg_display_campaign_candidates(
+        request_params.allocator());
 
       get_all_display_campaign_candidates_(
         wg_display_campaign_candidates,
@@ -3128,7 +3277,8 @@ namespace AdServer
          )
       {
         // get OIX display candidates
-        WeightedCampaignList display_campaign_candidates;
+        WeightedCampaignList display_campaign_candidates(
+          request_params.allocator());
 
         get_all_display_campaign_candidates_(
           display_campaign_candidates,
@@ -3441,7 +3591,8 @@ namespace AdServer
                 lost_auction->ccgs.begin();
               lost_ccg_it != lost_auction->ccgs.end(); ++lost_ccg_it)
           {
-            CampaignIndex::ConstCreativePtrList available_creatives;
+            CampaignIndex::ConstCreativePtrList available_creatives(
+              request_params.allocator());
 
             for(TextSelectionBySizeList::iterator text_selection_it =
                   text_selections.begin();
@@ -3676,7 +3827,7 @@ namespace AdServer
                     cpc_keyword_map.begin();
                   rit != cpc_keyword_map.end(); ++rit)
               {
-                std::cerr << "[ " << rit->first << ": (";
+                std::cerr << "[ " << FixedRevenue::to_decimal(rit->first) << ": (";
 
                 for(WeightedCampaignKeywordList::const_iterator cit =
                       rit->second.begin();
@@ -3833,6 +3984,14 @@ namespace AdServer
         return;
       }
 
+      // request deadline passed (response will be late for exchange):
+      // stop selection without bid
+      if(request_params.deadline != Generics::Time::ZERO &&
+         Generics::Time::get_time_of_day() >= request_params.deadline)
+      {
+        return;
+      }
+
       // create ctr calculation context
       CTRProvider::Calculation_var ctr_calculation;
       CTRProvider::Calculation_var conv_rate_calculation;
@@ -3881,6 +4040,11 @@ namespace AdServer
       key.test_request = request_params.test_request;
       key.tag_delivery_factor = request_params.tag_delivery_factor;
       key.ccg_delivery_factor = request_params.ccg_delivery_factor;
+      // candidates are checked by check_campaign with equal arguments
+      key.init_filter(
+        request_params.time,
+        request_params.colocation->colo_id,
+        request_params.user_id);
 
       if(auction_type == AT_RANDOM)
       {
@@ -25,12 +25,14 @@
 #include <cassert>
 
 #include <Commons/Containers.hpp>
+#include <Commons/MonotonicBuffer.hpp>
 
 #include "CampaignManagerDeclarations.hpp"
 #include "CampaignConfig.hpp"
 #include "CampaignIndex.hpp"
 #include "CampaignSelectParams.hpp"
 #include "CTRProvider.hpp"
+#include "FixedRevenue.hpp"
 
 namespace AdServer
 {
@@ -93,7 +95,9 @@ namespace AdServer
         RevenueDecimal conv_rate;
       };
 
-      typedef std::unique_ptr<WeightedCampaign> WeightedCampaignPtr;
+      // allocated in request arena (CampaignSelectParams::arena)
+      typedef AdServer::Commons::ArenaPtr<WeightedCampaign>::Type
+        WeightedCampaignPtr;
 
       struct WeightedCampaignKeyword
       {
@@ -182,10 +186,14 @@ namespace AdServer
         AdSelectionResult& select_result);
 
     protected:
-      typedef std::map<RevenueDecimal, WeightedCampaignKeywordList>
+      // ordered by actual ecpm (FixedRevenue image)
+      typedef std::map<FixedRevenue::Value, WeightedCampaignKeywordList>
         CPCKeywordMap;
 
-      typedef std::list<WeightedCampaignPtr> WeightedCampaignList;
+      typedef std::list<
+        WeightedCampaignPtr,
+        AdServer::Commons::ArenaAllocator<WeightedCampaignPtr> >
+        WeightedCampaignList;
 
       typedef std::multimap<RevenueDecimal, WeightedCampaignKeywordPtrArray>
         ExpRevWeightedCampaignKeywordMap;
@@ -525,6 +533,20 @@ namespace AdServer
         const CampaignIndex::ConstCreativePtrList& available_creatives)
         throw();
 
+      // ecpm of cpc campaign with defined ctr
+      static RevenueDecimal
+      ctr_campaign_ecpm_(
+        const Campaign* campaign,
+        const RevenueDecimal& ctr)
+        throw();
+
+      // ecpm of campaign keyword with defined ctr
+      static RevenueDecimal
+      ctr_campaign_keyword_ecpm_(
+        const CampaignKeyword* campaign_keyword,
+        const RevenueDecimal& ctr)
+        throw();
+
       static RevenueDecimal
       default_campaign_ecpm_(
         const Tag* tag,
@@ -87,11 +87,34 @@ namespace AdServer
 
       CampaignIndex_var configuration_index;
       CampaignConfig_var new_config;
+      bool snapshot_config = false;
+
+      if(!config_snapshot_checked_)
+      {
+        // serve config from local snapshot at start,
+        // actual config will be requested at next check immediately
+        config_snapshot_checked_ = true;
+
+        try
+        {
+          new_config = campaign_config_source_->load_snapshot();
+          snapshot_config = new_config.in();
+        }
+        catch(const eh::Exception& e)
+        {
+          logger_->stream(Logging::Logger::WARNING,
+            Aspect::CAMPAIGN_MANAGER) << FUN <<
+            ": can't load config snapshot: " << e.what();
+        }
+      }
 
       try
       {
-        CampaignConfig_var old_config = configuration();
-        new_config = campaign_config_source_->update(old_config);
+        if(!snapshot_config)
+        {
+          CampaignConfig_var old_config = configuration();
+          new_config = campaign_config_source_->update(old_config);
+        }
       }
       catch(const eh::Exception& e)
       {
@@ -133,8 +156,12 @@ namespace AdServer
             ": Config expired - disable ad showing: config timestamp = " <<
             master_stamp.get_gm_time();
 
-          SyncPolicy::WriteGuard guard(lock_);
-          configuration_index_.swap(configuration_index);
+          // keep config for requests that don't use index
+          ConfigurationState_var state = new ConfigurationState();
+          state->configuration = configuration();
+          configuration_state_.swap(state);
+
+          configuration_index.swap(state->configuration_index);
         }
         else if(new_config.in())
         {
@@ -149,9 +176,14 @@ namespace AdServer
 
           configuration_index = new CampaignIndex(new_config, logger_);
 
+          // unchanged campaigns will be relinked from actual index
+          CampaignIndex_var prev_configuration_index = this->configuration_index();
+
           if(configuration_index->index_campaigns(
                &indexing_progress_,
-               this))
+               this,
+               prev_configuration_index,
+               campaign_manager_config_.index_threads()))
           {
             if (logger_->log_level() >= TraceLevel::MIDDLE)
             {
@@ -162,9 +194,14 @@ namespace AdServer
 
             precalculate_pub_pixel_accounts_(new_config);
 
-            SyncPolicy::WriteGuard guard(lock_);
-            configuration_index_.swap(configuration_index);
-            configuration_.swap(new_config);
+            ConfigurationState_var state = new ConfigurationState();
+            state->configuration.swap(new_config);
+            state->configuration_index.swap(configuration_index);
+            configuration_state_.swap(state);
+
+            // previous config and index destroyed below
+            new_config.swap(state->configuration);
+            configuration_index.swap(state->configuration_index);
           }
           else if (logger_->log_level() >= TraceLevel::MIDDLE)
           {
@@ -195,8 +232,12 @@ namespace AdServer
         CampaignManagerTaskMessage_var msg =
           new CheckConfigTaskMessage(this, update_task_runner_);
 
-        Generics::Time tm = Generics::Time::get_time_of_day() +
-          campaign_manager_config_.config_update_period();
+        Generics::Time tm = Generics::Time::get_time_of_day();
+
+        if(!snapshot_config)
+        {
+          tm += Generics::Time(campaign_manager_config_.config_update_period());
+        }
 
         scheduler_->schedule(msg, tm);
       }
@@ -21,8 +21,11 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <libxml/tree.h>
 #include <String/TextTemplate.hpp>
-#include <Commons/Xslt/XslTransformer.hpp>
+#include <Generics/Time.hpp>
+#include <Commons/Xslt/LibxsltTransformer.hpp>
 #include <Commons/Xslt/LibxsltExFunctions.hpp>
 
 #include "CreativeTemplate.hpp"
@@ -49,8 +52,82 @@ namespace CampaignSvcs
     }
   };
 
+  /** TemplateParamsArgs
+   *   arguments callback over request and creative params
+   *   (request tokens override creative tokens)
+   */
+  class TemplateParamsArgs: public String::TextTemplate::ArgsCallback
+  {
+  public:
+    TemplateParamsArgs(
+      const TokenValueMap& request_args,
+      const TokenValueMap* creative_args)
+      throw()
+      : request_args_(request_args),
+        creative_args_(creative_args)
+    {}
+
+    const std::string*
+    find(const std::string& key) const throw()
+    {
+      TokenValueMap::const_iterator it = request_args_.find(key);
+
+      if(it != request_args_.end())
+      {
+        return &it->second;
+      }
+
+      if(creative_args_)
+      {
+        it = creative_args_->find(key);
+
+        if(it != creative_args_->end())
+        {
+          return &it->second;
+        }
+      }
+
+      return 0;
+    }
+
+    virtual
+    bool
+    get_argument(const String::SubString& key, std::string& result,
+      bool value = true) const throw (eh::Exception)
+    {
+      const std::string* arg = find(key.str());
+
+      if(!arg)
+      {
+        return false;
+      }
+
+      if(value)
+      {
+        result = *arg;
+      }
+      else
+      {
+        key.assign_to(result);
+      }
+
+      return true;
+    }
+
+  private:
+    const TokenValueMap& request_args_;
+    const TokenValueMap* creative_args_;
+  };
+
   /* Concrete template implementations */
-  /** TextTemplate */
+  /** TextTemplate
+   *   template text compiled at load into instructions stream:
+   *   literal spans and argument slots. Plain keys are resolved by direct
+   *   lookup in request and creative params, keys with default value or
+   *   encoding are resolved through String::TextTemplate::ArgsEncoder.
+   *   Text that can't be split into tokens is instantiated by
+   *   String::TextTemplate.
+   */
   class TextTemplate: public Template
   {
   public:
@@ -71,21 +148,57 @@ namespace CampaignSvcs
     key_used(const String::SubString& key) const
       throw();
 
+  protected:
+    struct Instruction
+    {
+      enum Type
+      {
+        I_LITERAL,
+        I_KEY, // plain key
+        I_ENCODED_KEY
+      };
+
+      Instruction(Type type_val, const String::SubString& text_val)
+        : type(type_val),
+          text(text_val)
+      {}
+
+      Type type;
+      // literal or token text (refer to text_)
+      String::SubString text;
+      std::string key;
+    };
+
+    typedef std::vector<Instruction> InstructionArray;
+
   protected:
     virtual ~TextTemplate() throw()
     {}
 
+    bool
+    compile_() throw(eh::Exception);
+
+    static bool
+    plain_key_(const String::SubString& key) throw();
+
   protected:
+    std::string text_;
+    bool compiled_;
+    InstructionArray instructions_;
+
     String::TextTemplate::IStream text_template_;
     String::TextTemplate::Keys keys_;
   };
 
-  /** XsltTemplate */
+  /** XsltTemplate
+   *   input document built directly as libxml tree (without parsing),
+   *   transformer shared between threads without locking
+   */
   class XsltTemplate: public Template
   {
   public:
     XsltTemplate(const char* file)
-      throw(FileNotExists, XslTransformer::Exception);
+      throw(FileNotExists, LibxslTransformer::Exception);
 
     virtual void instantiate(
       const TemplateParams* request_params,
@@ -99,9 +212,39 @@ namespace CampaignSvcs
     key_used(const String::SubString& key) const
       throw();
 
+    virtual bool
+    get_stats(Stats& stats) const
+      throw();
+
   protected:
-    typedef Sync::Policy::PosixThread SyncPolicy;
-    XslTransformer xsl_transformer_;
+    struct XmlDocDestroyer
+    {
+      void
+      operator()(xmlDocPtr doc) const throw()
+      {
+        xmlFreeDoc(doc);
+      }
+    };
+
+    typedef std::unique_ptr<xmlDoc, XmlDocDestroyer> XmlDocPtr;
+
+    typedef Sync::Policy::PosixSpinThread StatsSyncPolicy;
+
+  protected:
+    static void
+    add_tokens_(
+      xmlNodePtr parent,
+      const TokenValueMap& args)
+      throw(ImplementationException);
+
+    void
+    add_stats_(const Generics::Time& time) throw();
+
+  protected:
+    LibxslTransformer xsl_transformer_;
+
+    mutable StatsSyncPolicy::Mutex stats_lock_;
+    Stats stats_;
   };
 
   /**
@@ -109,6 +252,7 @@ namespace CampaignSvcs
    */
   TextTemplate::TextTemplate(const char* file)
     throw(Template::FileNotExists, Exception)
+    : compiled_(false)
   {
     static const char* FUN = "TextTemplate::TextTemplate()";
 
@@ -122,10 +266,15 @@ namespace CampaignSvcs
 
     try
     {
-      std::stringstream ostr;
-      ostr << fstr.rdbuf();
+      {
+        std::stringstream ostr;
+        ostr << fstr.rdbuf();
+        text_ = ostr.str();
+      }
+
+      std::istringstream istr(text_);
       text_template_.init(
-        ostr,
+        istr,
         TokenTemplateProperties::START_TOKEN,
         TokenTemplateProperties::STOP_TOKEN);
 
@@ -134,6 +283,8 @@ namespace CampaignSvcs
       String::TextTemplate::DefaultValue default_cont(&null_args);
       String::TextTemplate::ArgsEncoder encoder(&default_cont);
       text_template_.keys(encoder, keys_);
+
+      compiled_ = compile_();
     }
     catch(const eh::Exception& ex)
     {
@@ -145,6 +296,83 @@ namespace CampaignSvcs
     }
   }
 
+  bool
+  TextTemplate::compile_() throw(eh::Exception)
+  {
+    const String::SubString& start = TokenTemplateProperties::START_TOKEN;
+    const String::SubString& stop = TokenTemplateProperties::STOP_TOKEN;
+    const String::SubString text(text_);
+
+    String::SubString::SizeType pos = 0;
+
+    while(pos < text.size())
+    {
+      String::SubString::SizeType key_start = text.find(start, pos);
+
+      if(key_start == String::SubString::NPOS)
+      {
+        instructions_.push_back(
+          Instruction(Instruction::I_LITERAL, text.substr(pos)));
+        break;
+      }
+
+      String::SubString::SizeType key_stop = text.find(
+        stop, key_start + start.size());
+
+      if(key_stop == String::SubString::NPOS ||
+         key_stop == key_start + start.size())
+      {
+        // unclosed or empty token: keep String::TextTemplate behaviour
+        instructions_.clear();
+        return false;
+      }
+
+      if(key_start > pos)
+      {
+        instructions_.push_back(
+          Instruction(
+            Instruction::I_LITERAL,
+            text.substr(pos, key_start - pos)));
+      }
+
+      const String::SubString key = text.substr(
+        key_start + start.size(),
+        key_stop - key_start - start.size());
+
+      if(plain_key_(key))
+      {
+        instructions_.push_back(Instruction(Instruction::I_KEY, key));
+        key.assign_to(instructions_.back().key);
+      }
+      else
+      {
+        instructions_.push_back(Instruction(Instruction::I_ENCODED_KEY, key));
+      }
+
+      pos = key_stop + stop.size();
+    }
+
+    return true;
+  }
+
+  bool
+  TextTemplate::plain_key_(const String::SubString& key) throw()
+  {
+    for(String::SubString::ConstPointer it = key.begin();
+        it != key.end(); ++it)
+    {
+      if(!((*it >= 'A' && *it <= 'Z') ||
+           (*it >= 'a' && *it <= 'z') ||
+           (*it >= '0' && *it <= '9') ||
+           *it == '_'))
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
   void
   TextTemplate::instantiate(
     const TemplateParams* request_params,
@@ -156,21 +384,63 @@ namespace CampaignSvcs
   {
     try
     {
-      TokenValueMap args;
-      // request tokens override creative tokens
-      args.insert(request_params->begin(), request_params->end());
+      // creative tokens used only for single creative
+      const TokenValueMap* creative_args =
+        !params.empty() && ++params.begin() == params.end() ?
+        params.begin()->in() : 0;
 
-      if(++params.begin() == params.end())
+      TemplateParamsArgs args(*request_params, creative_args);
+      String::TextTemplate::DefaultValue default_cont(&args);
+      String::TextTemplate::ArgsEncoder encoder(&default_cont);
+
+      if(!compiled_)
       {
-        const TokenValueMap& creative_args = *(*params.begin());
-        args.insert(creative_args.begin(), creative_args.end());
+        ostr << text_template_.instantiate(encoder);
+        return;
       }
 
-      String::TextTemplate::ArgsContainer<TokenValueMap,
-        String::TextTemplate::ArgsContainerStringAdapter> args_cont(&args);
-      String::TextTemplate::DefaultValue default_cont(&args_cont);
-      String::TextTemplate::ArgsEncoder encoder(&default_cont);
-      ostr << text_template_.instantiate(encoder);
+      std::string value;
+
+      for(InstructionArray::const_iterator it = instructions_.begin();
+          it != instructions_.end(); ++it)
+      {
+        if(it->type == Instruction::I_LITERAL)
+        {
+          ostr.write(it->text.data(), it->text.size());
+        }
+        else if(it->type == Instruction::I_KEY)
+        {
+          const std::string* arg = args.find(it->key);
+
+          if(!arg)
+          {
+            Stream::Error ostr;
+            ostr << "Can't instantiate creative. Unknown token '" <<
+              it->key << "'";
+            throw InvalidParams(ostr);
+          }
+
+          ostr.write(arg->data(), arg->size());
+        }
+        else
+        {
+          value.clear();
+
+          if(!encoder.get_argument(it->text, value))
+          {
+            Stream::Error ostr;
+            ostr << "Can't instantiate creative. Unknown token '" <<
+              it->text << "'";
+            throw InvalidParams(ostr);
+          }
+
+          ostr.write(value.data(), value.size());
+        }
+      }
+    }
+    catch(const InvalidParams&)
+    {
+      throw;
     }
     catch(const String::TextTemplate::UnknownName& ex)
     {
@@ -199,7 +469,7 @@ namespace CampaignSvcs
    * XsltTemplate implementation
    */
   XsltTemplate::XsltTemplate(const char* file)
-    throw(Template::FileNotExists, XslTransformer::Exception)
+    throw(Template::FileNotExists, LibxslTransformer::Exception)
   {
     try
     {
@@ -220,12 +490,50 @@ namespace CampaignSvcs
         "escape-xml",
         AdServer::XsltExt::XmlEscapeFun::create());
     }
-    catch(const XslTransformer::FileNotExists& ex)
+    catch(const LibxslTransformer::FileNotExists& ex)
     {
       throw Template::FileNotExists("");
     }
   }
 
+  void
+  XsltTemplate::add_tokens_(
+    xmlNodePtr parent,
+    const TokenValueMap& args)
+    throw(ImplementationException)
+  {
+    for(TokenValueMap::const_iterator it = args.begin();
+        it != args.end(); ++it)
+    {
+      // text node content and attribute value isn't parsed,
+      // special symbols don't require escaping (like CDATA before)
+      xmlNodePtr token = xmlNewChild(parent, 0, BAD_CAST "token", 0);
+
+      if(!token ||
+         !xmlNewProp(token, BAD_CAST "name", BAD_CAST it->first.c_str()) ||
+         !xmlAddChild(token, xmlNewDocTextLen(
+           parent->doc,
+           BAD_CAST it->second.data(),
+           it->second.size())))
+      {
+        throw ImplementationException(
+          "XsltTemplate::add_tokens_(): can't create token node");
+      }
+    }
+  }
+
+  void
+  XsltTemplate::add_stats_(const Generics::Time& time) throw()
+  {
+    StatsSyncPolicy::WriteGuard lock(stats_lock_);
+    ++stats_.instantiations;
+    stats_.time += time;
+    if(time > stats_.max_time)
+    {
+      stats_.max_time = time;
+    }
+  }
+
   void
   XsltTemplate::instantiate(
     const TemplateParams* request_params,
@@ -235,60 +543,67 @@ namespace CampaignSvcs
       InvalidTemplate,
       ImplementationException)
   {
-    /* generate xml */
-    std::stringstream xml_params;
+    static const char* FUN = "XsltTemplate::instantiate()";
+
+    Generics::Timer timer;
+    timer.start();
+
+    /* generate xml:
+     * <impression>
+     *   <creative><token name="...">...</token>...</creative>...
+     *   <token name="...">...</token>...
+     * </impression>
+     */
+    XmlDocPtr doc(xmlNewDoc(BAD_CAST "1.0"));
+    xmlNodePtr root = doc.get() ?
+      xmlNewDocNode(doc.get(), 0, BAD_CAST "impression", 0) : 0;
+
+    if(!root)
+    {
+      Stream::Error ostr;
+      ostr << FUN << ": can't create xml document";
+      throw ImplementationException(ostr);
+    }
 
-    xml_params << "<impression>" << std::endl;
+    xmlDocSetRootElement(doc.get(), root);
 
     for(TemplateParamsList::const_iterator cr_it = params.begin();
         cr_it != params.end(); ++cr_it)
     {
-      const TokenValueMap& args = *(*cr_it);
-
-      xml_params << "  <creative>" << std::endl;
+      xmlNodePtr creative = xmlNewChild(root, 0, BAD_CAST "creative", 0);
 
-      for(TokenValueMap::const_iterator it = args.begin();
-          it != args.end(); ++it)
+      if(!creative)
       {
-        xml_params <<
-          "    <token name=\"" << it->first << "\">" <<
-          "<![CDATA[" << it->second << "]]>" <<
-          "</token>" << std::endl;
+        Stream::Error ostr;
+        ostr << FUN << ": can't create creative node";
+        throw ImplementationException(ostr);
       }
 
-      xml_params << "  </creative>" << std::endl;
-    }
-
-    for(TokenValueMap::const_iterator it = request_params->begin();
-        it != request_params->end(); ++it)
-    {
-      xml_params <<
-        "  <token name=\"" << it->first << "\">" <<
-        "<![CDATA[" << it->second << "]]>" <<
-        "</token>" << std::endl;
+      add_tokens_(creative, *(*cr_it));
     }
 
-    xml_params << "</impression>" << std::endl;
-
-    /*
-    std::cerr << ">>>>>>>>>>>>>>>>>" << std::endl <<
-      xml_params.str() <<
-      "<<<<<<<<<<<<<<<<<<<" << std::endl;
-    */
+    add_tokens_(root, *request_params);
 
     try
     {
-      xsl_transformer_.transform(xml_params, ostr);
+      xsl_transformer_.transform(doc.get(), ostr);
     }
-    catch(const XslTransformer::Exception& ex)
+    catch(const LibxslTransformer::Exception& ex)
     {
-      /*
-      std::cout << "==============" << std::endl;
-      std::cout << xml_params.str() << std::endl;
-      std::cout << "==============" << std::endl;
-      */
       throw ImplementationException(ex.what());
     }
+
+    timer.stop();
+    add_stats_(timer.elapsed_time());
+  }
+
+  bool
+  XsltTemplate::get_stats(Stats& stats) const
+    throw()
+  {
+    StatsSyncPolicy::ReadGuard lock(stats_lock_);
+    stats = stats_;
+    return true;
   }
 
   bool
@@ -356,7 +671,7 @@ namespace CampaignSvcs
         return new XsltTemplate(
           creative_template_handler.file.c_str());
       }
-      catch(const XslTransformer::Exception& ex)
+      catch(const LibxslTransformer::Exception& ex)
       {
         Stream::Error ostr;
         ostr << "CreativeTemplateFactory::create(): "
@@ -74,6 +74,16 @@ namespace AdServer
       DECLARE_EXCEPTION(InvalidTemplate, Exception);
       DECLARE_EXCEPTION(ImplementationException, Exception);
 
+      /** instantiation time counters */
+      struct Stats
+      {
+        Stats() throw(): instantiations(0) {}
+
+        unsigned long instantiations;
+        Generics::Time time;
+        Generics::Time max_time;
+      };
+
       virtual void
       instantiate(
         const TemplateParams* request_params,
@@ -87,6 +97,16 @@ namespace AdServer
       key_used(const String::SubString& key) const
         throw() = 0;
 
+      /**
+       * @return false if template don't count instantiations time
+       */
+      virtual bool
+      get_stats(Stats& /*stats*/) const
+        throw()
+      {
+        return false;
+      }
+
       static void
       get_keys(
         String::TextTemplate::Keys& keys,
@@ -189,6 +209,13 @@ namespace AdServer
       void assign(const KeySet& key_set, TemplateMap& source_map)
         throw(Exception);
 
+      typedef std::map<_VALUE_HANDLER, Template::Stats> StatsMap;
+
+      /**
+       * Collect counters of already loaded templates, that count its
+       */
+      void get_stats(StatsMap& stats) const throw(eh::Exception);
+
       size_t size() const
       {
         return key_map_.size();
@@ -528,6 +555,35 @@ namespace AdServer
       return get_(templ_it);
     }
 
+    template<
+      typename _KEY,
+      typename _VALUE,
+      typename _VALUE_HANDLER,
+      typename _FACTORY>
+    void
+    TemplateMap<_KEY, _VALUE, _VALUE_HANDLER, _FACTORY>::get_stats(
+      StatsMap& stats) const
+      throw(eh::Exception)
+    {
+      for(typename ValueMap::iterator templ_it = value_map_.begin();
+          templ_it != value_map_.end(); ++templ_it)
+      {
+        Template_var templ;
+
+        {
+          typename SyncPolicy::ReadGuard lock(templ_it->second.lock);
+          templ = templ_it->second.templ;
+        }
+
+        Template::Stats templ_stats;
+
+        if(templ.in() && templ->get_stats(templ_stats))
+        {
+          stats[templ_it->first] = templ_stats;
+        }
+      }
+    }
+
   } /* CampaignSvcs */
 } /* AdServer */
 
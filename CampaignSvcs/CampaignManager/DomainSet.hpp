@@ -0,0 +1,148 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/// @file DomainSet.hpp
+#ifndef _DOMAINSET_HPP_
+#define _DOMAINSET_HPP_
+
+#include <list>
+#include <string>
+#include <eh/Exception.hpp>
+#include <String/SubString.hpp>
+#include <Generics/GnuHashTable.hpp>
+
+namespace AdServer
+{
+  namespace CampaignSvcs
+  {
+    /**
+     * DomainSet - set of exact domains (without "www." prefix):
+     *   check is one hash lookup by SubString (without allocations)
+     */
+    class DomainSet
+    {
+    public:
+      DomainSet() throw();
+
+      DomainSet(const DomainSet& init) throw(eh::Exception);
+
+      DomainSet&
+      operator=(const DomainSet& init) throw(eh::Exception);
+
+      /**
+       * @param domain Must be in lower case
+       */
+      void
+      insert(const String::SubString& domain) throw(eh::Exception);
+
+      bool
+      empty() const throw();
+
+      std::size_t
+      size() const throw();
+
+      /**
+       * @param domain Must be in lower case, "www." prefix must be cut
+       */
+      bool
+      contains(const String::SubString& domain) const throw();
+
+    private:
+      typedef Generics::GnuHashSet<Generics::SubStringHashAdapter>
+        DomainHashSet;
+
+      // domains_ hold memory of domain_set_ keys
+      std::list<std::string> domains_;
+      DomainHashSet domain_set_;
+    };
+  }
+}
+
+namespace AdServer
+{
+  namespace CampaignSvcs
+  {
+    inline
+    DomainSet::DomainSet() throw()
+    {}
+
+    inline
+    DomainSet::DomainSet(const DomainSet& init) throw(eh::Exception)
+    {
+      *this = init;
+    }
+
+    inline
+    DomainSet&
+    DomainSet::operator=(const DomainSet& init) throw(eh::Exception)
+    {
+      if(this != &init)
+      {
+        domain_set_.clear();
+        domains_.clear();
+
+        for(std::list<std::string>::const_iterator it = init.domains_.begin();
+            it != init.domains_.end(); ++it)
+        {
+          insert(*it);
+        }
+      }
+
+      return *this;
+    }
+
+    inline
+    void
+    DomainSet::insert(const String::SubString& domain) throw(eh::Exception)
+    {
+      if(domain_set_.find(Generics::SubStringHashAdapter(domain)) ==
+           domain_set_.end())
+      {
+        domains_.push_back(domain.str());
+        domain_set_.insert(Generics::SubStringHashAdapter(
+          String::SubString(domains_.back())));
+      }
+    }
+
+    inline
+    bool
+    DomainSet::empty() const throw()
+    {
+      return domain_set_.empty();
+    }
+
+    inline
+    std::size_t
+    DomainSet::size() const throw()
+    {
+      return domain_set_.size();
+    }
+
+    inline
+    bool
+    DomainSet::contains(const String::SubString& domain) const throw()
+    {
+      return domain_set_.find(Generics::SubStringHashAdapter(domain)) !=
+        domain_set_.end();
+    }
+  }
+}
+
+#endif /*_DOMAINSET_HPP_*/
@@ -0,0 +1,160 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/// @file FixedRevenue.hpp
+#ifndef _FIXEDREVENUE_HPP_
+#define _FIXEDREVENUE_HPP_
+
+#include <stdint.h>
+#include <CampaignSvcs/CampaignCommons/CampaignTypes.hpp>
+
+namespace AdServer
+{
+  namespace CampaignSvcs
+  {
+    /**
+     * FixedRevenue - integer image of non negative RevenueDecimal:
+     *   value in RevenueDecimal::EPSILON units (10 ^ -FRACTION_RANK).
+     * mul, div give the same result as RevenueDecimal::mul(DMR_FLOOR),
+     * RevenueDecimal::div(DDR_FLOOR) and return false if argument is INVALID
+     * or result leaves RevenueDecimal range, the caller should fall back to
+     * RevenueDecimal arithmetic in this case.
+     */
+    struct FixedRevenue
+    {
+      typedef uint64_t Value;
+
+      static const Value INVALID = ~static_cast<Value>(0);
+      static const Value MULTIPLIER = 100000000ULL;
+      static const Value MAXIMUM = 999999999999999999ULL;
+
+      /**
+       * @return INVALID for negative value
+       */
+      static Value
+      from_decimal(const RevenueDecimal& value) throw();
+
+      static RevenueDecimal
+      to_decimal(Value value) throw();
+
+      static bool
+      mul(Value& res, Value left, Value right) throw();
+
+      static bool
+      div(Value& res, Value left, Value right) throw();
+    };
+
+    static_assert(
+      RevenueDecimal::FRACTION_RANK == 8,
+      "FixedRevenue::MULTIPLIER doesn't match RevenueDecimal");
+  }
+}
+
+namespace AdServer
+{
+  namespace CampaignSvcs
+  {
+    inline
+    FixedRevenue::Value
+    FixedRevenue::from_decimal(const RevenueDecimal& value) throw()
+    {
+      if(!value.is_nonnegative())
+      {
+        return INVALID;
+      }
+
+      RevenueDecimal integer_part(value);
+      integer_part.floor(0);
+
+      Value res = integer_part.integer<Value>() * MULTIPLIER;
+
+      if(integer_part != value)
+      {
+        // fraction part * MULTIPLIER is exact and less than MULTIPLIER
+        res += RevenueDecimal::mul(
+          value - integer_part,
+          RevenueDecimal(false, MULTIPLIER, 0),
+          Generics::DMR_FLOOR).integer<Value>();
+      }
+
+      return res;
+    }
+
+    inline
+    RevenueDecimal
+    FixedRevenue::to_decimal(Value value) throw()
+    {
+      return RevenueDecimal(false, value / MULTIPLIER, value % MULTIPLIER);
+    }
+
+    inline
+    bool
+    FixedRevenue::mul(Value& res, Value left, Value right) throw()
+    {
+      if(left > MAXIMUM || right > MAXIMUM)
+      {
+        return false;
+      }
+
+      Value product;
+
+      if(!__builtin_mul_overflow(left, right, &product))
+      {
+        // product / MULTIPLIER < MAXIMUM
+        res = product / MULTIPLIER;
+        return true;
+      }
+
+      const unsigned __int128 wide_res =
+        static_cast<unsigned __int128>(left) * right / MULTIPLIER;
+
+      if(wide_res > MAXIMUM)
+      {
+        return false;
+      }
+
+      res = static_cast<Value>(wide_res);
+      return true;
+    }
+
+    inline
+    bool
+    FixedRevenue::div(Value& res, Value left, Value right) throw()
+    {
+      if(left > MAXIMUM || right > MAXIMUM || right == 0)
+      {
+        return false;
+      }
+
+      const unsigned __int128 wide_res =
+        static_cast<unsigned __int128>(left) * MULTIPLIER / right;
+
+      if(wide_res > MAXIMUM)
+      {
+        return false;
+      }
+
+      res = static_cast<Value>(wide_res);
+      return true;
+    }
+  }
+}
+
+#endif /*_FIXEDREVENUE_HPP_*/
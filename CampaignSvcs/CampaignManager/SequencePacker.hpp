@@ -144,6 +144,10 @@ namespace AdServer
           const ElementSeqHashAdapter& el_seq_hash_adapter,
           const ElementSeqType* el_seq);
 
+        /* adapter for insert of filled sequence */
+        explicit
+        ElementSeqHashAdapter(const ElementSeqType* el_seq);
+
         ElementSeqHashAdapter& operator=(const ElementSeqHashAdapter& init);
         
         unsigned long hash() const;
@@ -174,6 +178,10 @@ namespace AdServer
 
       ConstElementSeq_var get(const ElementSeqType* cmp_list, const ElementType* cell);
 
+      /* register filled sequence (constructed outside packer),
+       * return equal sequence if it already exists */
+      ConstElementSeq_var pack(ElementSeqType* el_seq);
+
       void unkeep(const ElementSeqBase* el_seq);
 
       ConstElementSeq_var create_seq(
@@ -294,6 +302,19 @@ namespace AdServer
         add_cell_(0)
     {}
 
+    template<typename ElementType, typename ElementSeqType, typename ElementSeqHashType>
+    inline
+    SequencePacker<ElementType, ElementSeqType, ElementSeqHashType>::
+    ElementSeqHashAdapter::ElementSeqHashAdapter(
+      const ElementSeqType* el_seq)
+      : size_(el_seq->size()),
+        cell_list_(el_seq),
+        add_cell_(0)
+    {
+      ElementSeqHashType hasher;
+      hash_ = hasher.hash(el_seq);
+    }
+
     template<typename ElementType, typename ElementSeqType, typename ElementSeqHashType>
     inline
     unsigned long
@@ -459,6 +480,33 @@ namespace AdServer
       return ReferenceCounting::add_ref(el_seq_adapter_it->list());
     }
 
+    template<typename ElementType, typename ElementSeqType, typename ElementSeqHashType>
+    inline
+    typename SequencePacker<ElementType, ElementSeqType, ElementSeqHashType>::
+      ConstElementSeq_var
+    SequencePacker<ElementType, ElementSeqType, ElementSeqHashType>::pack(
+      ElementSeqType* el_seq)
+    {
+      ElementSeqHashAdapter el_seq_adapter(el_seq);
+
+      typename HashAdapterSet::const_iterator el_seq_adapter_it =
+        adapters_.find(el_seq_adapter);
+
+      if(el_seq_adapter_it == adapters_.end())
+      {
+        el_seq->attach_eraser(eraser_);
+
+        adapter_table_.insert(
+          std::make_pair(el_seq, el_seq_adapter));
+
+        adapters_.insert(el_seq_adapter);
+
+        return ReferenceCounting::add_ref(el_seq);
+      }
+
+      return ReferenceCounting::add_ref(el_seq_adapter_it->list());
+    }
+
     template<typename ElementType, typename ElementSeqType, typename ElementSeqHashType>
     inline
     void
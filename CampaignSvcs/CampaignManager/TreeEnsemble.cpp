@@ -0,0 +1,326 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "TreeEnsemble.hpp"
+
+namespace AdServer
+{
+namespace CampaignSvcs
+{
+namespace CTR
+{
+  const uint32_t TreeEnsemble::LEAF;
+  const std::size_t TreeEnsemble::BLOCK_SIZE;
+
+  TreeEnsemble::TreeEnsemble(
+    const SourceTreeArray& trees,
+    float base_score,
+    Transform transform)
+    throw(InvalidModel)
+    : base_score_(base_score),
+      transform_type_(transform)
+  {
+    for(SourceTreeArray::const_iterator tree_it = trees.begin();
+        tree_it != trees.end(); ++tree_it)
+    {
+      add_tree_(*tree_it);
+    }
+  }
+
+  void
+  TreeEnsemble::add_tree_(const SourceTree& tree)
+    throw(InvalidModel)
+  {
+    static const char* FUN = "TreeEnsemble::add_tree_()";
+
+    if(tree.empty())
+    {
+      Stream::Error ostr;
+      ostr << FUN << ": empty tree #" << roots_.size();
+      throw InvalidModel(ostr);
+    }
+
+    // place nodes level by level: source indexes in result order
+    const uint32_t base = nodes_.size();
+    std::vector<long> order;
+    order.reserve(tree.size());
+    order.push_back(0);
+
+    for(std::size_t node_i = 0; node_i < order.size(); ++node_i)
+    {
+      const SourceNode& source_node = tree[order[node_i]];
+      Node node;
+      node.value = source_node.value;
+
+      if(source_node.leaf)
+      {
+        node.feature = LEAF;
+        node.left = 0;
+        node.default_left = 0;
+      }
+      else
+      {
+        if(source_node.left < 0 ||
+           source_node.left >= static_cast<long>(tree.size()) ||
+           source_node.right < 0 ||
+           source_node.right >= static_cast<long>(tree.size()) ||
+           order.size() + 2 > tree.size())
+        {
+          Stream::Error ostr;
+          ostr << FUN << ": invalid node #" << order[node_i] <<
+            " in tree #" << roots_.size();
+          throw InvalidModel(ostr);
+        }
+
+        FeatureIndexMap::const_iterator feature_it =
+          feature_indexes_.find(source_node.feature);
+
+        if(feature_it != feature_indexes_.end())
+        {
+          node.feature = feature_it->second;
+        }
+        else
+        {
+          node.feature = feature_indexes_.size();
+          feature_indexes_.insert(
+            std::make_pair(source_node.feature, node.feature));
+        }
+
+        node.left = base + order.size();
+        node.default_left = source_node.default_left ? 1 : 0;
+        order.push_back(source_node.left);
+        order.push_back(source_node.right);
+      }
+
+      nodes_.push_back(node);
+    }
+
+    roots_.push_back(base);
+  }
+
+  void
+  TreeEnsemble::init_(FeatureVector& feature_vector) const throw()
+  {
+    if(feature_vector.values_.size() != feature_indexes_.size())
+    {
+      feature_vector.values_.assign(
+        feature_indexes_.size(),
+        std::numeric_limits<float>::quiet_NaN());
+      feature_vector.filled_.clear();
+    }
+  }
+
+  void
+  TreeEnsemble::fill_(
+    FeatureVector& feature_vector,
+    const HashArray& hashes)
+    const throw()
+  {
+    for(HashArray::const_iterator hash_it = hashes.begin();
+        hash_it != hashes.end(); ++hash_it)
+    {
+      // input SVM contains indexes, model use indexes - 1
+      FeatureIndexMap::const_iterator feature_it =
+        feature_indexes_.find(hash_it->first - 1);
+
+      if(feature_it != feature_indexes_.end())
+      {
+        float& value = feature_vector.values_[feature_it->second];
+
+        if(value != value)
+        {
+          feature_vector.filled_.push_back(feature_it->second);
+        }
+
+        value = static_cast<float>(hash_it->second);
+      }
+    }
+  }
+
+  void
+  TreeEnsemble::fill_values_(
+    float* values,
+    const HashArray& hashes)
+    const throw()
+  {
+    for(HashArray::const_iterator hash_it = hashes.begin();
+        hash_it != hashes.end(); ++hash_it)
+    {
+      FeatureIndexMap::const_iterator feature_it =
+        feature_indexes_.find(hash_it->first - 1);
+
+      if(feature_it != feature_indexes_.end())
+      {
+        values[feature_it->second] = static_cast<float>(hash_it->second);
+      }
+    }
+  }
+
+  void
+  TreeEnsemble::clear_(FeatureVector& feature_vector) const throw()
+  {
+    for(std::vector<uint32_t>::const_iterator it =
+          feature_vector.filled_.begin();
+        it != feature_vector.filled_.end(); ++it)
+    {
+      feature_vector.values_[*it] = std::numeric_limits<float>::quiet_NaN();
+    }
+
+    feature_vector.filled_.clear();
+  }
+
+  float
+  TreeEnsemble::transform_(float margin) const throw()
+  {
+    if(transform_type_ == T_LOGISTIC)
+    {
+      return 1.0f / (1.0f + std::exp(-margin));
+    }
+
+    return margin;
+  }
+
+  float
+  TreeEnsemble::predict(
+    FeatureVector& feature_vector,
+    const HashArray& hashes,
+    const HashArray* add_hashes1,
+    const HashArray* add_hashes2,
+    const HashArray* add_hashes3)
+    const throw()
+  {
+    init_(feature_vector);
+
+    fill_(feature_vector, hashes);
+
+    if(add_hashes1)
+    {
+      fill_(feature_vector, *add_hashes1);
+    }
+
+    if(add_hashes2)
+    {
+      fill_(feature_vector, *add_hashes2);
+    }
+
+    if(add_hashes3)
+    {
+      fill_(feature_vector, *add_hashes3);
+    }
+
+    const float* values = feature_vector.values_.data();
+    float sum = 0.0f;
+
+    for(IndexArray::const_iterator root_it = roots_.begin();
+        root_it != roots_.end(); ++root_it)
+    {
+      sum += walk_(values, *root_it);
+    }
+
+    clear_(feature_vector);
+
+    return transform_(sum + base_score_);
+  }
+
+  void
+  TreeEnsemble::predict(
+    PredictionArray& result,
+    FeatureVector& feature_vector,
+    const BatchRowArray& rows,
+    const HashArray& shared_hashes,
+    const HashArray* add_shared_hashes)
+    const throw()
+  {
+    result.resize(rows.size());
+
+    if(rows.empty())
+    {
+      return;
+    }
+
+    init_(feature_vector);
+
+    fill_(feature_vector, shared_hashes);
+
+    if(add_shared_hashes)
+    {
+      fill_(feature_vector, *add_shared_hashes);
+    }
+
+    const std::size_t feature_count = feature_vector.values_.size();
+    feature_vector.block_values_.resize(BLOCK_SIZE * feature_count);
+    float* block_values = feature_vector.block_values_.data();
+
+    for(std::size_t block_start = 0; block_start < rows.size();
+        block_start += BLOCK_SIZE)
+    {
+      const std::size_t block_size = std::min(
+        BLOCK_SIZE, rows.size() - block_start);
+
+      float sums[BLOCK_SIZE];
+
+      for(std::size_t row_i = 0; row_i < block_size; ++row_i)
+      {
+        const BatchRow& row = rows[block_start + row_i];
+        float* row_values = block_values + row_i * feature_count;
+
+        std::copy(
+          feature_vector.values_.begin(),
+          feature_vector.values_.end(),
+          row_values);
+
+        if(row.hashes1)
+        {
+          fill_values_(row_values, *row.hashes1);
+        }
+
+        if(row.hashes2)
+        {
+          fill_values_(row_values, *row.hashes2);
+        }
+
+        sums[row_i] = 0.0f;
+      }
+
+      // walk each tree for all rows of block: tree nodes stay in cache
+      for(IndexArray::const_iterator root_it = roots_.begin();
+          root_it != roots_.end(); ++root_it)
+      {
+        for(std::size_t row_i = 0; row_i < block_size; ++row_i)
+        {
+          sums[row_i] += walk_(block_values + row_i * feature_count, *root_it);
+        }
+      }
+
+      for(std::size_t row_i = 0; row_i < block_size; ++row_i)
+      {
+        result[block_start + row_i] = transform_(sums[row_i] + base_score_);
+      }
+    }
+
+    clear_(feature_vector);
+  }
+}
+}
+}
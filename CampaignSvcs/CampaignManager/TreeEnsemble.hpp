@@ -0,0 +1,256 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TREEENSEMBLE_HPP_
+#define TREEENSEMBLE_HPP_
+
+#include <vector>
+
+#include <eh/Exception.hpp>
+#include <ReferenceCounting/AtomicImpl.hpp>
+#include <ReferenceCounting/SmartPtr.hpp>
+#include <Generics/GnuHashTable.hpp>
+#include <Generics/HashTableAdapters.hpp>
+
+#include "CTRFeatureCalculators.hpp"
+
+namespace AdServer
+{
+namespace CampaignSvcs
+{
+namespace CTR
+{
+  /**
+   * TreeEnsemble
+   * immutable flattened gradient boosted trees ensemble,
+   * evaluated over HashArray with xgboost semantic:
+   *   entry (index, value) define feature (index - 1) with value,
+   *   node go to left child if value < split condition,
+   *   to default child if feature missed;
+   *   prediction = transform(base_score + sum of leaf values).
+   * Nodes of each tree are placed in one array level by level
+   * (children of node are adjacent), only features used in splits
+   * are kept (mapped to compact indexes).
+   */
+  class TreeEnsemble: public ReferenceCounting::AtomicImpl
+  {
+  public:
+    DECLARE_EXCEPTION(Exception, eh::DescriptiveException);
+    DECLARE_EXCEPTION(InvalidModel, Exception);
+
+    enum Transform
+    {
+      T_IDENTITY,
+      T_LOGISTIC
+    };
+
+    // tree in source (not flattened) form
+    struct SourceNode
+    {
+      SourceNode()
+        : leaf(true),
+          value(0.0),
+          feature(0),
+          left(-1),
+          right(-1),
+          default_left(false)
+      {}
+
+      bool leaf;
+      float value; // leaf value or split condition
+      uint32_t feature;
+      long left;
+      long right;
+      bool default_left;
+    };
+
+    typedef std::vector<SourceNode> SourceTree; // root is first node
+    typedef std::vector<SourceTree> SourceTreeArray;
+
+    // evaluation buffer (one per evaluating thread)
+    class FeatureVector
+    {
+      friend class TreeEnsemble;
+
+    protected:
+      std::vector<float> values_; // NaN if feature missed
+      std::vector<uint32_t> filled_;
+      std::vector<float> block_values_;
+    };
+
+    struct BatchRow
+    {
+      BatchRow(
+        const HashArray* hashes1_val = 0,
+        const HashArray* hashes2_val = 0)
+        : hashes1(hashes1_val),
+          hashes2(hashes2_val)
+      {}
+
+      const HashArray* hashes1;
+      const HashArray* hashes2;
+    };
+
+    typedef std::vector<BatchRow> BatchRowArray;
+    typedef std::vector<float> PredictionArray;
+
+  public:
+    TreeEnsemble(
+      const SourceTreeArray& trees,
+      float base_score,
+      Transform transform)
+      throw(InvalidModel);
+
+    float
+    predict(
+      FeatureVector& feature_vector,
+      const HashArray& hashes,
+      const HashArray* add_hashes1 = 0,
+      const HashArray* add_hashes2 = 0,
+      const HashArray* add_hashes3 = 0)
+      const throw();
+
+    // evaluate rows by blocks: each tree walked for all rows of block,
+    // shared hashes converted once
+    void
+    predict(
+      PredictionArray& result,
+      FeatureVector& feature_vector,
+      const BatchRowArray& rows,
+      const HashArray& shared_hashes,
+      const HashArray* add_shared_hashes = 0)
+      const throw();
+
+    unsigned long
+    tree_count() const throw();
+
+    unsigned long
+    feature_count() const throw();
+
+  protected:
+    struct Node
+    {
+      float value; // split condition or leaf value
+      uint32_t feature; // compact feature index or LEAF
+      uint32_t left; // index of left child, right child = left + 1
+      uint32_t default_left;
+    };
+
+    typedef std::vector<Node> NodeArray;
+    typedef std::vector<uint32_t> IndexArray;
+
+    typedef Generics::GnuHashTable<
+      Generics::NumericHashAdapter<uint32_t>, uint32_t>
+      FeatureIndexMap;
+
+    static const uint32_t LEAF = ~static_cast<uint32_t>(0);
+
+    // rows evaluated together
+    static const std::size_t BLOCK_SIZE = 8;
+
+  protected:
+    virtual
+    ~TreeEnsemble() throw() = default;
+
+    void
+    add_tree_(const SourceTree& tree) throw(InvalidModel);
+
+    void
+    init_(FeatureVector& feature_vector) const throw();
+
+    void
+    fill_(FeatureVector& feature_vector, const HashArray& hashes)
+      const throw();
+
+    void
+    fill_values_(float* values, const HashArray& hashes)
+      const throw();
+
+    void
+    clear_(FeatureVector& feature_vector) const throw();
+
+    float
+    walk_(const float* values, uint32_t root) const throw();
+
+    float
+    transform_(float margin) const throw();
+
+  private:
+    const float base_score_;
+    const Transform transform_type_;
+
+    NodeArray nodes_;
+    IndexArray roots_;
+    FeatureIndexMap feature_indexes_; // model feature -> compact index
+  };
+
+  typedef ReferenceCounting::SmartPtr<TreeEnsemble>
+    TreeEnsemble_var;
+}
+}
+}
+
+namespace AdServer
+{
+namespace CampaignSvcs
+{
+namespace CTR
+{
+  inline
+  unsigned long
+  TreeEnsemble::tree_count() const throw()
+  {
+    return roots_.size();
+  }
+
+  inline
+  unsigned long
+  TreeEnsemble::feature_count() const throw()
+  {
+    return feature_indexes_.size();
+  }
+
+  inline
+  float
+  TreeEnsemble::walk_(const float* values, uint32_t node_i) const throw()
+  {
+    const Node* node = &nodes_[node_i];
+
+    while(node->feature != LEAF)
+    {
+      const float value = values[node->feature];
+
+      if(value != value) // missed
+      {
+        node = &nodes_[node->left + (node->default_left ? 0 : 1)];
+      }
+      else
+      {
+        node = &nodes_[node->left + (value < node->value ? 0 : 1)];
+      }
+    }
+
+    return node->value;
+  }
+}
+}
+}
+
+#endif /*TREEENSEMBLE_HPP_*/
@@ -24,6 +24,11 @@
 #include <xgboost/learner/learner-inl.hpp>
 #undef DISABLE_OPENMP
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <set>
+
 #include <Generics/MMap.hpp>
 #include "XGBoostPredictor.hpp"
 
@@ -42,6 +47,9 @@ namespace CTR
     const std::string model_file_name;
     Generics::ArrayByte model_buffer;
     std::unique_ptr<rabit::utils::MemoryFixSizeBuffer> model_stream;
+
+    // defined if model converted for native evaluation
+    TreeEnsemble_var tree_ensemble;
   };
 
   // XGBoostPredictorPool::PredictorWrapper
@@ -56,6 +64,14 @@ namespace CTR
     void
     init() throw();
 
+    // convert loaded model to TreeEnsemble, return null if model
+    // isn't supported or native predictions differ from xgboost predictions
+    TreeEnsemble_var
+    convert(const PredictorWrapperDescriptor& init) throw();
+
+    void
+    use_tree_ensemble(TreeEnsemble* tree_ensemble) throw();
+
     float
     predict(
       const HashArray& hashes,
@@ -63,15 +79,61 @@ namespace CTR
       const HashArray* add_hashes2 = 0,
       const HashArray* add_hashes3 = 0);
 
+    void
+    predict(
+      PredictionArray& result,
+      const BatchRowArray& rows,
+      const HashArray& shared_hashes,
+      const HashArray* add_shared_hashes);
+
+  protected:
+    // layout of gbm::GBTree model parameters in model file
+    struct GBTreeModelParam
+    {
+      int num_trees;
+      int num_roots;
+      int num_feature;
+      int pad_32bit;
+      int64_t num_pbuffer;
+      int num_output_group;
+      int size_leaf_vector;
+      int reserved[31];
+    };
+
   protected:
+    // call reader for model stream positioned after header
+    template<typename ReaderType>
+    static void
+    read_model_(
+      const PredictorWrapperDescriptor& init,
+      ReaderType reader)
+      throw(InvalidConfig);
+
+    static void
+    read_trees_(
+      TreeEnsemble::SourceTreeArray& trees,
+      xgboost::utils::IStream& model_stream)
+      throw(TreeEnsemble::InvalidModel);
+
+    float
+    xgboost_predict_(
+      const HashArray& hashes,
+      const HashArray* add_hashes1 = 0,
+      const HashArray* add_hashes2 = 0,
+      const HashArray* add_hashes3 = 0);
+
     static void
     fill_feats_(
       std::vector<xgboost::RowBatch::Entry>& feats,
       const HashArray& hashes);
 
   protected:
+    TreeEnsemble_var tree_ensemble_;
+    TreeEnsemble::FeatureVector feature_vector_;
+
     std::unique_ptr<xgboost::io::DMatrixSimple> dmatrix_;
     std::vector<xgboost::RowBatch::Entry> feats_;
+    std::vector<xgboost::RowBatch::Entry> shared_feats_;
     std::vector<float> preds_;
   };
 
@@ -108,7 +170,41 @@ namespace CTR
   PredictorWrapper::PredictorWrapper(const PredictorWrapperDescriptor& init)
     throw(InvalidConfig)
   {
-    static const char* FUN = "XGBoostPredictorPool::PredictorWrapper::PredictorWrapper()";
+    // disable num feature calculation with using rabit (thread and processes unsafe)
+    // use num feature from model file
+    const bool CALC_NUM_FEATURE = false;
+
+    read_model_(
+      init,
+      [this, CALC_NUM_FEATURE] (xgboost::utils::IStream& model_stream)
+      {
+        BoostLearner::LoadModel(model_stream, CALC_NUM_FEATURE);
+      });
+
+    tree_ensemble_ = init.tree_ensemble;
+
+    dmatrix_.reset(new xgboost::io::DMatrixSimple());
+    feats_.reserve(10*1024);
+    preds_.reserve(1);
+  }
+
+  void
+  XGBoostPredictorPool::
+  PredictorWrapper::init() throw()
+  {
+    // do mock predict for initalize big buffers inside predictor
+    predict(HashArray(), 0);
+  }
+
+  template<typename ReaderType>
+  void
+  XGBoostPredictorPool::
+  PredictorWrapper::read_model_(
+    const PredictorWrapperDescriptor& init,
+    ReaderType reader)
+    throw(InvalidConfig)
+  {
+    static const char* FUN = "XGBoostPredictorPool::PredictorWrapper::read_model_()";
 
     rabit::utils::MemoryFixSizeBuffer model_stream_copy(*init.model_stream);
     // workaround for difference in LoadModel(IStream) and LoadModel(const char*)
@@ -121,37 +217,235 @@ namespace CTR
       throw InvalidConfig(ostr);
     }
 
-    // disable num feature calculation with using rabit (thread and processes unsafe)
-    // use num feature from model file
-    const bool CALC_NUM_FEATURE = false;
-
     if(::strcmp(header, "bs64") == 0)
     {
       xgboost::utils::Base64InStream bsin(&model_stream_copy);
       bsin.InitPosition();
-      BoostLearner::LoadModel(bsin, CALC_NUM_FEATURE);
+      reader(bsin);
     }
     else if(::strcmp(header, "binf") == 0)
     {
-      BoostLearner::LoadModel(model_stream_copy, CALC_NUM_FEATURE);
+      reader(model_stream_copy);
     }
     else
     {
       model_stream_copy.Seek(0);
-      BoostLearner::LoadModel(model_stream_copy, CALC_NUM_FEATURE);
+      reader(model_stream_copy);
     }
+  }
 
-    dmatrix_.reset(new xgboost::io::DMatrixSimple());
-    feats_.reserve(10*1024);
-    preds_.reserve(1);
+  void
+  XGBoostPredictorPool::
+  PredictorWrapper::read_trees_(
+    TreeEnsemble::SourceTreeArray& trees,
+    xgboost::utils::IStream& model_stream)
+    throw(TreeEnsemble::InvalidModel)
+  {
+    static const char* FUN = "XGBoostPredictorPool::PredictorWrapper::read_trees_()";
+
+    // learner parameters (used values taken from loaded learner)
+    BoostLearner::ModelParam learner_param;
+    std::string name_obj;
+    std::string name_gbm;
+
+    if(model_stream.Read(&learner_param, sizeof(learner_param)) !=
+         sizeof(learner_param) ||
+       !model_stream.Read(&name_obj) ||
+       !model_stream.Read(&name_gbm))
+    {
+      Stream::Error ostr;
+      ostr << FUN << ": can't read learner parameters";
+      throw TreeEnsemble::InvalidModel(ostr);
+    }
+
+    if(name_gbm != "gbtree")
+    {
+      Stream::Error ostr;
+      ostr << FUN << ": unsupported booster '" << name_gbm << "'";
+      throw TreeEnsemble::InvalidModel(ostr);
+    }
+
+    GBTreeModelParam gbtree_param;
+
+    if(model_stream.Read(&gbtree_param, sizeof(gbtree_param)) !=
+         sizeof(gbtree_param) ||
+       gbtree_param.num_trees < 0)
+    {
+      Stream::Error ostr;
+      ostr << FUN << ": can't read gbtree parameters";
+      throw TreeEnsemble::InvalidModel(ostr);
+    }
+
+    if(gbtree_param.num_roots != 1 ||
+       gbtree_param.num_output_group != 1)
+    {
+      Stream::Error ostr;
+      ostr << FUN << ": unsupported gbtree with num_roots = " <<
+        gbtree_param.num_roots << ", num_output_group = " <<
+        gbtree_param.num_output_group;
+      throw TreeEnsemble::InvalidModel(ostr);
+    }
+
+    trees.resize(gbtree_param.num_trees);
+
+    for(int tree_i = 0; tree_i < gbtree_param.num_trees; ++tree_i)
+    {
+      xgboost::tree::RegTree tree;
+      tree.LoadModel(model_stream);
+
+      TreeEnsemble::SourceTree& source_tree = trees[tree_i];
+      source_tree.resize(tree.param.num_nodes);
+
+      for(int node_i = 0; node_i < tree.param.num_nodes; ++node_i)
+      {
+        const xgboost::tree::RegTree::Node& node = tree[node_i];
+        TreeEnsemble::SourceNode& source_node = source_tree[node_i];
+
+        source_node.leaf = node.is_leaf();
+
+        if(source_node.leaf)
+        {
+          source_node.value = node.leaf_value();
+        }
+        else
+        {
+          source_node.value = node.split_cond();
+          source_node.feature = node.split_index();
+          source_node.left = node.cleft();
+          source_node.right = node.cright();
+          source_node.default_left = node.default_left();
+        }
+      }
+    }
+  }
+
+  TreeEnsemble_var
+  XGBoostPredictorPool::
+  PredictorWrapper::convert(const PredictorWrapperDescriptor& init)
+    throw()
+  {
+    TreeEnsemble::Transform transform;
+
+    if(name_obj_ == "binary:logistic" || name_obj_ == "reg:logistic")
+    {
+      transform = TreeEnsemble::T_LOGISTIC;
+    }
+    else if(name_obj_ == "reg:linear" || name_obj_ == "binary:logitraw")
+    {
+      transform = TreeEnsemble::T_IDENTITY;
+    }
+    else
+    {
+      return TreeEnsemble_var();
+    }
+
+    try
+    {
+      TreeEnsemble::SourceTreeArray trees;
+
+      read_model_(
+        init,
+        [&trees] (xgboost::utils::IStream& model_stream)
+        {
+          read_trees_(trees, model_stream);
+        });
+
+      TreeEnsemble_var tree_ensemble = new TreeEnsemble(
+        trees,
+        mparam.base_score,
+        transform);
+
+      // check that native predictions equal to xgboost predictions:
+      // on empty row, rows with all split features defined and,
+      // for each split, rows with split feature value just below
+      // and not less than split condition (hash values are integers)
+      typedef std::set<std::pair<uint32_t, uint32_t> > FeatureValueSet;
+
+      HashArray split_hashes;
+      FeatureValueSet split_values;
+
+      for(auto tree_it = trees.begin(); tree_it != trees.end(); ++tree_it)
+      {
+        for(auto node_it = tree_it->begin(); node_it != tree_it->end(); ++node_it)
+        {
+          if(!node_it->leaf)
+          {
+            const uint32_t feature = node_it->feature + 1;
+            const double max_value = std::numeric_limits<uint32_t>::max();
+            const double min_right_value = std::ceil(node_it->value);
+
+            split_hashes.push_back(std::make_pair(feature, 0));
+
+            if(min_right_value > 0)
+            {
+              split_values.insert(std::make_pair(
+                feature,
+                static_cast<uint32_t>(
+                  std::min(min_right_value - 1, max_value))));
+            }
+
+            if(min_right_value <= max_value)
+            {
+              split_values.insert(std::make_pair(
+                feature,
+                static_cast<uint32_t>(std::max(min_right_value, 0.0))));
+            }
+          }
+        }
+      }
+
+      TreeEnsemble::FeatureVector feature_vector;
+
+      for(uint32_t check_value = 0; check_value < 3; ++check_value)
+      {
+        HashArray check_hashes;
+
+        if(check_value > 0)
+        {
+          check_hashes = split_hashes;
+
+          for(auto hash_it = check_hashes.begin();
+              hash_it != check_hashes.end(); ++hash_it)
+          {
+            hash_it->second = check_value - 1;
+          }
+        }
+
+        if(tree_ensemble->predict(feature_vector, check_hashes) !=
+           xgboost_predict_(check_hashes))
+        {
+          return TreeEnsemble_var();
+        }
+      }
+
+      HashArray check_hashes(1);
+
+      for(auto value_it = split_values.begin();
+          value_it != split_values.end(); ++value_it)
+      {
+        check_hashes[0] = *value_it;
+
+        if(tree_ensemble->predict(feature_vector, check_hashes) !=
+           xgboost_predict_(check_hashes))
+        {
+          return TreeEnsemble_var();
+        }
+      }
+
+      return tree_ensemble;
+    }
+    catch(const eh::Exception&)
+    {}
+
+    return TreeEnsemble_var();
   }
 
   void
   XGBoostPredictorPool::
-  PredictorWrapper::init() throw()
+  PredictorWrapper::use_tree_ensemble(TreeEnsemble* tree_ensemble)
+    throw()
   {
-    // do mock predict for initalize big buffers inside predictor
-    predict(HashArray(), 0);
+    tree_ensemble_ = ReferenceCounting::add_ref(tree_ensemble);
   }
 
   float
@@ -161,6 +455,23 @@ namespace CTR
     const HashArray* add_hashes1,
     const HashArray* add_hashes2,
     const HashArray* add_hashes3)
+  {
+    if(tree_ensemble_)
+    {
+      return tree_ensemble_->predict(
+        feature_vector_, hashes, add_hashes1, add_hashes2, add_hashes3);
+    }
+
+    return xgboost_predict_(hashes, add_hashes1, add_hashes2, add_hashes3);
+  }
+
+  float
+  XGBoostPredictorPool::
+  PredictorWrapper::xgboost_predict_(
+    const HashArray& hashes,
+    const HashArray* add_hashes1,
+    const HashArray* add_hashes2,
+    const HashArray* add_hashes3)
   {
     // input SVM contains indexes, predict require indexes - 1
     fill_feats_(feats_, hashes);
@@ -192,6 +503,62 @@ namespace CTR
     return result;
   }
 
+  void
+  XGBoostPredictorPool::
+  PredictorWrapper::predict(
+    PredictionArray& result,
+    const BatchRowArray& rows,
+    const HashArray& shared_hashes,
+    const HashArray* add_shared_hashes)
+  {
+    if(tree_ensemble_)
+    {
+      tree_ensemble_->predict(
+        result, feature_vector_, rows, shared_hashes, add_shared_hashes);
+      return;
+    }
+
+    result.clear();
+
+    if(rows.empty())
+    {
+      return;
+    }
+
+    fill_feats_(shared_feats_, shared_hashes);
+
+    if(add_shared_hashes)
+    {
+      fill_feats_(shared_feats_, *add_shared_hashes);
+    }
+
+    for(BatchRowArray::const_iterator row_it = rows.begin();
+        row_it != rows.end(); ++row_it)
+    {
+      feats_.assign(shared_feats_.begin(), shared_feats_.end());
+
+      if(row_it->hashes1)
+      {
+        fill_feats_(feats_, *row_it->hashes1);
+      }
+
+      if(row_it->hashes2)
+      {
+        fill_feats_(feats_, *row_it->hashes2);
+      }
+
+      dmatrix_->AddRow(feats_);
+    }
+
+    BoostLearner::Predict(*dmatrix_, false, &preds_);
+    result.swap(preds_);
+
+    feats_.clear();
+    shared_feats_.clear();
+    dmatrix_->Clear();
+    preds_.clear();
+  }
+
   void
   XGBoostPredictorPool::
   PredictorWrapper::fill_feats_(
@@ -231,9 +598,22 @@ namespace CTR
       hashes, add_hashes1, add_hashes2, add_hashes3);
   }
 
+  void
+  XGBoostPredictorPool::
+  Predictor::predict(
+    PredictionArray& result,
+    const BatchRowArray& rows,
+    const HashArray& shared_hashes,
+    const HashArray* add_shared_hashes)
+  {
+    predictor_impl_->predict(
+      result, rows, shared_hashes, add_shared_hashes);
+  }
+
   // XGBoostPredictorPool::XGBoostPredictorPool impl
   XGBoostPredictorPool::XGBoostPredictorPool(
-    const String::SubString& model_file)
+    const String::SubString& model_file,
+    bool native_evaluation)
     throw(InvalidConfig)
   {
     predictor_descriptor_.reset(new PredictorWrapperDescriptor(model_file));
@@ -241,12 +621,28 @@ namespace CTR
     predictors_.push_back(
       PredictorWrapperPtr(new PredictorWrapper(*predictor_descriptor_)));
     (*predictors_.begin())->init();
+
+    if(native_evaluation)
+    {
+      // convert model once, wrappers created after use converted model
+      predictor_descriptor_->tree_ensemble =
+        (*predictors_.begin())->convert(*predictor_descriptor_);
+      (*predictors_.begin())->use_tree_ensemble(
+        predictor_descriptor_->tree_ensemble);
+    }
   }
 
   XGBoostPredictorPool::~XGBoostPredictorPool()
     throw()
   {}
 
+  TreeEnsemble_var
+  XGBoostPredictorPool::tree_ensemble() const
+    throw()
+  {
+    return predictor_descriptor_->tree_ensemble;
+  }
+
   XGBoostPredictorPool::Predictor_var
   XGBoostPredictorPool::get_predictor()
     throw()
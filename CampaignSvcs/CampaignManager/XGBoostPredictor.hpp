@@ -26,6 +26,7 @@
 #include <String/SubString.hpp>
 
 #include "CTRFeatureCalculators.hpp"
+#include "TreeEnsemble.hpp"
 
 namespace AdServer
 {
@@ -47,6 +48,24 @@ namespace CTR
     DECLARE_EXCEPTION(Exception, eh::DescriptiveException);
     DECLARE_EXCEPTION(InvalidConfig, Exception);
 
+    // row of batch prediction: row specific hashes,
+    // that added to hashes shared by all rows
+    struct BatchRow
+    {
+      BatchRow(
+        const HashArray* hashes1_val = 0,
+        const HashArray* hashes2_val = 0)
+        : hashes1(hashes1_val),
+          hashes2(hashes2_val)
+      {}
+
+      const HashArray* hashes1;
+      const HashArray* hashes2;
+    };
+
+    typedef std::vector<BatchRow> BatchRowArray;
+    typedef std::vector<float> PredictionArray;
+
     struct Predictor: public ReferenceCounting::AtomicImpl
     {
     public:
@@ -62,6 +81,15 @@ namespace CTR
         const HashArray* add_hashes2 = 0,
         const HashArray* add_hashes3 = 0);
 
+      // predict all rows with one learner call,
+      // shared hashes converted once
+      void
+      predict(
+        PredictionArray& result,
+        const BatchRowArray& rows,
+        const HashArray& shared_hashes,
+        const HashArray* add_shared_hashes = 0);
+
     protected:
       virtual ~Predictor() throw();
 
@@ -73,12 +101,20 @@ namespace CTR
     typedef ReferenceCounting::SmartPtr<Predictor> Predictor_var;
 
   public:
-    XGBoostPredictorPool(const String::SubString& model_file)
+    // native_evaluation: evaluate model with flattened TreeEnsemble
+    // (converted at load) if model is supported, otherwise with xgboost
+    XGBoostPredictorPool(
+      const String::SubString& model_file,
+      bool native_evaluation = true)
       throw(InvalidConfig);
 
     Predictor_var
     get_predictor() throw();
 
+    // return native evaluator or null if model evaluated with xgboost
+    TreeEnsemble_var
+    tree_ensemble() const throw();
+
   protected:
     typedef Sync::Policy::PosixThread SyncPolicy;
 
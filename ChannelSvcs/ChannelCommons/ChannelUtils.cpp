@@ -18,6 +18,8 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include<string.h>
+#include<stdint.h>
 #include<string>
 #include<eh/Exception.hpp>
 #include<String/UTF8Case.hpp>
@@ -53,6 +55,44 @@ namespace AdServer
       trigger.swap(word.trigger);
     }
 
+    void ascii_to_lower(char* str, size_t length) throw()
+    {
+      static const uint64_t ONES = 0x0101010101010101ULL;
+      static const uint64_t HIGH_BITS = 0x8080808080808080ULL;
+
+      char* const end = str + length;
+      for(; end - str >= 8; str += 8)
+      {
+        uint64_t word;
+        ::memcpy(&word, str, sizeof(word));
+        // per byte compare of low 7 bits without carry to next byte:
+        // high bit of sum is set if byte >= 'A' (> 'Z')
+        const uint64_t low = word & ~HIGH_BITS;
+        const uint64_t ge_a = low + (0x80 - 'A') * ONES;
+        const uint64_t gt_z = low + (0x7F - 'Z') * ONES;
+        const uint64_t upper = (ge_a ^ gt_z) & ~word & HIGH_BITS;
+        if(upper)
+        {
+          word |= upper >> 2; // 0x80 >> 2 = 'a' - 'A'
+          ::memcpy(str, &word, sizeof(word));
+        }
+      }
+
+      for(; str != end; ++str)
+      {
+        if(*str >= 'A' && *str <= 'Z')
+        {
+          *str += 'a' - 'A';
+        }
+      }
+    }
+
+    ParseBuffers& parse_buffers() throw()
+    {
+      static thread_local ParseBuffers buffers;
+      return buffers;
+    }
+
     void build_combination(
       const std::vector<size_t>& positions,
       AdServer::ChannelSvcs::MatchWords& match_words,
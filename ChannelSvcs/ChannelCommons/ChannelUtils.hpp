@@ -21,7 +21,10 @@
 #ifndef CHANNEL_UTILS_HPP
 #define CHANNEL_UTILS_HPP
 
+#include<string.h>
+#include<stdint.h>
 #include<string>
+#include<vector>
 #include <Commons/CorbaAlgs.hpp>
 #include <Commons/Constants.hpp>
 #include <ChannelSvcs/ChannelCommons/CommonTypes.hpp>
@@ -62,6 +65,46 @@ namespace ChannelSvcs
     out << '.' << std::endl; 
   }
 
+  /* lower case of ASCII letters in place, other bytes (UTF-8 too)
+   * are kept, equal to AsciiStringManip::to_lower.
+   * 8 bytes are processed per step */
+  void ascii_to_lower(char* str, size_t length) throw();
+
+  /* splitter of text to words by MatchSeparators (' ', '\t'),
+   * separators are searched 8 bytes per step, empty words are skipped */
+  class MatchWordSplitter
+  {
+  public:
+    explicit
+    MatchWordSplitter(const String::SubString& text) throw();
+
+    bool
+    get_token(String::SubString& token) throw();
+
+  private:
+    static bool
+    is_separator_(char ch) throw();
+
+    static const char*
+    find_separator_(const char* pos, const char* end) throw();
+
+  private:
+    const char* pos_;
+    const char* end_;
+  };
+
+  /* per thread buffers of request parsing,
+   * their capacity is reused between requests */
+  struct ParseBuffers
+  {
+    std::vector<size_t> positions;
+    std::string subword;
+    std::string lower_path;
+    std::string lower_query;
+  };
+
+  ParseBuffers& parse_buffers() throw();
+
   enum ParseMode
   {
     PM_SIMPLIFY,
@@ -88,9 +131,11 @@ namespace ChannelSvcs
       try
       {
         String::SubString token, parsed_token;
-        std::vector<size_t> positions;
-        std::string subword;
+        ParseBuffers& buffers = parse_buffers();
+        std::vector<size_t>& positions = buffers.positions;
+        std::string& subword = buffers.subword;
         bool make_split;
+        positions.clear();
         match_words.data_holder_.reserve(in.length() * 4 + 2);
         String::StringManip::Splitter<SEPARATOR>
           splitter(!separators ? String::SubString() : in);
@@ -112,7 +157,7 @@ namespace ChannelSvcs
             Language::Trigger::normalize_phrase(token, subword, segmentor);
             token = subword;
           }
-          String::StringManip::Splitter<MatchSeparators> splitter2(token);
+          MatchWordSplitter splitter2(token);
           positions.push_back(match_words.data_holder_.length());
           while(splitter2.get_token(parsed_token))
           {
@@ -150,5 +195,76 @@ namespace ChannelSvcs
 }
 }
 
+namespace AdServer
+{
+namespace ChannelSvcs
+{
+  // MatchWordSplitter
+  inline
+  MatchWordSplitter::MatchWordSplitter(const String::SubString& text) throw()
+    : pos_(text.data()),
+      end_(text.data() + text.size())
+  {}
+
+  inline
+  bool
+  MatchWordSplitter::is_separator_(char ch) throw()
+  {
+    return ch == ' ' || ch == '\t';
+  }
+
+  inline
+  const char*
+  MatchWordSplitter::find_separator_(const char* pos, const char* end)
+    throw()
+  {
+    static const uint64_t ONES = 0x0101010101010101ULL;
+    static const uint64_t HIGH_BITS = 0x8080808080808080ULL;
+
+    for(; end - pos >= 8; pos += 8)
+    {
+      uint64_t word;
+      ::memcpy(&word, pos, sizeof(word));
+      // zero byte of (word ^ sep) marks separator, zero byte test can
+      // give false positive only after true one: bytes are checked below
+      const uint64_t spaces = word ^ (ONES * ' ');
+      const uint64_t tabs = word ^ (ONES * '\t');
+      if(((spaces - ONES) & ~spaces & HIGH_BITS) |
+         ((tabs - ONES) & ~tabs & HIGH_BITS))
+      {
+        break;
+      }
+    }
+
+    while(pos != end && !is_separator_(*pos))
+    {
+      ++pos;
+    }
+
+    return pos;
+  }
+
+  inline
+  bool
+  MatchWordSplitter::get_token(String::SubString& token) throw()
+  {
+    while(pos_ != end_ && is_separator_(*pos_))
+    {
+      ++pos_;
+    }
+
+    if(pos_ == end_)
+    {
+      return false;
+    }
+
+    const char* token_end = find_separator_(pos_ + 1, end_);
+    token = String::SubString(pos_, token_end - pos_);
+    pos_ = token_end;
+    return true;
+  }
+}
+}
+
 #endif
 
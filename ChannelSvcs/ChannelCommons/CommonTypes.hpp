@@ -22,8 +22,10 @@
 #ifndef AD_SERVER_COMMON_TYPES_HPP
 #define AD_SERVER_COMMON_TYPES_HPP
 
+#include<stdint.h>
 #include<vector>
 #include<string>
+#include<algorithm>
 #include<list>
 #include<map>
 #include<set>
@@ -116,12 +118,176 @@ namespace AdServer
       return id;
     }
 
-    struct MatchWords:
-      public Generics::GnuHashSet<Generics::SubStringHashAdapter>
+    /* set of request words (and word sequences) for matching,
+     * words are views of data_holder_ or of memory that is alive
+     * while matching. Words are kept in insertion order with open
+     * addressing index over them. clear() keeps capacity: reused
+     * object is filled without allocations */
+    class MatchWords
     {
+    public:
+      typedef Generics::SubStringHashAdapter key_type;
+      typedef key_type value_type;
+      typedef std::vector<key_type> WordArray;
+      typedef WordArray::const_iterator const_iterator;
+      typedef const_iterator iterator;
+
+      std::pair<const_iterator, bool>
+      insert(const key_type& word) throw(eh::Exception);
+
+      template<typename IteratorType>
+      void
+      insert(IteratorType begin, IteratorType end) throw(eh::Exception);
+
+      const_iterator
+      find(const key_type& word) const throw();
+
+      const_iterator
+      begin() const throw();
+
+      const_iterator
+      end() const throw();
+
+      size_t
+      size() const throw();
+
+      bool
+      empty() const throw();
+
+      // remove words and data_holder_ content, capacity is kept
+      void
+      clear() throw();
+
       std::string data_holder_;//uses for memory allocation of SubStrings
+
+    protected:
+      // word index + 1, 0 for empty cell
+      typedef std::vector<uint32_t> CellArray;
+
+    protected:
+      size_t
+      cell_index_(const key_type& word) const throw();
+
+      void
+      rehash_(size_t cells_count) throw(eh::Exception);
+
+    protected:
+      WordArray words_;
+      CellArray cells_;
     };
 
+
+    // MatchWords
+    inline
+    std::pair<MatchWords::const_iterator, bool>
+    MatchWords::insert(const key_type& word) throw(eh::Exception)
+    {
+      if((words_.size() + 1) * 2 > cells_.size())
+      {
+        // load factor is kept <= 1/2
+        rehash_(cells_.empty() ? 16 : cells_.size() * 2);
+      }
+
+      const size_t cell_i = cell_index_(word);
+
+      if(cells_[cell_i])
+      {
+        return std::make_pair(words_.begin() + (cells_[cell_i] - 1), false);
+      }
+
+      words_.push_back(word);
+      cells_[cell_i] = words_.size();
+      return std::make_pair(words_.end() - 1, true);
+    }
+
+    template<typename IteratorType>
+    void
+    MatchWords::insert(IteratorType begin, IteratorType end)
+      throw(eh::Exception)
+    {
+      for(; begin != end; ++begin)
+      {
+        insert(key_type(*begin));
+      }
+    }
+
+    inline
+    MatchWords::const_iterator
+    MatchWords::find(const key_type& word) const throw()
+    {
+      if(cells_.empty())
+      {
+        return words_.end();
+      }
+
+      const uint32_t cell = cells_[cell_index_(word)];
+      return cell ? words_.begin() + (cell - 1) : words_.end();
+    }
+
+    inline
+    MatchWords::const_iterator
+    MatchWords::begin() const throw()
+    {
+      return words_.begin();
+    }
+
+    inline
+    MatchWords::const_iterator
+    MatchWords::end() const throw()
+    {
+      return words_.end();
+    }
+
+    inline
+    size_t
+    MatchWords::size() const throw()
+    {
+      return words_.size();
+    }
+
+    inline
+    bool
+    MatchWords::empty() const throw()
+    {
+      return words_.empty();
+    }
+
+    inline
+    void
+    MatchWords::clear() throw()
+    {
+      words_.clear();
+      std::fill(cells_.begin(), cells_.end(), 0);
+      data_holder_.clear();
+    }
+
+    inline
+    size_t
+    MatchWords::cell_index_(const key_type& word) const throw()
+    {
+      // cells count is power of 2 and free cell exists
+      const size_t mask = cells_.size() - 1;
+      size_t cell_i = word.hash() & mask;
+
+      while(cells_[cell_i] && !(words_[cells_[cell_i] - 1] == word))
+      {
+        cell_i = (cell_i + 1) & mask;
+      }
+
+      return cell_i;
+    }
+
+    inline
+    void
+    MatchWords::rehash_(size_t cells_count) throw(eh::Exception)
+    {
+      cells_.assign(cells_count, 0);
+
+      for(size_t word_i = 0; word_i < words_.size(); ++word_i)
+      {
+        cells_[cell_index_(words_[word_i])] = word_i + 1;
+      }
+    }
   }
 }
 
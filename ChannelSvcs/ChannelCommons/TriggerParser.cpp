@@ -36,6 +36,7 @@
 #include <Commons/Constants.hpp>
 #include"CommonTypes.hpp"
 #include"TriggerParser.hpp"
+#include"ChannelUtils.hpp"
 
 namespace AdServer
 {
@@ -133,7 +134,7 @@ namespace ChannelSvcs
     {
       return false;
     }
-    String::AsciiStringManip::to_lower(out.begin(), out.end());
+    ascii_to_lower(&out[0], out.size());
     return true;
   }
 
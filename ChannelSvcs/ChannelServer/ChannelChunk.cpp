@@ -227,40 +227,49 @@ namespace ChannelSvcs
     TriggerMap::const_iterator fnd = url_map_var_->find(url.prefix);
     if(fnd != url_map_var_->end())
     {
-      const SoftVector& vector = *fnd->second;
-      bool match_exact = (*url.postfix.rbegin() == '"');
-      size_t length = url.postfix.length() - (match_exact ? 1 : 0);
-      size_t comp_length;
-      for(SoftVector::const_iterator it = vector.begin();
-          it != vector.end(); ++it)
-      {
-        const String::SubString& postfix = it->matcher->get_url_postfix();
-        if(flags & MF_NONSTRICTURL)
-        {
-          comp_length = std::min(length, postfix.length());
-        }
-        else if((it->matcher->exact() && 
-          (!match_exact || length != postfix.length())) ||
-          length < postfix.length())
-        {//doesn't match
-          continue;
-        }
-        else
-        {
-          comp_length = postfix.length();
-        }
+      match_url_atom_(*fnd->second, url, flags, res);
+    }
+  }
 
-        if(postfix.compare(
-            0, comp_length, url.postfix, 0, comp_length) == 0)
-        {
-          res.count_channels[CT_URL] += match_cell_(
-            *match_info_ptr_,
-            *it,
-            CT_URL,
-            flags,
-            res,
-            (flags & MF_NEGATIVE ? false : it->matcher->negative()));
-        }
+  void ChannelChunk::match_url_atom_(
+    const SoftVector& vector,
+    const MatchUrl& url,
+    unsigned int flags,
+    TriggerMatchRes& res) const
+    throw(eh::Exception)
+  {
+    bool match_exact = (*url.postfix.rbegin() == '"');
+    size_t length = url.postfix.length() - (match_exact ? 1 : 0);
+    size_t comp_length;
+    for(SoftVector::const_iterator it = vector.begin();
+        it != vector.end(); ++it)
+    {
+      const String::SubString& postfix = it->matcher->get_url_postfix();
+      if(flags & MF_NONSTRICTURL)
+      {
+        comp_length = std::min(length, postfix.length());
+      }
+      else if((it->matcher->exact() && 
+        (!match_exact || length != postfix.length())) ||
+        length < postfix.length())
+      {//doesn't match
+        continue;
+      }
+      else
+      {
+        comp_length = postfix.length();
+      }
+
+      if(postfix.compare(
+          0, comp_length, url.postfix, 0, comp_length) == 0)
+      {
+        res.count_channels[CT_URL] += match_cell_(
+          *match_info_ptr_,
+          *it,
+          CT_URL,
+          flags,
+          res,
+          (flags & MF_NEGATIVE ? false : it->matcher->negative()));
       }
     }
   }
@@ -333,60 +342,84 @@ namespace ChannelSvcs
     MatcherVarsSet* must_match)
     const
     throw(eh::Exception)
+  {
+    const TriggerAtom* atom = find_words(phrase, type);
+
+    if(atom) // find one word
+    {
+      match_words_atom(
+        *atom, words, exact_words, type, flags, res, must_match);
+    }
+  }
+
+  const TriggerAtom* ChannelChunk::find_words(
+    const Generics::SubStringHashAdapter& phrase,
+    MatchType type)
+    const
+    throw()
   {
     const TriggerMap& check_trigger_map = get_trigger_map_(type);
     TriggerMap::const_iterator fnd = check_trigger_map.find(phrase);
+    return fnd != check_trigger_map.end() ? fnd->second.in() : 0;
+  }
 
-    if(fnd != check_trigger_map.end()) // find one word
+  void ChannelChunk::match_words_atom(
+    const TriggerAtom& atom,
+    const MatchWords& words,
+    const StringVector* exact_words,
+    MatchType type,
+    unsigned int flags,
+    TriggerMatchRes& res,
+    MatcherVarsSet* must_match)
+    const
+    throw(eh::Exception)
+  {
+    const SoftVector& soft_vector = atom;
+    char sym_type;
+    switch(type)
     {
-      const TriggerAtom& atom = *fnd->second;
-      const SoftVector& soft_vector = atom;
-      char sym_type;
-      switch(type)
+      case CT_PAGE:
+        sym_type = 'P';
+        break;
+      case CT_URL_KEYWORDS:
+        sym_type = 'R';
+        break;
+      default:
+        sym_type = 'S';
+        break;
+    }
+
+    for (SoftVector::const_iterator i(soft_vector.begin());
+      i != soft_vector.end(); ++i)
+    {
+      const SoftMatcher* matcher = i->matcher.in();
+
+      if(matcher->trigger_type() != sym_type)
       {
-        case CT_PAGE:
-          sym_type = 'P';
-          break;
-        case CT_URL_KEYWORDS:
-          sym_type = 'R';
-          break;
-        default:
-          sym_type = 'S';
-          break;
+        continue;
       }
-
-      for (SoftVector::const_iterator i(soft_vector.begin());
-        i != soft_vector.end(); ++i)
+      bool match = matcher->match(words, (flags & MF_NONSTRICTKW ? true : false));
+      if (exact_words && !match)
       {
-        const SoftMatcher* matcher = i->matcher.in();
-
-        if(matcher->trigger_type() != sym_type)
-        {
-          continue;
-        }
-        bool match = matcher->match(words, (flags & MF_NONSTRICTKW ? true : false));
-        if (exact_words && !match)
-        {
-          match |= matcher->match_exact(*exact_words);
-        }
-        if(must_match)
-        {//additional soft matching
-          if(must_match->erase(i->matcher) > 0)
-          {
-            match = true;
-          }
-        }
-        if(match)
+        match |= matcher->match_exact(*exact_words);
+      }
+      if(must_match)
+      {//additional soft matching
+        if(must_match->erase(i->matcher) > 0)
         {
-          res.count_channels[type] += match_cell_(
-            *match_info_ptr_,
-            *i,
-            type,
-            flags,
-            res,
-            (flags & MF_NEGATIVE ? false : matcher->negative()));
+          match = true;
         }
       }
+      if(match)
+      {
+        res.count_channels[type] += match_cell_(
+          *match_info_ptr_,
+          *i,
+          type,
+          flags,
+          res,
+          (flags & MF_NEGATIVE ? false : matcher->negative()));
+      }
     }
   }
 
@@ -114,8 +114,53 @@ namespace ChannelSvcs
 
   struct MatchUrl
   {
+    MatchUrl() throw()
+      : text_begin(0), text_end(0)
+    {}
+
     std::string prefix;
     std::string postfix;
+    // position of prefix in MatchUrlText::text of referer
+    size_t text_begin;
+    size_t text_end;
+  };
+
+  /* normalized referer: host (with added www.) and path,
+   * prefixes of MatchUrls [first_url, first_url + count_urls) are
+   * substrings of text */
+  struct MatchUrlText
+  {
+    std::string text;
+    size_t first_url;
+    size_t count_urls;
+  };
+
+  typedef std::vector<MatchUrlText> MatchUrlTexts;
+
+  class MatchUrls: public std::vector<MatchUrl>
+  {
+  public:
+    void clear() throw()
+    {
+      std::vector<MatchUrl>::clear();
+      texts.clear();
+    }
+
+    /* texts cover all urls, so urls can be matched in one pass
+     * over each text */
+    bool
+    texts_complete() const throw()
+    {
+      size_t count_urls = 0;
+      for(MatchUrlTexts::const_iterator it = texts.begin();
+          it != texts.end(); ++it)
+      {
+        count_urls += it->count_urls;
+      }
+      return count_urls == size();
+    }
+
+    MatchUrlTexts texts;
   };
 
   typedef Generics::GnuHashTable<Generics::SubStringHashAdapter, TriggerAtom_var>
@@ -335,6 +380,9 @@ namespace ChannelSvcs
   class ChannelChunk:
     public ReferenceCounting::AtomicImpl
   {
+    friend class CompiledTriggerIndex;
+    friend class UrlTriggerAutomaton;
+
   public:
 
     DECLARE_EXCEPTION(Exception, eh::DescriptiveException);
@@ -368,6 +416,25 @@ namespace ChannelSvcs
       const
       throw(eh::Exception);
 
+    /* find triggers with key phrase, match_words is find_words
+     * and match_words_atom: batch matching do lookups grouped by chunk */
+    const TriggerAtom* find_words(
+      const Generics::SubStringHashAdapter& phrase,
+      MatchType type)
+      const
+      throw();
+
+    void match_words_atom(
+      const TriggerAtom& atom,
+      const MatchWords& words,
+      const StringVector* exact_words,
+      MatchType type,
+      unsigned int flags,
+      TriggerMatchRes& res,
+      MatcherVarsSet* must_match)
+      const
+      throw(eh::Exception);
+
     void match_uid(
       const Generics::Uuid& uid, 
       TriggerMatchRes& res)
@@ -479,6 +546,14 @@ namespace ChannelSvcs
       MatcherVarsSet* removed_matchers)
       throw ();
 
+    /* match url for triggers of one url map key */
+    void match_url_atom_(
+      const SoftVector& vector,
+      const MatchUrl& url,
+      unsigned int flags,
+      TriggerMatchRes& res) const
+      throw(eh::Exception);
+
     static size_t match_cell_(
       const ChannelMatchInfo& cinfo,
       const MatchingEntity& atom,
@@ -97,16 +97,16 @@ namespace ChannelSvcs
    *
    * */
   ChannelContainer::ChannelContainer(
-    unsigned long count_chunks, bool nonstrict)
+    unsigned long count_chunks, bool nonstrict, bool compiled_matching)
     throw(Exception)
     : ChannelContainerBase(),
       count_chunks_(count_chunks),
-      chunks_(new ChannelChunkArray),
       ccgs_(new CCGMap),
       master_(0),
       first_master_(0),
       max_update_(0),
       non_strict_(nonstrict),
+      compiled_matching_(compiled_matching),
       queries_(0),
       exceptions_(0),
       terminated_(false)
@@ -114,12 +114,14 @@ namespace ChannelSvcs
     try
     {
       memset(stats_.params, 0, sizeof(stats_.params));
-      chunks_->resize(count_chunks_);
+      ChannelChunkArray_var chunk_array = new ChannelChunkArray;
+      chunk_array->resize(count_chunks_);
       ChannelMatchInfo_var info = new ChannelMatchInfo;
       for(unsigned int i = 0; i < count_chunks_; i++)
       {
-        (*chunks_)[i] = new ChannelChunk(info);
+        (*chunk_array)[i] = new ChannelChunk(info);
       }
+      chunks_.swap(chunk_array);
     }
     catch(const eh::Exception& e)
     {
@@ -150,12 +152,7 @@ namespace ChannelSvcs
         //use prefix size of url
       }
 
-      ChannelChunkArray_var array;
-
-      {
-        ReadGuard_ lock(lock_configuration_);
-        array = ReferenceCounting::add_ref(chunks_);
-      }
+      ChannelChunkArray_var array = chunks_.get();
 
       for(SubStringVector::const_iterator it = parts.begin();
           it != parts.end(); ++it)
@@ -559,11 +556,7 @@ namespace ChannelSvcs
     {
       size_t count_channels = 0;
       IdType channel_id = 0;
-      ChannelChunkArray_var match_chunks;
-      {
-        ReadGuard_ lock(lock_configuration_);
-        match_chunks = ReferenceCounting::add_ref(chunks_);
-      }
+      ChannelChunkArray_var match_chunks = chunks_.get();
       UpdateContainer::Matters& matters_cont = add.get_matters();
       auto matters_it = matters_cont.begin();
       while(!terminated_ && matters_it != matters_cont.end())
@@ -640,11 +633,7 @@ namespace ChannelSvcs
     ChannelIdToTrigers& added)
     throw(Exception)
   {
-    ChannelChunkArray_var match_chunks;
-    {
-      ReadGuard_ lock(lock_configuration_);
-      match_chunks = ReferenceCounting::add_ref(chunks_);
-    }
+    ChannelChunkArray_var match_chunks = chunks_.get();
     while(!unmerged.empty())
     {
       auto it = unmerged.begin();
@@ -769,11 +758,7 @@ namespace ChannelSvcs
       }
 
       ChannelChunkArray_var chunks_array;
-      ChannelChunkArray_var match_chunks;
-      {
-        ReadGuard_ lock(lock_configuration_);
-        match_chunks = ReferenceCounting::add_ref(chunks_);
-      }
+      ChannelChunkArray_var match_chunks = chunks_.get();
       const ExcludeContainerType& removed_channels = add.get_removed();
       IdType channel_id = 0;
       bool reset_stat = false;
@@ -939,7 +924,7 @@ namespace ChannelSvcs
       }
       else
       {
-        info_res = ReferenceCounting::add_ref(get_rules_());
+        info_res = ReferenceCounting::add_ref(get_rules_(*match_chunks));
       }
 
       for(unsigned int i = 0; i < count_chunks_; i++)
@@ -965,15 +950,13 @@ namespace ChannelSvcs
           }
         }
         match_chunks = chunks_array;
-        {
-          WriteGuard_ lock(lock_configuration_);
-          chunks_.swap(chunks_array); // destroy chunk outside lock
-        }
+        chunks_.swap(chunks_array); // destroy chunk outside holder
         if (progress)
         {
           progress->set_progess(1);
         }
       }
+
       if (progress)
       {
         progress->change_stage(PROGRESS_REMOVE_NON_STRICT);
@@ -989,6 +972,22 @@ namespace ChannelSvcs
           removed_search_keywords);
       }
 
+      if(compiled_matching_ && !terminated_)
+      {
+        CompiledTriggerIndex_var compiled_index =
+          new CompiledTriggerIndex(match_chunks);
+        UrlTriggerAutomaton_var url_automaton;
+        {
+          ReadGuard_ lock(lock_ns_map_);
+          url_automaton = new UrlTriggerAutomaton(
+            match_chunks,
+            non_strict_ ? &ns_url_map_ : nullptr);
+        }
+        // old index and automaton destroyed outside holders
+        compiled_index_.swap(compiled_index);
+        url_automaton_.swap(url_automaton);
+      }
+
       if(reset_stat)
       {
         Sync::PosixGuard lock(lock_statistic_);
@@ -1040,11 +1039,7 @@ namespace ChannelSvcs
 
   void ChannelContainer::clean_failed_merge_() throw()
   {
-    ChannelChunkArray_var match_chunks;
-    {
-      ReadGuard_ lock(lock_configuration_);
-      match_chunks = ReferenceCounting::add_ref(chunks_);
-    }
+    ChannelChunkArray_var match_chunks = chunks_.get();
     for(unsigned int i = 0; i < count_chunks_; i++)
     {
       (*match_chunks)[i]->cancel_update();
@@ -1075,12 +1070,18 @@ namespace ChannelSvcs
   void ChannelContainer::match_urls_(
     const MatchUrls& urls,
     const ChannelChunkArray& array,
+    const UrlTriggerAutomaton* url_automaton,
     unsigned int flags,
     TriggerMatchRes& res)
     throw(Exception)
   {
     try
     {
+      if(url_automaton && url_automaton->match(urls, flags, res))
+      {
+        return;
+      }
+
       for (MatchUrls::const_iterator i = urls.begin();
            i != urls.end(); ++i)
       {
@@ -1102,6 +1103,7 @@ namespace ChannelSvcs
   void ChannelContainer::match_ns_urls_(
     const MatchUrls& urls,
     const ChannelChunkArray& array,
+    const UrlTriggerAutomaton* url_automaton,
     unsigned int flags,
     TriggerMatchRes& res)
     throw(Exception)
@@ -1109,6 +1111,7 @@ namespace ChannelSvcs
     try
     {
       MatchUrls additional_urls;
+      if(!url_automaton || !url_automaton->match_ns(urls, additional_urls))
       {
         ReadGuard_ lock(lock_ns_map_);
         for (MatchUrls::const_reverse_iterator i(urls.rbegin());
@@ -1120,42 +1123,13 @@ namespace ChannelSvcs
             for(NSTriggerAtom::const_iterator it_ns = it->second.begin();
                 it_ns != it->second.end(); ++it_ns)
             {
-              const String::SubString& url_prefix = (*it_ns)->get_url_prefix();
-              if(i->prefix.length() + i->postfix.length() < url_prefix.length())
-              {
-                if(url_prefix.compare(
-                    i->prefix.length(),
-                    i->postfix.length(),
-                    i->postfix, 0, i->postfix.length()) == 0)
-                {
-                  additional_urls.resize(additional_urls.size() + 1);
-                  MatchUrl& url = additional_urls.back();
-                  url.prefix = url_prefix.str();
-                  url.postfix = "/";
-                }
-              }
-              else
-              {
-                additional_urls.resize(additional_urls.size() + 1);
-                MatchUrl& url = additional_urls.back();
-                url.prefix.reserve(url_prefix.length());
-                url.postfix.reserve(i->postfix.length());
-                url.prefix.append(i->prefix);
-                url.prefix.append(
-                  i->postfix,
-                  0, 
-                  url_prefix.length() - i->prefix.size());
-                url.postfix.append(
-                  i->postfix,
-                  url_prefix.length() - i->prefix.size(),
-                  std::string::npos);
-              }
+              UrlTriggerAutomaton::add_ns_url(*i, **it_ns, additional_urls);
             }
           }
         }
       }
-      match_urls_(urls, array, flags, res);
-      match_urls_(additional_urls, array, flags, res);
+      match_urls_(urls, array, url_automaton, flags, res);
+      match_urls_(additional_urls, array, url_automaton, flags, res);
     }
     catch(const eh::Exception& e)
     {
@@ -1250,6 +1224,107 @@ namespace ChannelSvcs
     }
   }
 
+  void ChannelContainer::get_words_passes_(
+    const MatchWords match_words[CT_MAX],
+    const MatchWords& additional_url_keywords,
+    const StringVector& exact_words,
+    unsigned int flags,
+    WordsPass passes[WP_MAX])
+    throw()
+  {
+    const WordsPass res[WP_MAX] =
+    {
+      { &match_words[CT_PAGE], nullptr, CT_PAGE, flags | MF_BLACK_LIST },
+      { &match_words[CT_URL_KEYWORDS], nullptr, CT_URL_KEYWORDS,
+        flags | MF_BLACK_LIST },
+      { &additional_url_keywords, nullptr, CT_URL_KEYWORDS, flags },
+      { &match_words[CT_SEARCH], &exact_words, CT_SEARCH,
+        flags | MF_BLACK_LIST }
+    };
+
+    std::copy(res, res + WP_MAX, passes);
+  }
+
+  /* key words of all queries in order of match_ passes,
+   * lookups in trigger maps are grouped by chunk */
+  void ChannelContainer::find_batch_words_(
+    const MatchQueryArray& queries,
+    const ChannelChunkArray& array,
+    FoundWordsArray& found_words,
+    std::vector<size_t>& query_offsets) const
+    throw(eh::Exception)
+  {
+    std::vector<unsigned int> word_chunks;
+    std::vector<MatchType> word_types;
+    query_offsets.resize(queries.size() + 1);
+
+    for(size_t query_i = 0; query_i < queries.size(); ++query_i)
+    {
+      const MatchQuery& query = queries[query_i];
+      query_offsets[query_i] = found_words.size();
+
+      if(query.flags & MF_NONSTRICTKW)
+      {
+        continue;
+      }
+
+      WordsPass passes[WP_MAX];
+      get_words_passes_(
+        query.match_words,
+        query.additional_url_keywords,
+        query.exact_words,
+        query.flags,
+        passes);
+
+      for(unsigned int pass_i = 0; pass_i < WP_MAX; ++pass_i)
+      {
+        const WordsPass& pass = passes[pass_i];
+        for(MatchWords::const_iterator word_it = pass.words->begin();
+            word_it != pass.words->end(); ++word_it)
+        {
+          const FoundWords found = { &*word_it, 0, 0 };
+          found_words.push_back(found);
+          word_chunks.push_back(calc_chunk_num_(word_it->hash(), array.size()));
+          word_types.push_back(pass.type);
+        }
+      }
+    }
+
+    query_offsets[queries.size()] = found_words.size();
+
+    // group words by chunk
+    std::vector<size_t> chunk_offsets(array.size() + 1, 0);
+    for(size_t i = 0; i < word_chunks.size(); ++i)
+    {
+      ++chunk_offsets[word_chunks[i] + 1];
+    }
+
+    for(size_t chunk_i = 0; chunk_i < array.size(); ++chunk_i)
+    {
+      chunk_offsets[chunk_i + 1] += chunk_offsets[chunk_i];
+    }
+
+    std::vector<size_t> chunk_words(word_chunks.size());
+    for(size_t i = 0; i < word_chunks.size(); ++i)
+    {
+      chunk_words[chunk_offsets[word_chunks[i]]++] = i;
+    }
+
+    // chunk_offsets[chunk_i] is end of chunk words now
+    size_t word_i = 0;
+    for(size_t chunk_i = 0; chunk_i < array.size(); ++chunk_i)
+    {
+      const ChannelChunk* chunk = array[chunk_i];
+      for(; word_i < chunk_offsets[chunk_i]; ++word_i)
+      {
+        FoundWords& found = found_words[chunk_words[word_i]];
+        found.chunk = chunk;
+        found.atom = chunk->find_words(
+          *found.key, word_types[chunk_words[word_i]]);
+      }
+    }
+  }
+
   /*match channels for trigger */
   void ChannelContainer::match(
     const MatchUrls& url_words,
@@ -1264,118 +1339,93 @@ namespace ChannelSvcs
   {
     try
     {
-      ChannelChunkArray_var chunk_array;
-      {
-        ReadGuard_ lock(lock_configuration_);
-        chunk_array = ReferenceCounting::add_ref(chunks_);
-      }
-
-      if(flags & MF_NONSTRICTURL)
-      {
-        match_ns_urls_(
-          url_words,
-          *chunk_array,
-          flags | MF_BLACK_LIST,
-          res);
+      ChannelChunkArray_var chunk_array = chunks_.get();
+      CompiledTriggerIndex_var compiled_index = compiled_index_.get();
+      UrlTriggerAutomaton_var url_automaton = url_automaton_.get();
+
+      match_(
+        url_words,
+        additional_url_words,
+        match_words,
+        additional_url_keywords,
+        exact_words,
+        uid,
+        flags,
+        *chunk_array,
+        compiled_index,
+        url_automaton,
+        nullptr,
+        res);
 
-        match_ns_urls_(
-          additional_url_words,
-          *chunk_array,
-          flags | MF_BLACK_LIST,
-          res);
-      }
-      else
-      {
-        match_urls_(
-          url_words,
-          *chunk_array,
-          flags | MF_BLACK_LIST,
-          res);
+      __gnu_cxx::__atomic_add(&queries_, 1);
+    }
+    catch(const Exception& e)
+    {
+      Stream::Error ostr;
+      ostr << "ChannelContainer::match: Caught Exception: " <<
+        e.what();
+      __gnu_cxx::__atomic_add(&exceptions_, 1);
+      throw Exception(ostr);
+    }
+    catch(const eh::Exception& e)
+    {
+      Stream::Error ostr;
+      ostr << "ChannelContainer::match: Caught eh::Exception: " <<
+        e.what();
+      __gnu_cxx::__atomic_add(&exceptions_, 1);
+      throw Exception(ostr);
+    }
+  }
 
-        match_urls_(
-          additional_url_words,
-          *chunk_array,
-          flags,
-          res);
+  void ChannelContainer::match_batch(
+    const MatchQueryArray& queries,
+    TriggerMatchResArray& res)
+    throw(Exception)
+  {
+    try
+    {
+      ChannelChunkArray_var chunk_array = chunks_.get();
+      CompiledTriggerIndex_var compiled_index = compiled_index_.get();
+      UrlTriggerAutomaton_var url_automaton = url_automaton_.get();
 
-        match_uid_(uid, *chunk_array, res);
-      }
+      FoundWordsArray found_words;
+      std::vector<size_t> query_offsets;
 
-      if(flags & MF_NONSTRICTKW)
+      if(!compiled_index)
       {
-        match_ns_words_(
-          match_words[CT_PAGE],
-          *chunk_array,
-          CT_PAGE,
-          flags | MF_BLACK_LIST,
-          res);
-
-        match_ns_words_(
-          match_words[CT_URL_KEYWORDS],
-          *chunk_array,
-          CT_URL_KEYWORDS,
-          flags | MF_BLACK_LIST,
-          res);
+        find_batch_words_(
+          queries, *chunk_array, found_words, query_offsets);
+      }
 
-        match_ns_words_(
-          additional_url_keywords,
-          *chunk_array,
-          CT_URL_KEYWORDS,
-          flags | MF_BLACK_LIST,
-          res);
+      res.clear();
+      res.resize(queries.size());
 
-        match_ns_words_(
-          match_words[CT_SEARCH],
-          *chunk_array,
-          CT_SEARCH,
-          flags | MF_BLACK_LIST,
-          res);
-      }
-      else
+      for(size_t query_i = 0; query_i < queries.size(); ++query_i)
       {
-        match_words_(
-          match_words[CT_PAGE],
-          match_words[CT_PAGE],
-          *chunk_array,
-          nullptr,
-          CT_PAGE,
-          flags | MF_BLACK_LIST,
-          res);
-
-        match_words_(
-          match_words[CT_URL_KEYWORDS],
-          match_words[CT_URL_KEYWORDS],
-          *chunk_array,
-          nullptr,
-          CT_URL_KEYWORDS,
-          flags | MF_BLACK_LIST,
-          res);
-
-        match_words_(
-          additional_url_keywords,
-          additional_url_keywords,
-          *chunk_array,
-          nullptr,
-          CT_URL_KEYWORDS,
-          flags,
-          res);
-
-        match_words_(
-          match_words[CT_SEARCH],
-          match_words[CT_SEARCH],
+        const MatchQuery& query = queries[query_i];
+
+        match_(
+          query.url_words,
+          query.additional_url_words,
+          query.match_words,
+          query.additional_url_keywords,
+          query.exact_words,
+          query.uid,
+          query.flags,
           *chunk_array,
-          &exact_words,
-          CT_SEARCH,
-          flags | MF_BLACK_LIST,
-          res);
+          compiled_index,
+          url_automaton,
+          compiled_index ? nullptr :
+            found_words.data() + query_offsets[query_i],
+          res[query_i]);
       }
 
-      __gnu_cxx::__atomic_add(&queries_, 1);
+      __gnu_cxx::__atomic_add(&queries_, queries.size());
     }
     catch(const Exception& e)
     {
       Stream::Error ostr;
-      ostr << "ChannelContainer::match: Caught Exception: " <<
+      ostr << "ChannelContainer::match_batch: Caught Exception: " <<
         e.what();
       __gnu_cxx::__atomic_add(&exceptions_, 1);
       throw Exception(ostr);
@@ -1383,13 +1433,150 @@ namespace ChannelSvcs
     catch(const eh::Exception& e)
     {
       Stream::Error ostr;
-      ostr << "ChannelContainer::match: Caught eh::Exception: " <<
+      ostr << "ChannelContainer::match_batch: Caught eh::Exception: " <<
         e.what();
       __gnu_cxx::__atomic_add(&exceptions_, 1);
       throw Exception(ostr);
     }
   }
 
+  void ChannelContainer::match_(
+    const MatchUrls& url_words,
+    const MatchUrls& additional_url_words,
+    const MatchWords match_words[CT_MAX],
+    const MatchWords& additional_url_keywords,
+    const StringVector& exact_words,
+    const Generics::Uuid& uid, 
+    unsigned int flags,
+    const ChannelChunkArray& array,
+    const CompiledTriggerIndex* compiled_index,
+    const UrlTriggerAutomaton* url_automaton,
+    const FoundWords* found_words,
+    TriggerMatchRes& res)
+    throw(Exception)
+  {
+    if(flags & MF_NONSTRICTURL)
+    {
+      match_ns_urls_(
+        url_words,
+        array,
+        url_automaton,
+        flags | MF_BLACK_LIST,
+        res);
+
+      match_ns_urls_(
+        additional_url_words,
+        array,
+        url_automaton,
+        flags | MF_BLACK_LIST,
+        res);
+    }
+    else
+    {
+      match_urls_(
+        url_words,
+        array,
+        url_automaton,
+        flags | MF_BLACK_LIST,
+        res);
+
+      match_urls_(
+        additional_url_words,
+        array,
+        url_automaton,
+        flags,
+        res);
+
+      match_uid_(uid, array, res);
+    }
+
+    if(flags & MF_NONSTRICTKW)
+    {
+      match_ns_words_(
+        match_words[CT_PAGE],
+        array,
+        CT_PAGE,
+        flags | MF_BLACK_LIST,
+        res);
+
+      match_ns_words_(
+        match_words[CT_URL_KEYWORDS],
+        array,
+        CT_URL_KEYWORDS,
+        flags | MF_BLACK_LIST,
+        res);
+
+      match_ns_words_(
+        additional_url_keywords,
+        array,
+        CT_URL_KEYWORDS,
+        flags | MF_BLACK_LIST,
+        res);
+
+      match_ns_words_(
+        match_words[CT_SEARCH],
+        array,
+        CT_SEARCH,
+        flags | MF_BLACK_LIST,
+        res);
+    }
+    else
+    {
+      WordsPass passes[WP_MAX];
+      get_words_passes_(
+        match_words,
+        additional_url_keywords,
+        exact_words,
+        flags,
+        passes);
+
+      for(unsigned int pass_i = 0; pass_i < WP_MAX; ++pass_i)
+      {
+        const WordsPass& pass = passes[pass_i];
+
+        if(compiled_index)
+        {
+          compiled_index->match_words(
+            *pass.words,
+            pass.exact_words,
+            pass.type,
+            pass.flags,
+            res);
+        }
+        else if(found_words)
+        {
+          // triggers of key words was found by find_batch_words_
+          for(size_t word_i = 0; word_i < pass.words->size();
+              ++word_i, ++found_words)
+          {
+            if(found_words->atom)
+            {
+              found_words->chunk->match_words_atom(
+                *found_words->atom,
+                *pass.words,
+                pass.exact_words,
+                pass.type,
+                pass.flags,
+                res,
+                nullptr);
+            }
+          }
+        }
+        else
+        {
+          match_words_(
+            *pass.words,
+            *pass.words,
+            array,
+            pass.exact_words,
+            pass.type,
+            pass.flags,
+            res);
+        }
+      }
+    }
+  }
+
   /*get trigger lists content by id*/
   void ChannelContainer::fill(ChannelMap& buffer) const
     throw(Exception)
@@ -1506,11 +1693,7 @@ namespace ChannelSvcs
       stats_.params[ChannelServerStats::KW_ID_COUNT] = 0;
       stats_.params[ChannelServerStats::URL_ID_COUNT] = 0;
       stats_.params[ChannelServerStats::UID_ID_COUNT] = 0;
-      ChannelChunkArray_var chunk_array;
-      {
-        ReadGuard_ lock(lock_configuration_);
-        chunk_array = ReferenceCounting::add_ref(chunks_);
-      }
+      ChannelChunkArray_var chunk_array = chunks_.get();
       for(unsigned int j = 0; j < count_chunks_; j++)
       {
         (*chunk_array)[j]->accamulate_statistic(stats_);
@@ -1592,8 +1775,10 @@ namespace ChannelSvcs
   {
     try
     {
-      std::string lower_path;
-      std::string lower_query;
+      // per thread buffers: capacity is reused between requests
+      ParseBuffers& buffers = parse_buffers();
+      std::string& lower_path = buffers.lower_path;
+      std::string& lower_query = buffers.lower_query;
       const char* host;
       unsigned long host_len;
       HTTP::HTTPAddress url(lower_refer);//validation should be made by Frontend
@@ -1609,18 +1794,8 @@ namespace ChannelSvcs
       host = url.host().data();
       host_len = url.host().size();
 
-      try
-      {
-        String::AsciiStringManip::to_lower(lower_path);
-        String::AsciiStringManip::to_lower(lower_query);
-      }
-      catch(const eh::Exception& e)
-      {
-        Stream::Error err;
-        err << "Caught exception on executing to_lower for: " << lower_path
-          << "?" << lower_query << ". : " << e.what();
-        throw Exception(err);
-      }
+      ascii_to_lower(&lower_path[0], lower_path.size());
+      ascii_to_lower(&lower_query[0], lower_query.size());
       const char* path = lower_path.c_str();
       const char* query = lower_query.c_str();
       unsigned long path_len = lower_path.size();
@@ -1633,6 +1808,11 @@ namespace ChannelSvcs
       }
 
       bool added_www = false;
+      // prefixes of added urls are substrings of text:
+      //   [www.]host[path], host starts at host_begin
+      const size_t first_url = match_words.size();
+      const size_t host_begin =
+        (host_len < 5 || memcmp(host, "www.", 4) != 0) ? 4 : 0;
       const char* pos;
       size_t count, reserve, path_depth = 1;
       size_t current_sub_pos = 0, count_rep, prev_sub_pos, start_index;
@@ -1663,6 +1843,8 @@ namespace ChannelSvcs
         rcurrent = match_words.rbegin();
         rcurrent->prefix.assign(
           host + current_sub_pos + 1, host_len - current_sub_pos - 1);
+        rcurrent->text_begin = host_begin + current_sub_pos + 1;
+        rcurrent->text_end = host_begin + host_len;
         rcurrent->postfix.reserve(path_len + query_len + 1);
         rcurrent->postfix.push_back('/');
       }
@@ -1678,6 +1860,8 @@ namespace ChannelSvcs
         rcurrent->prefix.reserve(rfrom->prefix.size() + 4);
         rcurrent->prefix.append("www.", 4);
         rcurrent->prefix.append(rfrom->prefix);
+        rcurrent->text_begin = 0;
+        rcurrent->text_end = host_begin + host_len;
         rcurrent->postfix = rfrom->postfix;
       }
 
@@ -1735,6 +1919,9 @@ namespace ChannelSvcs
               current->prefix.append(
                 path + prev_sub_pos,
                 current_sub_pos - prev_sub_pos);
+              current->text_begin = from->text_begin;
+              current->text_end =
+                from->text_end + current_sub_pos - prev_sub_pos;
               ++from;
               ++current;
             }
@@ -1768,6 +1955,21 @@ namespace ChannelSvcs
 
         rcurrent->postfix.push_back('"');
       }
+
+      match_words.texts.resize(match_words.texts.size() + 1);
+      MatchUrlText& url_text = match_words.texts.back();
+      url_text.text.reserve(host_begin + host_len + path_len);
+      if(added_www)
+      {
+        url_text.text.append("www.", 4);
+      }
+      url_text.text.append(host, host_len);
+      if(!soft_matching)
+      {
+        url_text.text.append(path, path_len);
+      }
+      url_text.first_url = first_url;
+      url_text.count_urls = match_words.size() - first_url;
       /*
       std::cout << "reserve = " << reserve << ", size = " << match_words.size() << std::endl;
       for (current = match_words.begin(); current!=match_words.end(); ++current)
@@ -32,8 +32,11 @@
 #include <Logger/Logger.hpp>
 #include <Sync/SyncPolicy.hpp>
 #include <ReferenceCounting/SmartPtr.hpp>
+#include <Commons/SnapshotHolder.hpp>
 #include <ChannelSvcs/ChannelServer/ChannelChunk.hpp>
 #include "ContainerMatchers.hpp"
+#include "CompiledTriggerIndex.hpp"
+#include "UrlTriggerAutomaton.hpp"
 
 namespace AdServer
 {
@@ -58,8 +61,6 @@ namespace ChannelSvcs
   template<typename T>
   typename T::first_type get_first(const T& pair) throw() { return pair.first;}
 
-  typedef std::vector<MatchUrl> MatchUrls;
-
   struct UnmergedKey
   {
     UnmergedKey(unsigned short lang_value, const std::string& p_trigger) throw()
@@ -245,8 +246,13 @@ namespace ChannelSvcs
 
     virtual ~ChannelContainer() throw(){};
 
-    /* argument - count local chunks in container */
-    ChannelContainer(unsigned long count_chunks = 1, bool nonstrict = false)
+    /* argument - count local chunks in container,
+     * compiled_matching - match keywords with CompiledTriggerIndex and
+     * urls with UrlTriggerAutomaton, both are rebuilt after each merge */
+    ChannelContainer(
+      unsigned long count_chunks = 1,
+      bool nonstrict = false,
+      bool compiled_matching = false)
       throw(Exception);
 
     /* create chunks in container*/
@@ -293,6 +299,36 @@ namespace ChannelSvcs
       TriggerMatchRes& res)
       throw(Exception);
 
+    /* parsed query of batch matching, arguments of match.
+     * MatchWords refer to own memory: query is filled in place */
+    struct MatchQuery
+    {
+      MatchQuery() throw() : flags(0) {}
+
+      // reset for next query, capacity of words is kept
+      void
+      clear() throw();
+
+      MatchUrls url_words;
+      MatchUrls additional_url_words;
+      MatchWords match_words[CT_MAX];
+      MatchWords additional_url_keywords;
+      StringVector exact_words;
+      Generics::Uuid uid;
+      unsigned int flags;
+    };
+
+    typedef std::vector<MatchQuery> MatchQueryArray;
+    typedef std::vector<TriggerMatchRes> TriggerMatchResArray;
+
+    /* match channels for queries with one configuration,
+     * res[i] is equal to result of match for queries[i].
+     * strict key words of all queries are searched grouped by chunk */
+    void match_batch(
+      const MatchQueryArray& queries,
+      TriggerMatchResArray& res)
+      throw(Exception);
+
     /*get trigger lists content by id*/
     void fill(ChannelMap& buffer) const
       throw(Exception);
@@ -431,6 +467,68 @@ namespace ChannelSvcs
       const String::SubString& key_word)
       throw();
 
+    /* key words pass of strict matching */
+    struct WordsPass
+    {
+      const MatchWords* words;
+      const StringVector* exact_words;
+      MatchType type;
+      unsigned int flags;
+    };
+
+    enum
+    {
+      WP_PAGE = 0,
+      WP_URL_KEYWORDS,
+      WP_ADDITIONAL_URL_KEYWORDS,
+      WP_SEARCH,
+      WP_MAX
+    };
+
+    /* key word of batch matching: triggers found in chunk */
+    struct FoundWords
+    {
+      const Generics::SubStringHashAdapter* key;
+      const ChannelChunk* chunk;
+      const TriggerAtom* atom;
+    };
+
+    typedef std::vector<FoundWords> FoundWordsArray;
+
+    static void
+    get_words_passes_(
+      const MatchWords match_words[CT_MAX],
+      const MatchWords& additional_url_keywords,
+      const StringVector& exact_words,
+      unsigned int flags,
+      WordsPass passes[WP_MAX])
+      throw();
+
+    void
+    find_batch_words_(
+      const MatchQueryArray& queries,
+      const ChannelChunkArray& array,
+      FoundWordsArray& found_words,
+      std::vector<size_t>& query_offsets) const
+      throw(eh::Exception);
+
+    /* match one query with configuration snapshot,
+     * found_words - result of find_batch_words_ for query or null */
+    void match_(
+      const MatchUrls& url_words,
+      const MatchUrls& additional_url_words,
+      const MatchWords match_words[CT_MAX],
+      const MatchWords& additional_url_keywords,
+      const StringVector& exact_words,
+      const Generics::Uuid& uid,
+      unsigned int flags,
+      const ChannelChunkArray& array,
+      const CompiledTriggerIndex* compiled_index,
+      const UrlTriggerAutomaton* url_automaton,
+      const FoundWords* found_words,
+      TriggerMatchRes& res)
+      throw(Exception);
+
     /* match uid*/
     void match_uid_(
       const Generics::Uuid& uid, 
@@ -442,6 +540,7 @@ namespace ChannelSvcs
     void match_urls_(
       const MatchUrls& urls,
       const ChannelChunkArray& array,
+      const UrlTriggerAutomaton* url_automaton,
       unsigned int flags,
       TriggerMatchRes& res)
       throw(Exception);
@@ -450,6 +549,7 @@ namespace ChannelSvcs
     void match_ns_urls_(
       const MatchUrls& urls,
       const ChannelChunkArray& array,
+      const UrlTriggerAutomaton* url_automaton,
       unsigned int flags,
       TriggerMatchRes& res)
       throw(Exception);
@@ -496,7 +596,7 @@ namespace ChannelSvcs
       const LexemesPtrVector& lexemes) const
       throw();
 
-    ChannelMatchInfo* get_rules_() const
+    static ChannelMatchInfo* get_rules_(const ChannelChunkArray& array)
       throw();
 
   protected:
@@ -510,12 +610,16 @@ namespace ChannelSvcs
 
     static const char* ASPECT;
   private:
-    mutable Mutex_ lock_configuration_;
     mutable Sync::PosixMutex lock_statistic_;
     mutable Mutex_ lock_update_data_;
     mutable Mutex_ lock_ns_map_;
     const unsigned long count_chunks_;
-    ChannelChunkArray_var chunks_;//chunks
+    // configuration is read by each match without lock
+    AdServer::Commons::SnapshotHolder<ChannelChunkArray> chunks_;//chunks
+    //compiled keywords of chunks_
+    AdServer::Commons::SnapshotHolder<CompiledTriggerIndex> compiled_index_;
+    //compiled urls of chunks_
+    AdServer::Commons::SnapshotHolder<UrlTriggerAutomaton> url_automaton_;
     NSTriggerMapType ns_trigger_map_;//map triggers to NSTriggerAtom
     NSUrlMapType ns_url_map_;//map domain name to vector of matchers
     CCGMap_var ccgs_;
@@ -524,6 +628,7 @@ namespace ChannelSvcs
     Generics::Time start_update_;
     Generics::Time max_update_;
     bool non_strict_;
+    const bool compiled_matching_;
 
     ChannelServerStats stats_;
     volatile _Atomic_word queries_;
@@ -576,10 +681,25 @@ namespace AdServer
 
 
   inline
-  ChannelMatchInfo* ChannelContainer::get_rules_() const
+  ChannelMatchInfo* ChannelContainer::get_rules_(
+    const ChannelChunkArray& array)
     throw()
   {
-    return (*chunks_->rbegin())->get_info_ptr();
+    return (*array.rbegin())->get_info_ptr();
+  }
+
+  inline
+  void ChannelContainer::MatchQuery::clear() throw()
+  {
+    url_words.clear();
+    additional_url_words.clear();
+    for(unsigned int i = 0; i < CT_MAX; ++i)
+    {
+      match_words[i].clear();
+    }
+    additional_url_keywords.clear();
+    exact_words.clear();
+    flags = 0;
   }
 
   inline
@@ -633,19 +753,15 @@ namespace AdServer
   ChannelMatchInfo_var ChannelContainer::get_active() const
     throw()
   {
-    ReadGuard_ lock(lock_configuration_);
-    return ReferenceCounting::add_ref(get_rules_());
+    ChannelChunkArray_var chunk_array = chunks_.get();
+    return ReferenceCounting::add_ref(get_rules_(*chunk_array));
   }
 
   inline
   void ChannelContainer::terminate() throw()
   {
     terminated_ = true;
-    ChannelChunkArray_var chunk_array;
-    {
-      ReadGuard_ lock(lock_configuration_);
-      chunk_array = ReferenceCounting::add_ref(chunks_);
-    }
+    ChannelChunkArray_var chunk_array = chunks_.get();
     for (ChannelChunkArray::const_iterator it(chunk_array->begin());
       it != chunk_array->end(); ++it)
     {
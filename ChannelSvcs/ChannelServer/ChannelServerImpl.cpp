@@ -118,7 +118,8 @@ namespace ChannelSvcs
       merge_limit_(server_config->merge_size() * 1024 * 1024),
       container_(new ChannelContainer(
           count_container_chunks_,
-          server_config->MatchOptions().nonstrict())),
+          server_config->MatchOptions().nonstrict(),
+          server_config->MatchOptions().compiled_matching())),
       queries_counter_(0)
   {
     try
@@ -985,6 +986,66 @@ namespace ChannelSvcs
     return count_chunks_;
   }
 
+  void ChannelServerCustomImpl::parse_query_(
+    const ::AdServer::ChannelSvcs::ChannelServerBase::MatchQuery& query,
+    ChannelContainer::MatchQuery& parsed)
+    throw(eh::Exception)
+  {
+    static MatchBreakSeparators separators;
+
+    parsed.uid = CorbaAlgs::unpack_user_id(query.uid);
+    parsed.flags =
+      (query.non_strict_word_match ? MF_NONSTRICTKW : MF_NONE) |
+      (query.non_strict_url_match ? MF_NONSTRICTURL : MF_NONE) |
+      (query.return_negative ? MF_NEGATIVE : MF_NONE) |
+      (query.statuses[0] == 'A' ||
+       query.statuses[1] == 'A' ? MF_ACTIVE : MF_NONE) |
+      (query.statuses[0] == 'I' ||
+       query.statuses[1] == 'I' ? MF_INACTIVE : MF_NONE);
+
+    //parsing urls
+    ChannelContainer::match_parse_urls(
+      String::SubString(query.first_url),
+      String::SubString(query.first_url_words),
+      ports_,
+      query.non_strict_url_match,
+      parsed.url_words,
+      parsed.match_words[CT_URL_KEYWORDS],
+      logger(),
+      segmentor_);
+    ChannelContainer::match_parse_urls(
+      String::SubString(query.urls),
+      String::SubString(query.urls_words),
+      ports_,
+      query.non_strict_url_match,
+      parsed.additional_url_words,
+      parsed.additional_url_keywords,
+      logger(),
+      segmentor_);
+
+    const bool non_strict_kw = parsed.flags & MF_NONSTRICTKW;
+    parse_keywords(
+      String::SubString(query.swords),
+      parsed.match_words[CT_SEARCH],
+      non_strict_kw ? PM_SIMPLIFY : PM_NO_SIMPLIFY,
+      non_strict_kw ? nullptr : &separators,
+      non_strict_kw ? 1 : Commons::DEFAULT_MAX_HARD_WORD_SEQ,
+      &parsed.exact_words,//exact match
+      non_strict_kw ? segmentor_ : 0);
+    parse_keywords(
+      String::SubString(query.pwords),
+      parsed.match_words[CT_PAGE],
+      (query.simplify_page || non_strict_kw) ?
+      PM_SIMPLIFY : PM_NO_SIMPLIFY,
+      non_strict_kw ? nullptr : &separators,
+      non_strict_kw ? 1 : Commons::DEFAULT_MAX_HARD_WORD_SEQ,
+      0,//exact match
+      (query.simplify_page || non_strict_kw ? segmentor_ : 0));
+
+    parsed.match_words[CT_URL_KEYWORDS].insert(
+      parsed.exact_words.begin(), parsed.exact_words.end());
+  }
+
   //
   // IDL:AdServer/ChannelSvcs/ChannelServer/match:1.0
   //
@@ -996,8 +1057,10 @@ namespace ChannelSvcs
   {
     try
     {
+      const Generics::Time deadline = CorbaAlgs::unpack_time_budget(
+        query.time_budget,
+        Generics::Time::get_time_of_day());
       Generics::Timer timer;
-      static MatchBreakSeparators separators;
       timer.start();
       result = new ::AdServer::ChannelSvcs::ChannelServer::MatchResult;
       if(state_ == UpdateData::US_ZERO)
@@ -1007,84 +1070,39 @@ namespace ChannelSvcs
       }
       std::unique_ptr<std::ostringstream> logstr;
       TriggerMatchRes res;
-      const Generics::Uuid uid = CorbaAlgs::unpack_user_id(query.uid);
+      // words of thread previous query are cleared, their memory is reused
+      static thread_local ChannelContainer::MatchQuery parsed;
+      parsed.clear();
+      parse_query_(query, parsed);
       if (statistic_logger_)
       {
         logstr.reset(new std::ostringstream);
         *logstr << query.request_id << "::u:" <<  query.urls
           << "::p:" <<  query.pwords
           << "::s:" <<  query.swords
-          << "::U:" <<  uid.to_string(false);
+          << "::U:" <<  parsed.uid.to_string(false);
+      }
+
+      // caller time budget expired: result will be ignored
+      if(!CorbaAlgs::deadline_reached(
+           deadline, Generics::Time::get_time_of_day()))
+      {
+        container_->match(
+          parsed.url_words,
+          parsed.additional_url_words,
+          parsed.match_words,
+          parsed.additional_url_keywords,
+          parsed.exact_words,
+          parsed.uid,
+          parsed.flags,
+          res);
       }
-      unsigned int match_flags =
-        (query.non_strict_word_match ? MF_NONSTRICTKW : MF_NONE) |
-        (query.non_strict_url_match ? MF_NONSTRICTURL : MF_NONE) |
-        (query.return_negative ? MF_NEGATIVE : MF_NONE) |
-        (query.statuses[0] == 'A' ||
-         query.statuses[1] == 'A' ? MF_ACTIVE : MF_NONE) |
-        (query.statuses[0] == 'I' ||
-         query.statuses[1] == 'I' ? MF_INACTIVE : MF_NONE);
-
-      AdServer::ChannelSvcs::MatchWords phrases[CT_MAX];
-      AdServer::ChannelSvcs::MatchWords additional_url_keywords;
-      MatchUrls url_words, additional_url_words;
-      //parsing urls
-      ChannelContainer::match_parse_urls(
-        String::SubString(query.first_url),
-        String::SubString(query.first_url_words),
-        ports_,
-        query.non_strict_url_match,
-        url_words,
-        phrases[CT_URL_KEYWORDS],
-        logger(),
-        segmentor_);
-      ChannelContainer::match_parse_urls(
-        String::SubString(query.urls),
-        String::SubString(query.urls_words),
-        ports_,
-        query.non_strict_url_match,
-        additional_url_words,
-        additional_url_keywords,
-        logger(),
-        segmentor_);
-
-      StringVector exact_phrases;
-      parse_keywords(
-        String::SubString(query.swords),
-        phrases[CT_SEARCH],
-        match_flags & MF_NONSTRICTKW ? PM_SIMPLIFY : PM_NO_SIMPLIFY,
-        match_flags & MF_NONSTRICTKW ? nullptr : &separators,
-        match_flags & MF_NONSTRICTKW ? 1 : Commons::DEFAULT_MAX_HARD_WORD_SEQ,
-        &exact_phrases,//exact match
-        match_flags & MF_NONSTRICTKW ? segmentor_ : 0);
-      parse_keywords(
-        String::SubString(query.pwords),
-        phrases[CT_PAGE],
-        (query.simplify_page || match_flags & MF_NONSTRICTKW) ?
-        PM_SIMPLIFY : PM_NO_SIMPLIFY,
-        match_flags & MF_NONSTRICTKW ? nullptr : &separators,
-        match_flags & MF_NONSTRICTKW ? 1 : Commons::DEFAULT_MAX_HARD_WORD_SEQ,
-        0,//exact match
-        (query.simplify_page || match_flags & MF_NONSTRICTKW ?
-         segmentor_ : 0));
-
-      phrases[CT_URL_KEYWORDS].insert(
-        exact_phrases.begin(), exact_phrases.end());
-
-      container_->match(
-        url_words,
-        additional_url_words,
-        phrases,
-        additional_url_keywords,
-        exact_phrases,
-        uid,
-        match_flags,
-        res);
       fill_result_(res, *result, query.fill_content);
       timer.stop();
       if (statistic_logger_)
       {
-        log_parsed_input_(url_words, phrases, exact_phrases, *logstr);
+        log_parsed_input_(
+          parsed.url_words, parsed.match_words, parsed.exact_words, *logstr);
         log_result_(res, timer.elapsed_time(), *logstr);
         statistic_logger_->log(logstr->str(), Logging::Logger::DEBUG, ASPECT);
       }
@@ -1121,6 +1139,104 @@ namespace ChannelSvcs
     }
   }
 
+  //
+  // IDL:AdServer/ChannelSvcs/ChannelServer/match_batch:1.0
+  //
+  void ChannelServerCustomImpl::match_batch(
+      const ::AdServer::ChannelSvcs::ChannelServer::MatchQuerySeq& queries,
+      ::AdServer::ChannelSvcs::ChannelServer::MatchResultSeq_out results)
+      throw(AdServer::ChannelSvcs::ImplementationException,
+            AdServer::ChannelSvcs::NotConfigured)
+  {
+    try
+    {
+      Generics::Timer timer;
+      timer.start();
+      results = new ::AdServer::ChannelSvcs::ChannelServer::MatchResultSeq;
+      if(state_ == UpdateData::US_ZERO)
+      {
+        throw AdServer::ChannelSvcs::NotConfigured(
+          "Source chunks wasn't setted for server yet");
+      }
+
+      // queries are parsed in place: MatchWords refer to own memory
+      ChannelContainer::MatchQueryArray parsed(queries.length());
+      for(CORBA::ULong i = 0; i < queries.length(); ++i)
+      {
+        parse_query_(queries[i], parsed[i]);
+      }
+
+      ChannelContainer::TriggerMatchResArray res;
+      container_->match_batch(parsed, res);
+
+      results->length(queries.length());
+      for(CORBA::ULong i = 0; i < queries.length(); ++i)
+      {
+        fill_result_(res[i], (*results)[i], queries[i].fill_content);
+      }
+      timer.stop();
+
+      // match time of batch is divided between queries
+      const Generics::Time match_time = queries.length() ?
+        timer.elapsed_time() / queries.length() : Generics::Time::ZERO;
+      for(CORBA::ULong i = 0; i < queries.length(); ++i)
+      {
+        (*results)[i].match_time = CorbaAlgs::pack_time(match_time);
+      }
+
+      if (statistic_logger_)
+      {
+        for(CORBA::ULong i = 0; i < queries.length(); ++i)
+        {
+          const ::AdServer::ChannelSvcs::ChannelServerBase::MatchQuery&
+            query = queries[i];
+          std::ostringstream logstr;
+          logstr << query.request_id << "::u:" <<  query.urls
+            << "::p:" <<  query.pwords
+            << "::s:" <<  query.swords
+            << "::U:" <<  parsed[i].uid.to_string(false);
+          log_parsed_input_(
+            parsed[i].url_words,
+            parsed[i].match_words,
+            parsed[i].exact_words,
+            logstr);
+          log_result_(res[i], match_time, logstr);
+          statistic_logger_->log(logstr.str(), Logging::Logger::DEBUG, ASPECT);
+        }
+      }
+
+      __gnu_cxx::__atomic_add(&queries_counter_, queries.length());
+    }
+    catch(const ChannelContainer::Exception& e)
+    {
+      Stream::Error ostr;
+      ostr << "ChannelServerCustomImpl::match_batch: Caught "
+        "ChannelContainer::Exception : " << e.what();
+      logger()->log(
+          ostr.str(),
+          Logging::Logger::ERROR,
+          ASPECT,
+          "ADS-IMPL-43");
+      CORBACommons::throw_desc<
+        ChannelSvcs::ImplementationException>(
+          ostr.str());
+    }
+    catch(const eh::Exception& e)
+    {
+      Stream::Error ostr;
+      ostr << "ChannelServerCustomImpl::match_batch: Caught eh::Exception "
+        ": " << e.what();
+      logger()->log(
+        ostr.str(),
+        Logging::Logger::ERROR,
+        ASPECT,
+        "ADS-IMPL-43");
+      CORBACommons::throw_desc<
+        ChannelSvcs::ImplementationException>(
+          ostr.str());
+    }
+  }
+
   struct comp_string_ptr
   {
     bool operator() (const char* lhs, const char* rhs) const
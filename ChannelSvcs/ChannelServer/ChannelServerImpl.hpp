@@ -92,6 +92,15 @@ namespace ChannelSvcs
         throw(AdServer::ChannelSvcs::ImplementationException,
               AdServer::ChannelSvcs::NotConfigured);
 
+    //
+    // IDL:AdServer/ChannelSvcs/ChannelServer/match_batch:1.0
+    //
+    virtual void match_batch(
+        const ::AdServer::ChannelSvcs::ChannelServer::MatchQuerySeq& queries,
+        ::AdServer::ChannelSvcs::ChannelServer::MatchResultSeq_out results)
+        throw(AdServer::ChannelSvcs::ImplementationException,
+              AdServer::ChannelSvcs::NotConfigured);
+
     //
     // IDL:AdServer/ChannelSvcs/ChannelServer/match:1.0
     //
@@ -249,6 +258,12 @@ namespace ChannelSvcs
       AdServer::ChannelSvcs::ChannelServerBase::ChannelAtom* out)
       throw();
 
+    /* fill parsed query in place, it keeps parsed words */
+    void parse_query_(
+      const ::AdServer::ChannelSvcs::ChannelServerBase::MatchQuery& query,
+      ChannelContainer::MatchQuery& parsed)
+      throw(eh::Exception);
+
     void fill_result_(
       const TriggerMatchRes& result,
       AdServer::ChannelSvcs::ChannelServer::MatchResult& res,
@@ -0,0 +1,407 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include "CompiledTriggerIndex.hpp"
+
+namespace AdServer
+{
+namespace ChannelSvcs
+{
+  namespace
+  {
+    const MatchType COMPILED_TYPES[] = { CT_PAGE, CT_SEARCH, CT_URL_KEYWORDS };
+    const char COMPILED_TRIGGER_TYPES[] = { 'P', 'S', 'R' };
+  }
+
+  const CompiledTriggerIndex::TokenId CompiledTriggerIndex::INVALID_TOKEN;
+
+  CompiledTriggerIndex::CompiledTriggerIndex(ChannelChunkArray* chunks)
+    throw(eh::Exception)
+    : chunks_(ReferenceCounting::add_ref(chunks)),
+      count_states_(0)
+  {
+    const size_t COMPILED_TYPES_SIZE =
+      sizeof(COMPILED_TYPES) / sizeof(COMPILED_TYPES[0]);
+
+    KeyStateVector key_states[COMPILED_TYPES_SIZE];
+    LexemeSlots lexeme_slots;
+
+    infos_.reserve(chunks_->size());
+
+    for(ChannelChunkArray::const_iterator chunk_it = chunks_->begin();
+        chunk_it != chunks_->end(); ++chunk_it)
+    {
+      const ChannelChunk& chunk = **chunk_it;
+      const uint32_t info_index = infos_.size();
+      infos_.push_back(chunk.match_info_ptr_.in());
+
+      for(size_t type_i = 0; type_i < COMPILED_TYPES_SIZE; ++type_i)
+      {
+        const TriggerMap& trigger_map =
+          chunk.get_trigger_map_(COMPILED_TYPES[type_i]);
+
+        for(TriggerMap::const_iterator map_it = trigger_map.begin();
+            map_it != trigger_map.end(); ++map_it)
+        {
+          const SoftVector& soft_vector = *map_it->second;
+          const TokenId key = add_token_(map_it->first);
+
+          for(SoftVector::const_iterator it = soft_vector.begin();
+              it != soft_vector.end(); ++it)
+          {
+            if(it->matcher->trigger_type() != COMPILED_TRIGGER_TYPES[type_i])
+            {
+              continue;
+            }
+
+            KeyState key_state;
+            key_state.key = key;
+            key_state.state.entity = &*it;
+            key_state.state.info_index = info_index;
+            compile_matcher_(*it->matcher, key_state.state, lexeme_slots);
+            key_states[type_i].push_back(key_state);
+          }
+        }
+      }
+    }
+
+    for(size_t type_i = 0; type_i < COMPILED_TYPES_SIZE; ++type_i)
+    {
+      build_transitions_(
+        key_states[type_i],
+        tokens_.size(),
+        transitions_[COMPILED_TYPES[type_i]]);
+      count_states_ += key_states[type_i].size();
+    }
+
+    std::vector<Slot>(slots_).swap(slots_);
+    TokenIdVector(alternatives_).swap(alternatives_);
+  }
+
+  CompiledTriggerIndex::TokenId
+  CompiledTriggerIndex::add_token_(
+    const Generics::SubStringHashAdapter& word)
+    throw(eh::Exception)
+  {
+    // word memory is owned by matchers of chunks_
+    TokenMap::const_iterator it = tokens_.find(word);
+
+    if(it != tokens_.end())
+    {
+      return it->second;
+    }
+
+    const TokenId id = tokens_.size();
+    tokens_.insert(std::make_pair(word, id));
+    return id;
+  }
+
+  CompiledTriggerIndex::TokenId
+  CompiledTriggerIndex::find_token_(
+    const Generics::SubStringHashAdapter& word) const
+    throw()
+  {
+    TokenMap::const_iterator it = tokens_.find(word);
+    return it != tokens_.end() ? it->second : INVALID_TOKEN;
+  }
+
+  CompiledTriggerIndex::Slot
+  CompiledTriggerIndex::add_slot_(
+    const Generics::SubStringHashAdapter& word)
+    throw(eh::Exception)
+  {
+    Slot slot;
+    slot.begin = alternatives_.size();
+    alternatives_.push_back(add_token_(word));
+    slot.end = alternatives_.size();
+    return slot;
+  }
+
+  CompiledTriggerIndex::Slot
+  CompiledTriggerIndex::add_slot_(
+    const Lexeme* lexeme,
+    LexemeSlots& lexeme_slots)
+    throw(eh::Exception)
+  {
+    if(!lexeme)
+    {//empty slot, can't be matched
+      Slot slot;
+      slot.begin = slot.end = alternatives_.size();
+      return slot;
+    }
+
+    // forms of lexeme are shared by all triggers that contain it
+    LexemeSlots::const_iterator it = lexeme_slots.find(lexeme);
+
+    if(it != lexeme_slots.end())
+    {
+      return it->second;
+    }
+
+    Slot slot;
+    slot.begin = alternatives_.size();
+    for(LexemeData::Forms::const_iterator form_it = lexeme->forms.begin();
+        form_it != lexeme->forms.end(); ++form_it)
+    {
+      alternatives_.push_back(add_token_(*form_it));
+    }
+    slot.end = alternatives_.size();
+    lexeme_slots.insert(std::make_pair(lexeme, slot));
+    return slot;
+  }
+
+  void
+  CompiledTriggerIndex::compile_matcher_(
+    const SoftMatcher& matcher,
+    State& state,
+    LexemeSlots& lexeme_slots)
+    throw(eh::Exception)
+  {
+    const SoftMatcher::SubHashVector& simple_words = matcher.simple_words();
+    const LexemesPtrVector& lexemes = matcher.lexemes();
+
+    state.flags = (matcher.negative() ? SF_NEGATIVE : 0);
+    state.slots_begin = slots_.size();
+
+    if(matcher.exact())
+    {//slot for each position of trigger, see SoftMatcher::match_exact
+      state.flags |= SF_EXACT;
+
+      for(size_t i = 0; i < simple_words.size(); ++i)
+      {
+        if(i < lexemes.size() && lexemes[i])
+        {
+          slots_.push_back(add_slot_(lexemes[i].in(), lexeme_slots));
+        }
+        else
+        {
+          slots_.push_back(add_slot_(simple_words[i]));
+        }
+      }
+    }
+    else
+    {//slot for each word except key word, see SoftMatcher::match
+      for(SoftMatcher::SubHashVector::const_iterator it =
+            simple_words.begin();
+          it != simple_words.end(); ++it)
+      {
+        slots_.push_back(add_slot_(*it));
+      }
+
+      for(LexemesPtrVector::const_iterator it = lexemes.begin();
+          it != lexemes.end(); ++it)
+      {
+        slots_.push_back(add_slot_(it->in(), lexeme_slots));
+      }
+    }
+
+    state.slots_end = slots_.size();
+  }
+
+  void
+  CompiledTriggerIndex::build_transitions_(
+    const KeyStateVector& key_states,
+    size_t count_tokens,
+    Transitions& transitions)
+    throw(eh::Exception)
+  {
+    // counting sort by key token, keeps order of states inside key
+    transitions.offsets.assign(count_tokens + 1, 0);
+
+    for(KeyStateVector::const_iterator it = key_states.begin();
+        it != key_states.end(); ++it)
+    {
+      ++transitions.offsets[it->key + 1];
+    }
+
+    for(size_t i = 1; i < transitions.offsets.size(); ++i)
+    {
+      transitions.offsets[i] += transitions.offsets[i - 1];
+    }
+
+    std::vector<uint32_t> positions(
+      transitions.offsets.begin(), transitions.offsets.end() - 1);
+
+    transitions.states.resize(key_states.size());
+
+    for(KeyStateVector::const_iterator it = key_states.begin();
+        it != key_states.end(); ++it)
+    {
+      transitions.states[positions[it->key]++] = it->state;
+    }
+  }
+
+  bool
+  CompiledTriggerIndex::match_state_(
+    const State& state,
+    const TokenIdVector& present) const
+    throw()
+  {
+    for(uint32_t slot_i = state.slots_begin; slot_i < state.slots_end; ++slot_i)
+    {
+      const Slot& slot = slots_[slot_i];
+      bool match = false;
+
+      for(uint32_t alt_i = slot.begin; alt_i < slot.end; ++alt_i)
+      {
+        if(std::binary_search(
+             present.begin(), present.end(), alternatives_[alt_i]))
+        {
+          match = true;
+          break;
+        }
+      }
+
+      if(!match)
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool
+  CompiledTriggerIndex::match_exact_state_(
+    const State& state,
+    const TokenIdVector& exact) const
+    throw()
+  {
+    if(state.slots_end - state.slots_begin != exact.size())
+    {
+      return false;
+    }
+
+    TokenIdVector::const_iterator word_it = exact.begin();
+
+    for(uint32_t slot_i = state.slots_begin;
+        slot_i < state.slots_end; ++slot_i, ++word_it)
+    {
+      const Slot& slot = slots_[slot_i];
+
+      if(std::find(
+           alternatives_.begin() + slot.begin,
+           alternatives_.begin() + slot.end,
+           *word_it) == alternatives_.begin() + slot.end)
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  void
+  CompiledTriggerIndex::match_words(
+    const MatchWords& words,
+    const StringVector* exact_words,
+    MatchType type,
+    unsigned int flags,
+    TriggerMatchRes& res) const
+    throw(eh::Exception)
+  {
+    const Transitions& transitions = transitions_[type];
+
+    if(transitions.states.empty() || words.empty())
+    {
+      return;
+    }
+
+    // request words as key tokens (in order of words) and sorted set
+    TokenIdVector keys;
+    TokenIdVector present;
+    keys.reserve(words.size());
+
+    for(MatchWords::const_iterator it = words.begin(); it != words.end(); ++it)
+    {
+      const TokenId id = find_token_(*it);
+      keys.push_back(id);
+      if(id != INVALID_TOKEN)
+      {
+        present.push_back(id);
+      }
+    }
+
+    std::sort(present.begin(), present.end());
+
+    TokenIdVector exact;
+    if(exact_words)
+    {
+      exact.reserve(exact_words->size());
+      for(StringVector::const_iterator it = exact_words->begin();
+          it != exact_words->end(); ++it)
+      {
+        exact.push_back(find_token_(
+          Generics::SubStringHashAdapter(String::SubString(*it))));
+      }
+    }
+
+    for(TokenIdVector::const_iterator key_it = keys.begin();
+        key_it != keys.end(); ++key_it)
+    {
+      if(*key_it == INVALID_TOKEN)
+      {
+        continue;
+      }
+
+      for(uint32_t state_i = transitions.offsets[*key_it];
+          state_i < transitions.offsets[*key_it + 1]; ++state_i)
+      {
+        const State& state = transitions.states[state_i];
+        bool match = !(state.flags & SF_EXACT) && match_state_(state, present);
+
+        if(exact_words && !match && (state.flags & SF_EXACT))
+        {
+          match = match_exact_state_(state, exact);
+        }
+
+        if(match)
+        {
+          res.count_channels[type] += ChannelChunk::match_cell_(
+            *infos_[state.info_index],
+            *state.entity,
+            type,
+            flags,
+            res,
+            (flags & MF_NEGATIVE ? false : (state.flags & SF_NEGATIVE) != 0));
+        }
+      }
+    }
+  }
+
+  size_t CompiledTriggerIndex::memory_size() const throw()
+  {
+    size_t res = sizeof(CompiledTriggerIndex) +
+      infos_.capacity() * sizeof(const ChannelMatchInfo*) +
+      tokens_.size() * (sizeof(Generics::SubStringHashAdapter) + sizeof(TokenId)) +
+      alternatives_.capacity() * sizeof(TokenId) +
+      slots_.capacity() * sizeof(Slot);
+
+    for(size_t i = 0; i < CT_MAX; ++i)
+    {
+      res += transitions_[i].offsets.capacity() * sizeof(uint32_t) +
+        transitions_[i].states.capacity() * sizeof(State);
+    }
+
+    return res;
+  }
+}
+}
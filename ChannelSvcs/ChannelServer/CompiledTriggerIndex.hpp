@@ -0,0 +1,195 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AD_SERVER_COMPILED_TRIGGER_INDEX_HPP_
+#define AD_SERVER_COMPILED_TRIGGER_INDEX_HPP_
+
+#include <map>
+#include <vector>
+#include <stdint.h>
+#include <eh/Exception.hpp>
+#include <Generics/GnuHashTable.hpp>
+#include <Generics/HashTableAdapters.hpp>
+#include <ReferenceCounting/AtomicImpl.hpp>
+#include <ReferenceCounting/SmartPtr.hpp>
+#include <ChannelSvcs/ChannelCommons/CommonTypes.hpp>
+#include "ChannelChunk.hpp"
+
+namespace AdServer
+{
+namespace ChannelSvcs
+{
+  /* CompiledTriggerIndex is read only representation of keyword triggers
+   * of chunks array. It is built once after merge and replaced as whole:
+   * words of triggers are interned into token ids, every trigger is
+   * compiled into state with contiguous list of slots (set of token ids
+   * any of which satisfies slot) and states are grouped by key token.
+   * Matching gives same result as ChannelChunk::match_words for strict
+   * keyword matching, but don't touch SoftMatcher and Lexeme objects.
+   * Index holds chunks array: states refer to its MatchingEntity items
+   * and tokens refer to memory of its matchers.
+   */
+  class CompiledTriggerIndex: public ReferenceCounting::AtomicImpl
+  {
+  public:
+    explicit
+    CompiledTriggerIndex(ChannelChunkArray* chunks)
+      throw(eh::Exception);
+
+    /* match words for triggers of type,
+     * equal to ChannelChunk::match_words for each word from words
+     * without non strict matching */
+    void match_words(
+      const MatchWords& words,
+      const StringVector* exact_words,
+      MatchType type,
+      unsigned int flags,
+      TriggerMatchRes& res) const
+      throw(eh::Exception);
+
+    /* count of compiled triggers */
+    size_t size() const throw();
+
+    size_t memory_size() const throw();
+
+  protected:
+    virtual
+    ~CompiledTriggerIndex() throw ()
+    {
+    }
+
+  private:
+    typedef uint32_t TokenId;
+    typedef std::vector<TokenId> TokenIdVector;
+
+    typedef Generics::GnuHashTable<
+      Generics::SubStringHashAdapter, TokenId>
+      TokenMap;
+
+    static const TokenId INVALID_TOKEN = ~static_cast<TokenId>(0);
+
+    enum StateFlags
+    {
+      SF_EXACT = 1,
+      SF_NEGATIVE = 2
+    };
+
+    /* range in alternatives_ */
+    struct Slot
+    {
+      uint32_t begin;
+      uint32_t end;
+    };
+
+    struct State
+    {
+      const MatchingEntity* entity;
+      uint32_t slots_begin;
+      uint32_t slots_end;
+      uint32_t info_index;
+      uint32_t flags;
+    };
+
+    typedef std::vector<State> StateVector;
+
+    /* states of one match type grouped by key token:
+     * states of token are [offsets[id], offsets[id + 1]) */
+    struct Transitions
+    {
+      std::vector<uint32_t> offsets;
+      StateVector states;
+    };
+
+    struct KeyState
+    {
+      TokenId key;
+      State state;
+    };
+
+    typedef std::vector<KeyState> KeyStateVector;
+    typedef std::map<const Lexeme*, Slot> LexemeSlots;
+
+  private:
+    TokenId
+    add_token_(const Generics::SubStringHashAdapter& word)
+      throw(eh::Exception);
+
+    TokenId
+    find_token_(const Generics::SubStringHashAdapter& word) const
+      throw();
+
+    Slot
+    add_slot_(const Generics::SubStringHashAdapter& word)
+      throw(eh::Exception);
+
+    Slot
+    add_slot_(const Lexeme* lexeme, LexemeSlots& lexeme_slots)
+      throw(eh::Exception);
+
+    void
+    compile_matcher_(
+      const SoftMatcher& matcher,
+      State& state,
+      LexemeSlots& lexeme_slots)
+      throw(eh::Exception);
+
+    static void
+    build_transitions_(
+      const KeyStateVector& key_states,
+      size_t count_tokens,
+      Transitions& transitions)
+      throw(eh::Exception);
+
+    bool
+    match_state_(const State& state, const TokenIdVector& present) const
+      throw();
+
+    bool
+    match_exact_state_(const State& state, const TokenIdVector& exact) const
+      throw();
+
+  private:
+    ChannelChunkArray_var chunks_;
+    std::vector<const ChannelMatchInfo*> infos_;
+    TokenMap tokens_;
+    TokenIdVector alternatives_;
+    std::vector<Slot> slots_;
+    Transitions transitions_[CT_MAX];
+    size_t count_states_;
+  };
+
+  typedef ReferenceCounting::SmartPtr<CompiledTriggerIndex>
+    CompiledTriggerIndex_var;
+}
+}
+
+namespace AdServer
+{
+namespace ChannelSvcs
+{
+  inline
+  size_t CompiledTriggerIndex::size() const throw()
+  {
+    return count_states_;
+  }
+}
+}
+
+#endif //AD_SERVER_COMPILED_TRIGGER_INDEX_HPP_
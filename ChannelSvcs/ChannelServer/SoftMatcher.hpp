@@ -100,6 +100,14 @@ namespace ChannelSvcs
 
     const Lexeme_var& matched_lexeme() const throw();
 
+    /* words (except key word) that should be present in request,
+     * for exact triggers holds all words of trigger */
+    const SubHashVector& simple_words() const throw();
+
+    /* lexemes that should be present in request (any form),
+     * for exact triggers can contain null for words without lexeme */
+    const LexemesPtrVector& lexemes() const throw();
+
   protected:
     virtual
     ~SoftMatcher() throw ()
@@ -190,6 +198,19 @@ namespace ChannelSvcs
     return main_lexem_;
   }
 
+  inline
+  const SoftMatcher::SubHashVector&
+  SoftMatcher::simple_words() const throw()
+  {
+    return simple_words_;
+  }
+
+  inline
+  const LexemesPtrVector& SoftMatcher::lexemes() const throw()
+  {
+    return words_;
+  }
+
 }// namespace ChannelSvcs
 }// namespace AdServer
 
@@ -0,0 +1,446 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <deque>
+#include "UrlTriggerAutomaton.hpp"
+
+namespace AdServer
+{
+namespace ChannelSvcs
+{
+  const UrlTriggerAutomaton::StateId UrlTriggerAutomaton::ROOT;
+  const uint32_t UrlTriggerAutomaton::NONE;
+  const size_t UrlTriggerAutomaton::ALPHABET_SIZE;
+
+  struct UrlTriggerAutomaton::HitUrlLess
+  {
+    bool
+    operator()(const Hit& left, const Hit& right) const throw()
+    {
+      return left.url_index < right.url_index;
+    }
+  };
+
+  struct UrlTriggerAutomaton::HitUrlGreater
+  {
+    bool
+    operator()(const Hit& left, const Hit& right) const throw()
+    {
+      return left.url_index > right.url_index;
+    }
+  };
+
+  namespace
+  {
+    struct TransitionSymbolLess
+    {
+      template<typename TransitionType>
+      bool
+      operator()(const TransitionType& left, const TransitionType& right)
+        const throw()
+      {
+        return left.symbol < right.symbol;
+      }
+
+      template<typename TransitionType>
+      bool
+      operator()(const TransitionType& left, unsigned char right)
+        const throw()
+      {
+        return left.symbol < right;
+      }
+    };
+  }
+
+  UrlTriggerAutomaton::UrlTriggerAutomaton(
+    ChannelChunkArray* chunks,
+    const NSUrlMap* ns_urls)
+    throw(eh::Exception)
+    : chunks_(ReferenceCounting::add_ref(chunks))
+  {
+    BuildStateVector build_states(1);
+
+    for(ChannelChunkArray::const_iterator chunk_it = chunks_->begin();
+        chunk_it != chunks_->end(); ++chunk_it)
+    {
+      const ChannelChunk& chunk = **chunk_it;
+      const TriggerMap& url_map = *chunk.url_map_var_;
+
+      for(TriggerMap::const_iterator map_it = url_map.begin();
+          map_it != url_map.end(); ++map_it)
+      {
+        const StateId state = insert_(build_states, map_it->first.text());
+
+        if(build_states[state].url_pattern == NONE)
+        {
+          UrlPattern pattern;
+          pattern.chunk = &chunk;
+          pattern.atom = map_it->second.in();
+          build_states[state].url_pattern = url_patterns_.size();
+          url_patterns_.push_back(pattern);
+        }
+      }
+    }
+
+    if(ns_urls)
+    {
+      ns_offsets_.push_back(0);
+
+      for(NSUrlMap::const_iterator it = ns_urls->begin();
+          it != ns_urls->end(); ++it)
+      {
+        const StateId state = insert_(build_states, it->first);
+        build_states[state].ns_pattern = ns_offsets_.size() - 1;
+        ns_matchers_.insert(
+          ns_matchers_.end(), it->second.begin(), it->second.end());
+        ns_offsets_.push_back(ns_matchers_.size());
+      }
+    }
+
+    compile_(build_states);
+  }
+
+  UrlTriggerAutomaton::StateId
+  UrlTriggerAutomaton::find_build_transition_(
+    const BuildState& state,
+    unsigned char symbol)
+    throw()
+  {
+    for(TransitionVector::const_iterator it = state.transitions.begin();
+        it != state.transitions.end(); ++it)
+    {
+      if(it->symbol == symbol)
+      {
+        return it->state;
+      }
+    }
+
+    return NONE;
+  }
+
+  UrlTriggerAutomaton::StateId
+  UrlTriggerAutomaton::insert_(
+    BuildStateVector& build_states,
+    const String::SubString& key)
+    throw(eh::Exception)
+  {
+    StateId state = ROOT;
+
+    for(const char* it = key.begin(); it != key.end(); ++it)
+    {
+      const unsigned char symbol = static_cast<unsigned char>(*it);
+      StateId next_state = find_build_transition_(
+        build_states[state], symbol);
+
+      if(next_state == NONE)
+      {
+        next_state = build_states.size();
+        build_states.push_back(BuildState());
+        build_states.back().depth = build_states[state].depth + 1;
+
+        Transition transition;
+        transition.symbol = symbol;
+        transition.state = next_state;
+        build_states[state].transitions.push_back(transition);
+      }
+
+      state = next_state;
+    }
+
+    return state;
+  }
+
+  void
+  UrlTriggerAutomaton::compile_(BuildStateVector& build_states)
+    throw(eh::Exception)
+  {
+    size_t count_transitions = 0;
+    for(BuildStateVector::const_iterator it = build_states.begin();
+        it != build_states.end(); ++it)
+    {
+      count_transitions += it->transitions.size();
+    }
+
+    states_.resize(build_states.size());
+    transitions_.reserve(count_transitions);
+
+    for(size_t i = 0; i < build_states.size(); ++i)
+    {
+      BuildState& build_state = build_states[i];
+      State& state = states_[i];
+
+      std::sort(
+        build_state.transitions.begin(),
+        build_state.transitions.end(),
+        TransitionSymbolLess());
+
+      state.transitions_begin = transitions_.size();
+      transitions_.insert(
+        transitions_.end(),
+        build_state.transitions.begin(),
+        build_state.transitions.end());
+      state.transitions_end = transitions_.size();
+      state.fail = ROOT;
+      state.output = NONE;
+      state.depth = build_state.depth;
+      state.url_pattern = build_state.url_pattern;
+      state.ns_pattern = build_state.ns_pattern;
+
+      TransitionVector().swap(build_state.transitions);
+    }
+
+    std::fill(root_transitions_, root_transitions_ + ALPHABET_SIZE, ROOT);
+
+    // fail links are set in order of depth (BFS)
+    std::deque<StateId> states_queue;
+
+    for(uint32_t i = states_[ROOT].transitions_begin;
+        i < states_[ROOT].transitions_end; ++i)
+    {
+      root_transitions_[transitions_[i].symbol] = transitions_[i].state;
+      states_queue.push_back(transitions_[i].state);
+    }
+
+    while(!states_queue.empty())
+    {
+      const StateId state = states_queue.front();
+      states_queue.pop_front();
+
+      for(uint32_t i = states_[state].transitions_begin;
+          i < states_[state].transitions_end; ++i)
+      {
+        const Transition& transition = transitions_[i];
+        const StateId fail = next_(states_[state].fail, transition.symbol);
+        State& next_state = states_[transition.state];
+
+        next_state.fail = fail;
+        next_state.output =
+          (states_[fail].url_pattern != NONE ||
+           states_[fail].ns_pattern != NONE) ?
+          fail : states_[fail].output;
+
+        states_queue.push_back(transition.state);
+      }
+    }
+  }
+
+  UrlTriggerAutomaton::StateId
+  UrlTriggerAutomaton::find_transition_(
+    StateId state,
+    unsigned char symbol) const
+    throw()
+  {
+    const TransitionVector::const_iterator begin =
+      transitions_.begin() + states_[state].transitions_begin;
+    const TransitionVector::const_iterator end =
+      transitions_.begin() + states_[state].transitions_end;
+    const TransitionVector::const_iterator it = std::lower_bound(
+      begin, end, symbol, TransitionSymbolLess());
+
+    return it != end && it->symbol == symbol ? it->state : NONE;
+  }
+
+  UrlTriggerAutomaton::StateId
+  UrlTriggerAutomaton::next_(
+    StateId state,
+    unsigned char symbol) const
+    throw()
+  {
+    while(state != ROOT)
+    {
+      const StateId next_state = find_transition_(state, symbol);
+
+      if(next_state != NONE)
+      {
+        return next_state;
+      }
+
+      state = states_[state].fail;
+    }
+
+    return root_transitions_[symbol];
+  }
+
+  void
+  UrlTriggerAutomaton::scan_(
+    const MatchUrls& urls,
+    bool ns,
+    HitVector& hits) const
+    throw(eh::Exception)
+  {
+    for(MatchUrlTexts::const_iterator text_it = urls.texts.begin();
+        text_it != urls.texts.end(); ++text_it)
+    {
+      const std::string& text = text_it->text;
+      const size_t urls_end = text_it->first_url + text_it->count_urls;
+      StateId state = ROOT;
+
+      for(size_t pos = 0; pos < text.size(); ++pos)
+      {
+        state = next_(state, static_cast<unsigned char>(text[pos]));
+
+        for(StateId out = state; out != NONE; out = states_[out].output)
+        {
+          const State& out_state = states_[out];
+
+          if((ns ? out_state.ns_pattern : out_state.url_pattern) == NONE)
+          {
+            continue;
+          }
+
+          // key is text[begin, end), check that it is prefix of url
+          const size_t end = pos + 1;
+          const size_t begin = end - out_state.depth;
+
+          for(size_t url_i = text_it->first_url; url_i < urls_end; ++url_i)
+          {
+            if(urls[url_i].text_begin == begin && urls[url_i].text_end == end)
+            {
+              Hit hit;
+              hit.url_index = url_i;
+              hit.state = out;
+              hits.push_back(hit);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  bool
+  UrlTriggerAutomaton::match(
+    const MatchUrls& urls,
+    unsigned int flags,
+    TriggerMatchRes& res) const
+    throw(eh::Exception)
+  {
+    if(!urls.texts_complete())
+    {
+      return false;
+    }
+
+    if(url_patterns_.empty() || urls.empty())
+    {
+      return true;
+    }
+
+    HitVector hits;
+    scan_(urls, false, hits);
+
+    // keep order of ChannelContainer::match_urls_
+    std::stable_sort(hits.begin(), hits.end(), HitUrlLess());
+
+    for(HitVector::const_iterator it = hits.begin(); it != hits.end(); ++it)
+    {
+      const UrlPattern& pattern =
+        url_patterns_[states_[it->state].url_pattern];
+      pattern.chunk->match_url_atom_(
+        *pattern.atom, urls[it->url_index], flags, res);
+    }
+
+    return true;
+  }
+
+  bool
+  UrlTriggerAutomaton::match_ns(
+    const MatchUrls& urls,
+    MatchUrls& additional_urls) const
+    throw(eh::Exception)
+  {
+    if(!urls.texts_complete())
+    {
+      return false;
+    }
+
+    if(ns_offsets_.size() < 2 || urls.empty())
+    {
+      return true;
+    }
+
+    HitVector hits;
+    scan_(urls, true, hits);
+
+    // ChannelContainer::match_ns_urls_ checks urls in reverse order
+    std::stable_sort(hits.begin(), hits.end(), HitUrlGreater());
+
+    for(HitVector::const_iterator it = hits.begin(); it != hits.end(); ++it)
+    {
+      const uint32_t pattern = states_[it->state].ns_pattern;
+
+      for(uint32_t i = ns_offsets_[pattern]; i < ns_offsets_[pattern + 1]; ++i)
+      {
+        add_ns_url(urls[it->url_index], *ns_matchers_[i], additional_urls);
+      }
+    }
+
+    return true;
+  }
+
+  void
+  UrlTriggerAutomaton::add_ns_url(
+    const MatchUrl& url,
+    const SoftMatcher& matcher,
+    MatchUrls& additional_urls)
+    throw(eh::Exception)
+  {
+    const String::SubString& url_prefix = matcher.get_url_prefix();
+    if(url.prefix.length() + url.postfix.length() < url_prefix.length())
+    {
+      if(url_prefix.compare(
+          url.prefix.length(),
+          url.postfix.length(),
+          url.postfix, 0, url.postfix.length()) == 0)
+      {
+        additional_urls.resize(additional_urls.size() + 1);
+        MatchUrl& add_url = additional_urls.back();
+        add_url.prefix = url_prefix.str();
+        add_url.postfix = "/";
+      }
+    }
+    else
+    {
+      additional_urls.resize(additional_urls.size() + 1);
+      MatchUrl& add_url = additional_urls.back();
+      add_url.prefix.reserve(url_prefix.length());
+      add_url.postfix.reserve(url.postfix.length());
+      add_url.prefix.append(url.prefix);
+      add_url.prefix.append(
+        url.postfix,
+        0,
+        url_prefix.length() - url.prefix.size());
+      add_url.postfix.append(
+        url.postfix,
+        url_prefix.length() - url.prefix.size(),
+        std::string::npos);
+    }
+  }
+
+  size_t UrlTriggerAutomaton::memory_size() const throw()
+  {
+    return sizeof(UrlTriggerAutomaton) +
+      states_.capacity() * sizeof(State) +
+      transitions_.capacity() * sizeof(Transition) +
+      url_patterns_.capacity() * sizeof(UrlPattern) +
+      ns_offsets_.capacity() * sizeof(uint32_t) +
+      ns_matchers_.capacity() * sizeof(SoftMatcher_var);
+  }
+}
+}
@@ -0,0 +1,217 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AD_SERVER_URL_TRIGGER_AUTOMATON_HPP_
+#define AD_SERVER_URL_TRIGGER_AUTOMATON_HPP_
+
+#include <map>
+#include <vector>
+#include <stdint.h>
+#include <eh/Exception.hpp>
+#include <String/SubString.hpp>
+#include <ReferenceCounting/AtomicImpl.hpp>
+#include <ReferenceCounting/SmartPtr.hpp>
+#include "ChannelChunk.hpp"
+
+namespace AdServer
+{
+namespace ChannelSvcs
+{
+  /* UrlTriggerAutomaton is Aho-Corasick automaton over keys of url maps
+   * of chunks array and keys of non strict url map. It is built once
+   * after merge and replaced as whole.
+   * Each MatchUrlText of request is scanned once: every found key
+   * that is equal to prefix of some MatchUrl gives same result as
+   * probe of this prefix in url map of chunk (ChannelChunk::match_url).
+   * States with their sorted transitions are stored in contiguous arrays,
+   * transitions of root are direct table.
+   */
+  class UrlTriggerAutomaton: public ReferenceCounting::AtomicImpl
+  {
+  public:
+    typedef std::map<String::SubString, MatcherVarsSet> NSUrlMap;
+
+    /* ns_urls can be null if non strict matching isn't used */
+    UrlTriggerAutomaton(
+      ChannelChunkArray* chunks,
+      const NSUrlMap* ns_urls)
+      throw(eh::Exception);
+
+    /* match urls for url triggers
+     * @return false if urls don't contain texts, urls should be
+     * matched by chunks in this case */
+    bool
+    match(
+      const MatchUrls& urls,
+      unsigned int flags,
+      TriggerMatchRes& res) const
+      throw(eh::Exception);
+
+    /* fill additional urls for non strict url triggers, see
+     * ChannelContainer::match_ns_urls_
+     * @return false if urls don't contain texts */
+    bool
+    match_ns(
+      const MatchUrls& urls,
+      MatchUrls& additional_urls) const
+      throw(eh::Exception);
+
+    /* add url for non strict url trigger found by url prefix */
+    static void
+    add_ns_url(
+      const MatchUrl& url,
+      const SoftMatcher& matcher,
+      MatchUrls& additional_urls)
+      throw(eh::Exception);
+
+    /* count of states */
+    size_t size() const throw();
+
+    size_t memory_size() const throw();
+
+  protected:
+    virtual
+    ~UrlTriggerAutomaton() throw ()
+    {
+    }
+
+  private:
+    typedef uint32_t StateId;
+
+    static const StateId ROOT = 0;
+    static const uint32_t NONE = ~static_cast<uint32_t>(0);
+    static const size_t ALPHABET_SIZE = 256;
+
+    struct Transition
+    {
+      unsigned char symbol;
+      StateId state;
+    };
+
+    typedef std::vector<Transition> TransitionVector;
+
+    struct State
+    {
+      uint32_t transitions_begin;
+      uint32_t transitions_end;
+      StateId fail;
+      // nearest state by fail links that ends some key
+      StateId output;
+      // length of key
+      uint32_t depth;
+      uint32_t url_pattern;
+      uint32_t ns_pattern;
+    };
+
+    struct UrlPattern
+    {
+      const ChannelChunk* chunk;
+      const SoftVector* atom;
+    };
+
+    /* key is found for MatchUrl */
+    struct Hit
+    {
+      size_t url_index;
+      StateId state;
+    };
+
+    typedef std::vector<Hit> HitVector;
+
+    struct HitUrlLess;
+    struct HitUrlGreater;
+
+    /* state of trie while building */
+    struct BuildState
+    {
+      BuildState() throw()
+        : depth(0), url_pattern(NONE), ns_pattern(NONE)
+      {}
+
+      TransitionVector transitions;
+      uint32_t depth;
+      uint32_t url_pattern;
+      uint32_t ns_pattern;
+    };
+
+    typedef std::vector<BuildState> BuildStateVector;
+
+  private:
+    static StateId
+    insert_(
+      BuildStateVector& build_states,
+      const String::SubString& key)
+      throw(eh::Exception);
+
+    static StateId
+    find_build_transition_(
+      const BuildState& state,
+      unsigned char symbol)
+      throw();
+
+    void
+    compile_(BuildStateVector& build_states)
+      throw(eh::Exception);
+
+    StateId
+    find_transition_(StateId state, unsigned char symbol) const
+      throw();
+
+    StateId
+    next_(StateId state, unsigned char symbol) const
+      throw();
+
+    /* collect keys that are equal to prefixes of urls */
+    void
+    scan_(
+      const MatchUrls& urls,
+      bool ns,
+      HitVector& hits) const
+      throw(eh::Exception);
+
+  private:
+    ChannelChunkArray_var chunks_;
+    std::vector<State> states_;
+    TransitionVector transitions_;
+    StateId root_transitions_[ALPHABET_SIZE];
+    std::vector<UrlPattern> url_patterns_;
+    // matchers of ns pattern i are [ns_offsets_[i], ns_offsets_[i + 1])
+    std::vector<uint32_t> ns_offsets_;
+    std::vector<SoftMatcher_var> ns_matchers_;
+  };
+
+  typedef ReferenceCounting::SmartPtr<UrlTriggerAutomaton>
+    UrlTriggerAutomaton_var;
+}
+}
+
+namespace AdServer
+{
+namespace ChannelSvcs
+{
+  inline
+  size_t UrlTriggerAutomaton::size() const throw()
+  {
+    return states_.size();
+  }
+}
+}
+
+#endif //AD_SERVER_URL_TRIGGER_AUTOMATON_HPP_
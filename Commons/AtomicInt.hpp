@@ -39,6 +39,9 @@ namespace Algs
 
     int exchange_and_add(int val);
 
+    // set new_val if current value is equal to old_val
+    bool compare_and_swap(int old_val, int new_val);
+
     AtomicInt& operator+=(int val);
 
     AtomicInt& operator-=(int val);
@@ -82,6 +85,13 @@ namespace Algs
     return __gnu_cxx::__exchange_and_add(&value_, val);
   }
 
+  inline
+  bool
+  AtomicInt::compare_and_swap(int old_val, int new_val)
+  {
+    return __sync_bool_compare_and_swap(&value_, old_val, new_val);
+  }
+
   inline
   AtomicInt&
   AtomicInt::operator+=(int val)
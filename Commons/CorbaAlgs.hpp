@@ -117,6 +117,39 @@ namespace CorbaAlgs
     ts.pack(cts);
   }
 
+  // processing time budget is passed to servers as time relative to
+  // request receiving (caller and server clocks can differ),
+  // zero deadline (not defined) is passed as empty budget
+  inline
+  CORBACommons::TimestampInfo
+  pack_time_budget(const Generics::Time& deadline, const Generics::Time& now)
+  {
+    if(deadline == Generics::Time::ZERO)
+    {
+      return CORBACommons::TimestampInfo();
+    }
+
+    return pack_time(deadline > now ? deadline - now : Generics::Time::ZERO);
+  }
+
+  // deadline by server clock, zero if budget isn't defined
+  inline
+  Generics::Time
+  unpack_time_budget(
+    const CORBACommons::TimestampInfo& time_budget,
+    const Generics::Time& now)
+  {
+    return time_budget.length() ?
+      now + unpack_time(time_budget) : Generics::Time::ZERO;
+  }
+
+  inline
+  bool
+  deadline_reached(const Generics::Time& deadline, const Generics::Time& now)
+  {
+    return deadline != Generics::Time::ZERO && now >= deadline;
+  }
+
   inline
   AdServer::Commons::UserId
   unpack_user_id(const CORBACommons::UserIdInfo& uid)
@@ -19,6 +19,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "Gason.hpp"
 
 static unsigned char ctype[256];
@@ -42,6 +43,12 @@ bool is_sign(char c) { return (ctype[(int)(unsigned char)c] & 004) != 0; }
 bool is_dec(char c) { return (ctype[(int)(unsigned char)c] & 010) != 0; }
 bool is_hex(char c) { return (ctype[(int)(unsigned char)c] & 030) != 0; }
 
+// character at p or terminator if p is out of parsed buffer
+inline char char_at(const char* p, const char* end)
+{
+  return p < end ? *p : '\0';
+}
+
 inline int char2int(char c)
 {
   if (c >= 'a') return c - 'a' + 10;
@@ -52,38 +59,39 @@ inline int char2int(char c)
 void
 consume_float(
   char *str,
+  const char *end,
   char **endptr)
 {
-  if (is_sign(*str))
+  if (is_sign(char_at(str, end)))
   {
     ++str;
   }
 
-  while (is_dec(*str))
+  while (is_dec(char_at(str, end)))
   {
     ++str;
   }
 
-  if (*str == '.')
+  if (char_at(str, end) == '.')
   {
     ++str;
 
-    while (is_dec(*str))
+    while (is_dec(char_at(str, end)))
     {
       ++str;
     }
   }
 
-  if (*str == 'e' || *str == 'E')
+  if (char_at(str, end) == 'e' || char_at(str, end) == 'E')
   {
     ++str;
 
-    if (is_sign(*str))
+    if (is_sign(char_at(str, end)))
     {
       ++str;
     }
 
-    while (is_dec(*str))
+    while (is_dec(char_at(str, end)))
     {
       ++str;
     }
@@ -221,21 +229,32 @@ struct JsonList
 
 JsonParseStatus
 json_parse(char *str, char **endptr, JsonValue *value, JsonAllocator &allocator)
+{
+  return json_parse(str, str + ::strlen(str), endptr, value, allocator);
+}
+
+JsonParseStatus
+json_parse(
+  char *str,
+  char *end,
+  char **endptr,
+  JsonValue *value,
+  JsonAllocator &allocator)
 {
   JsonList stack[JSON_STACK_SIZE];
   int top = -1;
   bool separator = true;
-  while (*str)
+  while (str < end && *str)
   {
     JsonValue o;
-    while (*str && is_space(*str)) ++str;
+    while (str < end && is_space(*str)) ++str;
     *endptr = str++;
-    switch (**endptr)
+    switch (char_at(*endptr, end))
     {
       case '\0':
         continue;
       case '-':
-        if (!is_dec(*str) && *str != '.') return *endptr = str, JSON_PARSE_BAD_NUMBER;
+        if (!is_dec(char_at(str, end)) && char_at(str, end) != '.') return *endptr = str, JSON_PARSE_BAD_NUMBER;
       case '0':
       case '1':
       case '2':
@@ -247,17 +266,23 @@ json_parse(char *str, char **endptr, JsonValue *value, JsonAllocator &allocator)
       case '8':
       case '9':
         o = JsonValue(JSON_TAG_NUMBER, *endptr);
-        consume_float(*endptr, &str);
-        if (!is_delim(*str)) return *endptr = str, JSON_PARSE_BAD_NUMBER;
+        consume_float(*endptr, end, &str);
+        if (!is_delim(char_at(str, end))) return *endptr = str, JSON_PARSE_BAD_NUMBER;
         break;
       case '"':
         o = JsonValue(JSON_TAG_STRING, str);
-        for (char *s = str; *str; ++s, ++str)
+        for (char *s = str; ; ++s, ++str)
         {
+          if (str >= end || !*str)
+          {
+            // string isn't terminated in parsed buffer
+            return *endptr = str, JSON_PARSE_BAD_STRING;
+          }
+
           int c = *s = *str;
           if (c == '\\')
           {
-            c = *++str;
+            c = char_at(++str, end);
             switch (c)
             {
               case '\\':
@@ -272,7 +297,7 @@ json_parse(char *str, char **endptr, JsonValue *value, JsonAllocator &allocator)
                 c = 0;
                 for (int i = 0; i < 4; ++i)
                 {
-                  if (!is_hex(*++str)) return *endptr = str, JSON_PARSE_BAD_STRING;
+                  if (!is_hex(char_at(++str, end))) return *endptr = str, JSON_PARSE_BAD_STRING;
                   c = c * 16 + char2int(*str);
                 }
                 if (c < 0x80)
@@ -302,30 +327,30 @@ json_parse(char *str, char **endptr, JsonValue *value, JsonAllocator &allocator)
             break;
           }
         }
-        if (!is_delim(*str)) return *endptr = str, JSON_PARSE_BAD_STRING;
+        if (!is_delim(char_at(str, end))) return *endptr = str, JSON_PARSE_BAD_STRING;
         break;
       case 't':
         for (const char *s = "rue"; *s; ++s, ++str)
         {
-          if (*s != *str) return JSON_PARSE_BAD_IDENTIFIER;
+          if (*s != char_at(str, end)) return JSON_PARSE_BAD_IDENTIFIER;
         }
-        if (!is_delim(*str)) return JSON_PARSE_BAD_IDENTIFIER;
+        if (!is_delim(char_at(str, end))) return JSON_PARSE_BAD_IDENTIFIER;
         o = JsonValue(JSON_TAG_BOOL, (void *)true);
         break;
       case 'f':
         for (const char *s = "alse"; *s; ++s, ++str)
         {
-          if (*s != *str) return JSON_PARSE_BAD_IDENTIFIER;
+          if (*s != char_at(str, end)) return JSON_PARSE_BAD_IDENTIFIER;
         }
-        if (!is_delim(*str)) return JSON_PARSE_BAD_IDENTIFIER;
+        if (!is_delim(char_at(str, end))) return JSON_PARSE_BAD_IDENTIFIER;
         o = JsonValue(JSON_TAG_BOOL, (void *)false);
         break;
       case 'n':
         for (const char *s = "ull"; *s; ++s, ++str)
         {
-          if (*s != *str) return JSON_PARSE_BAD_IDENTIFIER;
+          if (*s != char_at(str, end)) return JSON_PARSE_BAD_IDENTIFIER;
         }
-        if (!is_delim(*str)) return JSON_PARSE_BAD_IDENTIFIER;
+        if (!is_delim(char_at(str, end))) return JSON_PARSE_BAD_IDENTIFIER;
         break;
       case ']':
         if (top == -1) return JSON_PARSE_STACK_UNDERFLOW;
@@ -271,9 +271,19 @@ enum JsonParseStatus
   JSON_PARSE_BREAKING_BAD
 };
 
+// str: null terminated json, parsed in place (will be modified)
 JsonParseStatus
 json_parse(char *str, char **endptr, JsonValue *value, JsonAllocator &allocator);
 
+// parse [str, end) in place, data after end isn't read or modified
+JsonParseStatus
+json_parse(
+  char *str,
+  char *end,
+  char **endptr,
+  JsonValue *value,
+  JsonAllocator &allocator);
+
 std::string
 json_parse_error(JsonParseStatus status);
 
@@ -0,0 +1,371 @@
+/*
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _COMMONS_MONOTONICBUFFER_HPP_
+#define _COMMONS_MONOTONICBUFFER_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <Generics/Uncopyable.hpp>
+
+namespace AdServer
+{
+namespace Commons
+{
+  /**
+   * MonotonicBuffer
+   *   request scoped arena: memory is taken sequentially from blocks,
+   *   deallocation is no-op, all blocks released by release() or
+   *   at destruction. First block can be provided by owner
+   *   (for example inline buffer of request object), it isn't freed.
+   *   Not thread safe.
+   */
+  class MonotonicBuffer: private Generics::Uncopyable
+  {
+  public:
+    static const std::size_t DEFAULT_BLOCK_SIZE = 4 * 1024;
+
+    explicit
+    MonotonicBuffer(
+      void* initial_block = 0,
+      std::size_t initial_block_size = 0,
+      std::size_t block_size = DEFAULT_BLOCK_SIZE)
+      throw ();
+
+    ~MonotonicBuffer() throw ();
+
+    void*
+    allocate(std::size_t size, std::size_t alignment)
+      throw (std::bad_alloc);
+
+    // free allocated blocks, initial block will be reused
+    void
+    release() throw ();
+
+    // number of blocks allocated on heap since construction
+    std::size_t
+    heap_blocks() const throw ();
+
+  private:
+    struct Block
+    {
+      Block* next;
+    };
+
+    void*
+    allocate_block_(std::size_t size, std::size_t alignment)
+      throw (std::bad_alloc);
+
+  private:
+    char* const initial_block_;
+    const std::size_t initial_block_size_;
+    std::size_t block_size_;
+
+    char* cur_;
+    char* end_;
+    Block* blocks_;
+    std::size_t heap_blocks_;
+  };
+
+  /**
+   * ArenaAllocator
+   *   STL allocator over MonotonicBuffer,
+   *   default constructed allocator use heap.
+   *   Allocator is propagated on container swap and move assignment,
+   *   so containers can exchange content with heap based containers.
+   */
+  template<typename ObjectType>
+  class ArenaAllocator
+  {
+  public:
+    typedef ObjectType value_type;
+    typedef ObjectType* pointer;
+    typedef const ObjectType* const_pointer;
+    typedef ObjectType& reference;
+    typedef const ObjectType& const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template<typename OtherType>
+    struct rebind
+    {
+      typedef ArenaAllocator<OtherType> other;
+    };
+
+    ArenaAllocator() throw ()
+      : buffer_(0)
+    {}
+
+    explicit
+    ArenaAllocator(MonotonicBuffer* buffer) throw ()
+      : buffer_(buffer)
+    {}
+
+    template<typename OtherType>
+    ArenaAllocator(const ArenaAllocator<OtherType>& init) throw ()
+      : buffer_(init.buffer())
+    {}
+
+    ObjectType*
+    allocate(std::size_t n)
+    {
+      if(buffer_)
+      {
+        return static_cast<ObjectType*>(buffer_->allocate(
+          n * sizeof(ObjectType), alignof(ObjectType)));
+      }
+
+      return static_cast<ObjectType*>(::operator new(n * sizeof(ObjectType)));
+    }
+
+    void
+    deallocate(ObjectType* ptr, std::size_t) throw ()
+    {
+      if(!buffer_)
+      {
+        ::operator delete(ptr);
+      }
+    }
+
+    template<typename OtherType, typename... Args>
+    void
+    construct(OtherType* ptr, Args&&... args)
+    {
+      ::new (static_cast<void*>(ptr)) OtherType(std::forward<Args>(args)...);
+    }
+
+    template<typename OtherType>
+    void
+    destroy(OtherType* ptr)
+    {
+      ptr->~OtherType();
+    }
+
+    size_type
+    max_size() const throw ()
+    {
+      return static_cast<size_type>(-1) / sizeof(ObjectType);
+    }
+
+    MonotonicBuffer*
+    buffer() const throw ()
+    {
+      return buffer_;
+    }
+
+  private:
+    MonotonicBuffer* buffer_;
+  };
+
+  template<typename LeftType, typename RightType>
+  bool
+  operator==(
+    const ArenaAllocator<LeftType>& left,
+    const ArenaAllocator<RightType>& right)
+    throw ()
+  {
+    return left.buffer() == right.buffer();
+  }
+
+  template<typename LeftType, typename RightType>
+  bool
+  operator!=(
+    const ArenaAllocator<LeftType>& left,
+    const ArenaAllocator<RightType>& right)
+    throw ()
+  {
+    return left.buffer() != right.buffer();
+  }
+
+  /**
+   * ArenaDeleter
+   *   deleter for objects created by make_arena_ptr:
+   *   arena objects are only destroyed, heap objects deleted
+   */
+  template<typename ObjectType>
+  class ArenaDeleter
+  {
+  public:
+    ArenaDeleter() throw ()
+      : buffer_(0)
+    {}
+
+    explicit
+    ArenaDeleter(MonotonicBuffer* buffer) throw ()
+      : buffer_(buffer)
+    {}
+
+    void
+    operator()(ObjectType* ptr) const throw ()
+    {
+      if(buffer_)
+      {
+        ptr->~ObjectType();
+      }
+      else
+      {
+        delete ptr;
+      }
+    }
+
+  private:
+    MonotonicBuffer* buffer_;
+  };
+
+  template<typename ObjectType>
+  struct ArenaPtr
+  {
+    typedef std::unique_ptr<ObjectType, ArenaDeleter<ObjectType> > Type;
+  };
+
+  // create object in buffer (on heap if buffer is null)
+  template<typename ObjectType, typename... Args>
+  typename ArenaPtr<ObjectType>::Type
+  make_arena_ptr(MonotonicBuffer* buffer, Args&&... args)
+  {
+    if(buffer)
+    {
+      void* ptr = buffer->allocate(sizeof(ObjectType), alignof(ObjectType));
+      return typename ArenaPtr<ObjectType>::Type(
+        new (ptr) ObjectType(std::forward<Args>(args)...),
+        ArenaDeleter<ObjectType>(buffer));
+    }
+
+    return typename ArenaPtr<ObjectType>::Type(
+      new ObjectType(std::forward<Args>(args)...));
+  }
+}
+}
+
+namespace AdServer
+{
+namespace Commons
+{
+  inline
+  MonotonicBuffer::MonotonicBuffer(
+    void* initial_block,
+    std::size_t initial_block_size,
+    std::size_t block_size)
+    throw ()
+    : initial_block_(static_cast<char*>(initial_block)),
+      initial_block_size_(initial_block ? initial_block_size : 0),
+      block_size_(block_size),
+      cur_(initial_block_),
+      end_(initial_block_ + initial_block_size_),
+      blocks_(0),
+      heap_blocks_(0)
+  {}
+
+  inline
+  MonotonicBuffer::~MonotonicBuffer() throw ()
+  {
+    release();
+  }
+
+  inline
+  void*
+  MonotonicBuffer::allocate(std::size_t size, std::size_t alignment)
+    throw (std::bad_alloc)
+  {
+    const std::size_t pad =
+      (alignment - reinterpret_cast<std::size_t>(cur_) % alignment) % alignment;
+
+    if(cur_ && static_cast<std::size_t>(end_ - cur_) >= size + pad)
+    {
+      void* res = cur_ + pad;
+      cur_ += size + pad;
+      return res;
+    }
+
+    return allocate_block_(size, alignment);
+  }
+
+  inline
+  void
+  MonotonicBuffer::release() throw ()
+  {
+    while(blocks_)
+    {
+      Block* next = blocks_->next;
+      ::operator delete(blocks_);
+      blocks_ = next;
+    }
+
+    cur_ = initial_block_;
+    end_ = initial_block_ + initial_block_size_;
+  }
+
+  inline
+  std::size_t
+  MonotonicBuffer::heap_blocks() const throw ()
+  {
+    return heap_blocks_;
+  }
+
+  inline
+  void*
+  MonotonicBuffer::allocate_block_(std::size_t size, std::size_t alignment)
+    throw (std::bad_alloc)
+  {
+    // block header is aligned for any fundamental type
+    const std::size_t header_size =
+      (sizeof(Block) + alignof(std::max_align_t) - 1) /
+      alignof(std::max_align_t) * alignof(std::max_align_t);
+
+    std::size_t alloc_size = header_size + size + alignment;
+
+    if(alloc_size < block_size_)
+    {
+      alloc_size = block_size_;
+    }
+    else
+    {
+      // big object: take own block, next blocks grow
+      block_size_ = alloc_size;
+    }
+
+    Block* block = static_cast<Block*>(::operator new(alloc_size));
+    block->next = blocks_;
+    blocks_ = block;
+    ++heap_blocks_;
+
+    char* block_begin = reinterpret_cast<char*>(block) + header_size;
+    const std::size_t pad =
+      (alignment - reinterpret_cast<std::size_t>(block_begin) % alignment) %
+      alignment;
+
+    cur_ = block_begin + pad + size;
+    end_ = reinterpret_cast<char*>(block) + alloc_size;
+
+    // next heap block is twice bigger
+    block_size_ *= 2;
+
+    return block_begin + pad;
+  }
+}
+}
+
+#endif /*_COMMONS_MONOTONICBUFFER_HPP_*/
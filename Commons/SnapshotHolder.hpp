@@ -0,0 +1,445 @@
+/*
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADSERVER_COMMONS_SNAPSHOTHOLDER_HPP
+#define ADSERVER_COMMONS_SNAPSHOTHOLDER_HPP
+
+#include <pthread.h>
+#include <sched.h>
+#include <vector>
+
+#include <ReferenceCounting/SmartPtr.hpp>
+#include <Sync/SyncPolicy.hpp>
+
+namespace AdServer
+{
+namespace Commons
+{
+  /**
+   * SnapshotThreadRegistry
+   * assign dense indexes to threads that read SnapshotHolder's,
+   * index returned to registry at thread exit and reused by next thread
+   */
+  class SnapshotThreadRegistry
+  {
+  public:
+    static const unsigned long MAX_THREADS = 256;
+    static const unsigned long NO_INDEX = MAX_THREADS;
+
+    /**
+     * @return index of calling thread in [0, MAX_THREADS) or
+     *   NO_INDEX if all indexes are busy
+     */
+    static unsigned long
+    thread_index() throw();
+
+  private:
+    SnapshotThreadRegistry() throw();
+
+    ~SnapshotThreadRegistry() throw();
+
+    static SnapshotThreadRegistry&
+    instance_() throw();
+
+    static void
+    release_thread_(void* index) throw();
+
+    unsigned long
+    allocate_() throw();
+
+  private:
+    Sync::PosixMutex lock_;
+    const bool key_inited_;
+    pthread_key_t key_;
+    std::vector<unsigned long> free_indexes_;
+    unsigned long next_index_;
+  };
+
+  /**
+   * SnapshotHolder
+   * publish ref counted object for readers without shared lock:
+   *   reader mark own thread slot with current epoch, load pointer and
+   *   add reference, no shared cache line is written except object counter;
+   *   writer publish new object, increment epoch and wait readers that
+   *   marked slots with older epoch, after that old object can't be
+   *   loaded by any reader and writer get it back.
+   * Threads that haven't slot (more than MAX_THREADS alive readers)
+   * use rw lock as before.
+   */
+  template<typename ObjectType>
+  class SnapshotHolder
+  {
+  public:
+    typedef ReferenceCounting::SmartPtr<ObjectType> Object_var;
+
+    /**
+     * ReadGuard
+     * pin current object for guard scope without object reference
+     * increment. Writers wait guard destruction, so guard must not be
+     * kept over blocking calls or over swap of same holder
+     */
+    class ReadGuard
+    {
+    public:
+      explicit
+      ReadGuard(const SnapshotHolder& holder) throw();
+
+      ~ReadGuard() throw();
+
+      ObjectType*
+      get() const throw();
+
+      ObjectType*
+      operator->() const throw();
+
+    private:
+      ReadGuard(const ReadGuard&);
+
+      ReadGuard&
+      operator=(const ReadGuard&);
+
+    private:
+      ObjectType* object_;
+      unsigned long* mark_;
+      Object_var overflow_object_;
+    };
+
+  public:
+    explicit
+    SnapshotHolder(Object_var object = Object_var()) throw();
+
+    ~SnapshotHolder() throw();
+
+    /**
+     * @return current object with added reference
+     */
+    Object_var
+    get() const throw();
+
+    /**
+     * publish object and return previous in it, previous object can be
+     * destroyed by caller without lock: no readers use it without reference
+     */
+    void
+    swap(Object_var& object) throw();
+
+  private:
+    SnapshotHolder(const SnapshotHolder&);
+
+    SnapshotHolder&
+    operator=(const SnapshotHolder&);
+
+    unsigned long*
+    pin_() const throw();
+
+    static void
+    unpin_(unsigned long* mark) throw();
+
+    void
+    synchronize_() throw();
+
+  private:
+    enum
+    {
+      CACHE_LINE_SIZE = 64
+    };
+
+    struct Slot
+    {
+      unsigned long epoch;
+      char padding[CACHE_LINE_SIZE - sizeof(unsigned long)];
+    };
+
+    char head_padding_[CACHE_LINE_SIZE];
+    ObjectType* object_;
+    unsigned long epoch_;
+    mutable Sync::PosixRWLock overflow_lock_;
+    Sync::PosixMutex write_lock_;
+    char slots_padding_[CACHE_LINE_SIZE];
+    mutable Slot slots_[SnapshotThreadRegistry::MAX_THREADS];
+  };
+}
+}
+
+namespace AdServer
+{
+namespace Commons
+{
+  // SnapshotThreadRegistry
+  inline
+  SnapshotThreadRegistry::SnapshotThreadRegistry() throw()
+    : key_inited_(::pthread_key_create(&key_, release_thread_) == 0),
+      next_index_(0)
+  {}
+
+  inline
+  SnapshotThreadRegistry::~SnapshotThreadRegistry() throw()
+  {
+    if(key_inited_)
+    {
+      ::pthread_key_delete(key_);
+    }
+  }
+
+  inline
+  SnapshotThreadRegistry&
+  SnapshotThreadRegistry::instance_() throw()
+  {
+    static SnapshotThreadRegistry registry;
+    return registry;
+  }
+
+  inline
+  void
+  SnapshotThreadRegistry::release_thread_(void* index) throw()
+  {
+    SnapshotThreadRegistry& registry = instance_();
+    Sync::PosixGuard lock(registry.lock_);
+    registry.free_indexes_.push_back(
+      reinterpret_cast<unsigned long>(index) - 1);
+  }
+
+  inline
+  unsigned long
+  SnapshotThreadRegistry::allocate_() throw()
+  {
+    if(!key_inited_)
+    {
+      return NO_INDEX;
+    }
+
+    unsigned long index;
+
+    {
+      Sync::PosixGuard lock(lock_);
+      if(!free_indexes_.empty())
+      {
+        index = free_indexes_.back();
+        free_indexes_.pop_back();
+      }
+      else if(next_index_ < MAX_THREADS)
+      {
+        index = next_index_++;
+        // reserve place for release at thread exit
+        free_indexes_.reserve(next_index_);
+      }
+      else
+      {
+        return NO_INDEX;
+      }
+    }
+
+    ::pthread_setspecific(key_, reinterpret_cast<void*>(index + 1));
+    return index;
+  }
+
+  inline
+  unsigned long
+  SnapshotThreadRegistry::thread_index() throw()
+  {
+    // index + 1 cached for fast path, key value used only for release
+    static __thread unsigned long thread_index = 0;
+
+    if(!thread_index)
+    {
+      // NO_INDEX is cached too: overflow threads don't retry allocation
+      thread_index = instance_().allocate_() + 1;
+    }
+
+    return thread_index - 1;
+  }
+
+  // SnapshotHolder::ReadGuard
+  template<typename ObjectType>
+  SnapshotHolder<ObjectType>::ReadGuard::ReadGuard(
+    const SnapshotHolder& holder) throw()
+    : mark_(holder.pin_())
+  {
+    if(mark_)
+    {
+      object_ = __atomic_load_n(&holder.object_, __ATOMIC_ACQUIRE);
+    }
+    else
+    {
+      overflow_object_ = holder.get();
+      object_ = overflow_object_.in();
+    }
+  }
+
+  template<typename ObjectType>
+  SnapshotHolder<ObjectType>::ReadGuard::~ReadGuard() throw()
+  {
+    unpin_(mark_);
+  }
+
+  template<typename ObjectType>
+  ObjectType*
+  SnapshotHolder<ObjectType>::ReadGuard::get() const throw()
+  {
+    return object_;
+  }
+
+  template<typename ObjectType>
+  ObjectType*
+  SnapshotHolder<ObjectType>::ReadGuard::operator->() const throw()
+  {
+    return object_;
+  }
+
+  // SnapshotHolder
+  template<typename ObjectType>
+  SnapshotHolder<ObjectType>::SnapshotHolder(Object_var object) throw()
+    : object_(object.retn()),
+      epoch_(1)
+  {
+    for(unsigned long i = 0; i < SnapshotThreadRegistry::MAX_THREADS; ++i)
+    {
+      slots_[i].epoch = 0;
+    }
+  }
+
+  template<typename ObjectType>
+  SnapshotHolder<ObjectType>::~SnapshotHolder() throw()
+  {
+    Object_var destroy(object_);
+  }
+
+  template<typename ObjectType>
+  unsigned long*
+  SnapshotHolder<ObjectType>::pin_() const throw()
+  {
+    const unsigned long index = SnapshotThreadRegistry::thread_index();
+
+    if(index == SnapshotThreadRegistry::NO_INDEX)
+    {
+      return 0;
+    }
+
+    unsigned long* mark = &slots_[index].epoch;
+
+    if(*mark)
+    {
+      // nested pin: keep older epoch, it is more strict
+      return 0;
+    }
+
+    // mark must be visible to writer before object load
+    __atomic_exchange_n(
+      mark,
+      __atomic_load_n(&epoch_, __ATOMIC_RELAXED),
+      __ATOMIC_SEQ_CST);
+
+    return mark;
+  }
+
+  template<typename ObjectType>
+  void
+  SnapshotHolder<ObjectType>::unpin_(unsigned long* mark) throw()
+  {
+    if(mark)
+    {
+      __atomic_store_n(mark, 0, __ATOMIC_RELEASE);
+    }
+  }
+
+  template<typename ObjectType>
+  typename SnapshotHolder<ObjectType>::Object_var
+  SnapshotHolder<ObjectType>::get() const throw()
+  {
+    const unsigned long index = SnapshotThreadRegistry::thread_index();
+
+    if(index == SnapshotThreadRegistry::NO_INDEX)
+    {
+      Sync::PosixRGuard lock(overflow_lock_);
+      return ReferenceCounting::add_ref(object_);
+    }
+
+    unsigned long* mark = &slots_[index].epoch;
+
+    if(*mark)
+    {
+      // pinned by ReadGuard of this thread
+      return ReferenceCounting::add_ref(
+        __atomic_load_n(&object_, __ATOMIC_ACQUIRE));
+    }
+
+    __atomic_exchange_n(
+      mark,
+      __atomic_load_n(&epoch_, __ATOMIC_RELAXED),
+      __ATOMIC_SEQ_CST);
+
+    Object_var res = ReferenceCounting::add_ref(
+      __atomic_load_n(&object_, __ATOMIC_ACQUIRE));
+
+    __atomic_store_n(mark, 0, __ATOMIC_RELEASE);
+
+    return res;
+  }
+
+  template<typename ObjectType>
+  void
+  SnapshotHolder<ObjectType>::swap(Object_var& object) throw()
+  {
+    ObjectType* new_object = object.retn();
+    ObjectType* old_object;
+
+    {
+      Sync::PosixGuard lock(write_lock_);
+
+      {
+        Sync::PosixWGuard overflow_lock(overflow_lock_);
+        old_object = object_;
+        __atomic_store_n(&object_, new_object, __ATOMIC_SEQ_CST);
+      }
+
+      synchronize_();
+    }
+
+    object = Object_var(old_object);
+  }
+
+  template<typename ObjectType>
+  void
+  SnapshotHolder<ObjectType>::synchronize_() throw()
+  {
+    // readers that marked slot with new epoch loaded new object
+    const unsigned long epoch =
+      __atomic_add_fetch(&epoch_, 1, __ATOMIC_SEQ_CST);
+
+    for(unsigned long i = 0; i < SnapshotThreadRegistry::MAX_THREADS; ++i)
+    {
+      for(;;)
+      {
+        const unsigned long mark =
+          __atomic_load_n(&slots_[i].epoch, __ATOMIC_ACQUIRE);
+
+        if(!mark || mark >= epoch)
+        {
+          break;
+        }
+
+        sched_yield();
+      }
+    }
+  }
+}
+}
+
+#endif /*ADSERVER_COMMONS_SNAPSHOTHOLDER_HPP*/
@@ -21,6 +21,7 @@
 // @file Xslt/LibxsltTransformer.cpp
 
 #include <fstream>
+#include <pthread.h>
 
 #include <libxslt/transform.h>
 #include <ReferenceCounting/DefaultImpl.hpp>
@@ -42,10 +43,16 @@ namespace AdServer
    * Class created because xsltSetGenericErrorFunc doesn't support threads
    * (xmlSetGenericErrorFunc is thread-safe, if libxml is compiled
    * with LIBXML_THREAD_ENABLED)
+   * Errors descriptions placed in thread specific storage: transform
+   * calls from different threads don't lock each other.
    */
   class ErrorListener
   {
   public:
+    ErrorListener() throw ();
+
+    ~ErrorListener() throw ();
+
     /**
      * Called back while error events
      * @param message Trouble description should be stored into
@@ -74,8 +81,7 @@ namespace AdServer
     xslt_generic_error(void* context, const char* message, ...) throw ();
 
     /**
-     * Remove error place for current calling thread from global
-     * container
+     * Clear errors place of current calling thread
      */
     struct ThreadGuard : Generics::Uncopyable
     {
@@ -84,7 +90,8 @@ namespace AdServer
        */
       ThreadGuard() throw (eh::Exception);
       /**
-       * Remove errors place for calling thread from caching container
+       * Clear errors place for calling thread, buffer is kept
+       * for next transformations in this thread
        */
       ~ThreadGuard() throw ();
     };
@@ -94,28 +101,14 @@ namespace AdServer
     void
     clear_thread_last_error_() throw ();
 
-    struct String : public std::string,
-      ReferenceCounting::DefaultImpl<>
-    {
-    private:
-      virtual
-      ~String() throw ()
-      {}
-    };
-
-    typedef ReferenceCounting::SmartPtr<String> String_var;
-
-    /// Contain troubles description, empty if don't exist any thread,
-    /// working with XslTransformer at current moment
-    typedef std::map<pthread_t, String_var> ThreadsErrors;
-    ThreadsErrors threads_last_errors_;
+    static void
+    destroy_thread_error_(void* error) throw ();
 
-    typedef Sync::PosixRWLock Lock;
-    typedef Sync::PosixRGuard RGuard;
-    typedef Sync::PosixWGuard WGuard;
-    Lock lock_;
+    /// Contain troubles description of thread, empty if thread
+    /// don't have errors at current moment
+    pthread_key_t thread_error_key_;
+    bool thread_error_key_inited_;
   };
-
   namespace
   {
     /// Here accumulate errors descriptions from libxslt calls
@@ -161,29 +154,81 @@ namespace AdServer
     typedef std::unique_ptr<
       xmlOutputBuffer,
       LibxsltXmlOutputBufferDestroyer> XmlOutputBufferPtr;
+
+    /**
+     * Set URL of document without own URL for transformation time,
+     * URL isn't copied and must be reset before document freeing
+     */
+    class XmlDocUrlGuard : Generics::Uncopyable
+    {
+    public:
+      XmlDocUrlGuard(xmlDocPtr doc, const std::string& url) throw ()
+        : doc_(doc && !doc->URL && !url.empty() ? doc : 0)
+      {
+        if (doc_)
+        {
+          doc_->URL = reinterpret_cast<const xmlChar*>(url.c_str());
+        }
+      }
+
+      ~XmlDocUrlGuard() throw ()
+      {
+        if (doc_)
+        {
+          doc_->URL = 0;
+        }
+      }
+
+    private:
+      xmlDocPtr doc_;
+    };
   }
 
   //
   // LibxslTransformer::ErrorListener class
   //
 
+  ErrorListener::ErrorListener() throw ()
+    : thread_error_key_inited_(
+        ::pthread_key_create(&thread_error_key_, destroy_thread_error_) == 0)
+  {}
+
+  ErrorListener::~ErrorListener() throw ()
+  {
+    if (thread_error_key_inited_)
+    {
+      ::pthread_key_delete(thread_error_key_);
+    }
+  }
+
+  void
+  ErrorListener::destroy_thread_error_(void* error) throw ()
+  {
+    delete static_cast<std::string*>(error);
+  }
+
   void
   ErrorListener::event_error(const char* message, int n) throw (eh::Exception)
   {
-    pthread_t tid = pthread_self();
-    std::string* all_msg;
+    if (!thread_error_key_inited_)
+    {
+      return;
+    }
+
+    std::string* all_msg = static_cast<std::string*>(
+      ::pthread_getspecific(thread_error_key_));
 
+    if (!all_msg)
     {
-      WGuard guard(lock_);
-      String_var& str = threads_last_errors_[tid];
-      if (!str)
+      std::unique_ptr<std::string> new_msg(new std::string());
+      if (::pthread_setspecific(thread_error_key_, new_msg.get()) != 0)
       {
-        str = new String;
+        return;
       }
-      all_msg = str;
+      all_msg = new_msg.release();
     }
+
     all_msg->append(message, n);
-    return;
   }
 
   void
@@ -219,31 +264,35 @@ namespace AdServer
   const char*
   ErrorListener::get_last_error() throw ()
   {
-    pthread_t tid = pthread_self();
-    const char* msg = 0;
-
+    if (thread_error_key_inited_)
     {
-      RGuard guard(lock_);
-      ThreadsErrors::iterator it = threads_last_errors_.find(tid);
-      if (it != threads_last_errors_.end())
+      const std::string* msg = static_cast<const std::string*>(
+        ::pthread_getspecific(thread_error_key_));
+
+      if (msg && !msg->empty())
       {
-        msg = it->second->c_str();
+        return msg->c_str();
       }
     }
-    return msg;
+
+    return 0;
   }
 
   /**
-   * Remove errors place for calling thread from caching container
+   * Clear errors place of calling thread
    */
   void
   ErrorListener::clear_thread_last_error_() throw ()
   {
-    if (get_last_error())
+    if (thread_error_key_inited_)
     {
-      pthread_t tid = pthread_self();
-      WGuard guard(lock_);
-      threads_last_errors_.erase(tid);
+      std::string* msg = static_cast<std::string*>(
+        ::pthread_getspecific(thread_error_key_));
+
+      if (msg)
+      {
+        msg->clear();
+      }
     }
   }
 
@@ -601,6 +650,40 @@ namespace AdServer
     ParserContextPtr xml_parser_context(parse_xml_stream_(input));
     XmlDocPtr xml_guard(xml_parser_context->myDoc);
 
+    transform_(xml_parser_context->myDoc, output, parameters);
+  }
+
+  void
+  LibxslTransformer::transform(
+    xmlDocPtr input,
+    std::ostream& output,
+    const XslParameters* parameters) throw (Exception)
+  {
+    static const char* FUN = "LibxslTransformer::transform()";
+
+    if (!libxslt_holder_.in())
+    {
+      Stream::Error ostr;
+      ostr << FUN << ": LibxslTransformer isn't inited.";
+      throw Exception(ostr);
+    }
+
+    // document built in memory haven't URL, use base path
+    // for resolve relative addresses like for parsed documents
+    XmlDocUrlGuard url_guard(input, base_path_);
+
+    ErrorListener::ThreadGuard thread_cleaner;
+    transform_(input, output, parameters);
+  }
+
+  void
+  LibxslTransformer::transform_(
+    xmlDocPtr input,
+    std::ostream& output,
+    const XslParameters* parameters) throw (Exception)
+  {
+    static const char* FUN = "LibxslTransformer::transform_()";
+
     Generics::ArrayAutoPtr<const char*> params;
     // fill params
     if (parameters)
@@ -625,7 +708,7 @@ namespace AdServer
     XmlDocPtr result;
     {
       XsltTransformContextPtr ctxt(
-        xsltNewTransformContext(stylesheet_.get(), xml_parser_context->myDoc));
+        xsltNewTransformContext(stylesheet_.get(), input));
       if (!ctxt.get())
       {
         Stream::Error ostr;
@@ -636,7 +719,7 @@ namespace AdServer
       xsltSetCtxtParseOptions(ctxt.get(), OPTIONS);
 
       result.reset(xsltApplyStylesheetUser(stylesheet_.get(),
-        xml_parser_context->myDoc, params.get(), 0, 0, ctxt.get()));
+        input, params.get(), 0, 0, ctxt.get()));
 
       if (ctxt->state == XSLT_STATE_ERROR ||
         ctxt->state == XSLT_STATE_STOPPED || !result.get())
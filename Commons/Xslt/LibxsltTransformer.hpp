@@ -85,6 +85,9 @@ namespace AdServer
    * 1. Create transformer and do transform of different XML in some threads.
    * 2. Create transformer, transform in some threads.
    *   Other class methods is not thread safe.
+   * Compiled stylesheet is shared (read only) between transform calls,
+   * each call create own transformation context and errors
+   * place (thread specific), so transform don't lock.
    */
   class LibxslTransformer : public XslTransformerBase
   {
@@ -141,6 +144,19 @@ namespace AdServer
       const XslParameters* parameters = 0)
       throw (Exception);
 
+    /**
+     * Apply stylesheet to XML document built in memory, allow to avoid
+     * serialization and parsing of input data
+     * @param input The XML document, stay owned by caller and
+     * shouldn't be changed by other threads while transform
+     * @param output Result will here
+     * @param parameters Optional parameters for XSL stylesheet
+     */
+    void
+    transform(xmlDocPtr input, std::ostream& output,
+      const XslParameters* parameters = 0)
+      throw (Exception);
+
     /**
      * Registrate external XSL function in libxslt engine
      * Note: You should register external function once, but
@@ -208,6 +224,15 @@ namespace AdServer
     void
     init_(std::istream& istr) throw (Exception);
 
+    /**
+     * Apply stylesheet to parsed document, thread errors place
+     * should be guarded by caller
+     */
+    void
+    transform_(xmlDocPtr input, std::ostream& output,
+      const XslParameters* parameters)
+      throw (Exception);
+
     /// libxslt globals load/unload guard
     LibxsltHolder_var libxslt_holder_;
     /// Store all registered external XSL function, release while
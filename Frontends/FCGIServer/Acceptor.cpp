@@ -23,12 +23,12 @@
 #include <sys/un.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <limits.h>
 #include <eh/Errno.hpp>
 
 #include <deque>
 
 #include <Frontends/FrontendCommons/FCGI.hpp>
-#include "FrontendsPool.hpp"
 
 #include "Acceptor.hpp"
 
@@ -181,6 +181,7 @@ namespace Frontends
 
   private:
     static const int BUF_SIZE = 1024 * 1024; // 1 Mb
+    static const int INITIAL_READ_BUF_SIZE = 16 * 1024;
     Logging::Logger_var logger_;
     FrontendCommons::Frontend_var frontend_;
     State_var state_;
@@ -189,9 +190,9 @@ namespace Frontends
     pthread_t thread_;
     volatile bool active_;
     State::WorkerId id_;
-    char rbuf_[BUF_SIZE];
-    Sync::PosixMutex rpos_lock_;
-    char* rpos_;
+    Sync::PosixMutex rsize_lock_;
+    // received size of current request
+    size_t rsize_;
     char wbuf_[BUF_SIZE];
   };
 
@@ -458,7 +459,7 @@ namespace Frontends
       thread_(0),
       active_(true),
       id_(state_->reg_worker(this)),
-      rpos_(rbuf_)
+      rsize_(0)
   {}
 
   Acceptor::Worker::~Worker() throw()
@@ -499,8 +500,8 @@ namespace Frontends
     active_ = false;
 
     {
-      Guard lock(rpos_lock_);
-      if (rpos_ != rbuf_)
+      Guard lock(rsize_lock_);
+      if (rsize_ != 0)
       {
         return;
       }
@@ -525,17 +526,49 @@ namespace Frontends
     while (active_)
     {
       FCGI::HttpRequest request;
+      FCGI::RequestScanner scanner;
+      // request is parsed over ref counted buffer: handlers can keep it
+      // (parse body in place) after response, buffer allocated per request
+      FCGI::ReceiveBuffer_var rbuf;
 
       {
-        Guard lock(rpos_lock_);
-        rpos_ = rbuf_;
+        Guard lock(rsize_lock_);
+        rsize_ = 0;
       }
 
       size_t rsize = 0;
+      size_t request_size = 0;
+      int parse_res;
 
       do
       {
-        ssize_t recv_res = recv(sock_, rpos_, sizeof(rbuf_) - rsize, 0);
+        try
+        {
+          if (!rbuf.in())
+          {
+            rbuf = new FCGI::ReceiveBuffer(INITIAL_READ_BUF_SIZE);
+          }
+          else if (rsize == rbuf->size())
+          {
+            if (rsize >= static_cast<size_t>(BUF_SIZE))
+            {
+              logger()->info(String::SubString("request too big"), Aspect::WORKER);
+              return;
+            }
+
+            rbuf->resize(std::min(rsize * 2, static_cast<size_t>(BUF_SIZE)));
+          }
+        }
+        catch (const eh::Exception& e)
+        {
+          Stream::Error ostr;
+          ostr << "Can't allocate receive buffer: " << e.what();
+          logger()->error(ostr.str(), Aspect::WORKER);
+          return;
+        }
+
+        ssize_t recv_res = recv(
+          sock_, rbuf->data() + rsize, rbuf->size() - rsize, 0);
 
         if (recv_res == -1)
         { // TODO: handle stop event and signal interrupt
@@ -552,45 +585,42 @@ namespace Frontends
         }
 
         {
-          Guard lock(rpos_lock_);
-          rpos_ += recv_res;
+          Guard lock(rsize_lock_);
+          rsize_ += recv_res;
         }
 
         rsize += recv_res;
 
-        int parse_res = request.parse(rbuf_, rsize);
-        if (parse_res == FCGI::PARSE_OK)
-        {
-          break;
-        }
-
-        switch(parse_res)
-        {
-        case FCGI::PARSE_NEED_MORE:
-          logger()->warning(String::SubString("getting PARSE_NEED_MORE"), Aspect::WORKER);
-          break;
+        // only new records are checked, request parsed once when complete
+        parse_res = scanner.scan(rbuf->data(), rsize, request_size);
+      }
+      while(parse_res == FCGI::PARSE_NEED_MORE);
 
-        case FCGI::PARSE_INVALID_HEADER:
-          logger()->info(String::SubString("invalid fcgi header"), Aspect::WORKER);
-          return;
-        case FCGI::PARSE_BEGIN_REQUEST_EXPECTED:
-          logger()->info(String::SubString("begin request expected"), Aspect::WORKER);
-          return;
-        case FCGI::PARSE_INVALID_ID:
-          logger()->info(String::SubString("invalid FCGI header id"), Aspect::WORKER);
-          return;
-        case FCGI::PARSE_FRAGMENTED_STDIN:
-          logger()->info(String::SubString("fragmented stdin"), Aspect::WORKER);
-          return;
-        }
+      if (parse_res == FCGI::PARSE_OK)
+      {
+        parse_res = request.parse(rbuf, request_size);
+      }
 
-        if (rsize >= sizeof(rbuf_))
-        {
-          logger()->info(String::SubString("request too big"), Aspect::WORKER);
-          return;
-        }
+      switch(parse_res)
+      {
+      case FCGI::PARSE_OK:
+        break;
+      case FCGI::PARSE_NEED_MORE:
+        logger()->warning(String::SubString("getting PARSE_NEED_MORE"), Aspect::WORKER);
+        return;
+      case FCGI::PARSE_INVALID_HEADER:
+        logger()->info(String::SubString("invalid fcgi header"), Aspect::WORKER);
+        return;
+      case FCGI::PARSE_BEGIN_REQUEST_EXPECTED:
+        logger()->info(String::SubString("begin request expected"), Aspect::WORKER);
+        return;
+      case FCGI::PARSE_INVALID_ID:
+        logger()->info(String::SubString("invalid FCGI header id"), Aspect::WORKER);
+        return;
+      case FCGI::PARSE_FRAGMENTED_STDIN:
+        logger()->info(String::SubString("fragmented stdin"), Aspect::WORKER);
+        return;
       }
-      while(true);
 
       FCGI::HttpResponse response(1, wbuf_, sizeof(wbuf_));
 
@@ -631,15 +661,18 @@ namespace Frontends
 
       //size_t orig_sendsize = sendsize;
       msg.msg_iov = v.data();
-      msg.msg_iovlen = v.size();
+      size_t iov_left = v.size();
 
       while(sendsize)
       {
-        if(msg.msg_iovlen == 0)
+        if(iov_left == 0)
         {
           assert(0);
         }
 
+        // body segments can produce more buffers than allowed for one call
+        msg.msg_iovlen = std::min(iov_left, static_cast<size_t>(IOV_MAX));
+
         ssize_t res = sendmsg(sock_, &msg, 0);
         if (res == -1)
         {
@@ -675,7 +708,7 @@ namespace Frontends
           if (msg.msg_iov[0].iov_len == 0)
           {
             ++msg.msg_iov;
-            --msg.msg_iovlen;
+            --iov_left;
           }
         }
       }
@@ -132,5 +132,7 @@ namespace Frontends
     WorkerStatsObject_var worker_stats_object_;
     State_var state_;
   };
+
+  typedef ReferenceCounting::SmartPtr<Acceptor> Acceptor_var;
 }
 }
@@ -0,0 +1,1081 @@
+/*
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <limits.h>
+#include <eh/Errno.hpp>
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+#include <Sync/SyncPolicy.hpp>
+#include <Frontends/FrontendCommons/FCGI.hpp>
+
+#include "EpollAcceptor.hpp"
+
+namespace AdServer
+{
+namespace Frontends
+{
+  namespace Aspect
+  {
+    const char EPOLL_ACCEPTOR[] = "FCGI::EpollAcceptor";
+  }
+
+  namespace
+  {
+    // read buffer grows from INITIAL_READ_BUF_SIZE up to MAX_REQUEST_SIZE
+    // and released when request processed (request handlers can keep it)
+    const size_t INITIAL_READ_BUF_SIZE = 16 * 1024;
+    const size_t MAX_REQUEST_SIZE = 1024 * 1024;
+    const size_t RESPONSE_BUF_SIZE = 1024 * 1024;
+    // buffer enough for response without body (overflow reply)
+    const size_t SMALL_RESPONSE_BUF_SIZE = 4 * 1024;
+    const int MAX_EVENTS = 64;
+    const int HTTP_SERVICE_UNAVAILABLE = 503;
+  }
+
+  // EpollAcceptor::Connection
+  class EpollAcceptor::Connection: public ReferenceCounting::AtomicImpl
+  {
+  public:
+    Connection(int sock_val) throw ()
+      : sock(sock_val),
+        rsize(0),
+        request_size(0),
+        pending_pos(0)
+    {}
+
+    int sock;
+    FCGI::ReceiveBuffer_var rbuf;
+    // received size, can be greater then request_size if next request
+    // received with current (pipelining)
+    size_t rsize;
+    size_t request_size;
+    FCGI::RequestScanner scanner;
+    std::unique_ptr<FCGI::HttpRequest> request;
+
+    // response part that wasn't sent by worker (socket buffer is full),
+    // it is written by io thread
+    std::string pending_output;
+    size_t pending_pos;
+
+  protected:
+    virtual
+    ~Connection() throw ()
+    {
+      if(sock != -1)
+      {
+        ::close(sock);
+      }
+    }
+  };
+
+  // EpollAcceptor::State
+  struct EpollAcceptor::State: public ReferenceCounting::AtomicImpl
+  {
+    typedef Sync::Policy::PosixThread SyncPolicy;
+    typedef std::unordered_map<int, Connection_var> ConnectionMap;
+
+    enum SendResult
+    {
+      SR_SENT,
+      SR_PENDING,
+      SR_ERROR
+    };
+
+    State(
+      Logging::Logger* logger_val,
+      FrontendCommons::FrontendInterface* frontend_val,
+      WorkerStatsObject* worker_stats_val,
+      Generics::ActiveObjectCallback* callback,
+      const char* bind_address_val,
+      unsigned long backlog,
+      unsigned long worker_threads,
+      unsigned long max_pending_requests)
+      throw (eh::Exception);
+
+    /// register accepted socket in epoll
+    void
+    add_connection(int sock) throw ();
+
+    /// wait next request on connection
+    void
+    rearm(Connection* connection) throw ();
+
+    /// wait events on disarmed connection, return false on error
+    bool
+    arm(Connection* connection, uint32_t events) throw ();
+
+    /// pass complete request received into connection buffer
+    /// to workers, return false if request isn't received completely
+    bool
+    start_request(Connection* connection) throw ();
+
+    /// release processed request and start next request:
+    /// already received (pipelined) or wait it
+    void
+    finish_request(Connection* connection) throw ();
+
+    /// reply without frontend processing (all workers busy)
+    void
+    reply_overflow(Connection* connection) throw ();
+
+    void
+    close(Connection* connection) throw ();
+
+    void
+    close_all() throw ();
+
+    char*
+    acquire_response_buffer() throw (eh::Exception);
+
+    void
+    release_response_buffer(char* buf) throw ();
+
+    /// send response to nonblocking socket, if socket buffer is full
+    /// not sent part is saved into connection and
+    /// connection armed for writing in io thread (SR_PENDING returned)
+    SendResult
+    send_response(
+      Connection* connection,
+      FCGI::HttpResponse& response,
+      int status)
+      throw ();
+
+    const Logging::Logger_var logger;
+    const FrontendCommons::Frontend_var frontend;
+    const WorkerStatsObject_var worker_stats;
+    const std::string bind_address;
+    Generics::TaskRunner_var task_runner;
+
+    int epoll_fd;
+    int listen_fd;
+    int stop_fd;
+
+  protected:
+    virtual
+    ~State() throw ();
+
+  private:
+    SyncPolicy::Mutex connections_lock_;
+    ConnectionMap connections_;
+
+    SyncPolicy::Mutex response_buffers_lock_;
+    std::vector<char*> response_buffers_;
+  };
+
+  // EpollAcceptor::ProcessRequestTask
+  class EpollAcceptor::ProcessRequestTask:
+    public Generics::Task,
+    public ReferenceCounting::AtomicImpl
+  {
+  public:
+    ProcessRequestTask(State* state, Connection* connection)
+      throw ();
+
+    virtual void
+    execute() throw ();
+
+  protected:
+    virtual
+    ~ProcessRequestTask() throw ()
+    {}
+
+  private:
+    State_var state_;
+    Connection_var connection_;
+  };
+
+  // EpollAcceptor::IOActiveObject
+  class EpollAcceptor::IOActiveObject: public Commons::DelegateActiveObject
+  {
+  public:
+    IOActiveObject(
+      Generics::ActiveObjectCallback* callback,
+      State* state,
+      unsigned long threads)
+      throw (eh::Exception);
+
+  protected:
+    virtual
+    ~IOActiveObject() throw ()
+    {}
+
+    virtual void
+    work_() throw ();
+
+    virtual void
+    terminate_() throw ();
+
+    void
+    accept_() throw ();
+
+    void
+    read_(Connection* connection) throw ();
+
+    void
+    write_pending_(Connection* connection) throw ();
+
+  private:
+    Generics::ActiveObjectCallback_var callback_;
+    State_var state_;
+  };
+
+  // State implementation
+  EpollAcceptor::State::State(
+    Logging::Logger* logger_val,
+    FrontendCommons::FrontendInterface* frontend_val,
+    WorkerStatsObject* worker_stats_val,
+    Generics::ActiveObjectCallback* callback,
+    const char* bind_address_val,
+    unsigned long backlog,
+    unsigned long worker_threads,
+    unsigned long max_pending_requests)
+    throw (eh::Exception)
+    : logger(ReferenceCounting::add_ref(logger_val)),
+      frontend(ReferenceCounting::add_ref(frontend_val)),
+      worker_stats(ReferenceCounting::add_ref(worker_stats_val)),
+      bind_address(bind_address_val),
+      epoll_fd(-1),
+      listen_fd(-1),
+      stop_fd(-1)
+  {
+    task_runner = new Generics::TaskRunner(
+      callback,
+      worker_threads,
+      0, // stack_size
+      max_pending_requests);
+
+    epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+
+    if(epoll_fd == -1)
+    {
+      eh::throw_errno_exception<Exception>(errno, FNE, "epoll_create1() failed");
+    }
+
+    stop_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if(stop_fd == -1)
+    {
+      eh::throw_errno_exception<Exception>(errno, FNE, "eventfd() failed");
+    }
+
+    listen_fd = ::socket(AF_LOCAL, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if(listen_fd == -1)
+    {
+      eh::throw_errno_exception<Exception>(errno, FNE, "socket() failed");
+    }
+
+    sockaddr_un bind_addr;
+    ::memset(&bind_addr, 0, sizeof(bind_addr));
+
+    bind_addr.sun_family = AF_UNIX;
+    ::strncpy(bind_addr.sun_path, bind_address_val, sizeof(bind_addr.sun_path) - 1);
+
+    // check if socket file was not removed earlier
+    struct stat bind_address_stat;
+    if(::stat(bind_address_val, &bind_address_stat) == 0 &&
+      S_ISSOCK(bind_address_stat.st_mode))
+    {
+      ::unlink(bind_address_val);
+    }
+
+    if(::bind(
+      listen_fd,
+      (struct sockaddr *)&bind_addr,
+      sizeof(bind_addr)) == -1)
+    {
+      eh::throw_errno_exception<Exception>(errno, FNE, "bind() failed");
+    }
+
+    if(::listen(listen_fd, backlog) == -1)
+    {
+      eh::throw_errno_exception<Exception>(errno, FNE, "listen() failed");
+    }
+
+    // listen socket and stop event are level triggered
+    // and shared by all io threads
+    epoll_event ev;
+    ::memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = 0;
+
+    if(::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) == -1)
+    {
+      eh::throw_errno_exception<Exception>(errno, FNE, "epoll_ctl() failed");
+    }
+
+    ev.data.ptr = this;
+
+    if(::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &ev) == -1)
+    {
+      eh::throw_errno_exception<Exception>(errno, FNE, "epoll_ctl() failed");
+    }
+
+    response_buffers_.reserve(worker_threads);
+  }
+
+  EpollAcceptor::State::~State() throw ()
+  {
+    for(auto buf_it = response_buffers_.begin();
+      buf_it != response_buffers_.end(); ++buf_it)
+    {
+      delete [] *buf_it;
+    }
+
+    if(listen_fd != -1)
+    {
+      ::close(listen_fd);
+      ::unlink(bind_address.c_str());
+    }
+
+    if(stop_fd != -1)
+    {
+      ::close(stop_fd);
+    }
+
+    if(epoll_fd != -1)
+    {
+      ::close(epoll_fd);
+    }
+  }
+
+  void
+  EpollAcceptor::State::add_connection(int sock) throw ()
+  {
+    Connection_var connection = new Connection(sock);
+
+    {
+      SyncPolicy::WriteGuard lock(connections_lock_);
+      connections_.insert(std::make_pair(sock, connection));
+    }
+
+    worker_stats->incr_workers();
+
+    epoll_event ev;
+    ::memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.ptr = connection.in();
+
+    if(::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock, &ev) == -1)
+    {
+      char err_msg[256];
+      eh::ErrnoHelper::compose_safe(
+        err_msg, sizeof(err_msg), errno, FNE, "epoll_ctl() failed");
+      logger->error(String::SubString(err_msg), Aspect::EPOLL_ACCEPTOR);
+      close(connection);
+    }
+  }
+
+  void
+  EpollAcceptor::State::rearm(Connection* connection) throw ()
+  {
+    if(!arm(connection, EPOLLIN | EPOLLRDHUP))
+    {
+      close(connection);
+    }
+  }
+
+  bool
+  EpollAcceptor::State::arm(Connection* connection, uint32_t events) throw ()
+  {
+    epoll_event ev;
+    ::memset(&ev, 0, sizeof(ev));
+    ev.events = events | EPOLLONESHOT;
+    ev.data.ptr = connection;
+
+    return ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection->sock, &ev) != -1;
+  }
+
+  bool
+  EpollAcceptor::State::start_request(Connection* connection) throw ()
+  {
+    size_t request_size = 0;
+
+    // only records received after previous call are checked
+    int parse_res = connection->scanner.scan(
+      connection->rbuf->data(), connection->rsize, request_size);
+
+    if(parse_res == FCGI::PARSE_NEED_MORE)
+    {
+      return false;
+    }
+
+    if(parse_res == FCGI::PARSE_OK)
+    {
+      // request parsed once when it received completely
+      connection->request_size = request_size;
+      connection->request.reset(new FCGI::HttpRequest());
+      parse_res = connection->request->parse(
+        connection->rbuf, request_size);
+    }
+
+    switch(parse_res)
+    {
+    case FCGI::PARSE_OK:
+      try
+      {
+        task_runner->enqueue_task(
+          Generics::Task_var(new ProcessRequestTask(this, connection)));
+      }
+      catch(const Generics::TaskRunner::Overflow&)
+      {
+        reply_overflow(connection);
+      }
+      catch(const eh::Exception&)
+      {
+        close(connection);
+      }
+      return true;
+
+    case FCGI::PARSE_NEED_MORE:
+      logger->info(
+        String::SubString("not complete request"), Aspect::EPOLL_ACCEPTOR);
+      break;
+
+    case FCGI::PARSE_INVALID_HEADER:
+      logger->info(
+        String::SubString("invalid fcgi header"), Aspect::EPOLL_ACCEPTOR);
+      break;
+
+    case FCGI::PARSE_BEGIN_REQUEST_EXPECTED:
+      logger->info(
+        String::SubString("begin request expected"), Aspect::EPOLL_ACCEPTOR);
+      break;
+
+    case FCGI::PARSE_INVALID_ID:
+      logger->info(
+        String::SubString("invalid FCGI header id"), Aspect::EPOLL_ACCEPTOR);
+      break;
+
+    case FCGI::PARSE_FRAGMENTED_STDIN:
+      logger->info(
+        String::SubString("fragmented stdin"), Aspect::EPOLL_ACCEPTOR);
+      break;
+    }
+
+    close(connection);
+    return true;
+  }
+
+  void
+  EpollAcceptor::State::finish_request(Connection* connection) throw ()
+  {
+    const size_t next_size = connection->rsize - connection->request_size;
+
+    connection->request.reset();
+    connection->scanner.reset();
+
+    if(next_size == 0)
+    {
+      // buffer is released: connection don't hold memory while it wait request
+      connection->rbuf = FCGI::ReceiveBuffer_var();
+      connection->rsize = 0;
+      connection->request_size = 0;
+      rearm(connection);
+      return;
+    }
+
+    // next request data received with processed request:
+    // move it into new buffer (processed request buffer can be referenced
+    // by request handlers)
+    try
+    {
+      FCGI::ReceiveBuffer_var rbuf = new FCGI::ReceiveBuffer(
+        std::max(next_size, INITIAL_READ_BUF_SIZE));
+      ::memcpy(
+        rbuf->data(),
+        connection->rbuf->data() + connection->request_size,
+        next_size);
+      connection->rbuf = rbuf;
+    }
+    catch(const eh::Exception&)
+    {
+      close(connection);
+      return;
+    }
+
+    connection->rsize = next_size;
+    connection->request_size = 0;
+
+    if(!start_request(connection))
+    {
+      rearm(connection);
+    }
+  }
+
+  void
+  EpollAcceptor::State::reply_overflow(Connection* connection) throw ()
+  {
+    // all workers busy and queue is full: reply without frontend processing
+    char buf[SMALL_RESPONSE_BUF_SIZE];
+    SendResult send_res;
+
+    {
+      FCGI::HttpResponse response(1, buf, sizeof(buf));
+      send_res = send_response(
+        connection, response, HTTP_SERVICE_UNAVAILABLE);
+    }
+
+    if(send_res == SR_SENT)
+    {
+      if(connection->rsize > connection->request_size)
+      {
+        // don't process pipelined requests while workers are overloaded
+        close(connection);
+      }
+      else
+      {
+        finish_request(connection);
+      }
+    }
+    else if(send_res == SR_ERROR)
+    {
+      close(connection);
+    }
+  }
+
+  void
+  EpollAcceptor::State::close(Connection* connection) throw ()
+  {
+    // connection is disarmed (EPOLLONESHOT) and owned by caller thread
+    Connection_var holder = ReferenceCounting::add_ref(connection);
+    const int sock = connection->sock;
+
+    {
+      SyncPolicy::WriteGuard lock(connections_lock_);
+      if(connections_.erase(sock) == 0)
+      {
+        return;
+      }
+    }
+
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, sock, 0);
+    ::shutdown(sock, SHUT_RDWR);
+    ::close(sock);
+    connection->sock = -1;
+
+    worker_stats->dec_workers();
+  }
+
+  void
+  EpollAcceptor::State::close_all() throw ()
+  {
+    ConnectionMap connections;
+
+    {
+      SyncPolicy::WriteGuard lock(connections_lock_);
+      connections.swap(connections_);
+    }
+
+    for(auto conn_it = connections.begin();
+      conn_it != connections.end(); ++conn_it)
+    {
+      ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn_it->first, 0);
+      ::shutdown(conn_it->first, SHUT_RDWR);
+      ::close(conn_it->first);
+      conn_it->second->sock = -1;
+      worker_stats->dec_workers();
+    }
+  }
+
+  char*
+  EpollAcceptor::State::acquire_response_buffer() throw (eh::Exception)
+  {
+    {
+      SyncPolicy::WriteGuard lock(response_buffers_lock_);
+      if(!response_buffers_.empty())
+      {
+        char* buf = response_buffers_.back();
+        response_buffers_.pop_back();
+        return buf;
+      }
+    }
+
+    // pool grows up to number of worker threads
+    return new char[RESPONSE_BUF_SIZE];
+  }
+
+  void
+  EpollAcceptor::State::release_response_buffer(char* buf) throw ()
+  {
+    SyncPolicy::WriteGuard lock(response_buffers_lock_);
+    response_buffers_.push_back(buf);
+  }
+
+  EpollAcceptor::State::SendResult
+  EpollAcceptor::State::send_response(
+    Connection* connection,
+    FCGI::HttpResponse& response,
+    int status)
+    throw ()
+  {
+    std::vector<String::SubString> buffers;
+    size_t sendsize = response.end_response(buffers, status);
+
+    std::vector<iovec> v(buffers.size());
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+
+    size_t vec_i = 0;
+    for(auto buf_it = buffers.begin(); buf_it != buffers.end(); ++buf_it, ++vec_i)
+    {
+      v[vec_i].iov_base = (void*)buf_it->data();
+      v[vec_i].iov_len = buf_it->size();
+    }
+
+    msg.msg_iov = v.data();
+    size_t iov_left = v.size();
+
+    while(sendsize)
+    {
+      // body segments can produce more buffers than allowed for one call
+      msg.msg_iovlen = std::min(iov_left, static_cast<size_t>(IOV_MAX));
+
+      ssize_t res = ::sendmsg(connection->sock, &msg, MSG_NOSIGNAL);
+
+      if(res == -1)
+      {
+        if(errno == EINTR)
+        {
+          continue;
+        }
+
+        if(errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+          // socket buffer is full: worker don't wait it,
+          // response buffers will be released - copy not sent part
+          // and pass connection to io thread
+          try
+          {
+            connection->pending_output.reserve(sendsize);
+
+            for(size_t i = 0; i < iov_left; ++i)
+            {
+              connection->pending_output.append(
+                static_cast<const char*>(msg.msg_iov[i].iov_base),
+                msg.msg_iov[i].iov_len);
+            }
+          }
+          catch(const eh::Exception&)
+          {
+            return SR_ERROR;
+          }
+
+          connection->pending_pos = 0;
+
+          return arm(connection, EPOLLOUT) ? SR_PENDING : SR_ERROR;
+        }
+
+        return SR_ERROR;
+      }
+
+      while(res > 0)
+      {
+        size_t n = std::min((size_t)res, msg.msg_iov[0].iov_len);
+        msg.msg_iov[0].iov_base = ((char*)msg.msg_iov[0].iov_base) + n;
+        msg.msg_iov[0].iov_len -= n;
+        res -= n;
+        sendsize -= n;
+
+        if(msg.msg_iov[0].iov_len == 0)
+        {
+          ++msg.msg_iov;
+          --iov_left;
+        }
+      }
+    }
+
+    return SR_SENT;
+  }
+
+  // ProcessRequestTask implementation
+  EpollAcceptor::ProcessRequestTask::ProcessRequestTask(
+    State* state,
+    Connection* connection)
+    throw ()
+    : state_(ReferenceCounting::add_ref(state)),
+      connection_(ReferenceCounting::add_ref(connection))
+  {}
+
+  void
+  EpollAcceptor::ProcessRequestTask::execute() throw ()
+  {
+    FCGI::HttpRequest& request = *connection_->request;
+    char* buf;
+
+    try
+    {
+      buf = state_->acquire_response_buffer();
+    }
+    catch(const eh::Exception&)
+    {
+      state_->close(connection_);
+      return;
+    }
+
+    State::SendResult send_res;
+
+    {
+      FCGI::HttpResponse response(1, buf, RESPONSE_BUF_SIZE);
+
+      int res = 0;
+
+      try
+      {
+        res = state_->frontend->handle_request_noparams(request, response);
+      }
+      catch (const eh::Exception& e)
+      {
+        res = 500; //HTTP_INTERNAL_SERVER_ERROR
+        Stream::Error ostr;
+        ostr << "Can't handle request '" << request.uri() <<
+          "': " << e.what();
+        state_->logger->error(ostr.str(), Aspect::EPOLL_ACCEPTOR);
+      }
+
+      if (res == 0)
+      {
+        res = 200; // OK
+      }
+
+      send_res = state_->send_response(connection_, response, res);
+    }
+
+    state_->release_response_buffer(buf);
+
+    // connection passed to io thread if response is pending
+    if(send_res == State::SR_SENT)
+    {
+      state_->finish_request(connection_);
+    }
+    else if(send_res == State::SR_ERROR)
+    {
+      state_->close(connection_);
+    }
+  }
+
+  // IOActiveObject implementation
+  EpollAcceptor::IOActiveObject::IOActiveObject(
+    Generics::ActiveObjectCallback* callback,
+    State* state,
+    unsigned long threads)
+    throw (eh::Exception)
+    : Commons::DelegateActiveObject(callback, threads, 128*1024),
+      callback_(ReferenceCounting::add_ref(callback)),
+      state_(ReferenceCounting::add_ref(state))
+  {}
+
+  void
+  EpollAcceptor::IOActiveObject::work_() throw ()
+  {
+    epoll_event events[MAX_EVENTS];
+
+    while(active())
+    {
+      int n = ::epoll_wait(state_->epoll_fd, events, MAX_EVENTS, -1);
+
+      if(n == -1)
+      {
+        if(errno != EINTR)
+        {
+          char err_msg[256];
+          eh::ErrnoHelper::compose_safe(
+            err_msg, sizeof(err_msg), errno, FNE, "epoll_wait() failed");
+          callback_->error(String::SubString(err_msg));
+        }
+
+        continue;
+      }
+
+      for(int i = 0; i < n; ++i)
+      {
+        void* const ptr = events[i].data.ptr;
+
+        if(ptr == 0)
+        {
+          accept_();
+        }
+        else if(ptr == state_.in())
+        {
+          // stop event stay signaled: all io threads will see it
+          return;
+        }
+        else
+        {
+          Connection* connection = static_cast<Connection*>(ptr);
+
+          if(!connection->pending_output.empty())
+          {
+            write_pending_(connection);
+          }
+          else
+          {
+            read_(connection);
+          }
+        }
+      }
+    }
+  }
+
+  void
+  EpollAcceptor::IOActiveObject::terminate_() throw ()
+  {
+    const uint64_t val = 1;
+    ssize_t res = ::write(state_->stop_fd, &val, sizeof(val));
+    (void)res;
+  }
+
+  void
+  EpollAcceptor::IOActiveObject::accept_() throw ()
+  {
+    while(true)
+    {
+      sockaddr_un peer_addr;
+      socklen_t p_size = sizeof(peer_addr);
+      int sock = ::accept4(
+        state_->listen_fd,
+        (struct sockaddr*)&peer_addr,
+        &p_size,
+        SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+      if(sock == -1)
+      {
+        if(errno == EINTR)
+        {
+          continue;
+        }
+
+        if(errno != EAGAIN && errno != EWOULDBLOCK && active())
+        {
+          char err_msg[256];
+          eh::ErrnoHelper::compose_safe(
+            err_msg, sizeof(err_msg), errno, FNE, "accept() failed");
+          callback_->error(String::SubString(err_msg));
+        }
+
+        return;
+      }
+
+      state_->add_connection(sock);
+    }
+  }
+
+  void
+  EpollAcceptor::IOActiveObject::read_(Connection* connection) throw ()
+  {
+    while(true)
+    {
+      if(!connection->rbuf.in())
+      {
+        connection->rbuf = new FCGI::ReceiveBuffer(INITIAL_READ_BUF_SIZE);
+      }
+      else if(connection->rsize == connection->rbuf->size())
+      {
+        if(connection->rsize >= MAX_REQUEST_SIZE)
+        {
+          state_->logger->info(
+            String::SubString("request too big"),
+            Aspect::EPOLL_ACCEPTOR);
+          state_->close(connection);
+          return;
+        }
+
+        connection->rbuf->resize(std::min(
+          connection->rsize * 2,
+          MAX_REQUEST_SIZE));
+      }
+
+      ssize_t recv_res = ::recv(
+        connection->sock,
+        connection->rbuf->data() + connection->rsize,
+        connection->rbuf->size() - connection->rsize,
+        0);
+
+      if(recv_res == -1)
+      {
+        if(errno == EINTR)
+        {
+          continue;
+        }
+
+        if(errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+          state_->rearm(connection);
+        }
+        else
+        {
+          state_->close(connection);
+        }
+
+        return;
+      }
+
+      if(recv_res == 0)
+      {
+        // connection closed by peer
+        state_->close(connection);
+        return;
+      }
+
+      connection->rsize += recv_res;
+
+      if(state_->start_request(connection))
+      {
+        return;
+      }
+    }
+  }
+
+  void
+  EpollAcceptor::IOActiveObject::write_pending_(Connection* connection)
+    throw ()
+  {
+    while(connection->pending_pos < connection->pending_output.size())
+    {
+      ssize_t res = ::send(
+        connection->sock,
+        connection->pending_output.data() + connection->pending_pos,
+        connection->pending_output.size() - connection->pending_pos,
+        MSG_NOSIGNAL);
+
+      if(res == -1)
+      {
+        if(errno == EINTR)
+        {
+          continue;
+        }
+
+        if(errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+          if(!state_->arm(connection, EPOLLOUT))
+          {
+            state_->close(connection);
+          }
+        }
+        else
+        {
+          state_->close(connection);
+        }
+
+        return;
+      }
+
+      connection->pending_pos += res;
+    }
+
+    std::string().swap(connection->pending_output);
+    connection->pending_pos = 0;
+
+    state_->finish_request(connection);
+  }
+
+  // EpollAcceptor implementation
+  EpollAcceptor::EpollAcceptor(
+    Logging::Logger* logger,
+    FrontendCommons::FrontendInterface* frontend,
+    Generics::ActiveObjectCallback* callback,
+    const char* bind_address,
+    unsigned long backlog,
+    unsigned long io_threads,
+    unsigned long worker_threads,
+    unsigned long max_pending_requests)
+    throw (eh::Exception)
+    : callback_(ReferenceCounting::add_ref(callback)),
+      logger_(ReferenceCounting::add_ref(logger)),
+      frontend_(ReferenceCounting::add_ref(frontend)),
+      worker_stats_object_(new WorkerStatsObject(
+        logger,
+        callback)),
+      state_(new EpollAcceptor::State(
+        logger,
+        frontend,
+        worker_stats_object_,
+        callback,
+        bind_address,
+        backlog,
+        worker_threads,
+        max_pending_requests))
+  {
+    add_child_object(state_->task_runner);
+
+    add_child_object(Generics::ActiveObject_var(
+      new IOActiveObject(
+        callback,
+        state_,
+        io_threads)));
+  }
+
+  EpollAcceptor::~EpollAcceptor() throw()
+  {}
+
+  void
+  EpollAcceptor::activate_object()
+    throw (Exception, eh::Exception)
+  {
+    Generics::CompositeActiveObject::activate_object();
+
+    worker_stats_object_->activate_object();
+  }
+
+  void
+  EpollAcceptor::deactivate_object()
+    throw (Exception, eh::Exception)
+  {
+    Generics::CompositeActiveObject::deactivate_object();
+  }
+
+  void
+  EpollAcceptor::wait_object()
+    throw (Exception, eh::Exception)
+  {
+    Generics::CompositeActiveObject::wait_object();
+
+    // io threads and workers stopped - connections can't be used now
+    state_->close_all();
+
+    worker_stats_object_->deactivate_object();
+    worker_stats_object_->wait_object();
+
+    frontend_->shutdown();
+  }
+
+  FrontendCommons::FrontendInterface*
+  EpollAcceptor::handler() throw()
+  {
+    return frontend_.in();
+  }
+
+  Logging::Logger*
+  EpollAcceptor::logger() throw()
+  {
+    return logger_.in();
+  }
+}
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <Generics/Time.hpp>
+#include <Generics/TaskRunner.hpp>
+#include <Generics/CompositeActiveObject.hpp>
+
+#include <Commons/DelegateActiveObject.hpp>
+#include <Frontends/FrontendCommons/FrontendInterface.hpp>
+
+#include "Acceptor.hpp"
+
+namespace AdServer
+{
+namespace Frontends
+{
+  /**
+   * EpollAcceptor
+   * event driven alternative to Acceptor: connections are multiplexed
+   * by io_threads over one epoll descriptor, complete FCGI requests
+   * are processed by fixed pool of worker_threads.
+   * Connection hold read buffer only while request is received,
+   * response buffers are owned by pool (one per worker thread).
+   */
+  class EpollAcceptor:
+    public Generics::CompositeActiveObject,
+    public ReferenceCounting::AtomicImpl
+  {
+  public:
+    DECLARE_EXCEPTION(Exception, eh::DescriptiveException);
+
+    EpollAcceptor(
+      Logging::Logger* logger,
+      FrontendCommons::FrontendInterface* frontend,
+      Generics::ActiveObjectCallback* callback,
+      const char* bind_address,
+      unsigned long backlog,
+      unsigned long io_threads,
+      unsigned long worker_threads,
+      unsigned long max_pending_requests)
+      throw (eh::Exception);
+
+    FrontendCommons::FrontendInterface*
+    handler() throw();
+
+    Logging::Logger*
+    logger() throw();
+
+    virtual void
+    activate_object()
+      throw (Exception, eh::Exception);
+
+    virtual void
+    deactivate_object()
+      throw (Exception, eh::Exception);
+
+    virtual void
+    wait_object()
+      throw (Exception, eh::Exception);
+
+  protected:
+    struct State;
+    typedef ReferenceCounting::SmartPtr<State> State_var;
+
+    class Connection;
+    typedef ReferenceCounting::SmartPtr<Connection> Connection_var;
+
+    class ProcessRequestTask;
+    class IOActiveObject;
+
+  protected:
+    virtual
+    ~EpollAcceptor() throw ();
+
+  private:
+    Generics::ActiveObjectCallback_var callback_;
+    Logging::Logger_var logger_;
+    FrontendCommons::Frontend_var frontend_;
+    WorkerStatsObject_var worker_stats_object_;
+    State_var state_;
+  };
+
+  typedef ReferenceCounting::SmartPtr<EpollAcceptor> EpollAcceptor_var;
+}
+}
@@ -28,6 +28,7 @@
 #include "FCGIServer.hpp"
 #include "FrontendsPool.hpp"
 #include "Acceptor.hpp"
+#include "EpollAcceptor.hpp"
 
 namespace
 {
@@ -259,15 +260,32 @@ namespace Frontends
       for(auto bind_it = config_->BindSocket().begin(); bind_it != config_->BindSocket().end();
         ++bind_it)
       {
-        add_child_object(
-          Generics::ActiveObject_var(
-            new Acceptor(
-              logger(),
-              frontend_pool,
-              callback(),
-              bind_it->bind().data(),
-              bind_it->backlog(),
-              bind_it->accept_threads())));
+        if(bind_it->mode() == "epoll")
+        {
+          add_child_object(
+            Generics::ActiveObject_var(
+              new EpollAcceptor(
+                logger(),
+                frontend_pool,
+                callback(),
+                bind_it->bind().data(),
+                bind_it->backlog(),
+                bind_it->io_threads(),
+                bind_it->worker_threads(),
+                bind_it->max_pending_requests())));
+        }
+        else
+        {
+          add_child_object(
+            Generics::ActiveObject_var(
+              new Acceptor(
+                logger(),
+                frontend_pool,
+                callback(),
+                bind_it->bind().data(),
+                bind_it->backlog(),
+                bind_it->accept_threads())));
+        }
       }
 
       frontend_pool->init();
@@ -163,6 +163,11 @@ namespace FrontendCommons
     get_colocation_flags()
       throw (Exception);
 
+    AdServer::CampaignSvcs::CampaignManager::BidEligibilityInfo_var
+    get_bid_eligibility(
+      const AdServer::CampaignSvcs::TimestampInfo& known_version)
+      throw (Exception);
+
     AdServer::CampaignSvcs::StringSeq_var
     get_pub_pixels(
       const char* country,
@@ -1280,6 +1285,64 @@ namespace FrontendCommons
     }
   }
 
+  template <typename Exception>
+  AdServer::CampaignSvcs::CampaignManager::BidEligibilityInfo_var
+  CampaignManagersPool<Exception>::get_bid_eligibility(
+    const AdServer::CampaignSvcs::TimestampInfo& known_version)
+    throw (Exception)
+  {
+    static const char* descr = "CampaignManager::get_bid_eligibility(): "
+      "Can't update bid eligibility, caught ";
+    for (;;)
+    {
+      CampaignManagerHandler campaign_manager =
+       campaign_managers_->get_object<Exception>(
+          logger_,
+          Logging::Logger::EMERGENCY,
+          ASPECT_.c_str(),
+          "ADS_ICON-4");
+      try
+      {
+        return campaign_manager->get_bid_eligibility(known_version);
+      }
+      catch (const AdServer::CampaignSvcs::
+        CampaignManager::ImplementationException& ex)
+      {
+        Stream::Error ostr;
+        ostr << descr << "ImplementationException: " <<
+          ex.description;
+
+        logger_->log(ostr.str(),
+          Logging::Logger::EMERGENCY,
+          ASPECT_.c_str(),
+          "ADS-IMPL-118");
+        throw Exception(ostr);
+      }
+      catch (const AdServer::CampaignSvcs::CampaignManager::NotReady& ex)
+      {
+        Stream::Error ostr;
+        ostr << descr << "NotReady exception: " << ex.description;
+
+        logger_->log(ostr.str(),
+          Logging::Logger::NOTICE,
+          ASPECT_.c_str(),
+          "ADS-IMPL-118");
+        campaign_manager.release_bad(ostr.str());
+      }
+      catch (const CORBA::SystemException& ex)
+      {
+        Stream::Error ostr;
+        ostr << descr << "CORBA::SystemException: " << ex;
+
+        campaign_manager.release_bad(ostr.str());
+        logger_->log(ostr.str(),
+          Logging::Logger::EMERGENCY,
+          ASPECT_.c_str(),
+          "ADS-ICON-4");
+      }
+    }
+  }
+
   template <typename Exception>
   AdServer::CampaignSvcs::StringSeq_var
   CampaignManagersPool<Exception>::get_pub_pixels(
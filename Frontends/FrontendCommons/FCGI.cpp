@@ -112,6 +112,65 @@ OutputStream::write(const char_type* s, streamsize n)
 }
 
 
+RequestScanner::RequestScanner() throw ()
+  : pos_(0),
+    id_(0)
+{}
+
+ParseRes
+RequestScanner::scan(const char* buf, size_t size, size_t& request_size)
+  throw ()
+{
+  while(pos_ + FCGI_HEADER_LEN <= size)
+  {
+    const tinyfcgi::header& h =
+      *reinterpret_cast<const tinyfcgi::header*>(buf + pos_);
+
+    if (!h.valid())
+    {
+      return PARSE_INVALID_HEADER;
+    }
+
+    if (id_ == 0)
+    {
+      if (h.type != FCGI_BEGIN_REQUEST)
+      {
+        return PARSE_BEGIN_REQUEST_EXPECTED;
+      }
+      id_ = h.id();
+    }
+    else if (id_ != h.id())
+    {
+      return PARSE_INVALID_ID;
+    }
+
+    const size_t record_size = FCGI_HEADER_LEN + h.size() + h.paddingLength;
+
+    if (pos_ + record_size > size)
+    {
+      // record isn't received completely
+      break;
+    }
+
+    pos_ += record_size;
+
+    if (h.type == FCGI_STDIN && h.size() == 0)
+    {
+      request_size = pos_;
+      return PARSE_OK;
+    }
+  }
+
+  return PARSE_NEED_MORE;
+}
+
+void
+RequestScanner::reset() throw ()
+{
+  pos_ = 0;
+  id_ = 0;
+}
+
 void
 HttpRequest::parse_params(
   const String::SubString& str,
@@ -279,6 +338,13 @@ HttpRequest::parse(char* buf, size_t size)
   return PARSE_OK;
 }
 
+ParseRes
+HttpRequest::parse(ReceiveBuffer* buf, size_t size)
+{
+  buffer_ = ReferenceCounting::add_ref(buf);
+  return parse(buf->data(), size);
+}
+
 namespace {
   std::string CRLF("\r\n");
   std::string STATUS_200("OK");
@@ -292,6 +358,7 @@ namespace {
   std::string STATUS_404("Not Found");
   std::string STATUS_500("Internal Server Error");
   const size_t STATUS_MSG_SIZE = 256;
+  const size_t BODY_CHUNK_SIZE = 16 * 1024;
 }
 
 HttpResponse::HttpResponse(uint16_t id, char* buf, size_t capacity) throw ()
@@ -348,24 +415,26 @@ HttpResponse::write(const String::SubString& str) throw ()
 
   while(str.size() > saved_size)
   {
-    if(body_messages_.empty() ||
-      body_messages_.back()->msg.size() >= body_messages_.back()->msg.capacity())
+    if(body_chunks_.empty() ||
+      body_chunks_.back().size() >= body_chunks_.back().capacity())
     {
-      body_messages_.push_back(
-        std::unique_ptr<MessageHolder>(new MessageHolder(status_msg_.id())));
+      body_chunks_.push_back(std::string());
+      body_chunks_.back().reserve(
+        std::max(BODY_CHUNK_SIZE, str.size() - saved_size));
     }
 
-    tinyfcgi::message& target_body_msg = body_messages_.back()->msg;
+    std::string& target_chunk = body_chunks_.back();
 
-    size_t msg_size = std::min(
+    const size_t chunk_size = std::min(
       str.size() - saved_size,
-      target_body_msg.capacity() - target_body_msg.size());
+      target_chunk.capacity() - target_chunk.size());
 
-    target_body_msg.append(FCGI_STDOUT, str.substr(saved_size, msg_size));
+    // append inside reserved capacity: chunk data isn't reallocated
+    const char* chunk_pos = target_chunk.data() + target_chunk.size();
+    target_chunk.append(str.data() + saved_size, chunk_size);
+    add_body_segment_(String::SubString(chunk_pos, chunk_size));
 
-    assert(target_body_msg);
-
-    saved_size += msg_size;
+    saved_size += chunk_size;
   }
 
   body_size_ += str.size();
@@ -373,6 +442,37 @@ HttpResponse::write(const String::SubString& str) throw ()
   return str.size();
 }
 
+void
+HttpResponse::write_owned(std::string&& str) throw ()
+{
+  if(str.empty())
+  {
+    return;
+  }
+
+  body_chunks_.push_back(std::move(str));
+  const std::string& chunk = body_chunks_.back();
+  add_body_segment_(String::SubString(chunk.data(), chunk.size()));
+  body_size_ += chunk.size();
+}
+
+void
+HttpResponse::add_body_segment_(const String::SubString& str) throw ()
+{
+  if(!body_segments_.empty() &&
+    body_segments_.back().end() == str.begin())
+  {
+    // continuation of previous segment
+    String::SubString& last_segment = body_segments_.back();
+    last_segment = String::SubString(
+      last_segment.data(), last_segment.size() + str.size());
+  }
+  else
+  {
+    body_segments_.push_back(str);
+  }
+}
+
 size_t
 HttpResponse::end_response(
   std::vector<String::SubString>& res,
@@ -414,14 +514,44 @@ HttpResponse::end_response(
 
   end_msg_.end_request(0, FCGI_REQUEST_COMPLETE);
 
-  res.reserve(3 + body_messages_.size());
+  // body records: header built here, content refer to body segment
+  size_t records_count = 0;
+  for(auto it = body_segments_.begin(); it != body_segments_.end(); ++it)
+  {
+    records_count += (it->size() + FCGI_MAX_LENGTH - 1) / FCGI_MAX_LENGTH;
+  }
+
+  body_record_headers_.resize(records_count);
+
+  res.reserve(3 + 2 * records_count);
 
   res.push_back(status_msg_.str());
   res.push_back(headers_msg_.str());
 
-  for(auto it = body_messages_.begin(); it != body_messages_.end(); ++it)
+  const uint16_t id = status_msg_.id();
+  size_t record_i = 0;
+
+  for(auto it = body_segments_.begin(); it != body_segments_.end(); ++it)
   {
-    res.push_back((*it)->msg.str());
+    for(size_t pos = 0; pos < it->size(); pos += FCGI_MAX_LENGTH, ++record_i)
+    {
+      const size_t record_size = std::min(
+        it->size() - pos, static_cast<size_t>(FCGI_MAX_LENGTH));
+
+      FCGI_Header& header = body_record_headers_[record_i];
+      header.version = FCGI_VERSION_1;
+      header.type = FCGI_STDOUT;
+      header.requestIdB1 = static_cast<unsigned char>(id >> 8);
+      header.requestIdB0 = static_cast<unsigned char>(id & 0xFF);
+      header.contentLengthB1 = static_cast<unsigned char>(record_size >> 8);
+      header.contentLengthB0 = static_cast<unsigned char>(record_size & 0xFF);
+      header.paddingLength = 0;
+      header.reserved = 0;
+
+      res.push_back(String::SubString(
+        reinterpret_cast<const char*>(&header), FCGI_HEADER_LEN));
+      res.push_back(it->substr(pos, record_size));
+    }
   }
 
   res.push_back(end_msg_.str());
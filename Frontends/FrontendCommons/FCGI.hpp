@@ -24,7 +24,10 @@
 #include <memory>
 #include <iostream>
 #include <vector>
+#include <list>
 
+#include <ReferenceCounting/AtomicImpl.hpp>
+#include <ReferenceCounting/SmartPtr.hpp>
 #include <Stream/BinaryStream.hpp>
 #include <String/SubString.hpp>
 #include <String/StringManip.hpp>
@@ -88,6 +91,88 @@ namespace FCGI
     PARSE_FRAGMENTED_STDIN
   };
 
+  /**
+   * RequestScanner
+   * incremental framing of FCGI request over received data:
+   * record is passed once it received completely, request is complete
+   * when terminating (empty) FCGI_STDIN record received.
+   * Data after request belong to next request on connection.
+   */
+  class RequestScanner
+  {
+  public:
+    RequestScanner() throw ();
+
+    /**
+     * Continue scanning of buf from first not complete record
+     * @param size size of received data, buf content before it
+     *   can't be changed between calls
+     * @param request_size set to size of request if PARSE_OK returned
+     */
+    ParseRes
+    scan(const char* buf, size_t size, size_t& request_size) throw ();
+
+    void
+    reset() throw ();
+
+  private:
+    size_t pos_;
+    uint16_t id_;
+  };
+
+  /**
+   * ReceiveBuffer
+   * ref counted buffer with received FCGI records,
+   * requests parsed over it keep views (params, headers, body) into buffer
+   * and can be used after connection read next request.
+   */
+  class ReceiveBuffer: public ReferenceCounting::AtomicImpl
+  {
+  public:
+    ReceiveBuffer(size_t size) throw (eh::Exception)
+      : buf_(size)
+    {}
+
+    char*
+    data() throw () { return buf_.data(); }
+
+    size_t
+    size() const throw () { return buf_.size(); }
+
+    // grow buffer with keeping content
+    void
+    resize(size_t size) throw (eh::Exception) { buf_.resize(size); }
+
+    /**
+     * Writable view of received data part (request body) for in place
+     * parsing, only part bytes can be modified, records around it stay
+     * untouched. Caller should hold buffer reference while uses it.
+     * @return null if part isn't placed in buffer
+     */
+    char*
+    writable_part(const String::SubString& part) throw ()
+    {
+      if(part.empty() ||
+        part.data() < buf_.data() ||
+        part.data() + part.size() > buf_.data() + buf_.size())
+      {
+        return 0;
+      }
+
+      return buf_.data() + (part.data() - buf_.data());
+    }
+
+  protected:
+    virtual
+    ~ReceiveBuffer() throw ()
+    {}
+
+  private:
+    std::vector<char> buf_;
+  };
+
+  typedef ReferenceCounting::SmartPtr<ReceiveBuffer> ReceiveBuffer_var;
+
   class HttpRequest
   {
   public:
@@ -167,10 +252,24 @@ namespace FCGI
     bool
     header_only() const throw () { return header_only_; }
 
+    /**
+     * Receive buffer that owns request data,
+     * null if request parsed over plain buffer.
+     * Request views stay valid while buffer referenced.
+     */
+    ReceiveBuffer*
+    buffer() const throw () { return buffer_.in(); }
+
   public:
     ParseRes
     parse(char* buf, size_t size);
 
+    /**
+     * Parse over ref counted buffer without copying of request data
+     */
+    ParseRes
+    parse(ReceiveBuffer* buf, size_t size);
+
   private:
     Method method_;
     String::SubString body_;
@@ -182,6 +281,7 @@ namespace FCGI
     mutable InputStream input_stream_;
     bool header_only_;
     bool secure_;
+    ReceiveBuffer_var buffer_;
   };
 
   class HttpResponse
@@ -206,9 +306,25 @@ namespace FCGI
     OutputStream&
     get_output_stream() throw ();
 
+    /**
+     * Append copy of str to body
+     */
     ssize_t
     write(const String::SubString& str) throw ();
 
+    /**
+     * Append body part without copying: response takes ownership of str
+     * (use for instantiated creatives, serialized bid responses)
+     */
+    void
+    write_owned(std::string&& str) throw ();
+
+    /**
+     * Fill res with buffers for gather write:
+     * status and headers records, FCGI record header and data for each
+     * body segment (body isn't copied), end request record.
+     * Buffers are valid while response exists.
+     */
     size_t
     end_response(
       std::vector<String::SubString>& res,
@@ -218,22 +334,19 @@ namespace FCGI
     cookie_installed() const throw();
 
   private:
-    struct MessageHolder
-    {
-      MessageHolder(uint16_t id)
-        : buf(MAX_SIZE),
-          msg(id, buf.data(), MAX_SIZE)
-      {};
-
-      static const size_t MAX_SIZE = 64 * 1024 - 1;
-      std::vector<char> buf;
-      tinyfcgi::message msg;
-    };
+    void
+    add_body_segment_(const String::SubString& str) throw ();
 
   private:
+    // owned body parts: copies of written data and moved strings,
+    // list provide stable addresses for segments
+    typedef std::list<std::string> BodyChunkList;
+
     tinyfcgi::message status_msg_;
     tinyfcgi::message headers_msg_;
-    std::vector<std::unique_ptr<MessageHolder> > body_messages_;
+    BodyChunkList body_chunks_;
+    std::vector<String::SubString> body_segments_;
+    std::vector<FCGI_Header> body_record_headers_;
     tinyfcgi::message end_msg_;
     OutputStream output_stream_;
     size_t body_size_;
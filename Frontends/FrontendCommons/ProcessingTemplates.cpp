@@ -87,8 +87,7 @@ namespace FrontendCommons
       String::TextTemplate::ArgsContainerStringAdapter> args_cont(&args_copy);
     String::TextTemplate::DefaultValue args_with_default(&args_cont);
     String::TextTemplate::ArgsEncoder args_encoder(&args_with_default);
-    std::string res = text_template.instantiate(args_encoder);
-    response.get_output_stream().write(res.data(), res.size());
+    response.write_owned(text_template.instantiate(args_encoder));
 
     return 200;
   }
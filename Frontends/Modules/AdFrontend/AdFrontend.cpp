@@ -606,8 +606,7 @@ namespace AdServer
           FrontendCommons::CORS::set_headers(request, response);
         }
 
-        response.get_output_stream().write(
-          str_response.c_str(), str_response.length());
+        response.write_owned(std::move(str_response));
       }
     }
     catch (const ForbiddenException &ex)
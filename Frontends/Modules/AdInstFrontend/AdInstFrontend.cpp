@@ -880,9 +880,6 @@ namespace Instantiate
         std::string response_body(inst_ad_result->creative_body);
         response.set_content_type(String::SubString(inst_ad_result->mime_format.in()));
 
-        response.get_output_stream().write(
-          response_body.c_str(), response_body.length());
-          
         if(logger()->log_level() >= TraceLevel::MIDDLE)
         {
           Stream::Error ostr;
@@ -892,6 +889,8 @@ namespace Instantiate
             TraceLevel::MIDDLE,
             Aspect::AD_INST_FRONTEND);
         }
+
+        response.write_owned(std::move(response_body));
           
         return 200;
       }
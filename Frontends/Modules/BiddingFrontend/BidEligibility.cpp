@@ -0,0 +1,167 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <CampaignSvcs/CampaignCommons/CampaignTypes.hpp>
+#include <Commons/CorbaAlgs.hpp>
+
+#include "BidEligibility.hpp"
+
+namespace AdServer
+{
+namespace Bidding
+{
+  BidEligibility::BidEligibility(
+    const AdServer::CampaignSvcs::CampaignManager::BidEligibilityInfo& info)
+    throw(eh::Exception)
+    : version_(CorbaAlgs::unpack_time(info.version))
+  {
+    fill_tags_(site_tags_, info.site_tags);
+    fill_tags_(account_tags_, info.account_tags);
+
+    for(CORBA::ULong tag_i = 0; tag_i < info.tags.length(); ++tag_i)
+    {
+      const AdServer::CampaignSvcs::CampaignManager::BidEligibilityTagInfo&
+        tag_info = info.tags[tag_i];
+      CountrySet& countries = tag_countries_[tag_info.tag_id];
+      for(CORBA::ULong country_i = 0;
+          country_i < tag_info.countries.length(); ++country_i)
+      {
+        countries.insert(tag_info.countries[country_i].in());
+      }
+    }
+  }
+
+  ReferenceCounting::SmartPtr<BidEligibility>
+  BidEligibility::update(
+    BidEligibility* current,
+    const AdServer::CampaignSvcs::CampaignManager::BidEligibilityInfo& info)
+    throw(eh::Exception)
+  {
+    if(!info.changed || (
+         current && current->version() == CorbaAlgs::unpack_time(info.version)))
+    {
+      return ReferenceCounting::add_ref(current);
+    }
+
+    return new BidEligibility(info);
+  }
+
+  void
+  BidEligibility::fill_tags_(
+    IdSizeTagMap& result,
+    const AdServer::CampaignSvcs::CampaignManager::BidEligibilityTagKeySeq& tag_keys)
+    throw(eh::Exception)
+  {
+    for(CORBA::ULong key_i = 0; key_i < tag_keys.length(); ++key_i)
+    {
+      const AdServer::CampaignSvcs::CampaignManager::BidEligibilityTagKeyInfo&
+        tag_key = tag_keys[key_i];
+      TagIdArray& tag_ids = result[IdSizeKey(tag_key.id, tag_key.size.in())];
+      CorbaAlgs::convert_sequence(tag_key.tag_ids, tag_ids);
+    }
+  }
+
+  bool
+  BidEligibility::tag_eligible_(
+    const IdSizeTagMap& tags,
+    unsigned long id,
+    const AdServer::CampaignSvcs::StringSeq& sizes,
+    const std::string& country)
+    const throw()
+  {
+    for(CORBA::ULong size_i = 0; size_i < sizes.length(); ++size_i)
+    {
+      IdSizeTagMap::const_iterator tag_it = tags.find(
+        IdSizeKey(id, sizes[size_i].in()));
+
+      if(tag_it != tags.end())
+      {
+        for(TagIdArray::const_iterator tag_id_it = tag_it->second.begin();
+            tag_id_it != tag_it->second.end(); ++tag_id_it)
+        {
+          TagCountryMap::const_iterator country_it =
+            tag_countries_.find(*tag_id_it);
+
+          if(country_it != tag_countries_.end() &&
+             country_it->second.find(country) != country_it->second.end())
+          {
+            return true;
+          }
+        }
+      }
+    }
+
+    return false;
+  }
+
+  bool
+  BidEligibility::eligible(
+    const AdServer::CampaignSvcs::CampaignManager::RequestParams& request_params)
+    const throw()
+  {
+    if(request_params.common_info.request_type ==
+         AdServer::CampaignSvcs::AR_NORMAL)
+    {
+      // tag defined explicitly
+      return true;
+    }
+
+    try
+    {
+      const std::string country(
+        request_params.common_info.location.length() ?
+        request_params.common_info.location[0].country.in() : "");
+
+      for(CORBA::ULong slot_i = 0; slot_i < request_params.ad_slots.length();
+          ++slot_i)
+      {
+        const AdServer::CampaignSvcs::StringSeq& sizes =
+          request_params.ad_slots[slot_i].sizes;
+
+        if(request_params.publisher_site_id &&
+           tag_eligible_(site_tags_, request_params.publisher_site_id, sizes, country))
+        {
+          return true;
+        }
+
+        for(CORBA::ULong acc_i = 0;
+            acc_i < request_params.publisher_account_ids.length(); ++acc_i)
+        {
+          if(tag_eligible_(
+               account_tags_,
+               request_params.publisher_account_ids[acc_i],
+               sizes,
+               country))
+          {
+            return true;
+          }
+        }
+      }
+    }
+    catch(const eh::Exception&)
+    {
+      // don't skip request if check can't be done
+      return true;
+    }
+
+    return false;
+  }
+}
+}
@@ -0,0 +1,162 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BIDDINGFRONTEND_BIDELIGIBILITY_HPP_
+#define BIDDINGFRONTEND_BIDELIGIBILITY_HPP_
+
+#include <string>
+#include <vector>
+#include <set>
+
+#include <eh/Exception.hpp>
+#include <ReferenceCounting/AtomicImpl.hpp>
+#include <ReferenceCounting/SmartPtr.hpp>
+#include <Generics/Time.hpp>
+#include <Generics/Hash.hpp>
+#include <Generics/GnuHashTable.hpp>
+#include <Generics/HashTableAdapters.hpp>
+
+#include <CampaignSvcs/CampaignManager/CampaignManager.hpp>
+
+namespace AdServer
+{
+namespace Bidding
+{
+  /**
+   * BidEligibility
+   * immutable snapshot of campaign manager tags index
+   * (site_id, size) | (publisher account_id, size) -> tag -> countries,
+   * that have indexed campaigns. Used for skip requests, that can't be
+   * bidded, without campaign manager call: check is superset of
+   * campaign manager tag resolving (user status, formats, filters
+   * applied on campaign selection isn't checked).
+   */
+  class BidEligibility: public ReferenceCounting::AtomicImpl
+  {
+  public:
+    BidEligibility(
+      const AdServer::CampaignSvcs::CampaignManager::BidEligibilityInfo& info)
+      throw(eh::Exception);
+
+    /**
+     * snapshot for tags index info received from campaign manager:
+     * current snapshot is kept if index isn't changed (info.changed false
+     * or index version is equal to current snapshot version)
+     */
+    static ReferenceCounting::SmartPtr<BidEligibility>
+    update(
+      BidEligibility* current,
+      const AdServer::CampaignSvcs::CampaignManager::BidEligibilityInfo& info)
+      throw(eh::Exception);
+
+    const Generics::Time&
+    version() const throw();
+
+    bool
+    eligible(
+      const AdServer::CampaignSvcs::CampaignManager::RequestParams& request_params)
+      const throw();
+
+  protected:
+    struct IdSizeKey
+    {
+      IdSizeKey(unsigned long id_val, const char* size_val)
+        : id(id_val),
+          size(size_val)
+      {
+        Generics::Murmur64Hash hasher(hash_);
+        hash_add(hasher, id);
+        hash_add(hasher, size);
+      }
+
+      bool
+      operator==(const IdSizeKey& right) const
+      {
+        return id == right.id && size == right.size;
+      }
+
+      size_t
+      hash() const throw()
+      {
+        return hash_;
+      }
+
+      const unsigned long id;
+      const std::string size;
+
+    private:
+      size_t hash_;
+    };
+
+    typedef std::vector<unsigned long> TagIdArray;
+
+    typedef Generics::GnuHashTable<IdSizeKey, TagIdArray>
+      IdSizeTagMap;
+
+    typedef std::set<std::string> CountrySet;
+
+    typedef Generics::GnuHashTable<Generics::NumericHashAdapter<unsigned long>,
+      CountrySet>
+      TagCountryMap;
+
+  protected:
+    virtual
+    ~BidEligibility() throw() = default;
+
+    static void
+    fill_tags_(
+      IdSizeTagMap& result,
+      const AdServer::CampaignSvcs::CampaignManager::BidEligibilityTagKeySeq& tag_keys)
+      throw(eh::Exception);
+
+    bool
+    tag_eligible_(
+      const IdSizeTagMap& tags,
+      unsigned long id,
+      const AdServer::CampaignSvcs::StringSeq& sizes,
+      const std::string& country)
+      const throw();
+
+  private:
+    Generics::Time version_;
+    IdSizeTagMap site_tags_;
+    IdSizeTagMap account_tags_;
+    TagCountryMap tag_countries_;
+  };
+
+  typedef ReferenceCounting::SmartPtr<BidEligibility>
+    BidEligibility_var;
+}
+}
+
+namespace AdServer
+{
+namespace Bidding
+{
+  inline
+  const Generics::Time&
+  BidEligibility::version() const throw()
+  {
+    return version_;
+  }
+}
+}
+
+#endif /*BIDDINGFRONTEND_BIDELIGIBILITY_HPP_*/
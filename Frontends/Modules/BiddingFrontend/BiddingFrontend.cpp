@@ -46,6 +46,7 @@
 #include <CampaignSvcs/CampaignCommons/CampaignTypes.hpp>
 
 #include "BiddingFrontend.hpp"
+#include "RequestBody.hpp"
 
 namespace Response
 {
@@ -527,6 +528,7 @@ namespace Bidding
       throw (Invalid)
       : to_interrupt(false),
         finished(false),
+        deadline(Generics::Time::ZERO),
         bad_request(false),
         hostname(CORBA::string_dup("")),
         request_params(new RequestParamsHolder),
@@ -560,8 +562,33 @@ namespace Bidding
     virtual bool
     interrupt() const throw()
     {
+      const Generics::Time now = Generics::Time::get_time_of_day();
       Sync::PosixGuard lock(cond);
-      return to_interrupt;
+      return to_interrupt || (deadline != Generics::Time::ZERO && now >= deadline);
+    }
+
+    Generics::Time
+    get_deadline() const throw()
+    {
+      Sync::PosixGuard lock(cond);
+      return deadline;
+    }
+
+    // shorten deadline to exchange processing time limit,
+    // waiting thread is woken up to use new deadline
+    void
+    limit_processing_time(const Generics::Time& max_processing_time)
+      throw()
+    {
+      const Generics::Time new_deadline =
+        start_processing_time_ + max_processing_time;
+
+      Sync::ConditionalGuard guard(cond);
+      if(deadline == Generics::Time::ZERO || new_deadline < deadline)
+      {
+        deadline = new_deadline;
+        cond.signal();
+      }
     }
 
     virtual int
@@ -583,10 +610,43 @@ namespace Bidding
       return start_processing_time_;
     }
 
+  protected:
+    // fill body_ with request body, that can be parsed in place,
+    // in place parsing damages body_, untouched copy is saved for tracing
+    void
+    init_body_(const FCGI::HttpRequest& request)
+      throw (eh::Exception)
+    {
+      if(bid_frontend_->logger()->log_level() >= Logging::Logger::TRACE)
+      {
+        trace_body_.assign(
+          request.body().data(),
+          request.body().size());
+      }
+
+      body_.init(request);
+    }
+
+    void
+    print_body_(std::ostream& out) const throw()
+    {
+      if(!trace_body_.empty())
+      {
+        out << trace_body_;
+      }
+      else
+      {
+        out << "<request body isn't saved, trace logging disabled "
+          "at request receiving>";
+      }
+    }
+
   public:
     mutable Sync::Condition cond;
     bool to_interrupt;
     bool finished;
+    // request processing deadline (guarded by cond), zero if not defined
+    Generics::Time deadline;
     bool bad_request;
     /// The host performed last unbreakable operation.
     CORBA::String_var hostname;
@@ -602,6 +662,11 @@ namespace Bidding
     Frontend* bid_frontend_;
     RequestInfo request_info_;
     const Generics::Time start_processing_time_;
+
+    // request body (used by json based protocols)
+    RequestBody body_;
+    // copy of request body before in place parsing (only for TRACE log level)
+    std::string trace_body_;
   };
 
   //
@@ -620,10 +685,9 @@ namespace Bidding
     {
       static const char* FUN = "Frontend::GoogleRequestTask::GoogleRequestTask()";
 
-      Stream::BinaryStreamReader request_reader(
-        &request.get_input_stream());
-
-      bid_request_.ParseFromIstream(&request_reader);
+      bid_request_.ParseFromArray(
+        request.body().data(),
+        request.body().size());
 
       if(bid_frontend->logger()->log_level() >= Logging::Logger::TRACE)
       {
@@ -706,16 +770,7 @@ namespace Bidding
           bid_frontend, request, start_processing_time),
         uri(request.uri().str())
     {
-      Stream::BinaryStreamReader request_reader(
-        &request.get_input_stream());
-
-      char buf[16 * 1024];
-
-      while(!request_reader.eof() && !request_reader.bad())
-      {
-        request_reader.read(buf, sizeof(buf));
-        bid_request_.append(buf, request_reader.gcount());
-      }
+      init_body_(request);
     }
 
     virtual void
@@ -727,7 +782,8 @@ namespace Bidding
         bad_request_val,
         this,
         request_info_,
-        bid_request_.c_str());
+        body_.data(),
+        body_.size());
 
       bad_request = bad_request_val;
     }
@@ -743,9 +799,7 @@ namespace Bidding
 
       if(!bid_response.empty())
       {
-        FCGI::OutputStream& output = response.get_output_stream();
-        output.write(bid_response.data(), bid_response.size());
-        //output.flush();
+        response.write_owned(std::move(bid_response));
         return 0; //OK;
       }
 
@@ -770,7 +824,7 @@ namespace Bidding
     virtual void
     print_request(std::ostream& out) const throw()
     {
-      out << bid_request_;
+      print_body_(out);
     }
 
   public:
@@ -779,9 +833,6 @@ namespace Bidding
 
   protected:
     virtual ~OpenRtbRequestTask() throw() {}
-
-  private:
-    std::string bid_request_;
   };
 
   //
@@ -798,16 +849,7 @@ namespace Bidding
       : RequestTask(
           bid_frontend, request, start_processing_time)
     {
-      Stream::BinaryStreamReader request_reader(
-        &request.get_input_stream());
-
-      char buf[16 * 1024];
-
-      while(!request_reader.eof() && !request_reader.bad())
-      {
-        request_reader.read(buf, sizeof(buf));
-        bid_request_.append(buf, request_reader.gcount());
-      }
+      init_body_(request);
     }
 
     virtual void
@@ -819,7 +861,8 @@ namespace Bidding
         bad_request_val,
         this,
         request_info_,
-        bid_request_.c_str());
+        body_.data(),
+        body_.size());
 
       bad_request = bad_request_val;
     }
@@ -831,8 +874,7 @@ namespace Bidding
       if(!bid_response.empty())
       {
         response.set_content_type(Response::Type::JSON);
-        FCGI::OutputStream& output = response.get_output_stream();
-        output.write(bid_response.data(), bid_response.size());
+        response.write_owned(std::move(bid_response));
         return 0; //OK;
       }
 
@@ -867,7 +909,7 @@ namespace Bidding
     virtual void
     print_request(std::ostream& out) const throw()
     {
-      out << bid_request_;
+      print_body_(out);
     }
 
   public:
@@ -875,9 +917,6 @@ namespace Bidding
 
   protected:
     virtual ~AppNexusRequestTask() throw() {}
-
-  private:
-    std::string bid_request_;
   };
 
   //
@@ -926,6 +965,101 @@ namespace Bidding
     CORBA::String_var hostname_;
   };
 
+  //
+  // Frontend::AsyncCallTask
+  //
+  class Frontend::AsyncCallTask:
+    public Generics::Task,
+    public ReferenceCounting::AtomicImpl
+  {
+  public:
+    typedef std::function<void()> Call;
+
+    AsyncCallTask(const Call& call)
+      throw (eh::Exception)
+      : call_(call),
+        state_(S_NOT_STARTED)
+    {}
+
+    virtual void
+    execute() throw ()
+    {
+      if(start_())
+      {
+        call_();
+
+        Sync::ConditionalGuard guard(cond_);
+        state_ = S_FINISHED;
+        cond_.signal();
+      }
+    }
+
+    // wait call finish, call is executed in caller thread
+    // if async task runner didn't start it yet (queue overloaded):
+    // caller never wait more then call execution time
+    void
+    wait() throw ()
+    {
+      if(start_())
+      {
+        call_();
+        return;
+      }
+
+      Sync::ConditionalGuard guard(cond_);
+      while(state_ != S_FINISHED)
+      {
+        guard.wait();
+      }
+    }
+
+    // skip call if it isn't started yet, otherwise wait call finish:
+    // call can refer to caller data
+    void
+    cancel() throw ()
+    {
+      Sync::ConditionalGuard guard(cond_);
+      if(state_ == S_NOT_STARTED)
+      {
+        state_ = S_FINISHED;
+        return;
+      }
+
+      while(state_ != S_FINISHED)
+      {
+        guard.wait();
+      }
+    }
+
+  protected:
+    virtual ~AsyncCallTask() throw() {}
+
+  private:
+    enum State
+    {
+      S_NOT_STARTED,
+      S_STARTED,
+      S_FINISHED
+    };
+
+    bool
+    start_() throw ()
+    {
+      Sync::ConditionalGuard guard(cond_);
+      if(state_ != S_NOT_STARTED)
+      {
+        return false;
+      }
+      state_ = S_STARTED;
+      return true;
+    }
+
+  private:
+    const Call call_;
+    Sync::Condition cond_;
+    State state_;
+  };
+
   //
   // Frontend implementation
   //
@@ -1056,6 +1190,18 @@ namespace Bidding
             );
         add_child_object(passback_task_runner_);
 
+        // concurrent downstream calls of request processing
+        async_task_runner_ =
+          new Generics::TaskRunner(
+            callback(),
+            config_->async_threads().present() ?
+              static_cast<unsigned long>(*config_->async_threads()) :
+              static_cast<unsigned long>(config_->threads()), // threads
+            0, // stack_size
+            config_->max_pending_tasks() // max_pending_tasks
+            );
+        add_child_object(async_task_runner_);
+
         Generics::Planner_var task_scheduler(new Generics::Planner(callback()));
         add_child_object(task_scheduler);
 
@@ -1384,14 +1530,19 @@ namespace Bidding
       }
       else
       {
+        request_task->deadline = expire_time;
+
         task_runner_->enqueue_task(request_task);
 
         {
           Sync::ConditionalGuard guard(request_task->cond);
 
-          do
+          while(!request_task->finished)
           {
-            if(!guard.timed_wait(&expire_time))
+            // deadline can be shortened by task after request parsing
+            const Generics::Time deadline = request_task->deadline;
+
+            if(!guard.timed_wait(&deadline))
             {
               // timed out
               request_task->to_interrupt = true;
@@ -1399,7 +1550,6 @@ namespace Bidding
               break;
             }
           }
-          while(!request_task->finished);
 
           bad_request = request_task->bad_request;
         }
@@ -1678,7 +1828,8 @@ namespace Bidding
     bool& bad_request,
     OpenRtbRequestTask* request_task,
     RequestInfo& request_info,
-    const char* bid_request)
+    char* bid_request,
+    size_t bid_request_size)
     throw()
   {
     if(logger()->log_level() >= TraceLevel::MIDDLE)
@@ -1713,16 +1864,18 @@ namespace Bidding
           request_info,
           keywords,
           context,
-          bid_request);
+          bid_request,
+          bid_request_size);
       }
       catch(const InvalidParamException& ex)
       {
         bad_request = true;
         
         Stream::Error ostr;
-        ostr << FUN << ": bad request, " << ex.what() <<
-          ", request: '" << bid_request << "'" << ", uri: '" <<
-          request_task->uri << "'";
+        // bid_request is damaged by in place parsing
+        ostr << FUN << ": bad request, " << ex.what() << ", request: '";
+        request_task->print_request(ostr);
+        ostr << "', uri: '" << request_task->uri << "'";
         
         logger()->log(
           ostr.str(),
@@ -1831,7 +1984,8 @@ namespace Bidding
     bool& bad_request,
     AppNexusRequestTask* request_task,
     RequestInfo& request_info,
-    const char* bid_request)
+    char* bid_request,
+    size_t bid_request_size)
     throw()
   {
     if(logger()->log_level() >= TraceLevel::MIDDLE)
@@ -1866,15 +2020,18 @@ namespace Bidding
           request_info,
           keywords,
           context,
-          bid_request);
+          bid_request,
+          bid_request_size);
       }
       catch(const InvalidParamException& ex)
       {
         bad_request = true;
         
         Stream::Error ostr;
-        ostr << FUN << ": bad request, " << ex.what() <<
-          ", request: '" << bid_request << "'";
+        // bid_request is damaged by in place parsing
+        ostr << FUN << ": bad request, " << ex.what() << ", request: '";
+        request_task->print_request(ostr);
+        ostr << "'";
 
         logger()->log(
           ostr.str(),
@@ -2031,7 +2188,8 @@ namespace Bidding
   Frontend::resolve_user_id_(
     AdServer::Commons::UserId& match_user_id,
     AdServer::CampaignSvcs::CampaignManager::CommonAdRequestInfo& common_info,
-    RequestInfo& request_info)
+    RequestInfo& request_info,
+    const Generics::Time& deadline)
     throw()
   {
     static const char* FUN = "Bidding::Frontend::resolve_user_id_()";
@@ -2117,6 +2275,8 @@ namespace Bidding
             get_request_info.for_set_cookie = false;
             get_request_info.create_timestamp = CorbaAlgs::pack_time(request_info.user_create_time);
             // get_request_info.current_user_id is null
+            get_request_info.time_budget = CorbaAlgs::pack_time_budget(
+              deadline, Generics::Time::get_time_of_day());
 
             user_bind_info = user_bind_mapper->get_user_id(get_request_info);
 
@@ -2298,144 +2458,178 @@ namespace Bidding
     AdServer::CampaignSvcs::CampaignManager::RequestParams& request_params,
     const RequestInfo& request_info,
     const AdServer::Commons::UserId& user_id,
+    const Generics::Time& deadline,
     CORBA::String_var& /*hostname*/,
     const char* keywords)
     throw()
   {
     static const char* FUN = "Bidding::Frontend::trigger_match_()";
 
-    if(!request_info.filter_request)
+    try
     {
+      AdServer::ChannelSvcs::ChannelServerBase::MatchQuery query;
+      query.non_strict_word_match = false;
+      query.non_strict_url_match = false;
+      query.return_negative = false;
+      query.simplify_page = true;
+      query.fill_content = true;
+      query.statuses[0] = 'A';
+      query.statuses[1] = '\0';
+      query.first_url = request_params.common_info.referer;
       try
       {
-        AdServer::ChannelSvcs::ChannelServerBase::MatchQuery query;
-        query.non_strict_word_match = false;
-        query.non_strict_url_match = false;
-        query.return_negative = false;
-        query.simplify_page = true;
-        query.fill_content = true;
-        query.statuses[0] = 'A';
-        query.statuses[1] = '\0';
-        query.first_url = request_params.common_info.referer;
-        try
+        std::string ref_words;
+        FrontendCommons::extract_url_keywords(
+            ref_words,
+            String::SubString(request_params.common_info.referer),
+            common_module_->segmentor());
+        
+        if (!ref_words.empty())
         {
-          std::string ref_words;
-          FrontendCommons::extract_url_keywords(
-              ref_words,
-              String::SubString(request_params.common_info.referer),
-              common_module_->segmentor());
-          
-          if (!ref_words.empty())
-          {
-            query.first_url_words << ref_words;
-          }
-        }
-        catch (const eh::Exception& e)
-        {
-          Stream::Error ostr;
-          
-          ostr << FUN << " url keywords extracting error: " << e.what();
-          
-          logger()->log(ostr.str(),
-            Logging::Logger::TRACE,
-            Aspect::BIDDING_FRONTEND);
+          query.first_url_words << ref_words;
         }
+      }
+      catch (const eh::Exception& e)
+      {
+        Stream::Error ostr;
+        
+        ostr << FUN << " url keywords extracting error: " << e.what();
+        
+        logger()->log(ostr.str(),
+          Logging::Logger::TRACE,
+          Aspect::BIDDING_FRONTEND);
+      }
 
-        // check multiline
+      // check multiline
+      {
+        std::ostringstream urls_ostr;
+        std::ostringstream urls_words_ostr;
+        bool url_word_added = false;
+        for(CORBA::ULong i = 0; i < request_params.common_info.urls.length(); ++i)
         {
-          std::ostringstream urls_ostr;
-          std::ostringstream urls_words_ostr;
-          bool url_word_added = false;
-          for(CORBA::ULong i = 0; i < request_params.common_info.urls.length(); ++i)
-          {
-            urls_ostr << (i != 0 ? "\n" : "") <<
-              request_params.common_info.urls[i];
+          urls_ostr << (i != 0 ? "\n" : "") <<
+            request_params.common_info.urls[i];
 
-            std::string url_words_res;
-            FrontendCommons::extract_url_keywords(
-              url_words_res,
-              String::SubString(request_params.common_info.urls[i]),
-              common_module_->segmentor());
+          std::string url_words_res;
+          FrontendCommons::extract_url_keywords(
+            url_words_res,
+            String::SubString(request_params.common_info.urls[i]),
+            common_module_->segmentor());
 
-            if (!url_words_res.empty())
-            {
-              urls_words_ostr << (url_word_added ? "\n" : "") << url_words_res;
-              url_word_added = true;
-            }
-          }
-          query.urls << urls_ostr.str();
-          const std::string& tmp = urls_words_ostr.str();
-          if (!tmp.empty())
+          if (!url_words_res.empty())
           {
-            query.urls_words << tmp;
+            urls_words_ostr << (url_word_added ? "\n" : "") << url_words_res;
+            url_word_added = true;
           }
         }
-
-        if(keywords)
-        {
-          query.pwords = keywords;
-        }
-        query.swords << request_info.search_words;
-        query.uid = CorbaAlgs::pack_user_id(user_id);
-
-        channel_servers_->match(query, trigger_matched_channels);
-
-        request_params.trigger_match_result.pkw_channels.length(
-          trigger_matched_channels->matched_channels.page_channels.length());
-        std::transform(
-          trigger_matched_channels->matched_channels.page_channels.get_buffer(),
-          trigger_matched_channels->matched_channels.page_channels.get_buffer() +
-            trigger_matched_channels->matched_channels.page_channels.length(),
-          request_params.trigger_match_result.pkw_channels.get_buffer(),
-          convert_channel_atom);
-        request_params.trigger_match_result.url_channels.length(
-          trigger_matched_channels->matched_channels.url_channels.length());
-        std::transform(
-          trigger_matched_channels->matched_channels.url_channels.get_buffer(),
-          trigger_matched_channels->matched_channels.url_channels.get_buffer() +
-            trigger_matched_channels->matched_channels.url_channels.length(),
-          request_params.trigger_match_result.url_channels.get_buffer(),
-          convert_channel_atom);
-        request_params.trigger_match_result.ukw_channels.length(
-          trigger_matched_channels->matched_channels.url_keyword_channels.length());
-        std::transform(
-          trigger_matched_channels->matched_channels.url_keyword_channels.get_buffer(),
-          trigger_matched_channels->matched_channels.url_keyword_channels.get_buffer() +
-            trigger_matched_channels->matched_channels.url_keyword_channels.length(),
-          request_params.trigger_match_result.ukw_channels.get_buffer(),
-          convert_channel_atom);
-        request_params.trigger_match_result.skw_channels.length(
-          trigger_matched_channels->matched_channels.search_channels.length());
-        std::transform(
-          trigger_matched_channels->matched_channels.search_channels.get_buffer(),
-          trigger_matched_channels->matched_channels.search_channels.get_buffer() +
-            trigger_matched_channels->matched_channels.search_channels.length(),
-          request_params.trigger_match_result.skw_channels.get_buffer(),
-          convert_channel_atom);
-        CorbaAlgs::copy_sequence(
-          trigger_matched_channels->matched_channels.uid_channels,
-          request_params.trigger_match_result.uid_channels);
-
-        if(request_params.common_info.user_status ==
-           static_cast<CORBA::ULong>(AdServer::CampaignSvcs::US_OPTIN) &&
-           (trigger_matched_channels->no_track ||
-            trigger_matched_channels->no_adv))
+        query.urls << urls_ostr.str();
+        const std::string& tmp = urls_words_ostr.str();
+        if (!tmp.empty())
         {
-          request_params.common_info.user_status = static_cast<CORBA::ULong>(
-            AdServer::CampaignSvcs::US_BLACKLISTED);
+          query.urls_words << tmp;
         }
       }
-      catch(const FrontendCommons::ChannelServerSessionPool::Exception& ex)
+
+      if(keywords)
       {
-        Stream::Error ostr;
-        ostr << FUN <<
-          ": caught ChannelServerSessionPool::Exception: " <<
-          ex.what();
-        logger()->log(ostr.str(),
-          Logging::Logger::EMERGENCY,
-          Aspect::BIDDING_FRONTEND,
-          "ADS-IMPL-117");
+        query.pwords = keywords;
       }
+      query.swords << request_info.search_words;
+      query.uid = CorbaAlgs::pack_user_id(user_id);
+      query.time_budget = CorbaAlgs::pack_time_budget(
+        deadline, Generics::Time::get_time_of_day());
+
+      channel_servers_->match(query, trigger_matched_channels);
+
+      request_params.trigger_match_result.pkw_channels.length(
+        trigger_matched_channels->matched_channels.page_channels.length());
+      std::transform(
+        trigger_matched_channels->matched_channels.page_channels.get_buffer(),
+        trigger_matched_channels->matched_channels.page_channels.get_buffer() +
+          trigger_matched_channels->matched_channels.page_channels.length(),
+        request_params.trigger_match_result.pkw_channels.get_buffer(),
+        convert_channel_atom);
+      request_params.trigger_match_result.url_channels.length(
+        trigger_matched_channels->matched_channels.url_channels.length());
+      std::transform(
+        trigger_matched_channels->matched_channels.url_channels.get_buffer(),
+        trigger_matched_channels->matched_channels.url_channels.get_buffer() +
+          trigger_matched_channels->matched_channels.url_channels.length(),
+        request_params.trigger_match_result.url_channels.get_buffer(),
+        convert_channel_atom);
+      request_params.trigger_match_result.ukw_channels.length(
+        trigger_matched_channels->matched_channels.url_keyword_channels.length());
+      std::transform(
+        trigger_matched_channels->matched_channels.url_keyword_channels.get_buffer(),
+        trigger_matched_channels->matched_channels.url_keyword_channels.get_buffer() +
+          trigger_matched_channels->matched_channels.url_keyword_channels.length(),
+        request_params.trigger_match_result.ukw_channels.get_buffer(),
+        convert_channel_atom);
+      request_params.trigger_match_result.skw_channels.length(
+        trigger_matched_channels->matched_channels.search_channels.length());
+      std::transform(
+        trigger_matched_channels->matched_channels.search_channels.get_buffer(),
+        trigger_matched_channels->matched_channels.search_channels.get_buffer() +
+          trigger_matched_channels->matched_channels.search_channels.length(),
+        request_params.trigger_match_result.skw_channels.get_buffer(),
+        convert_channel_atom);
+      CorbaAlgs::copy_sequence(
+        trigger_matched_channels->matched_channels.uid_channels,
+        request_params.trigger_match_result.uid_channels);
+    }
+    catch(const FrontendCommons::ChannelServerSessionPool::Exception& ex)
+    {
+      Stream::Error ostr;
+      ostr << FUN <<
+        ": caught ChannelServerSessionPool::Exception: " <<
+        ex.what();
+      logger()->log(ostr.str(),
+        Logging::Logger::EMERGENCY,
+        Aspect::BIDDING_FRONTEND,
+        "ADS-IMPL-117");
+    }
+  }
+
+  void
+  Frontend::uid_match_(
+    AdServer::CampaignSvcs::ChannelIdSeq& uid_channels,
+    const AdServer::Commons::UserId& user_id,
+    const Generics::Time& deadline)
+    throw()
+  {
+    static const char* FUN = "Bidding::Frontend::uid_match_()";
+
+    try
+    {
+      AdServer::ChannelSvcs::ChannelServerBase::MatchQuery query;
+      query.non_strict_word_match = false;
+      query.non_strict_url_match = false;
+      query.return_negative = false;
+      query.simplify_page = false;
+      query.fill_content = false;
+      query.statuses[0] = 'A';
+      query.statuses[1] = '\0';
+      query.uid = CorbaAlgs::pack_user_id(user_id);
+      query.time_budget = CorbaAlgs::pack_time_budget(
+        deadline, Generics::Time::get_time_of_day());
+
+      AdServer::ChannelSvcs::ChannelServerBase::MatchResult_var match_result;
+      channel_servers_->match(query, match_result.out());
+
+      CorbaAlgs::copy_sequence(
+        match_result->matched_channels.uid_channels,
+        uid_channels);
+    }
+    catch(const FrontendCommons::ChannelServerSessionPool::Exception& ex)
+    {
+      Stream::Error ostr;
+      ostr << FUN <<
+        ": caught ChannelServerSessionPool::Exception: " <<
+        ex.what();
+      logger()->log(ostr.str(),
+        Logging::Logger::EMERGENCY,
+        Aspect::BIDDING_FRONTEND,
+        "ADS-IMPL-117");
     }
   }
 
@@ -2447,6 +2641,7 @@ namespace Bidding
     const AdServer::ChannelSvcs::ChannelServerBase::MatchResult* trigger_match_result,
     const AdServer::Commons::UserId& user_id,
     const Generics::Time& time,
+    const Generics::Time& deadline,
     CORBA::String_var& /*hostname*/)
     throw()
   {
@@ -2572,6 +2767,9 @@ namespace Bidding
             }
           }
 
+          match_params.time_budget = CorbaAlgs::pack_time_budget(
+            deadline, Generics::Time::get_time_of_day());
+
           // get merge target profile, if need
           uim_session->match(
             user_info,
@@ -2902,27 +3100,123 @@ namespace Bidding
     AdServer::CampaignSvcs::CampaignManager::RequestParams&
         request_params(*request_task->request_params);
 
+    // deadline: exchange time limit or configured request timeout,
+    // rest of it passed as time budget with each downstream call
+    if(request_info.max_processing_time != Generics::Time::ZERO)
+    {
+      request_task->limit_processing_time(request_info.max_processing_time);
+    }
+
+    const Generics::Time deadline = request_task->get_deadline();
+
+    if(check_interrupt_(fn, "request parsing", request_task))
+    {
+      return false;
+    }
+
+    // skip requests, that can't be resolved to tag with campaigns
+    // (no bid response without downstream calls)
+    {
+      BidEligibility_var bid_eligibility = get_bid_eligibility_();
+
+      if(bid_eligibility.in() && !bid_eligibility->eligible(request_params))
+      {
+        if(stats_.in())
+        {
+          stats_->add_ineligible();
+        }
+
+        return true;
+      }
+    }
+
+    // user resolving (UserBindServer) and trigger matching (ChannelServer)
+    // are independent: triggers are matched asynchronously while user
+    // resolved, trigger matching use user id that known before resolving
+    AdServer::Commons::UserId trigger_match_user_id;
+
+    if(!request_info.filter_request &&
+      request_params.common_info.signed_user_id[0] &&
+      request_params.common_info.user_status != AdServer::CampaignSvcs::US_PROBE)
+    {
+      trigger_match_user_id = CorbaAlgs::unpack_user_id(
+        request_params.common_info.user_id);
+    }
+
+    AdServer::ChannelSvcs::ChannelServerBase::MatchResult_var trigger_match_result;
+    AsyncCallTask_var trigger_match_call;
+
+    if(!request_info.filter_request)
+    {
+      trigger_match_call = async_call_(
+        [&]()
+        {
+          trigger_match_(trigger_match_result.out(), request_params,
+            request_info, trigger_match_user_id, deadline,
+            request_task->hostname, keywords.c_str());
+        });
+    }
+
     // map external id to uid
     resolve_user_id_(
-      user_id,
-      request_params.common_info,
-      request_info);
+      user_id, request_params.common_info, request_info, deadline);
+
+    if(request_info.filter_request)
+    {
+      // filtered by user status: skip trigger matching if it isn't started
+      if(trigger_match_call.in())
+      {
+        trigger_match_call->cancel();
+      }
+
+      trigger_match_result = 0;
+      request_params.trigger_match_result =
+        AdServer::CampaignSvcs::CampaignManager::TriggerMatchResult();
+    }
+    else if(trigger_match_call.in())
+    {
+      trigger_match_call->wait();
+    }
+
+    if(!request_info.filter_request &&
+      trigger_match_result.ptr() &&
+      request_params.common_info.user_status ==
+        static_cast<CORBA::ULong>(AdServer::CampaignSvcs::US_OPTIN) &&
+      (trigger_match_result->no_track ||
+       trigger_match_result->no_adv))
+    {
+      request_params.common_info.user_status = static_cast<CORBA::ULong>(
+        AdServer::CampaignSvcs::US_BLACKLISTED);
+    }
 
-    if(check_interrupt_(fn, "user resolving", request_task))
+    if(check_interrupt_(fn, "user resolving and trigger matching", request_task))
     {
       interrupted = true;
     }
 
-    AdServer::ChannelSvcs::ChannelServerBase::MatchResult_var trigger_match_result;
+    // uid channels of user resolved by external id
+    // matched concurrently with history matching
+    AdServer::CampaignSvcs::ChannelIdSeq uid_channels;
+    bool uid_matching = false;
+    AsyncCallTask_var uid_match_call;
 
-    if (!interrupted)
+    if(!interrupted &&
+      !request_info.filter_request &&
+      user_id != trigger_match_user_id)
     {
-      trigger_match_(trigger_match_result.out(), request_params, request_info, user_id,
-        request_task->hostname, keywords.c_str());
-      
-      if(check_interrupt_(fn, "trigger matching", request_task))
+      // uid channels matched by trigger matching belong to other user id
+      request_params.trigger_match_result.uid_channels.length(0);
+
+      if(!user_id.is_null())
       {
-        interrupted = true;
+        uid_matching = true;
+        uid_match_call = async_call_(
+          std::bind(
+            &Frontend::uid_match_,
+            this,
+            std::ref(uid_channels),
+            std::cref(user_id),
+            std::cref(deadline)));
       }
     }
 
@@ -2939,8 +3233,19 @@ namespace Bidding
         trigger_match_result.ptr(),
         user_id,
         request_info.current_time,
+        deadline,
         request_task->hostname);
 
+      if(uid_matching)
+      {
+        if(uid_match_call.in())
+        {
+          uid_match_call->wait();
+        }
+
+        request_params.trigger_match_result.uid_channels = uid_channels;
+      }
+
       if(check_interrupt_(fn, "history matching", request_task))
       {
         interrupted = true;
@@ -2981,6 +3286,7 @@ namespace Bidding
       (trigger_match_result &&
         (trigger_match_result->no_track || trigger_match_result->no_adv)) ||
       request_info.filter_request,
+      deadline,
       request_task->hostname,
       interrupted);
 
@@ -3073,6 +3379,7 @@ namespace Bidding
     AdServer::CampaignSvcs::CampaignManager::RequestParams& request_params,
     const AdServer::Commons::UserId& user_id,
     bool passback,
+    const Generics::Time& deadline,
     CORBA::String_var& hostname,
     bool interrupted)
     throw()
@@ -3150,16 +3457,14 @@ namespace Bidding
       }
 
       /* fill input channel sequence for CampaignManager */
-      std::size_t uid_channels_length = 0;
-
-      if (trigger_match_result)
-      {
-        uid_channels_length = trigger_match_result->matched_channels.uid_channels.length();
-      }
+      // uid channels of resolved user: matched with triggers or
+      // by separate uid query (user resolved by external id)
+      const AdServer::CampaignSvcs::ChannelIdSeq& uid_channels =
+        request_params.trigger_match_result.uid_channels;
 
       request_params.channels.length(
         history_match_result.channels.length() +
-          uid_channels_length);
+          uid_channels.length());
 
       CORBA::ULong j = 0;
       for (CORBA::ULong i = 0; i < history_match_result.channels.length();
@@ -3168,15 +3473,9 @@ namespace Bidding
           request_params.channels[j] = history_match_result.channels[i].channel_id;
       }
 
-      if (trigger_match_result)
+      for (CORBA::ULong i = 0; i < uid_channels.length(); ++i, ++j)
       {
-        for (CORBA::ULong i = 0;
-             i < trigger_match_result->matched_channels.uid_channels.length();
-             ++i, ++j)
-        {
-          request_params.channels[j] =
-            trigger_match_result->matched_channels.uid_channels[i];
-        }
+        request_params.channels[j] = uid_channels[i];
       }
 
       // Fill CCG keywords
@@ -3310,6 +3609,9 @@ namespace Bidding
       }
       else
       {
+        request_params.time_budget = CorbaAlgs::pack_time_budget(
+          deadline, Generics::Time::get_time_of_day());
+
         campaign_managers_.get_campaign_creative(
           request_params,
           hostname,
@@ -3973,6 +4275,11 @@ namespace Bidding
         "caught eh::Exception: " << e.what();
     }
 
+    if(config_->eligibility_filter())
+    {
+      update_bid_eligibility_();
+    }
+
     try
     {
       planner_->schedule(
@@ -3988,6 +4295,42 @@ namespace Bidding
     }
   }
 
+  void
+  Frontend::update_bid_eligibility_()
+    throw ()
+  {
+    static const char* FUN = "Frontend::update_bid_eligibility_()";
+
+    try
+    {
+      BidEligibility_var old_bid_eligibility = get_bid_eligibility_();
+
+      AdServer::CampaignSvcs::CampaignManager::BidEligibilityInfo_var
+        bid_eligibility_info = campaign_managers_.get_bid_eligibility(
+          old_bid_eligibility.in() ?
+          CorbaAlgs::pack_time(old_bid_eligibility->version()) :
+          AdServer::CampaignSvcs::TimestampInfo());
+
+      BidEligibility_var new_bid_eligibility = BidEligibility::update(
+        old_bid_eligibility, *bid_eligibility_info);
+
+      if(new_bid_eligibility.in() != old_bid_eligibility.in())
+      {
+        set_bid_eligibility_(new_bid_eligibility);
+      }
+    }
+    catch (const eh::Exception& e)
+    {
+      // disable filtering while tags index can't be actualized
+      set_bid_eligibility_(0);
+
+      logger()->sstream(Logging::Logger::CRITICAL,
+        Aspect::BIDDING_FRONTEND,
+        "ADS-IMPL-118") << FUN << ": Can't update bid eligibility, "
+        "caught eh::Exception: " << e.what();
+    }
+  }
+
   void
   Frontend::flush_state_()
     throw ()
@@ -4177,6 +4520,48 @@ namespace Bidding
       "ADS-IMPL-7600");
   }
 
+  Frontend::AsyncCallTask_var
+  Frontend::async_call_(const std::function<void()>& call)
+    throw ()
+  {
+    AsyncCallTask_var task;
+
+    try
+    {
+      task = new AsyncCallTask(call);
+    }
+    catch(const std::exception& ex)
+    {
+      Stream::Error ostr;
+      ostr << "Bidding::Frontend::async_call_(): can't create task: " <<
+        ex.what();
+      logger()->log(ostr.str(),
+        TraceLevel::MIDDLE,
+        Aspect::BIDDING_FRONTEND);
+
+      // fall back to synchronous call
+      call();
+      return AsyncCallTask_var();
+    }
+
+    try
+    {
+      async_task_runner_->enqueue_task(task);
+    }
+    catch(const eh::Exception& ex)
+    {
+      // task will be executed by waiting thread
+      Stream::Error ostr;
+      ostr << "Bidding::Frontend::async_call_(): can't enqueue task: " <<
+        ex.what();
+      logger()->log(ostr.str(),
+        TraceLevel::MIDDLE,
+        Aspect::BIDDING_FRONTEND);
+    }
+
+    return task;
+  }
+
   bool
   Frontend::check_interrupt_(
     const char* fun,
@@ -21,6 +21,8 @@
 #ifndef ADSERVER_BIDDINGFRONTEND_HPP
 #define ADSERVER_BIDDINGFRONTEND_HPP
 
+#include <functional>
+
 #include <eh/Exception.hpp>
 
 #include <Logger/Logger.hpp>
@@ -52,6 +54,7 @@
 #include "GroupLogger.hpp"
 #include "RequestInfoFiller.hpp"
 #include "BiddingFrontendStat.hpp"
+#include "BidEligibility.hpp"
 #include "JsonFormatter.hpp"
 
 namespace AdServer
@@ -141,6 +144,8 @@ namespace Bidding
     class UpdateConfigTask;
     class FlushStateTask;
     class InterruptPassbackTask;
+    class AsyncCallTask;
+    typedef ReferenceCounting::SmartPtr<AsyncCallTask> AsyncCallTask_var;
 
     struct ExtConfig: public ReferenceCounting::AtomicImpl
     {
@@ -163,6 +168,8 @@ namespace Bidding
 
     typedef Sync::Policy::PosixThreadRW
       ExtConfigSyncPolicy;
+    typedef Sync::Policy::PosixThreadRW
+      BidEligibilitySyncPolicy;
     typedef Sync::Policy::PosixThread
       MaxPendingSyncPolicy;
 
@@ -176,7 +183,8 @@ namespace Bidding
       bool& bad_request,
       OpenRtbRequestTask* request_task,
       RequestInfo& request_info,
-      const char* bid_request)
+      char* bid_request,
+      size_t bid_request_size)
       throw();
 
     void
@@ -184,7 +192,8 @@ namespace Bidding
       bool& bad_request,
       AppNexusRequestTask* request_task,
       RequestInfo& request_info,
-      const char* bid_request)
+      char* bid_request,
+      size_t bid_request_size)
       throw();
 
     void
@@ -201,7 +210,8 @@ namespace Bidding
     resolve_user_id_(
       AdServer::Commons::UserId& match_user_id,
       AdServer::CampaignSvcs::CampaignManager::CommonAdRequestInfo& common_info,
-      RequestInfo& request_info)
+      RequestInfo& request_info,
+      const Generics::Time& deadline)
       throw();
 
     void
@@ -210,10 +220,19 @@ namespace Bidding
       AdServer::CampaignSvcs::CampaignManager::RequestParams& request_params,
       const RequestInfo& request_info,
       const AdServer::Commons::UserId& user_id,
+      const Generics::Time& deadline,
       CORBA::String_var& hostname,
       const char* keywords = 0)
       throw();
 
+    // match uid channels only
+    void
+    uid_match_(
+      AdServer::CampaignSvcs::ChannelIdSeq& uid_channels,
+      const AdServer::Commons::UserId& user_id,
+      const Generics::Time& deadline)
+      throw();
+
     void
     history_match_(
       AdServer::UserInfoSvcs::UserInfoMatcher::MatchResult_out history_match_result,
@@ -222,6 +241,7 @@ namespace Bidding
       const AdServer::ChannelSvcs::ChannelServerBase::MatchResult* trigger_match_result,
       const AdServer::Commons::UserId& user_id,
       const Generics::Time& time,
+      const Generics::Time& deadline,
       CORBA::String_var& hostname)
       throw();
 
@@ -259,6 +279,7 @@ namespace Bidding
       AdServer::CampaignSvcs::CampaignManager::RequestParams& request_params,
       const AdServer::Commons::UserId& user_id,
       bool passback,
+      const Generics::Time& deadline,
       CORBA::String_var& hostname,
       bool interrupted)
       throw();
@@ -326,6 +347,15 @@ namespace Bidding
     ExtConfig_var
     get_ext_config_() throw();
 
+    void
+    update_bid_eligibility_() throw ();
+
+    void
+    set_bid_eligibility_(BidEligibility* bid_eligibility) throw();
+
+    BidEligibility_var
+    get_bid_eligibility_() const throw();
+
     bool
     check_interrupt_(
       const char* fun,
@@ -333,6 +363,14 @@ namespace Bidding
       const RequestTask* task)
       throw();
 
+    // enqueue call to async task runner,
+    // result task should be waited before call arguments destroy;
+    // if task can't be created call is executed synchronously
+    // and null is returned
+    AsyncCallTask_var
+    async_call_(const std::function<void()>& call)
+      throw ();
+
     void
     interrupt_(
       const char* fun,
@@ -374,6 +412,9 @@ namespace Bidding
     // ADSC-10554
     // Interrupted requests queue
     Generics::TaskRunner_var passback_task_runner_;
+
+    // downstream calls issued concurrently with request processing
+    Generics::TaskRunner_var async_task_runner_;
     
     // configuration
     CommonConfigPtr common_config_;
@@ -402,6 +443,10 @@ namespace Bidding
     mutable ExtConfigSyncPolicy::Mutex ext_config_lock_;
     ExtConfig_var ext_config_;
 
+    // tags index snapshot, defined only if eligibility filter enabled
+    mutable BidEligibilitySyncPolicy::Mutex bid_eligibility_lock_;
+    BidEligibility_var bid_eligibility_;
+
     Algs::AtomicInt bid_task_count_;
 
     mutable MaxPendingSyncPolicy::Mutex reached_max_pending_tasks_lock_;
@@ -437,6 +482,26 @@ namespace Bidding
     ExtConfigSyncPolicy::ReadGuard lock(ext_config_lock_);
     return ext_config_;
   }
+
+  inline
+  void
+  Frontend::set_bid_eligibility_(BidEligibility* bid_eligibility)
+    throw()
+  {
+    BidEligibility_var new_bid_eligibility =
+      ReferenceCounting::add_ref(bid_eligibility);
+
+    BidEligibilitySyncPolicy::WriteGuard lock(bid_eligibility_lock_);
+    bid_eligibility_.swap(new_bid_eligibility);
+  }
+
+  inline
+  BidEligibility_var
+  Frontend::get_bid_eligibility_() const throw()
+  {
+    BidEligibilitySyncPolicy::ReadGuard lock(bid_eligibility_lock_);
+    return bid_eligibility_;
+  }
 }
 }
 
@@ -36,6 +36,7 @@ namespace
   const Generics::Values::Key BF_REQ_OTHER_BIDS   = "rtbRequestOtherBidCount";
 
   const Generics::Values::Key BF_SKIPPED          = "rtbRequestSkipCount";
+  const Generics::Values::Key BF_INELIGIBLE       = "rtbRequestIneligibleCount";
   const Generics::Values::Key BF_TIMEOUTS         = "rtbRequestTimeoutCount";
   const Generics::Values::Key BF_TIME_COUNTER     = "rtbRequestTimeCounter";
 
@@ -112,7 +113,8 @@ namespace AdServer
       request_openrtb_bid(0),
       request_other(0),
       request_other_bid(0),
-      skipped(0)
+      skipped(0),
+      ineligible(0)
   {}
 
   StatHolder::StatData::StatData(
@@ -129,6 +131,8 @@ namespace AdServer
       request_openrtb_bid(request_openrtb_bid_),
       request_other(request_other_),
       request_other_bid(request_other_bid_),
+      skipped(0),
+      ineligible(0),
       processing_time(processing_time_val)
   {}
 
@@ -141,6 +145,8 @@ namespace AdServer
     request_openrtb_bid += rhs.request_openrtb_bid;
     request_other += rhs.request_other;
     request_other_bid += rhs.request_other_bid;
+    skipped += rhs.skipped;
+    ineligible += rhs.ineligible;
     processing_time += rhs.processing_time;
 
     return *this;
@@ -181,6 +187,13 @@ namespace AdServer
     ++stat_data_.skipped;
   }
 
+  void
+  StatHolder::add_ineligible() throw ()
+  {
+    Sync::PosixGuard lock(mutex_);
+    ++stat_data_.ineligible;
+  }
+
   void
   StatHolder::add_timeout(const Generics::Time& timeout) throw ()
   {
@@ -217,6 +230,7 @@ namespace AdServer
     v->set(BF_REQ_OTHER_BIDS, d.request_other_bid);
 
     v->set(BF_SKIPPED, d.skipped);
+    v->set(BF_INELIGIBLE, d.ineligible);
     std::size_t timeout_counter = 0;
     for (StatData::TimeoutsMap::const_iterator cit = d.timeout_counters.begin();
       cit != d.timeout_counters.end(); ++cit)
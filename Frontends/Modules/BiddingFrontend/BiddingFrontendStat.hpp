@@ -55,6 +55,7 @@ namespace AdServer
       unsigned long request_other;
       unsigned long request_other_bid;
       unsigned long skipped;
+      unsigned long ineligible;
       Generics::Time processing_time;
       typedef std::map<Generics::Time, std::size_t> TimeoutsMap;
       TimeoutsMap timeout_counters;
@@ -73,6 +74,9 @@ namespace AdServer
     void
     add_skipped() throw ();
 
+    void
+    add_ineligible() throw ();
+
     void
     add_timeout(const Generics::Time& timeout) throw ();
 
@@ -266,7 +266,8 @@ namespace Bidding
     typedef std::vector<EIDUID> EIDUIDArray;
  
     JsonProcessingContext()
-      : site(false),
+      : tmax(0),
+        site(false),
         app(false),
         secure(false),
         test(false),
@@ -299,6 +300,7 @@ namespace Bidding
     std::string carrier;
 
     std::string request_id;
+    unsigned long tmax;
     StringList currencies;
     std::string required_category;
     StringList exclude_categories;
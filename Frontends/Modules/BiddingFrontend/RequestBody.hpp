@@ -0,0 +1,134 @@
+/*
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BIDDINGFRONTEND_REQUESTBODY_HPP_
+#define BIDDINGFRONTEND_REQUESTBODY_HPP_
+
+#include <string>
+
+#include <eh/Exception.hpp>
+#include <Frontends/FrontendCommons/FCGI.hpp>
+
+namespace AdServer
+{
+namespace Bidding
+{
+  /**
+   * RequestBody
+   * bid request body that can be parsed in place (json parsers modify it):
+   * body part of request receive buffer is used if request owns buffer,
+   * otherwise body is copied. Body isn't null terminated, parsers
+   * should be limited by end().
+   */
+  class RequestBody
+  {
+  public:
+    RequestBody() throw ();
+
+    void
+    init(const FCGI::HttpRequest& request) throw (eh::Exception);
+
+    char*
+    data() throw ();
+
+    char*
+    end() throw ();
+
+    size_t
+    size() const throw ();
+
+    // body placed in receive buffer (not copied)
+    bool
+    inplace() const throw ();
+
+  private:
+    FCGI::ReceiveBuffer_var buffer_;
+    std::string holder_;
+    char* data_;
+    size_t size_;
+  };
+}
+}
+
+namespace AdServer
+{
+namespace Bidding
+{
+  inline
+  RequestBody::RequestBody() throw ()
+    : data_(0),
+      size_(0)
+  {}
+
+  inline
+  void
+  RequestBody::init(const FCGI::HttpRequest& request)
+    throw (eh::Exception)
+  {
+    const String::SubString& body = request.body();
+    FCGI::ReceiveBuffer* buffer = request.buffer();
+
+    size_ = body.size();
+    data_ = buffer ? buffer->writable_part(body) : 0;
+
+    if(data_)
+    {
+      // request views are released with request,
+      // body part of buffer is owned by this since this point
+      buffer_ = ReferenceCounting::add_ref(buffer);
+    }
+    else
+    {
+      holder_.assign(body.data(), body.size());
+      data_ = &holder_[0];
+    }
+  }
+
+  inline
+  char*
+  RequestBody::data() throw ()
+  {
+    return data_;
+  }
+
+  inline
+  char*
+  RequestBody::end() throw ()
+  {
+    return data_ + size_;
+  }
+
+  inline
+  size_t
+  RequestBody::size() const throw ()
+  {
+    return size_;
+  }
+
+  inline
+  bool
+  RequestBody::inplace() const throw ()
+  {
+    return buffer_.in() != 0;
+  }
+}
+}
+
+#endif /*BIDDINGFRONTEND_REQUESTBODY_HPP_*/
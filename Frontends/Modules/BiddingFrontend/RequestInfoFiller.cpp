@@ -2615,6 +2615,12 @@ namespace Bidding
         new JsonContextStringParamProcessor<JsonProcessingContext>(
           &JsonProcessingContext::request_id)));
 
+    root_processor->add_processor(
+      Request::OpenRtb::MAX_PROCESSING_TIME,
+      JsonRequestParamProcessor_var(
+        new JsonContextNumberParamProcessor<JsonProcessingContext, unsigned long>(
+          &JsonProcessingContext::tmax)));
+
     root_processor->add_processor(
       Request::OpenRtb::CURRENCY,
       JsonRequestParamProcessor_var(
@@ -3274,6 +3280,13 @@ namespace Bidding
 
     init_request_param_(request_params, request_info);
 
+    if(bid_request.has_response_deadline_ms() &&
+      bid_request.response_deadline_ms() > 0)
+    {
+      request_info.max_processing_time =
+        Generics::Time(bid_request.response_deadline_ms()) / 1000;
+    }
+
     Stream::Stack<16> ip_str;
  
     if (bid_request.has_ip() && bid_request.ip().size() == 3)
@@ -4011,7 +4024,8 @@ namespace Bidding
     RequestInfo& request_info,
     std::string& keywords,
     JsonProcessingContext& context,
-    const char* bid_request) const
+    char* bid_request,
+    size_t bid_request_size) const
     throw(InvalidParamException, Exception)
   {
     static const char* FUN = "RequestInfoFiller::fill_by_openrtb_request()";
@@ -4035,29 +4049,34 @@ namespace Bidding
       request_params.fill_track_pixel = true;
     }
 
-    int bid_request_len = ::strlen(bid_request);
-    Generics::ArrayAutoPtr<char> bid_request_holder(bid_request_len + 1);
+    // parse in place: bid_request buffer is owned by request task and
+    // damaged by parsing (task keeps untouched copy for trace logging),
+    // it isn't null terminated (placed in receive buffer)
     JsonValue root_value;
     JsonAllocator json_allocator;
-    char* parse_end = bid_request_holder.get();
-    ::strcpy(bid_request_holder.get(), bid_request);
+    char* const bid_request_end = bid_request + bid_request_size;
+    char* parse_end = bid_request;
     JsonParseStatus status = json_parse(
-      bid_request_holder.get(), &parse_end, &root_value, json_allocator);
-
-    assert(parse_end < bid_request_holder.get() + bid_request_len + 1);
+      bid_request,
+      bid_request_end,
+      &parse_end,
+      &root_value,
+      json_allocator);
 
     if(status != JSON_PARSE_OK)
     {
       Stream::Error ostr;
       ostr << FUN << ": parsing error '" <<
         json_parse_error(status) << "' at pos : ";
-      if(parse_end)
+      if(parse_end < bid_request_end)
       {
-        ostr << std::string(parse_end, 20);
+        ostr << String::SubString(
+          parse_end,
+          std::min(bid_request_end - parse_end, static_cast<ptrdiff_t>(20)));
       }
       else
       {
-        ostr << "null";
+        ostr << "end of request";
       }
       throw InvalidParamException(ostr);
     }
@@ -4085,6 +4104,11 @@ namespace Bidding
     request_info.bid_site_id = context.site_id;
     request_info.bid_request_id = context.request_id;
 
+    if(context.tmax)
+    {
+      request_info.max_processing_time = Generics::Time(context.tmax) / 1000;
+    }
+
     //context.print(std::cerr);
     KeywordFormatter kw_fmt(request_info.source_id);
 
@@ -4943,7 +4967,8 @@ namespace Bidding
     RequestInfo& request_info,
     std::string& keywords,
     JsonProcessingContext& context,
-    const char* bid_request) const
+    char* bid_request,
+    size_t bid_request_size) const
     throw(InvalidParamException, Exception)
   {
     static const char* FUN = "RequestInfoFiller::fill_by_appnexus_request()";
@@ -4954,26 +4979,34 @@ namespace Bidding
 
     init_request_param_(request_params, request_info);
 
+    // parse in place: bid_request buffer is owned by request task and
+    // damaged by parsing (task keeps untouched copy for trace logging),
+    // it isn't null terminated (placed in receive buffer)
     JsonValue root_value;
     JsonAllocator json_allocator;
-    Generics::ArrayAutoPtr<char> bid_request_holder(strlen(bid_request) + 1);
-    char* parse_end;
-    strcpy(bid_request_holder.get(), bid_request);
+    char* const bid_request_end = bid_request + bid_request_size;
+    char* parse_end = bid_request;
     JsonParseStatus status = json_parse(
-      bid_request_holder.get(), &parse_end, &root_value, json_allocator);
+      bid_request,
+      bid_request_end,
+      &parse_end,
+      &root_value,
+      json_allocator);
 
     if(status != JSON_PARSE_OK)
     {
       Stream::Error ostr;
       ostr << FUN << ": parsing error '" <<
         json_parse_error(status) << "' at pos : ";
-      if(parse_end)
+      if(parse_end < bid_request_end)
       {
-        ostr << std::string(parse_end, 20);
+        ostr << String::SubString(
+          parse_end,
+          std::min(bid_request_end - parse_end, static_cast<ptrdiff_t>(20)));
       }
       else
       {
-        ostr << "null";
+        ostr << "end of request";
       }
       throw InvalidParamException(ostr);
     }
@@ -161,6 +161,9 @@ namespace Bidding
     std::string bid_request_id;
     std::string bid_site_id;
     std::string bid_publisher_id;
+
+    // exchange processing time limit (OpenRTB tmax), zero if not defined
+    Generics::Time max_processing_time;
   };
 
   class RequestInfoFiller: public FrontendCommons::HTTPExceptions
@@ -236,13 +239,16 @@ namespace Bidding
       throw(InvalidParamException, Exception);
 
     // OpenRTB, Yandex
+    // bid_request: json of bid_request_size (not null terminated),
+    // parsed in place (will be modified)
     void
     fill_by_openrtb_request(
       AdServer::CampaignSvcs::CampaignManager::RequestParams& request_params,
       RequestInfo& request_info,
       std::string& keywords,
       JsonProcessingContext& context,
-      const char* bid_request) const
+      char* bid_request,
+      size_t bid_request_size) const
       throw(InvalidParamException, Exception);
 
     void
@@ -251,7 +257,8 @@ namespace Bidding
       RequestInfo& request_info,
       std::string& keywords,
       JsonProcessingContext& context,
-      const char* bid_request) const
+      char* bid_request,
+      size_t bid_request_size) const
       throw(InvalidParamException, Exception);
 
     bool
@@ -234,19 +234,22 @@ namespace RequestInfoSvcs
     const Generics::Time& /*cache_timeout*/)
     throw(Exception)
     : logger_(ReferenceCounting::add_ref(logger)),
-      cache_limit_(cache_limit)
+      cache_limit_(cache_limit),
+      match_state_(new MatchState())
   {}
 
   ChannelMatcher::~ChannelMatcher() throw()
   {}
 
+  ChannelMatcher::MatchState::~MatchState() throw()
+  {}
+
   ChannelMatcher::Config_var
   ChannelMatcher::config() const throw(Exception)
   {
     try
     {
-      SyncPolicy::ReadGuard lock(lock_);
-      return ReferenceCounting::add_ref(config_);
+      return match_state_.get()->config;
     }
     catch(const eh::Exception& ex)
     {
@@ -262,8 +265,7 @@ namespace RequestInfoSvcs
   {
     try
     {
-      SyncPolicy::ReadGuard lock(lock_);
-      return ReferenceCounting::add_ref(channel_index_);
+      return match_state_.get()->channel_index;
     }
     catch(const eh::Exception& ex)
     {
@@ -279,14 +281,14 @@ namespace RequestInfoSvcs
   {
     try
     {
-      ExpressionChannelIndex_var ch_index =
+      MatchState_var match_state = new MatchState();
+      match_state->channel_index =
         new AdServer::CampaignSvcs::ExpressionChannelIndex();
-      ch_index->index(new_config->expression_channels);
-      Config_var config = ReferenceCounting::add_ref(new_config);
-      MatchCache_var match_cache;
+      match_state->channel_index->index(new_config->expression_channels);
+      match_state->config = ReferenceCounting::add_ref(new_config);
       if(cache_limit_ > 0)
       {
-        match_cache = new MatchCache(cache_limit_);
+        match_state->match_cache = new MatchCache(cache_limit_);
       }
 
       ChannelActionConfig_var channel_action_config =
@@ -306,12 +308,10 @@ namespace RequestInfoSvcs
         }
       }
 
+      match_state->channel_action_config.swap(channel_action_config);
+
       // cache cache syncronously with config for avoid inconsistent match result
-      SyncPolicy::WriteGuard lock(lock_);
-      config_.swap(config);
-      channel_index_.swap(ch_index);
-      match_cache_.swap(match_cache);
-      channel_action_config_.swap(channel_action_config);
+      match_state_.swap(match_state);
     }
     catch(const eh::Exception& ex)
     {
@@ -356,16 +356,11 @@ namespace RequestInfoSvcs
     ChannelActionMap* result_channel_actions)
     throw(Exception)
   {
-    ExpressionChannelIndex_var channel_index;
-    MatchCache_var match_cache;
-    ChannelActionConfig_var channel_action_config;
-
-    {
-      SyncPolicy::ReadGuard lock(lock_);
-      channel_index = ReferenceCounting::add_ref(channel_index_);
-      match_cache = ReferenceCounting::add_ref(match_cache_);
-      channel_action_config = ReferenceCounting::add_ref(channel_action_config_);
-    }
+    const MatchState_var match_state = match_state_.get();
+    const ExpressionChannelIndex_var& channel_index = match_state->channel_index;
+    const MatchCache_var& match_cache = match_state->match_cache;
+    const ChannelActionConfig_var& channel_action_config =
+      match_state->channel_action_config;
 
     if(match_cache.in())
     {
@@ -28,6 +28,8 @@
 #include <Sync/SyncPolicy.hpp>
 #include <Generics/Time.hpp>
 
+#include <Commons/SnapshotHolder.hpp>
+
 #include <CampaignSvcs/CampaignCommons/ExpressionChannel.hpp>
 #include <CampaignSvcs/CampaignCommons/ExpressionChannelIndex.hpp>
 
@@ -113,7 +115,6 @@ namespace AdServer
         throw(Exception);
 
     private:
-      typedef Sync::Policy::PosixThread SyncPolicy;
       typedef AdServer::CampaignSvcs::ExpressionChannelIndex_var
         ExpressionChannelIndex_var;
 
@@ -134,6 +135,22 @@ namespace AdServer
       typedef ReferenceCounting::SmartPtr<ChannelActionConfig>
         ChannelActionConfig_var;
 
+      // all parts replaced together for avoid inconsistent match result
+      struct MatchState: public ReferenceCounting::AtomicImpl
+      {
+        Config_var config;
+        ExpressionChannelIndex_var channel_index;
+        MatchCache_var match_cache;
+        ChannelActionConfig_var channel_action_config;
+
+      protected:
+        virtual ~MatchState() throw();
+      };
+
+      typedef AdServer::Commons::SnapshotHolder<MatchState>
+        MatchStateHolder;
+      typedef MatchStateHolder::Object_var MatchState_var;
+
     private:
       virtual
       ~ChannelMatcher() throw();
@@ -154,11 +171,7 @@ namespace AdServer
       Logging::Logger_var logger_;
       const unsigned long cache_limit_;
 
-      mutable SyncPolicy::Mutex lock_;
-      Config_var config_;
-      MatchCache_var match_cache_;
-      ExpressionChannelIndex_var channel_index_;
-      ChannelActionConfig_var channel_action_config_;
+      MatchStateHolder match_state_;
     };
 
     typedef ReferenceCounting::SmartPtr<ChannelMatcher>
@@ -242,6 +242,23 @@ namespace UserInfoSvcs
         std::endl;
     }
 
+    const Generics::Time receive_time = Generics::Time::get_time_of_day();
+
+    if(CorbaAlgs::deadline_reached(
+         CorbaAlgs::unpack_time_budget(request_info.time_budget, receive_time),
+         receive_time))
+    {
+      // caller time budget expired (before request sending):
+      // result will be ignored, don't create or change mapping
+      AdServer::UserInfoSvcs::UserBindServer::GetUserResponseInfo_var res(
+        new AdServer::UserInfoSvcs::UserBindServer::GetUserResponseInfo());
+      res->min_age_reached = false;
+      res->created = false;
+      res->invalid_operation = false;
+      res->user_found = false;
+      return res._retn();
+    }
+
     UserBindProcessorHolder::Accessor user_bind_accessor =
       user_bind_container_->get_accessor();
 
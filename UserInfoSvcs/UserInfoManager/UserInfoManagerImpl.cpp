@@ -1203,6 +1203,9 @@ namespace UserInfoSvcs
 
     try
     {
+      const Generics::Time deadline = CorbaAlgs::unpack_time_budget(
+        match_params.time_budget,
+        Generics::Time::get_time_of_day());
       Generics::Timer process_timer;
       process_timer.start();
 
@@ -1368,7 +1371,12 @@ namespace UserInfoSvcs
         AdServer::ProfilingCommons::OP_RUNTIME,
         &ho_info,
         &unique_channels_result);
-      
+
+      // profile is updated, but caller time budget expired:
+      // skip result parts that require additional profiles reading
+      const bool budget_expired = CorbaAlgs::deadline_reached(
+        deadline, Generics::Time::get_time_of_day());
+
       match_result = new AdServer::UserInfoSvcs::UserInfoManager::MatchResult();
 
       if (!household)
@@ -1437,7 +1445,7 @@ namespace UserInfoSvcs
 
         Generics::Time publisher_optin_timeout(
           CorbaAlgs::unpack_time(match_params.publishers_optin_timeout));
-        if (publisher_optin_timeout != Generics::Time::ZERO)
+        if (publisher_optin_timeout != Generics::Time::ZERO && !budget_expired)
         {
           std::list<unsigned long> publishers;
 
@@ -1452,7 +1460,7 @@ namespace UserInfoSvcs
             match_result->exclude_pubpixel_accounts);
         }
 
-        if(match_params.ret_freq_caps)
+        if(match_params.ret_freq_caps && !budget_expired)
         {
           UserFreqCapProfile::FreqCapIdList freq_caps;
           UserFreqCapProfile::FreqCapIdList virtual_freq_caps;
@@ -1548,7 +1556,7 @@ namespace UserInfoSvcs
         }
       }
 
-      if (!household && !huid.is_null())
+      if (!household && !huid.is_null() && !budget_expired)
       {
         UserInfoContainer::RequestMatchParams
           hid_request_params(
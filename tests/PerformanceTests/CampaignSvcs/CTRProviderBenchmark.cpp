@@ -0,0 +1,393 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * CTR evaluation benchmark:
+ *   generate FTRL CTR config (feature weights, hash mapping) with array
+ *   features (user channels, geo channels, creative categories),
+ *   evaluate CTR by CalculationContext::get_ctr for few creatives
+ *   as CampaignSelector do it, print time per get_ctr call for
+ *   different number of request channels.
+ *   Feature hashing of array elements (batch murmur hashing) is
+ *   measured separately: per element hasher copy and batch.
+ */
+
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <Generics/AppUtils.hpp>
+#include <Generics/Time.hpp>
+
+#include <CampaignSvcs/CampaignManager/CTRProvider.hpp>
+#include <CampaignSvcs/CampaignManager/CTRFeatureCalculators.hpp>
+
+using namespace AdServer::CampaignSvcs;
+
+namespace
+{
+  const char CONFIG_DIR[] = "./CTRProviderBenchmark.config";
+  const char CONFIG_FILE[] = "config.json";
+  const char MODEL_FILE[] = "model.bin";
+  const char HASH_FILE[] = "hash.csv";
+
+  const unsigned long DIMENSION = 18;
+  const unsigned long CREATIVES = 10;
+
+  const char CONFIG[] =
+    "{\n"
+    "  \"version\": 2,\n"
+    "  \"feature_mapping_file\": \"hash.csv\",\n"
+    "  \"algorithms\": [\n"
+    "    {\n"
+    "      \"id\": \"benchmark\",\n"
+    "      \"weight\": 1,\n"
+    "      \"models\": [\n"
+    "        {\n"
+    "          \"method\": \"ftrl\",\n"
+    "          \"weight\": 1,\n"
+    "          \"features_dimension\": 18,\n"
+    "          \"file\": \"model.bin\",\n"
+    "          \"features\": [\n"
+    "            [\"publisher\"], [\"tag\"], [\"sizeid\"],\n"
+    "            [\"geoch\"], [\"userch\"], [\"userch\", \"tag\"],\n"
+    "            [\"campaign\"], [\"creative\"], [\"userch\", \"creative\"],\n"
+    "            [\"crcatcont\", \"tag\"]\n"
+    "          ]\n"
+    "        }\n"
+    "      ]\n"
+    "    }\n"
+    "  ]\n"
+    "}\n";
+
+  std::string
+  config_path(const char* file)
+  {
+    return std::string(CONFIG_DIR) + "/" + file;
+  }
+
+  // FTRL weights (network byte order floats) and
+  // mapping for half of feature indexes
+  void
+  generate_config()
+  {
+    ::mkdir(CONFIG_DIR, 0755);
+
+    {
+      std::ofstream config(config_path(CONFIG_FILE).c_str());
+      config << CONFIG;
+    }
+
+    const unsigned long size = 1UL << DIMENSION;
+
+    {
+      std::ofstream model(
+        config_path(MODEL_FILE).c_str(),
+        std::ios_base::out | std::ios_base::binary);
+
+      for(unsigned long i = 0; i < size; ++i)
+      {
+        const float weight = static_cast<float>(::rand() % 2001 - 1000) /
+          100000;
+        uint32_t value;
+        ::memcpy(&value, &weight, sizeof(value));
+        value = htonl(value);
+        model.write(reinterpret_cast<const char*>(&value), sizeof(value));
+      }
+    }
+
+    {
+      std::ofstream hash(config_path(HASH_FILE).c_str());
+
+      for(unsigned long i = 1; i <= size; i += 2)
+      {
+        hash << i << "," << (::rand() % size + 1) << "\n";
+      }
+    }
+  }
+
+  void
+  remove_config()
+  {
+    std::remove(config_path(CONFIG_FILE).c_str());
+    std::remove(config_path(MODEL_FILE).c_str());
+    std::remove(config_path(HASH_FILE).c_str());
+    ::rmdir(CONFIG_DIR);
+  }
+
+  struct Holder
+  {
+    std::vector<Campaign_var> campaigns;
+    std::vector<Creative_var> creatives;
+    Tag_var tag;
+    Colocation_var colocation;
+  };
+
+  void
+  generate_creatives(Holder& holder)
+  {
+    Account_var account = new AccountDef();
+    account->account_id = 1;
+
+    for(unsigned long i = 1; i <= CREATIVES; ++i)
+    {
+      Campaign_var campaign = new Campaign();
+      campaign->campaign_id = i;
+      campaign->campaign_group_id = i;
+      campaign->account = account;
+      campaign->advertiser = account;
+      campaign->ctr = RevenueDecimal(false, 1, 0);
+
+      Creative_var creative = new Creative(
+        campaign,
+        i, // ccid
+        i, // creative_id
+        0,
+        0,
+        "",
+        "",
+        OptionValue(),
+        "",
+        "",
+        Creative::CategorySet());
+
+      for(unsigned long cat_i = 0; cat_i < 5; ++cat_i)
+      {
+        creative->content_categories.push_back(i * 10 + cat_i);
+      }
+
+      holder.campaigns.push_back(campaign);
+      holder.creatives.push_back(creative);
+    }
+  }
+
+  CampaignSelectParams_var
+  generate_request_params(Holder& holder, unsigned long channels)
+  {
+    CampaignSelectParams_var request_params = new CampaignSelectParams(
+      true, // profiling_available
+      FreqCapIdSet(),
+      SeqOrderMap(),
+      0,
+      0,
+      Tag::SizeMap(),
+      false,
+      -1, // visibility
+      -1 // viewability
+      );
+
+    Account_var publisher = new AccountDef();
+    publisher->account_id = 2;
+
+    Site_var site = new Site();
+    site->site_id = 2;
+    site->account = publisher;
+
+    holder.tag = new Tag();
+    holder.tag->tag_id = 3;
+    holder.tag->site = site;
+    holder.tag->adjustment = RevenueDecimal(false, 1, 0);
+
+    Size_var size = new Size();
+    size->size_id = 4;
+    size->protocol_name = "300x250";
+
+    Tag::Size_var tag_size = new Tag::Size();
+    tag_size->size = size;
+    tag_size->max_text_creatives = 1;
+    holder.tag->sizes.insert(std::make_pair(size->size_id, tag_size));
+
+    Account_var isp = new AccountDef();
+    isp->account_id = 5;
+
+    holder.colocation = new Colocation();
+    holder.colocation->colo_id = 6;
+    holder.colocation->account = isp;
+
+    request_params->tag = holder.tag;
+    request_params->colocation = holder.colocation;
+    request_params->tag_sizes = holder.tag->sizes;
+
+    for(unsigned long i = 0; i < channels; ++i)
+    {
+      request_params->channels.insert(1000 + i * 7);
+    }
+
+    for(unsigned long i = 0; i < 3; ++i)
+    {
+      request_params->geo_channels.insert(100 + i);
+    }
+
+    return request_params;
+  }
+
+  void
+  bench_get_ctr(
+    CTRProvider* ctr_provider,
+    unsigned long channels,
+    unsigned long count)
+  {
+    Holder holder;
+    generate_creatives(holder);
+    CampaignSelectParams_var request_params =
+      generate_request_params(holder, channels);
+
+    RevenueDecimal ctr_sum = RevenueDecimal::ZERO;
+    const Generics::Time start = Generics::Time::get_time_of_day();
+
+    for(unsigned long i = 0; i < count; ++i)
+    {
+      // calculation per request, context per auction
+      CTRProvider::Calculation_var calculation =
+        ctr_provider->create_calculation(request_params);
+
+      if(!calculation.in())
+      {
+        std::cerr << "get_ctr: no ctr calculation for request" << std::endl;
+        return;
+      }
+
+      CTRProvider::CalculationContext_var calculation_context =
+        calculation->create_context(
+          request_params->tag->sizes.begin()->second);
+
+      for(auto it = holder.creatives.begin();
+          it != holder.creatives.end(); ++it)
+      {
+        ctr_sum += calculation_context->get_ctr(*it);
+      }
+    }
+
+    const Generics::Time time = Generics::Time::get_time_of_day() - start;
+
+    std::cout << "get_ctr: channels = " << channels <<
+      ", time = " << time <<
+      ", per request (" << CREATIVES << " creatives) = " <<
+      time.microseconds() / count << " us" <<
+      ", per get_ctr = " <<
+      time.microseconds() * 1000 / (count * CREATIVES) << " ns" <<
+      ", ctr sum = " << ctr_sum <<
+      std::endl;
+  }
+
+  void
+  bench_hashing(unsigned long elements, unsigned long count)
+  {
+    std::vector<uint32_t> values(elements);
+    std::vector<uint32_t> hashes(elements);
+
+    for(unsigned long i = 0; i < elements; ++i)
+    {
+      values[i] = 1000 + i * 7;
+    }
+
+    CTR::Murmur32v3Adapter hash_adapter(0x9747b28c);
+    hash_adapter.add(static_cast<uint32_t>(3));
+
+    uint32_t check_sum = 0;
+
+    const Generics::Time scalar_start = Generics::Time::get_time_of_day();
+
+    for(unsigned long i = 0; i < count; ++i)
+    {
+      for(unsigned long el_i = 0; el_i < elements; ++el_i)
+      {
+        CTR::Murmur32v3Adapter hash_adapter_copy(hash_adapter);
+        hash_adapter_copy.add(values[el_i]);
+        check_sum += hash_adapter_copy.finalize();
+      }
+    }
+
+    const Generics::Time scalar_time =
+      Generics::Time::get_time_of_day() - scalar_start;
+
+    const Generics::Time batch_start = Generics::Time::get_time_of_day();
+
+    for(unsigned long i = 0; i < count; ++i)
+    {
+      hash_adapter.finalize_batch(hashes.data(), values.data(), elements);
+
+      for(unsigned long el_i = 0; el_i < elements; ++el_i)
+      {
+        check_sum -= hashes[el_i];
+      }
+    }
+
+    const Generics::Time batch_time =
+      Generics::Time::get_time_of_day() - batch_start;
+
+    std::cout << "hashing: elements = " << elements <<
+      ", scalar = " << scalar_time <<
+      ", batch = " << batch_time <<
+      ", check sum = " << check_sum << " (should be 0)" <<
+      std::endl;
+  }
+}
+
+int
+main(int argc, char** argv)
+{
+  Generics::AppUtils::Option<unsigned long> opt_count(10000);
+
+  Generics::AppUtils::Args args(-1);
+
+  args.add(
+    Generics::AppUtils::equal_name("count") ||
+    Generics::AppUtils::short_name("c"),
+    opt_count);
+
+  args.parse(argc - 1, argv + 1);
+
+  int ret = 0;
+
+  try
+  {
+    generate_config();
+
+    CTRProvider_var ctr_provider = new CTRProvider(
+      String::SubString(CONFIG_DIR), Generics::Time::ZERO, 0);
+
+    const unsigned long CHANNELS[] = { 0, 10, 100, 500 };
+
+    for(size_t i = 0; i < sizeof(CHANNELS) / sizeof(CHANNELS[0]); ++i)
+    {
+      bench_get_ctr(ctr_provider, CHANNELS[i], *opt_count);
+    }
+
+    for(size_t i = 0; i < sizeof(CHANNELS) / sizeof(CHANNELS[0]); ++i)
+    {
+      bench_hashing(CHANNELS[i], *opt_count);
+    }
+  }
+  catch(const eh::Exception& ex)
+  {
+    std::cerr << "Caught eh::Exception: " << ex.what() << std::endl;
+    ret = 1;
+  }
+
+  remove_config();
+
+  return ret;
+}
@@ -0,0 +1,152 @@
+/*
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * CampaignManager startup from config snapshot benchmark:
+ *   load config snapshot (saved by CampaignManager with defined
+ *   config_snapshot_file) and build campaign index over it,
+ *   print time of each stage.
+ *   usage: CampaignConfigSnapshotTest [-c <count>] [-t <index threads>]
+ *     <snapshot file> <domain config> <creative dir> <template dir>
+ */
+
+#include <iostream>
+
+#include <Generics/AppUtils.hpp>
+#include <Generics/Time.hpp>
+#include <Logger/StreamLogger.hpp>
+
+#include <Commons/ErrorHandler.hpp>
+#include <xsd/CampaignSvcs/DomainConfig.hpp>
+
+#include <CampaignSvcs/CampaignManager/CampaignConfigSource.hpp>
+#include <CampaignSvcs/CampaignManager/CampaignIndex.hpp>
+
+using namespace AdServer::CampaignSvcs;
+
+namespace
+{
+  const char USAGE[] =
+    "Usage: CampaignConfigSnapshotTest [-c <count>] [-t <index threads>] "
+    "<snapshot file> <domain config> <creative dir> <template dir>";
+}
+
+int
+main(int argc, char** argv)
+{
+  Generics::AppUtils::Option<unsigned long> opt_count(1);
+  Generics::AppUtils::Option<unsigned long> opt_threads(1);
+
+  Generics::AppUtils::Args args(-1);
+
+  args.add(
+    Generics::AppUtils::equal_name("count") ||
+    Generics::AppUtils::short_name("c"),
+    opt_count);
+  args.add(
+    Generics::AppUtils::equal_name("threads") ||
+    Generics::AppUtils::short_name("t"),
+    opt_threads);
+
+  args.parse(argc - 1, argv + 1);
+
+  const Generics::AppUtils::Args::CommandList& commands = args.commands();
+
+  if(commands.size() != 4)
+  {
+    std::cerr << USAGE << std::endl;
+    return 1;
+  }
+
+  Generics::AppUtils::Args::CommandList::const_iterator arg_it =
+    commands.begin();
+  const std::string snapshot_file = *arg_it++;
+  const std::string domain_config_file = *arg_it++;
+  const std::string creative_dir = *arg_it++;
+  const std::string template_dir = *arg_it++;
+
+  try
+  {
+    Logging::Logger_var logger = new Logging::OStream::Logger(
+      Logging::OStream::Config(std::cerr, Logging::Logger::WARNING));
+
+    Config::ErrorHandler error_handler;
+    std::unique_ptr<DomainParser::DomainConfig> domain_config =
+      xsd::AdServer::Configuration::DomainConfiguration(
+        domain_config_file.c_str(), error_handler);
+
+    if(error_handler.has_errors())
+    {
+      std::string error_string;
+      std::cerr << "Can't parse domain config '" << domain_config_file <<
+        "': " << error_handler.text(error_string) << std::endl;
+      return 1;
+    }
+
+    DomainParser_var domain_parser = new DomainParser(*domain_config);
+
+    // campaign servers isn't used for snapshot loading
+    CampaignConfigSource_var config_source = new CampaignConfigSource(
+      logger,
+      domain_parser,
+      CORBACommons::CorbaObjectRefList(),
+      "A",
+      creative_dir.c_str(),
+      template_dir.c_str(),
+      "0",
+      CreativeInstantiateRuleMap(),
+      false,
+      snapshot_file.c_str());
+
+    for(unsigned long i = 0; i < *opt_count; ++i)
+    {
+      const Generics::Time start = Generics::Time::get_time_of_day();
+
+      CampaignConfig_var config = config_source->load_snapshot();
+
+      if(!config)
+      {
+        std::cerr << "Snapshot '" << snapshot_file <<
+          "' don't exist or saved by other version" << std::endl;
+        return 1;
+      }
+
+      const Generics::Time loaded = Generics::Time::get_time_of_day();
+
+      CampaignIndex_var index = new CampaignIndex(config, logger);
+      index->index_campaigns(0, 0, 0, *opt_threads);
+
+      const Generics::Time indexed = Generics::Time::get_time_of_day();
+
+      std::cout << "campaigns = " << config->campaigns.size() <<
+        ", tags = " << config->tags.size() <<
+        ", config load time = " << (loaded - start) <<
+        ", index time = " << (indexed - loaded) <<
+        ", startup time = " << (indexed - start) << std::endl;
+    }
+  }
+  catch(const eh::Exception& ex)
+  {
+    std::cerr << "Caught eh::Exception: " << ex.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,448 @@
+/*
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Campaign selection allocations microbenchmark:
+ *   generate config with N display campaigns of equal ecpm (all of them
+ *   are candidates of max ecpm auction), index it and
+ *   select ad with CampaignSelector as CampaignManager do it,
+ *   print heap allocations and request arena blocks per request.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+
+#include <Generics/AppUtils.hpp>
+#include <Generics/Time.hpp>
+#include <Logger/StreamLogger.hpp>
+
+#include <CampaignSvcs/CampaignManager/CampaignSelector.hpp>
+
+using namespace AdServer::CampaignSvcs;
+
+namespace
+{
+  unsigned long allocations = 0;
+}
+
+void*
+operator new(std::size_t size) throw (std::bad_alloc)
+{
+  ++allocations;
+
+  void* ptr = ::malloc(size ? size : 1);
+
+  if(!ptr)
+  {
+    throw std::bad_alloc();
+  }
+
+  return ptr;
+}
+
+void
+operator delete(void* ptr) throw ()
+{
+  ::free(ptr);
+}
+
+namespace
+{
+  const char TEMPLATE_FILE[] = "~campaign-selection-alloc-template";
+  const unsigned long TAG_ID = 1;
+  const unsigned long COLO_ID = 1;
+
+  struct BenchResult
+  {
+    BenchResult()
+      : allocations(0),
+        arena_blocks(0),
+        selected(0)
+    {}
+
+    Generics::Time time;
+    unsigned long allocations;
+    unsigned long arena_blocks;
+    unsigned long selected;
+  };
+
+  Account_var
+  add_account_(
+    CampaignConfig& new_config,
+    unsigned long account_id,
+    Currency* currency)
+  {
+    Account_var acc = new AccountDef();
+    acc->account_id = account_id;
+    acc->internal_account_id = account_id;
+    acc->flags = 0;
+    acc->at_flags = 0;
+    acc->text_adserving = 'A';
+    acc->currency = ReferenceCounting::add_ref(currency);
+    acc->country = "ru";
+    acc->time_offset = Generics::Time::ZERO;
+    acc->commision = RevenueDecimal::ZERO;
+    acc->budget = RevenueDecimal::ZERO;
+    acc->paid_amount = RevenueDecimal::ZERO;
+    acc->status = 'A';
+    acc->eval_status = 'A';
+    new_config.accounts[account_id] = acc;
+
+    return acc;
+  }
+
+  void
+  add_creative_template_(CampaignConfig& new_config)
+  {
+    std::ofstream(TEMPLATE_FILE) << "TEST" << std::endl;
+
+    CreativeTemplate c_templ(
+      TEMPLATE_FILE,
+      CreativeTemplateFactory::Handler::CTT_TEXT,
+      "mime-format",
+      false,
+      0, // tokens
+      0, // hidden tokens
+      Generics::Time::ZERO);
+
+    c_templ.status = 'A';
+
+    new_config.creative_templates.insert(
+      CreativeTemplateKey(
+        "test-format",
+        "test-size",
+        "test-appformat"),
+      c_templ);
+  }
+
+  void
+  add_campaign_(
+    CampaignConfig& new_config,
+    AccountDef* account,
+    Size* size,
+    unsigned long id,
+    unsigned long creatives)
+  {
+    Campaign_var campaign = new Campaign();
+
+    campaign->campaign_id = id;
+    campaign->campaign_group_id = id;
+    campaign->account = ReferenceCounting::add_ref(account);
+    campaign->advertiser = ReferenceCounting::add_ref(account);
+    campaign->fc_id = 0;
+    campaign->group_fc_id = 0;
+    campaign->flags = CampaignFlags::US_NONE;
+    campaign->mode = CM_NON_RANDOM;
+    campaign->imp_revenue = RevenueDecimal::ZERO;
+    campaign->click_revenue = RevenueDecimal(false, 1, 0);
+    campaign->click_sys_revenue = campaign->click_revenue;
+    campaign->commision = RevenueDecimal::ZERO;
+    campaign->ccg_rate_id = 0;
+    campaign->ccg_rate_type = CR_CPC;
+    campaign->ctr = RevenueDecimal(false, 0, 10000000);
+    // equal ecpm for all campaigns: all of them are auction candidates
+    campaign->ecpm_ = RevenueDecimal(false, 10, 0);
+    campaign->fixed_ctr = FixedRevenue::from_decimal(campaign->ctr);
+    campaign->fixed_click_sys_revenue = FixedRevenue::from_decimal(
+      campaign->click_sys_revenue);
+    campaign->bid_strategy = BS_MAX_REACH;
+    campaign->delivery_coef = 1;
+    campaign->min_uid_age = Generics::Time::ZERO;
+
+    campaign->status = 'A';
+    campaign->eval_status = 'A';
+    campaign->ccg_type = CT_DISPLAY;
+    campaign->targeting_type = 'C';
+
+    campaign->country = "ru";
+    campaign->start_user_group_id = 0;
+    campaign->end_user_group_id = MAX_TARGET_USERS_GROUPS;
+    campaign->marketplace = 'A';
+
+    for(unsigned long cr_i = 0; cr_i < creatives; ++cr_i)
+    {
+      const unsigned long ccid = id * creatives + cr_i;
+
+      Creative_var creative(
+        new Creative(
+          campaign,
+          ccid,
+          ccid,
+          0, // fc_id
+          1, // weight
+          "test-format",
+          "",
+          OptionValue(0, "test-url"),
+          "test-url",
+          "test-url",
+          Creative::CategorySet()));
+
+      Creative::Size creative_size;
+      creative_size.size = ReferenceCounting::add_ref(size);
+      creative_size.up_expand_space = 0;
+      creative_size.right_expand_space = 0;
+      creative_size.down_expand_space = 0;
+      creative_size.left_expand_space = 0;
+      creative_size.expandable = false;
+      creative_size.available_appformats.insert("test-appformat");
+
+      creative->sizes.insert(std::make_pair(size->size_id, creative_size));
+
+      campaign->add_creative(creative);
+    }
+
+    new_config.campaigns.insert(std::make_pair(id, campaign));
+  }
+
+  void
+  add_tag_(
+    CampaignConfig& new_config,
+    AccountDef* account,
+    Size* size)
+  {
+    Site_var site = new Site();
+    site->site_id = TAG_ID;
+    site->account = ReferenceCounting::add_ref(account);
+    site->freq_cap_id = 0;
+    site->noads_timeout = 0;
+    site->status = 'A';
+    site->flags = 0;
+    new_config.sites[site->site_id] = site;
+
+    Tag_var tag = new Tag();
+    tag->tag_id = TAG_ID;
+    tag->site = site;
+    tag->adjustment = RevenueDecimal(false, 1, 0);
+    tag->fixed_adjustment = FixedRevenue::from_decimal(tag->adjustment);
+    tag->marketplace = 'A';
+
+    Tag::Size_var tag_size = new Tag::Size();
+    tag_size->size = ReferenceCounting::add_ref(size);
+    tag_size->max_text_creatives = 0;
+    tag->sizes.insert(std::make_pair(size->size_id, tag_size));
+
+    Tag::TagPricing tag_pricing;
+    tag_pricing.site_rate_id = 0;
+    tag_pricing.cpm = RevenueDecimal::ZERO;
+    tag->tag_pricings.insert(std::make_pair(
+      Tag::TagPricingKey("", CT_ALL, CR_ALL), tag_pricing));
+    tag->country_tag_pricings.insert(std::make_pair("", tag_pricing));
+
+    new_config.tags[tag->tag_id] = tag;
+  }
+
+  CampaignConfig_var
+  generate_config(unsigned long campaigns, unsigned long creatives)
+  {
+    CampaignConfig_var new_config = new CampaignConfig();
+
+    Currency_var currency = new Currency();
+    currency->currency_id = 1;
+    currency->currency_exchange_id = 1;
+    currency->effective_date = 0;
+    currency->rate = RevenueDecimal(false, 1, 0);
+    currency->fixed_rate = FixedRevenue::from_decimal(currency->rate);
+    currency->fraction = 1;
+    new_config->currencies[currency->currency_id] = currency;
+
+    Account_var account = add_account_(*new_config, 1, currency);
+
+    Colocation_var colo = new Colocation();
+    colo->colo_id = COLO_ID;
+    colo->colo_rate_id = COLO_ID;
+    colo->at_flags = 0;
+    colo->account = ReferenceCounting::add_ref(account.in());
+    colo->revenue_share = RevenueDecimal::ZERO;
+    colo->ad_serving = CS_ALL;
+    new_config->colocations.insert(std::make_pair(COLO_ID, colo));
+
+    Size_var size = new Size();
+    size->size_id = 1;
+    size->protocol_name = "test-size";
+    size->width = 1;
+    size->height = 1;
+
+    add_creative_template_(*new_config);
+    add_tag_(*new_config, account, size);
+
+    for(unsigned long cmp_i = 1; cmp_i <= campaigns; ++cmp_i)
+    {
+      add_campaign_(*new_config, account, size, cmp_i, creatives);
+    }
+
+    return new_config;
+  }
+
+  BenchResult
+  bench(
+    const CampaignIndex* campaign_index,
+    unsigned long count)
+  {
+    BenchResult res;
+
+    const ConstCampaignConfig_var config = campaign_index->configuration();
+    const Tag* tag = config->tags.find(TAG_ID)->second;
+    const Colocation* colocation = config->colocations.find(COLO_ID)->second;
+
+    const FreqCapIdSet full_freq_caps;
+    const SeqOrderMap seq_orders;
+    const ChannelIdHashSet channels;
+    const CampaignKeywordMap hit_keywords;
+    const Generics::Time now = Generics::Time::get_time_of_day();
+    const AdServer::Commons::UserId user_id =
+      AdServer::Commons::UserId::create_random_based();
+
+    CampaignSelector campaign_selector(campaign_index, 0, 0);
+
+    const unsigned long start_allocations = allocations;
+    const Generics::Time start = Generics::Time::get_time_of_day();
+
+    for(unsigned long i = 0; i < count; ++i)
+    {
+      CampaignSelectParams_var request_params = new CampaignSelectParams(
+        true, // profiling available
+        full_freq_caps,
+        seq_orders,
+        colocation,
+        tag,
+        tag->sizes,
+        false, // filter empty destination
+        -1, // tag visibility
+        -1 // tag predicted viewability
+        );
+
+      request_params->user_id = user_id;
+      request_params->country_code = "ru";
+      request_params->format = "test-appformat";
+      request_params->user_status = US_OPTIN;
+      request_params->time = now;
+      request_params->only_display_ad = true;
+
+      {
+        CampaignSelector::WeightedCampaignKeywordListPtr weighted_campaign_keywords;
+        CampaignSelector::WeightedCampaignPtr weighted_campaign;
+        AdSelectionResult select_result;
+
+        campaign_selector.select_campaigns(
+          AT_MAX_ECPM,
+          AT_MAX_ECPM,
+          request_params,
+          channels,
+          hit_keywords,
+          false, // collect lost
+          weighted_campaign_keywords,
+          weighted_campaign,
+          select_result);
+
+        if(weighted_campaign.get())
+        {
+          ++res.selected;
+        }
+      }
+
+      res.arena_blocks += request_params->arena.heap_blocks();
+    }
+
+    res.time = Generics::Time::get_time_of_day() - start;
+    res.allocations = allocations - start_allocations;
+    return res;
+  }
+
+  void
+  print_result(
+    unsigned long candidates,
+    unsigned long count,
+    const BenchResult& res)
+  {
+    std::cout << "candidates = " << candidates <<
+      ", time = " << res.time <<
+      ", per request = " << res.time.microseconds() / count << " us" <<
+      ", allocations per request = " <<
+        static_cast<double>(res.allocations) / count <<
+      ", arena blocks per request = " <<
+        static_cast<double>(res.arena_blocks) / count <<
+      ", selected = " << res.selected << "/" << count <<
+      std::endl;
+  }
+}
+
+int
+main(int argc, char** argv)
+{
+  Generics::AppUtils::Option<unsigned long> opt_count(10000);
+  Generics::AppUtils::Option<unsigned long> opt_creatives(3);
+
+  Generics::AppUtils::Args args(-1);
+
+  args.add(
+    Generics::AppUtils::equal_name("count") ||
+    Generics::AppUtils::short_name("c"),
+    opt_count);
+
+  args.add(
+    Generics::AppUtils::equal_name("creatives") ||
+    Generics::AppUtils::short_name("r"),
+    opt_creatives);
+
+  args.parse(argc - 1, argv + 1);
+
+  int ret = 0;
+
+  try
+  {
+    Logging::Logger_var logger = new Logging::OStream::Logger(
+      Logging::OStream::Config(std::cerr));
+
+    const unsigned long CANDIDATES[] = { 10, 50, 100, 500 };
+
+    for(size_t i = 0; i < sizeof(CANDIDATES) / sizeof(CANDIDATES[0]); ++i)
+    {
+      CampaignConfig_var config = generate_config(
+        CANDIDATES[i], *opt_creatives);
+
+      CampaignIndex_var campaign_index = new CampaignIndex(config, logger);
+      campaign_index->index_campaigns();
+
+      const BenchResult res = bench(campaign_index, *opt_count);
+
+      print_result(CANDIDATES[i], *opt_count, res);
+
+      if(res.selected != *opt_count)
+      {
+        std::cerr << "candidates = " << CANDIDATES[i] <<
+          ": campaign isn't selected for " <<
+          (*opt_count - res.selected) << " requests" << std::endl;
+        ret = 1;
+      }
+    }
+  }
+  catch(const eh::Exception& ex)
+  {
+    std::cerr << "Caught eh::Exception: " << ex.what() << std::endl;
+    ret = 1;
+  }
+
+  std::remove(TEMPLATE_FILE);
+
+  return ret;
+}
@@ -0,0 +1,241 @@
+/*
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Creative text templates instantiation benchmark:
+ *   instantiate each passed template file (production template set)
+ *   by String::TextTemplate over merged request & creative tokens
+ *   (previous behaviour) and by compiled CreativeTemplateFactory
+ *   text template, check that results are equal, print time per
+ *   instantiation.
+ *   usage: CreativeTemplateTest [-c <count>] <template file>...
+ */
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <Generics/AppUtils.hpp>
+#include <Generics/Time.hpp>
+#include <String/TextTemplate.hpp>
+
+#include <CampaignSvcs/CampaignManager/CreativeTemplate.hpp>
+
+using namespace AdServer::CampaignSvcs;
+
+namespace
+{
+  const char USAGE[] =
+    "Usage: CreativeTemplateTest [-c <count>] <template file>...";
+
+  struct TemplateArgs
+  {
+    TemplateArgs()
+      : request_params(new TemplateParams())
+    {}
+
+    TemplateParams_var request_params;
+    TemplateParamsList creative_params;
+  };
+
+  // fill tokens used in template: half of keys as request tokens,
+  // other as creative tokens
+  void
+  fill_args(TemplateArgs& args, const std::string& text)
+  {
+    String::TextTemplate::Keys keys;
+    Template::get_keys(keys, text);
+
+    TemplateParams_var creative_params = new TemplateParams();
+    unsigned long key_i = 0;
+
+    for(String::TextTemplate::Keys::const_iterator key_it = keys.begin();
+        key_it != keys.end(); ++key_it, ++key_i)
+    {
+      TokenValueMap& params = key_i % 2 ?
+        static_cast<TokenValueMap&>(*creative_params) :
+        static_cast<TokenValueMap&>(*args.request_params);
+
+      params[*key_it] = "http://adserver.example.com/services/" +
+        *key_it + "?requestid=PPrY1kSVTgCmLKnP5H1Srw..";
+    }
+
+    args.creative_params.push_back(creative_params);
+  }
+
+  // previous TextTemplate::instantiate implementation
+  void
+  instantiate_text_template(
+    String::TextTemplate::IStream& text_template,
+    const TemplateArgs& template_args,
+    std::ostream& ostr)
+  {
+    TokenValueMap args;
+    args.insert(
+      template_args.request_params->begin(),
+      template_args.request_params->end());
+
+    const TokenValueMap& creative_args = *template_args.creative_params.front();
+    args.insert(creative_args.begin(), creative_args.end());
+
+    String::TextTemplate::ArgsContainer<TokenValueMap,
+      String::TextTemplate::ArgsContainerStringAdapter> args_cont(&args);
+    String::TextTemplate::DefaultValue default_cont(&args_cont);
+    String::TextTemplate::ArgsEncoder encoder(&default_cont);
+    ostr << text_template.instantiate(encoder);
+  }
+
+  bool
+  bench_template(const char* file, unsigned long count)
+  {
+    std::string text;
+
+    {
+      std::ifstream fstr(file);
+
+      if(!fstr.is_open())
+      {
+        std::cerr << "Can't open file '" << file << "'" << std::endl;
+        return false;
+      }
+
+      std::stringstream ostr;
+      ostr << fstr.rdbuf();
+      text = ostr.str();
+    }
+
+    TemplateArgs args;
+    fill_args(args, text);
+
+    String::TextTemplate::IStream text_template;
+
+    {
+      std::istringstream istr(text);
+      text_template.init(
+        istr,
+        TokenTemplateProperties::START_TOKEN,
+        TokenTemplateProperties::STOP_TOKEN);
+    }
+
+    CreativeTemplateFactory factory;
+    CreativeTemplateFactory::State state;
+    Template_var compiled_template = factory.create(
+      CreativeTemplateFactory::Handler(
+        file, CreativeTemplateFactory::Handler::CTT_TEXT),
+      state);
+
+    {
+      std::ostringstream text_ostr;
+      std::ostringstream compiled_ostr;
+
+      instantiate_text_template(text_template, args, text_ostr);
+      compiled_template->instantiate(
+        args.request_params, args.creative_params, compiled_ostr);
+
+      if(text_ostr.str() != compiled_ostr.str())
+      {
+        std::cerr << file << ": instantiation results differ" << std::endl;
+        return false;
+      }
+    }
+
+    unsigned long size = 0;
+    Generics::Time text_time;
+    Generics::Time compiled_time;
+
+    {
+      const Generics::Time start = Generics::Time::get_time_of_day();
+
+      for(unsigned long i = 0; i < count; ++i)
+      {
+        std::ostringstream ostr;
+        instantiate_text_template(text_template, args, ostr);
+        size += ostr.str().size();
+      }
+
+      text_time = Generics::Time::get_time_of_day() - start;
+    }
+
+    {
+      const Generics::Time start = Generics::Time::get_time_of_day();
+
+      for(unsigned long i = 0; i < count; ++i)
+      {
+        std::ostringstream ostr;
+        compiled_template->instantiate(
+          args.request_params, args.creative_params, ostr);
+        size += ostr.str().size();
+      }
+
+      compiled_time = Generics::Time::get_time_of_day() - start;
+    }
+
+    std::cout << file << ": size = " << size / count / 2 <<
+      ", text template per instantiation = " <<
+        static_cast<double>(text_time.microseconds()) / count << " us" <<
+      ", compiled template per instantiation = " <<
+        static_cast<double>(compiled_time.microseconds()) / count << " us" <<
+      std::endl;
+
+    return true;
+  }
+}
+
+int
+main(int argc, char** argv)
+{
+  Generics::AppUtils::Option<unsigned long> opt_count(100000);
+
+  Generics::AppUtils::Args args(-1);
+
+  args.add(
+    Generics::AppUtils::equal_name("count") ||
+    Generics::AppUtils::short_name("c"),
+    opt_count);
+
+  args.parse(argc - 1, argv + 1);
+
+  const Generics::AppUtils::Args::CommandList& commands = args.commands();
+
+  if(commands.empty())
+  {
+    std::cerr << USAGE << std::endl;
+    return 1;
+  }
+
+  bool result = true;
+
+  try
+  {
+    for(Generics::AppUtils::Args::CommandList::const_iterator file_it =
+          commands.begin();
+        file_it != commands.end(); ++file_it)
+    {
+      result &= bench_template(file_it->c_str(), *opt_count);
+    }
+  }
+  catch(const eh::Exception& ex)
+  {
+    std::cerr << "Caught eh::Exception: " << ex.what() << std::endl;
+    return 1;
+  }
+
+  return result ? 0 : 1;
+}
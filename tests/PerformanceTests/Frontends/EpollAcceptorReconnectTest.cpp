@@ -0,0 +1,374 @@
+/*
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Reconnect storm benchmark of FCGI acceptors:
+ *   client threads open connection, send one request, read response
+ *   and close connection (nginx without keepalive to upstream).
+ *   For each round print request latency percentiles and process RSS
+ *   for thread per connection Acceptor and EpollAcceptor.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <Generics/AppUtils.hpp>
+#include <Generics/Time.hpp>
+#include <Logger/StreamLogger.hpp>
+#include <Logger/ActiveObjectCallback.hpp>
+
+#include <Frontends/FrontendCommons/FCGI.hpp>
+#include <Frontends/FrontendCommons/tinyfcgi/tinyfcgi.hpp>
+#include <Frontends/FCGIServer/Acceptor.hpp>
+#include <Frontends/FCGIServer/EpollAcceptor.hpp>
+
+using namespace AdServer::Frontends;
+
+namespace
+{
+  const char SOCKET_PATH[] = "./EpollAcceptorReconnectTest.sock";
+  const size_t RESPONSE_SIZE = 2 * 1024;
+
+  // reply with fixed size body (bid response)
+  class TestFrontend:
+    public FrontendCommons::FrontendInterface,
+    public ReferenceCounting::AtomicImpl
+  {
+  public:
+    virtual bool
+    will_handle(const String::SubString& /*uri*/) throw ()
+    {
+      return true;
+    }
+
+    virtual int
+    handle_request(
+      const FCGI::HttpRequest& /*request*/,
+      FCGI::HttpResponse& response) throw()
+    {
+      response.write_owned(std::string(RESPONSE_SIZE, 'x'));
+      return 0;
+    }
+
+    virtual void
+    init() throw(eh::Exception)
+    {}
+
+    virtual void
+    shutdown() throw()
+    {}
+
+  protected:
+    virtual
+    ~TestFrontend() throw()
+    {}
+  };
+
+  struct ClientContext
+  {
+    const std::string* request;
+    unsigned long connections;
+    std::vector<Generics::Time> latencies;
+    unsigned long errors;
+  };
+
+  bool
+  process_connection(const std::string& request)
+  {
+    int sock = ::socket(AF_LOCAL, SOCK_STREAM, 0);
+
+    if(sock == -1)
+    {
+      return false;
+    }
+
+    sockaddr_un addr;
+    ::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    ::strncpy(addr.sun_path, SOCKET_PATH, sizeof(addr.sun_path) - 1);
+
+    bool res = false;
+
+    if(::connect(sock, (sockaddr*)&addr, sizeof(addr)) == 0 &&
+      ::send(sock, request.data(), request.size(), MSG_NOSIGNAL) ==
+        static_cast<ssize_t>(request.size()))
+    {
+      // read response up to FCGI_END_REQUEST record
+      std::string buf;
+      char recv_buf[16 * 1024];
+      size_t pos = 0;
+
+      while(!res)
+      {
+        ssize_t recv_res = ::recv(sock, recv_buf, sizeof(recv_buf), 0);
+
+        if(recv_res <= 0)
+        {
+          break;
+        }
+
+        buf.append(recv_buf, recv_res);
+
+        while(buf.size() - pos >= FCGI_HEADER_LEN)
+        {
+          const FCGI_Header* h =
+            reinterpret_cast<const FCGI_Header*>(buf.data() + pos);
+          const size_t record_size = FCGI_HEADER_LEN +
+            (h->contentLengthB1 << 8) + h->contentLengthB0 +
+            h->paddingLength;
+
+          if(buf.size() - pos < record_size)
+          {
+            break;
+          }
+
+          pos += record_size;
+
+          if(h->type == FCGI_END_REQUEST)
+          {
+            res = true;
+            break;
+          }
+        }
+      }
+    }
+
+    ::close(sock);
+    return res;
+  }
+
+  void*
+  client_thread(void* arg)
+  {
+    ClientContext* context = static_cast<ClientContext*>(arg);
+
+    for(unsigned long i = 0; i < context->connections; ++i)
+    {
+      const Generics::Time start = Generics::Time::get_time_of_day();
+
+      if(process_connection(*context->request))
+      {
+        context->latencies.push_back(
+          Generics::Time::get_time_of_day() - start);
+      }
+      else
+      {
+        ++context->errors;
+      }
+    }
+
+    return 0;
+  }
+
+  // resident set size in Kb
+  unsigned long
+  get_rss()
+  {
+    std::ifstream statm("/proc/self/statm");
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    statm >> size >> resident;
+    return resident * (::sysconf(_SC_PAGESIZE) / 1024);
+  }
+
+  std::string
+  make_request()
+  {
+    char buf[16 * 1024];
+    tinyfcgi::message m(1, buf, sizeof(buf));
+    m.begin_request(FCGI_RESPONDER, 0)
+      .add_param("REQUEST_METHOD", "POST")
+      .add_param("REQUEST_URI", "/bid?src=openrtb")
+      .add_param("QUERY_STRING", "src=openrtb")
+      .add_param("CONTENT_TYPE", "application/json")
+      .add_param("HTTP_HOST", "localhost")
+      .append(FCGI_STDIN, std::string(1024, 'x'))
+      .end_stream(FCGI_STDIN);
+
+    return std::string(m.data(), m.size());
+  }
+
+  void
+  run_storm(
+    const char* name,
+    unsigned long clients,
+    unsigned long connections,
+    unsigned long rounds)
+  {
+    const std::string request = make_request();
+
+    for(unsigned long round_i = 0; round_i < rounds; ++round_i)
+    {
+      std::vector<ClientContext> contexts(clients);
+      std::vector<pthread_t> thread_ids;
+
+      const Generics::Time start = Generics::Time::get_time_of_day();
+
+      for(auto it = contexts.begin(); it != contexts.end(); ++it)
+      {
+        it->request = &request;
+        it->connections = connections;
+        it->errors = 0;
+        it->latencies.reserve(connections);
+
+        pthread_t tid;
+        ::pthread_create(&tid, 0, &client_thread, &*it);
+        thread_ids.push_back(tid);
+      }
+
+      for(auto it = thread_ids.begin(); it != thread_ids.end(); ++it)
+      {
+        ::pthread_join(*it, 0);
+      }
+
+      const Generics::Time round_time =
+        Generics::Time::get_time_of_day() - start;
+
+      std::vector<Generics::Time> latencies;
+      unsigned long errors = 0;
+
+      for(auto it = contexts.begin(); it != contexts.end(); ++it)
+      {
+        latencies.insert(
+          latencies.end(), it->latencies.begin(), it->latencies.end());
+        errors += it->errors;
+      }
+
+      std::sort(latencies.begin(), latencies.end());
+
+      std::cout << name << " round #" << round_i <<
+        ": connections = " << latencies.size() <<
+        ", errors = " << errors <<
+        ", time = " << round_time;
+
+      if(!latencies.empty())
+      {
+        std::cout <<
+          ", p50 = " << latencies[latencies.size() / 2].microseconds() <<
+          " us, p99 = " << latencies[latencies.size() * 99 / 100].microseconds() <<
+          " us, max = " << latencies.back().microseconds() << " us";
+      }
+
+      std::cout << ", rss = " << get_rss() << " Kb" << std::endl;
+    }
+  }
+}
+
+int
+main(int argc, char** argv)
+{
+  Generics::AppUtils::Option<unsigned long> opt_clients(64);
+  Generics::AppUtils::Option<unsigned long> opt_connections(1000);
+  Generics::AppUtils::Option<unsigned long> opt_rounds(5);
+  Generics::AppUtils::Option<unsigned long> opt_io_threads(2);
+  Generics::AppUtils::Option<unsigned long> opt_worker_threads(20);
+  Generics::AppUtils::Option<std::string> opt_mode("all");
+
+  Generics::AppUtils::Args args(-1);
+
+  args.add(
+    Generics::AppUtils::equal_name("clients") ||
+    Generics::AppUtils::short_name("c"),
+    opt_clients);
+  args.add(
+    Generics::AppUtils::equal_name("connections") ||
+    Generics::AppUtils::short_name("n"),
+    opt_connections);
+  args.add(
+    Generics::AppUtils::equal_name("rounds") ||
+    Generics::AppUtils::short_name("r"),
+    opt_rounds);
+  args.add(
+    Generics::AppUtils::equal_name("io-threads"),
+    opt_io_threads);
+  args.add(
+    Generics::AppUtils::equal_name("worker-threads"),
+    opt_worker_threads);
+  args.add(
+    Generics::AppUtils::equal_name("mode") ||
+    Generics::AppUtils::short_name("m"),
+    opt_mode);
+
+  args.parse(argc - 1, argv + 1);
+
+  try
+  {
+    Logging::Logger_var logger = new Logging::OStream::Logger(
+      Logging::OStream::Config(std::cerr));
+    Generics::ActiveObjectCallback_var callback =
+      new Logging::ActiveObjectCallbackImpl(
+        logger,
+        "EpollAcceptorReconnectTest::main()",
+        "EpollAcceptorReconnectTest",
+        "");
+
+    FrontendCommons::Frontend_var frontend = new TestFrontend();
+
+    if(*opt_mode == "all" || *opt_mode == "thread")
+    {
+      Acceptor_var acceptor = new Acceptor(
+        logger,
+        frontend,
+        callback,
+        SOCKET_PATH,
+        1000, // backlog
+        *opt_worker_threads // accept threads
+        );
+
+      acceptor->activate_object();
+      run_storm("thread", *opt_clients, *opt_connections, *opt_rounds);
+      acceptor->deactivate_object();
+      acceptor->wait_object();
+    }
+
+    if(*opt_mode == "all" || *opt_mode == "epoll")
+    {
+      EpollAcceptor_var acceptor = new EpollAcceptor(
+        logger,
+        frontend,
+        callback,
+        SOCKET_PATH,
+        1000, // backlog
+        *opt_io_threads,
+        *opt_worker_threads,
+        10000 // max pending requests
+        );
+
+      acceptor->activate_object();
+      run_storm("epoll", *opt_clients, *opt_connections, *opt_rounds);
+      acceptor->deactivate_object();
+      acceptor->wait_object();
+    }
+  }
+  catch(const eh::Exception& ex)
+  {
+    std::cerr << "Caught eh::Exception: " << ex.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
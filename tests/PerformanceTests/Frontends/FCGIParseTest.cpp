@@ -0,0 +1,354 @@
+/*
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * FCGI request processing allocations microbenchmark:
+ *   request is received as acceptors do it (into plain worker buffer or
+ *   into ref counted receive buffer), parsed and passed to
+ *   FrontendInterface::handle_request_noparams. Handler takes json body
+ *   with RequestBody and parses it in place, as
+ *   Bidding::Frontend::handle_request and its request task do for
+ *   OpenRTB requests. Heap allocations and allocated bytes are counted
+ *   by operator new: for handler call and for whole request.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include <Generics/AppUtils.hpp>
+#include <Generics/Time.hpp>
+#include <Commons/Gason.hpp>
+
+#include <Frontends/FrontendCommons/FCGI.hpp>
+#include <Frontends/FrontendCommons/FrontendInterface.hpp>
+#include <Frontends/Modules/BiddingFrontend/RequestBody.hpp>
+
+namespace
+{
+  unsigned long allocations = 0;
+  unsigned long allocated_bytes = 0;
+}
+
+void*
+operator new(std::size_t size) throw (std::bad_alloc)
+{
+  ++allocations;
+  allocated_bytes += size;
+
+  void* ptr = ::malloc(size ? size : 1);
+
+  if(!ptr)
+  {
+    throw std::bad_alloc();
+  }
+
+  return ptr;
+}
+
+void
+operator delete(void* ptr) throw ()
+{
+  ::free(ptr);
+}
+
+namespace
+{
+  const size_t MESSAGE_BUF_SIZE = 64 * 1024;
+  const size_t RESPONSE_BUF_SIZE = 64 * 1024;
+
+  struct AllocCounter
+  {
+    AllocCounter()
+      : allocations(0),
+        allocated_bytes(0)
+    {}
+
+    void
+    start()
+    {
+      start_allocations_ = ::allocations;
+      start_allocated_bytes_ = ::allocated_bytes;
+    }
+
+    void
+    stop()
+    {
+      allocations += ::allocations - start_allocations_;
+      allocated_bytes += ::allocated_bytes - start_allocated_bytes_;
+    }
+
+    unsigned long allocations;
+    unsigned long allocated_bytes;
+
+  private:
+    unsigned long start_allocations_;
+    unsigned long start_allocated_bytes_;
+  };
+
+  struct BenchResult
+  {
+    BenchResult()
+      : inplace_bodies(0),
+        errors(0)
+    {}
+
+    Generics::Time time;
+    AllocCounter handler;
+    AllocCounter total;
+    unsigned long inplace_bodies;
+    unsigned long errors;
+  };
+
+  // body processing of Bidding::Frontend OpenRTB request task
+  class BidFrontend:
+    public FrontendCommons::FrontendInterface,
+    public ReferenceCounting::AtomicImpl
+  {
+  public:
+    BidFrontend(BenchResult& result)
+      : result_(result)
+    {}
+
+    virtual bool
+    will_handle(const String::SubString& /*uri*/) throw ()
+    {
+      return true;
+    }
+
+    virtual int
+    handle_request(
+      const FCGI::HttpRequest& request,
+      FCGI::HttpResponse& /*response*/) throw()
+    {
+      try
+      {
+        AdServer::Bidding::RequestBody body;
+        body.init(request);
+
+        if(body.inplace())
+        {
+          ++result_.inplace_bodies;
+        }
+
+        JsonValue root_value;
+        JsonAllocator json_allocator;
+        char* parse_end = body.data();
+
+        if(json_parse(
+             body.data(),
+             body.end(),
+             &parse_end,
+             &root_value,
+             json_allocator) != JSON_PARSE_OK)
+        {
+          ++result_.errors;
+          return 400;
+        }
+      }
+      catch(const eh::Exception&)
+      {
+        ++result_.errors;
+        return 500;
+      }
+
+      return 204;
+    }
+
+    virtual void
+    init() throw(eh::Exception)
+    {}
+
+    virtual void
+    shutdown() throw()
+    {}
+
+  protected:
+    virtual
+    ~BidFrontend() throw()
+    {}
+
+  private:
+    BenchResult& result_;
+  };
+
+  // make FCGI request with json body of body_size
+  std::vector<char>
+  make_request(size_t body_size)
+  {
+    std::vector<char> buf(MESSAGE_BUF_SIZE);
+    std::string body("{\"id\":\"1\",\"imp\":[{\"id\":\"1\"}],\"ext\":\"");
+    body.append(body_size > body.size() + 2 ? body_size - body.size() - 2 : 0, 'x');
+    body += "\"}";
+
+    tinyfcgi::message m(1, buf.data(), buf.size());
+    m.begin_request(FCGI_RESPONDER, FCGI_KEEP_CONN)
+      .add_param("REQUEST_METHOD", "POST")
+      .add_param("REQUEST_URI", "/bid?src=openrtb")
+      .add_param("QUERY_STRING", "src=openrtb")
+      .add_param("CONTENT_TYPE", "application/json")
+      .add_param("HTTP_HOST", "localhost")
+      .add_param("HTTP_USER_AGENT", "Mozilla/5.0 (X11; Linux x86_64)")
+      .append(FCGI_STDIN, body)
+      .end_stream(FCGI_STDIN);
+
+    buf.resize(m.size());
+    return buf;
+  }
+
+  void
+  process_request(
+    BenchResult& res,
+    FrontendCommons::FrontendInterface* frontend,
+    FCGI::HttpRequest& request,
+    char* response_buf)
+  {
+    FCGI::HttpResponse response(1, response_buf, RESPONSE_BUF_SIZE);
+
+    res.handler.start();
+    frontend->handle_request_noparams(request, response);
+    res.handler.stop();
+
+    std::vector<String::SubString> buffers;
+    response.end_response(buffers, 204);
+  }
+
+  // request received into plain worker buffer (body copied by handler)
+  BenchResult
+  bench_plain(const std::vector<char>& message, unsigned long count)
+  {
+    BenchResult res;
+    FrontendCommons::Frontend_var frontend = new BidFrontend(res);
+    std::vector<char> rbuf(MESSAGE_BUF_SIZE);
+    std::vector<char> wbuf(RESPONSE_BUF_SIZE);
+
+    const Generics::Time start = Generics::Time::get_time_of_day();
+
+    for(unsigned long i = 0; i < count; ++i)
+    {
+      res.total.start();
+
+      ::memcpy(rbuf.data(), message.data(), message.size()); // recv
+
+      FCGI::HttpRequest request;
+      request.parse(rbuf.data(), message.size());
+      process_request(res, frontend, request, wbuf.data());
+
+      res.total.stop();
+    }
+
+    res.time = Generics::Time::get_time_of_day() - start;
+    return res;
+  }
+
+  // request received into ref counted buffer (body parsed in place)
+  BenchResult
+  bench_receive_buffer(const std::vector<char>& message, unsigned long count)
+  {
+    BenchResult res;
+    FrontendCommons::Frontend_var frontend = new BidFrontend(res);
+    std::vector<char> wbuf(RESPONSE_BUF_SIZE);
+
+    const Generics::Time start = Generics::Time::get_time_of_day();
+
+    for(unsigned long i = 0; i < count; ++i)
+    {
+      res.total.start();
+
+      {
+        FCGI::ReceiveBuffer_var rbuf = new FCGI::ReceiveBuffer(message.size());
+        ::memcpy(rbuf->data(), message.data(), message.size()); // recv
+
+        FCGI::HttpRequest request;
+        request.parse(rbuf, message.size());
+        process_request(res, frontend, request, wbuf.data());
+      }
+
+      res.total.stop();
+    }
+
+    res.time = Generics::Time::get_time_of_day() - start;
+    return res;
+  }
+
+  void
+  print_result(
+    const char* name,
+    size_t body_size,
+    unsigned long count,
+    const BenchResult& res)
+  {
+    std::cout << name << ": body size = " << body_size <<
+      ", time = " << res.time <<
+      ", per request = " << res.time.microseconds() / count << " us" <<
+      ", handler allocations = " << res.handler.allocations / count <<
+      " (" << res.handler.allocated_bytes / count << " bytes)" <<
+      ", total allocations = " << res.total.allocations / count <<
+      " (" << res.total.allocated_bytes / count << " bytes)" <<
+      ", in place bodies = " << res.inplace_bodies <<
+      ", errors = " << res.errors <<
+      std::endl;
+  }
+}
+
+int
+main(int argc, char** argv)
+{
+  Generics::AppUtils::Option<unsigned long> opt_count(100000);
+
+  Generics::AppUtils::Args args(-1);
+
+  args.add(
+    Generics::AppUtils::equal_name("count") ||
+    Generics::AppUtils::short_name("c"),
+    opt_count);
+
+  args.parse(argc - 1, argv + 1);
+
+  try
+  {
+    const size_t BODY_SIZES[] = { 1024, 5 * 1024, 10 * 1024, 20 * 1024 };
+
+    for(size_t i = 0; i < sizeof(BODY_SIZES) / sizeof(BODY_SIZES[0]); ++i)
+    {
+      const std::vector<char> message = make_request(BODY_SIZES[i]);
+
+      print_result(
+        "plain buffer",
+        BODY_SIZES[i],
+        *opt_count,
+        bench_plain(message, *opt_count));
+
+      print_result(
+        "receive buffer",
+        BODY_SIZES[i],
+        *opt_count,
+        bench_receive_buffer(message, *opt_count));
+    }
+  }
+  catch(const eh::Exception& ex)
+  {
+    std::cerr << "Caught eh::Exception: " << ex.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
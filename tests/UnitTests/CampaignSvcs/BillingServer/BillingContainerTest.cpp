@@ -0,0 +1,362 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @file BillingServer/BillingContainerTest.cpp
+// batch check and confirm of BillingContainer against bid by bid calls
+
+#include <iostream>
+
+#include <Logger/StreamLogger.hpp>
+
+#include <CampaignSvcs/BillingServer/BillingContainer.hpp>
+
+using namespace AdServer::CampaignSvcs;
+
+namespace
+{
+  const char STORAGE_ROOT[] = "./BillingContainerTest.storage";
+
+  // account 1 with budget 10, account 2 with budget 100,
+  // account N have campaign N * 10 + 1 and ccg N * 100 + 11
+  const unsigned long ACCOUNT_IDS[] = { 1, 2 };
+  const unsigned long SMALL_ACCOUNT_ID = 1;
+  const unsigned long LARGE_ACCOUNT_ID = 2;
+  const unsigned long UNKNOWN_ACCOUNT_ID = 3;
+}
+
+#define CHECK_EQUAL(TEST, EXPR, EXPECTED) \
+  if(!((EXPR) == (EXPECTED))) \
+  { \
+    std::cerr << TEST << ": " #EXPR " = " << (EXPR) << \
+      " instead " << (EXPECTED) << std::endl; \
+    ++result; \
+  }
+
+unsigned long
+campaign_id(unsigned long account_id)
+{
+  return account_id * 10 + 1;
+}
+
+unsigned long
+ccg_id(unsigned long account_id)
+{
+  return account_id * 100 + 11;
+}
+
+BillingContainer::Config_var
+create_config()
+{
+  BillingContainer::Config_var config = new BillingContainer::Config();
+
+  for(unsigned long acc_i = 0;
+      acc_i < sizeof(ACCOUNT_IDS) / sizeof(ACCOUNT_IDS[0]); ++acc_i)
+  {
+    const unsigned long account_id = ACCOUNT_IDS[acc_i];
+
+    BillingContainer::Config::Account& account =
+      config->accounts[account_id];
+    account.active = true;
+    account.time_offset = Generics::Time::ZERO;
+    account.budget = RevenueDecimal(
+      false, account_id == SMALL_ACCOUNT_ID ? 10 : 100, 0);
+
+    BillingContainer::Config::Campaign& campaign =
+      config->campaigns[campaign_id(account_id)];
+    campaign.active = true;
+    campaign.time_offset = Generics::Time::ZERO;
+    campaign.date_start = Generics::Time::ZERO;
+    campaign.date_end = Generics::Time::ZERO;
+    campaign.delivery_pacing = 'U';
+
+    BillingContainer::Config::CCG& ccg =
+      config->ccgs[ccg_id(account_id)];
+    ccg.active = true;
+    ccg.time_offset = Generics::Time::ZERO;
+    ccg.date_start = Generics::Time::ZERO;
+    ccg.date_end = Generics::Time::ZERO;
+    ccg.delivery_pacing = 'U';
+    ccg.campaign_id = campaign_id(account_id);
+    ccg.imp_amount = RevenueDecimal(false, 1, 0);
+    ccg.click_amount = RevenueDecimal::ZERO;
+  }
+
+  return config;
+}
+
+BillingContainer_var
+create_container(Logging::Logger* logger)
+{
+  BillingContainer_var container = new BillingContainer(
+    logger,
+    STORAGE_ROOT,
+    Generics::Time::ONE_DAY, // stat delay
+    1 // limits divider
+    );
+
+  container->config(create_config());
+
+  return container;
+}
+
+BillingProcessor::Bid
+create_bid(unsigned long account_id)
+{
+  BillingProcessor::Bid bid;
+  bid.time = Generics::Time::get_time_of_day();
+  bid.account_id = account_id;
+  bid.advertiser_id = 0;
+  bid.campaign_id = campaign_id(account_id);
+  bid.ccg_id = ccg_id(account_id);
+  bid.ctr = RevenueDecimal::ZERO;
+  bid.optimize_campaign_ctr = false;
+  return bid;
+}
+
+BillingProcessor::BidAmount
+create_amount(unsigned long amount)
+{
+  BillingProcessor::BidAmount bid_amount;
+  bid_amount.account_amount = RevenueDecimal(false, amount, 0);
+  bid_amount.amount = RevenueDecimal(false, amount, 0);
+  bid_amount.imps = RevenueDecimal(false, 1, 0);
+  bid_amount.clicks = RevenueDecimal::ZERO;
+  bid_amount.forced = false;
+  return bid_amount;
+}
+
+// small account bids interleaved with large account bids,
+// small account budget (10) is reached at 4th bid of amount 3
+void
+fill_mixed_bids(
+  BillingProcessor::BidArray& bids,
+  BillingProcessor::BidAmountArray& amounts)
+{
+  for(unsigned long i = 0; i < 4; ++i)
+  {
+    bids.push_back(create_bid(SMALL_ACCOUNT_ID));
+    amounts.push_back(create_amount(3));
+    bids.push_back(create_bid(LARGE_ACCOUNT_ID));
+    amounts.push_back(create_amount(3));
+  }
+}
+
+// check_available_bids give same results as check_available_bid
+int
+check_test(Logging::Logger* logger)
+{
+  static const char* TEST = "check_test";
+
+  int result = 0;
+
+  BillingContainer_var container = create_container(logger);
+
+  BillingProcessor::BidArray bids;
+  bids.push_back(create_bid(SMALL_ACCOUNT_ID));
+  bids.push_back(create_bid(UNKNOWN_ACCOUNT_ID));
+  bids.push_back(create_bid(LARGE_ACCOUNT_ID));
+  bids.push_back(create_bid(SMALL_ACCOUNT_ID));
+
+  BillingProcessor::BidResultArray results;
+  container->check_available_bids(results, bids);
+
+  CHECK_EQUAL(TEST, results.size(), bids.size());
+  CHECK_EQUAL(TEST, results[0].available, true);
+  CHECK_EQUAL(TEST, results[1].available, false);
+  CHECK_EQUAL(TEST, results[2].available, true);
+  CHECK_EQUAL(TEST, results[3].available, true);
+
+  // spend small account budget
+  {
+    BillingProcessor::BidAmount amount = create_amount(10);
+    container->confirm_bid(
+      amount.account_amount,
+      amount.amount,
+      amount.imps,
+      amount.clicks,
+      bids[0],
+      false);
+  }
+
+  container->check_available_bids(results, bids);
+
+  CHECK_EQUAL(TEST, results.size(), bids.size());
+
+  for(std::size_t bid_i = 0; bid_i < bids.size(); ++bid_i)
+  {
+    CHECK_EQUAL(TEST, results[bid_i].available,
+      bids[bid_i].account_id == LARGE_ACCOUNT_ID);
+    CHECK_EQUAL(TEST, results[bid_i].available,
+      container->check_available_bid(bids[bid_i]).available);
+  }
+
+  return result;
+}
+
+// account budget is reached inside batch: confirmed part of last bid
+int
+confirm_test(Logging::Logger* logger)
+{
+  static const char* TEST = "confirm_test";
+
+  int result = 0;
+
+  BillingContainer_var container = create_container(logger);
+
+  BillingProcessor::BidArray bids;
+  BillingProcessor::BidAmountArray amounts;
+  fill_mixed_bids(bids, amounts);
+
+  BillingProcessor::BidResultArray results;
+  container->confirm_bids(results, amounts, bids);
+
+  CHECK_EQUAL(TEST, results.size(), bids.size());
+
+  unsigned long small_bid_i = 0;
+
+  for(std::size_t bid_i = 0; bid_i < bids.size(); ++bid_i)
+  {
+    if(bids[bid_i].account_id == SMALL_ACCOUNT_ID && ++small_bid_i == 4)
+    {
+      // 9 of 10 spent by previous bids
+      CHECK_EQUAL(TEST, results[bid_i].available, false);
+      CHECK_EQUAL(TEST, amounts[bid_i].account_amount,
+        RevenueDecimal(false, 2, 0));
+    }
+    else
+    {
+      CHECK_EQUAL(TEST, results[bid_i].available, true);
+      CHECK_EQUAL(TEST, amounts[bid_i].account_amount, RevenueDecimal::ZERO);
+      CHECK_EQUAL(TEST, amounts[bid_i].amount, RevenueDecimal::ZERO);
+    }
+  }
+
+  CHECK_EQUAL(TEST,
+    container->check_available_bid(create_bid(SMALL_ACCOUNT_ID)).available,
+    false);
+  CHECK_EQUAL(TEST,
+    container->check_available_bid(create_bid(LARGE_ACCOUNT_ID)).available,
+    true);
+
+  return result;
+}
+
+// confirm_bids results, remainders and container state
+// are equal to results of confirm_bid calls in batch order
+int
+confirm_sequence_test(Logging::Logger* logger)
+{
+  static const char* TEST = "confirm_sequence_test";
+
+  int result = 0;
+
+  BillingContainer_var batch_container = create_container(logger);
+  BillingContainer_var sequence_container = create_container(logger);
+
+  BillingProcessor::BidArray bids;
+  BillingProcessor::BidAmountArray batch_amounts;
+  fill_mixed_bids(bids, batch_amounts);
+  bids.push_back(create_bid(UNKNOWN_ACCOUNT_ID));
+  batch_amounts.push_back(create_amount(1));
+
+  BillingProcessor::BidAmountArray sequence_amounts(batch_amounts);
+
+  BillingProcessor::BidResultArray batch_results;
+  batch_container->confirm_bids(batch_results, batch_amounts, bids);
+
+  CHECK_EQUAL(TEST, batch_results.size(), bids.size());
+
+  for(std::size_t bid_i = 0; bid_i < bids.size(); ++bid_i)
+  {
+    BillingProcessor::BidAmount& amount = sequence_amounts[bid_i];
+
+    const BillingProcessor::BidResult sequence_result =
+      sequence_container->confirm_bid(
+        amount.account_amount,
+        amount.amount,
+        amount.imps,
+        amount.clicks,
+        bids[bid_i],
+        amount.forced);
+
+    CHECK_EQUAL(TEST, batch_results[bid_i].available,
+      sequence_result.available);
+    CHECK_EQUAL(TEST, batch_results[bid_i].goal_ctr,
+      sequence_result.goal_ctr);
+    CHECK_EQUAL(TEST, batch_amounts[bid_i].account_amount,
+      amount.account_amount);
+    CHECK_EQUAL(TEST, batch_amounts[bid_i].amount, amount.amount);
+    CHECK_EQUAL(TEST, batch_amounts[bid_i].imps, amount.imps);
+    CHECK_EQUAL(TEST, batch_amounts[bid_i].clicks, amount.clicks);
+  }
+
+  // remaining budgets are equal: next equal confirm give equal remainders
+  for(unsigned long acc_i = 0;
+      acc_i < sizeof(ACCOUNT_IDS) / sizeof(ACCOUNT_IDS[0]); ++acc_i)
+  {
+    const BillingProcessor::Bid bid = create_bid(ACCOUNT_IDS[acc_i]);
+    BillingProcessor::BidAmount batch_amount = create_amount(1000);
+    BillingProcessor::BidAmount sequence_amount = create_amount(1000);
+
+    batch_container->confirm_bid(
+      batch_amount.account_amount,
+      batch_amount.amount,
+      batch_amount.imps,
+      batch_amount.clicks,
+      bid,
+      false);
+
+    sequence_container->confirm_bid(
+      sequence_amount.account_amount,
+      sequence_amount.amount,
+      sequence_amount.imps,
+      sequence_amount.clicks,
+      bid,
+      false);
+
+    CHECK_EQUAL(TEST, batch_amount.account_amount,
+      sequence_amount.account_amount);
+  }
+
+  return result;
+}
+
+int
+main() throw ()
+{
+  int result = 0;
+
+  try
+  {
+    Logging::Logger_var logger = new Logging::OStream::Logger(
+      Logging::OStream::Config(std::cerr));
+
+    result += check_test(logger);
+    result += confirm_test(logger);
+    result += confirm_sequence_test(logger);
+  }
+  catch (const eh::Exception& ex)
+  {
+    std::cerr << ex.what() << std::endl;
+    result = 1;
+  }
+
+  return result;
+}
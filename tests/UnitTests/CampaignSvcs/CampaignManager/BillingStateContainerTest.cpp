@@ -0,0 +1,543 @@
+/*
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @file CampaignManager/BillingStateContainerTest.cpp
+// lease mode of BillingStateContainer over in memory budget
+
+#include <unistd.h>
+#include <iostream>
+
+#include <Logger/StreamLogger.hpp>
+#include <Logger/ActiveObjectCallback.hpp>
+
+#include <Commons/CorbaAlgs.hpp>
+#include <CampaignSvcs/CampaignManager/BillingStateContainer.hpp>
+
+using namespace AdServer::CampaignSvcs;
+
+namespace
+{
+  const unsigned long LEASE_SIZE = 10;
+  const unsigned long REFILL_SIZE = 3;
+  const unsigned long MAX_OVERSPEND = 2;
+
+  const unsigned long ACCOUNT_ID = 1;
+  const unsigned long ADVERTISER_ID = 2;
+  const unsigned long CAMPAIGN_ID = 3;
+  const unsigned long CCG_ID = 4;
+
+  const Generics::Time WAIT_TIMEOUT(5);
+}
+
+// BillingStateContainer with BillingServer replaced by budget of one ccg,
+// lease methods are opened for test
+class TestBillingStateContainer: public BillingStateContainer
+{
+public:
+  typedef BillingStateContainer::CCGLease CCGLease;
+  typedef BillingStateContainer::CCGLease_var CCGLease_var;
+
+  TestBillingStateContainer(
+    Generics::ActiveObjectCallback* callback,
+    Logging::Logger* logger,
+    const CORBACommons::CorbaObjectRefList& billing_server_refs,
+    const LeaseConfig& lease_config,
+    const RevenueDecimal& budget)
+    throw()
+    : BillingStateContainer(
+        callback,
+        logger,
+        billing_server_refs,
+        1000, // max_use_count
+        false, // optimize_campaign_ctr
+        &lease_config),
+      budget_(budget),
+      returned_imps_(RevenueDecimal::ZERO),
+      returned_clicks_(RevenueDecimal::ZERO),
+      return_calls_(0),
+      fail_return_(false)
+  {}
+
+  CCGLease_var
+  create_lease(const RevenueDecimal& bid_amount)
+  {
+    create_lease_(
+      Generics::Time::get_time_of_day(),
+      ACCOUNT_ID,
+      ADVERTISER_ID,
+      CAMPAIGN_ID,
+      CCG_ID,
+      bid_amount,
+      bid_amount,
+      RevenueDecimal::ZERO);
+
+    CCGLease_var lease = get_lease_(CCG_ID);
+    wait_refill(lease);
+    return lease;
+  }
+
+  bool
+  confirm(CCGLease* lease, unsigned long imps, unsigned long clicks)
+  {
+    return confirm_delivery(
+      lease,
+      RevenueDecimal(false, imps, 0),
+      RevenueDecimal(false, clicks, 0));
+  }
+
+  bool
+  confirm_delivery(
+    CCGLease* lease,
+    const RevenueDecimal& imps,
+    const RevenueDecimal& clicks)
+  {
+    BidCheckResult result;
+    const bool confirmed = confirm_lease_bid_(
+      result,
+      Generics::Time::get_time_of_day(),
+      lease,
+      imps,
+      clicks);
+    wait_refill(lease);
+    return confirmed;
+  }
+
+  bool
+  check(CCGLease* lease)
+  {
+    const BidCheckResult result = check_lease_bid_(
+      Generics::Time::get_time_of_day(),
+      lease,
+      nullptr);
+    wait_refill(lease);
+    return result.available;
+  }
+
+  // refill without planning (ignore unavailability time)
+  void
+  force_refill(CCGLease* lease)
+  {
+    {
+      SyncPolicy::WriteGuard lock(lease->lock);
+      lease->refill_planned += 1;
+    }
+
+    refill_lease_(CCGLease_var(ReferenceCounting::add_ref(lease)));
+  }
+
+  void
+  return_leases()
+  {
+    return_leases_();
+  }
+
+  static void
+  wait_refill(CCGLease* lease)
+  {
+    const Generics::Time end = Generics::Time::get_time_of_day() + WAIT_TIMEOUT;
+
+    while(lease->refill_planned && Generics::Time::get_time_of_day() < end)
+    {
+      ::usleep(1000);
+    }
+  }
+
+  RevenueDecimal
+  budget() const
+  {
+    SyncPolicy::ReadGuard lock(budget_lock_);
+    return budget_;
+  }
+
+  void
+  add_budget(const RevenueDecimal& amount)
+  {
+    SyncPolicy::WriteGuard lock(budget_lock_);
+    budget_ += amount;
+  }
+
+  RevenueDecimal
+  returned_imps() const
+  {
+    SyncPolicy::ReadGuard lock(budget_lock_);
+    return returned_imps_;
+  }
+
+  RevenueDecimal
+  returned_clicks() const
+  {
+    SyncPolicy::ReadGuard lock(budget_lock_);
+    return returned_clicks_;
+  }
+
+  unsigned long
+  return_calls() const
+  {
+    SyncPolicy::ReadGuard lock(budget_lock_);
+    return return_calls_;
+  }
+
+  void
+  fail_return(bool fail)
+  {
+    SyncPolicy::WriteGuard lock(budget_lock_);
+    fail_return_ = fail;
+  }
+
+protected:
+  virtual
+  ~TestBillingStateContainer() throw() = default;
+
+  virtual bool
+  lease_budget_(
+    AdServer::CampaignSvcs::BillingServer::BidResultInfo_var& lease_result,
+    unsigned long /*service_index*/,
+    AdServer::CampaignSvcs::BillingServer::LeaseBudgetInfo& lease_budget_info)
+    throw()
+  {
+    const RevenueDecimal amount =
+      CorbaAlgs::unpack_decimal<RevenueDecimal>(lease_budget_info.amount);
+
+    SyncPolicy::WriteGuard lock(budget_lock_);
+    const RevenueDecimal leased_amount = std::min(amount, budget_);
+    budget_ -= leased_amount;
+
+    // account level isn't limited
+    lease_budget_info.account_amount =
+      CorbaAlgs::pack_decimal(RevenueDecimal::ZERO);
+    lease_budget_info.amount = CorbaAlgs::pack_decimal(amount - leased_amount);
+
+    lease_result = new AdServer::CampaignSvcs::BillingServer::BidResultInfo();
+    lease_result->available = (budget_ != RevenueDecimal::ZERO);
+    lease_result->goal_ctr = CorbaAlgs::pack_decimal(RevenueDecimal::ZERO);
+    return true;
+  }
+
+  virtual bool
+  return_budget_(
+    unsigned long /*service_index*/,
+    const AdServer::CampaignSvcs::BillingServer::ReturnBudgetInfo&
+      return_budget_info)
+    throw()
+  {
+    SyncPolicy::WriteGuard lock(budget_lock_);
+
+    if(fail_return_)
+    {
+      return false;
+    }
+
+    ++return_calls_;
+    budget_ += CorbaAlgs::unpack_decimal<RevenueDecimal>(
+      return_budget_info.amount);
+    returned_imps_ += CorbaAlgs::unpack_decimal<RevenueDecimal>(
+      return_budget_info.imps);
+    returned_clicks_ += CorbaAlgs::unpack_decimal<RevenueDecimal>(
+      return_budget_info.clicks);
+    return true;
+  }
+
+private:
+  mutable SyncPolicy::Mutex budget_lock_;
+  RevenueDecimal budget_;
+  RevenueDecimal returned_imps_;
+  RevenueDecimal returned_clicks_;
+  unsigned long return_calls_;
+  bool fail_return_;
+};
+
+typedef ReferenceCounting::QualPtr<TestBillingStateContainer>
+  TestBillingStateContainer_var;
+
+struct TestContext
+{
+  Logging::Logger_var logger;
+  Logging::ActiveObjectCallbackImpl_var callback;
+  CORBACommons::CorbaObjectRefList billing_server_refs;
+  BillingStateContainer::LeaseConfig lease_config;
+};
+
+#define CHECK_EQUAL(TEST, EXPR, EXPECTED) \
+  if(!((EXPR) == (EXPECTED))) \
+  { \
+    std::cerr << TEST << ": " #EXPR " = " << (EXPR) << \
+      " instead " << (EXPECTED) << std::endl; \
+    ++result; \
+  }
+
+TestBillingStateContainer_var
+create_container(
+  const TestContext& context,
+  const RevenueDecimal& budget)
+{
+  TestBillingStateContainer_var container = new TestBillingStateContainer(
+    context.callback,
+    context.logger,
+    context.billing_server_refs,
+    context.lease_config,
+    budget);
+  container->activate_object();
+  return container;
+}
+
+void
+destroy_container(TestBillingStateContainer* container)
+{
+  container->deactivate_object();
+  container->wait_object();
+}
+
+// first lease and refill when remainder reach refill_size
+int
+lease_refill_test(const TestContext& context)
+{
+  static const char* TEST = "lease_refill_test";
+
+  int result = 0;
+
+  const RevenueDecimal bid_amount(false, 1, 0);
+  TestBillingStateContainer_var container = create_container(
+    context, RevenueDecimal(false, 100, 0));
+
+  TestBillingStateContainer::CCGLease_var lease =
+    container->create_lease(bid_amount);
+
+  CHECK_EQUAL(TEST, static_cast<int>(lease->bids), static_cast<int>(LEASE_SIZE));
+  CHECK_EQUAL(TEST, container->budget(), RevenueDecimal(false, 90, 0));
+  CHECK_EQUAL(TEST, container->check(lease), true);
+
+  // spend lease up to refill_size
+  for(unsigned long i = 0; i < LEASE_SIZE - REFILL_SIZE; ++i)
+  {
+    CHECK_EQUAL(TEST, container->confirm(lease, 1, 0), true);
+  }
+
+  CHECK_EQUAL(TEST, static_cast<int>(lease->bids),
+    static_cast<int>(REFILL_SIZE + LEASE_SIZE));
+  CHECK_EQUAL(TEST, static_cast<int>(lease->spent_bids),
+    static_cast<int>(LEASE_SIZE - REFILL_SIZE));
+  CHECK_EQUAL(TEST, container->budget(), RevenueDecimal(false, 80, 0));
+
+  destroy_container(container);
+
+  return result;
+}
+
+// partial lease: amount that isn't enough for whole bid is returned
+int
+partial_lease_test(const TestContext& context)
+{
+  static const char* TEST = "partial_lease_test";
+
+  int result = 0;
+
+  const RevenueDecimal bid_amount(false, 2, 0);
+  TestBillingStateContainer_var container = create_container(
+    context, RevenueDecimal(false, 11, 0));
+
+  TestBillingStateContainer::CCGLease_var lease =
+    container->create_lease(bid_amount);
+
+  CHECK_EQUAL(TEST, static_cast<int>(lease->bids), 5);
+  CHECK_EQUAL(TEST, container->budget(), RevenueDecimal(false, 1, 0));
+  CHECK_EQUAL(TEST, container->return_calls(), 1u);
+
+  destroy_container(container);
+
+  return result;
+}
+
+// confirms over exhausted lease are bounded by max_overspend,
+// overspent bids are covered by next lease
+int
+overspend_test(const TestContext& context)
+{
+  static const char* TEST = "overspend_test";
+
+  int result = 0;
+
+  const RevenueDecimal bid_amount(false, 1, 0);
+  TestBillingStateContainer_var container = create_container(
+    context, RevenueDecimal(false, LEASE_SIZE, 0));
+
+  TestBillingStateContainer::CCGLease_var lease =
+    container->create_lease(bid_amount);
+
+  CHECK_EQUAL(TEST, static_cast<int>(lease->bids), static_cast<int>(LEASE_SIZE));
+  CHECK_EQUAL(TEST, container->budget(), RevenueDecimal::ZERO);
+
+  unsigned long confirmed = 0;
+  for(unsigned long i = 0; i < LEASE_SIZE + MAX_OVERSPEND + 5; ++i)
+  {
+    if(container->confirm(lease, 1, 0))
+    {
+      ++confirmed;
+    }
+  }
+
+  CHECK_EQUAL(TEST, confirmed, LEASE_SIZE + MAX_OVERSPEND);
+  CHECK_EQUAL(TEST, static_cast<int>(lease->bids),
+    -static_cast<int>(MAX_OVERSPEND));
+  CHECK_EQUAL(TEST, container->check(lease), false);
+
+  // budget increased: next lease covers overspent bids
+  container->add_budget(RevenueDecimal(false, 100, 0));
+  container->force_refill(lease);
+
+  CHECK_EQUAL(TEST, static_cast<int>(lease->bids), static_cast<int>(LEASE_SIZE));
+  CHECK_EQUAL(TEST, container->budget(),
+    RevenueDecimal(false, 100 - LEASE_SIZE - MAX_OVERSPEND, 0));
+  CHECK_EQUAL(TEST, container->check(lease), true);
+
+  destroy_container(container);
+
+  return result;
+}
+
+// not used lease remainder is returned, delivery is flushed on each return
+int
+return_test(const TestContext& context)
+{
+  static const char* TEST = "return_test";
+
+  int result = 0;
+
+  const RevenueDecimal bid_amount(false, 1, 0);
+  TestBillingStateContainer_var container = create_container(
+    context, RevenueDecimal(false, 100, 0));
+
+  TestBillingStateContainer::CCGLease_var lease =
+    container->create_lease(bid_amount);
+
+  CHECK_EQUAL(TEST, container->confirm(lease, 1, 1), true);
+  CHECK_EQUAL(TEST, container->confirm(lease, 1, 0), true);
+
+  // lease used in period: only delivery returned
+  container->return_leases();
+
+  CHECK_EQUAL(TEST, static_cast<int>(lease->bids),
+    static_cast<int>(LEASE_SIZE - 2));
+  CHECK_EQUAL(TEST, container->budget(), RevenueDecimal(false, 90, 0));
+  CHECK_EQUAL(TEST, container->returned_imps(), RevenueDecimal(false, 2, 0));
+  CHECK_EQUAL(TEST, container->returned_clicks(), RevenueDecimal(false, 1, 0));
+
+  // failed return keeps remainder
+  container->fail_return(true);
+  container->return_leases();
+
+  CHECK_EQUAL(TEST, static_cast<int>(lease->bids),
+    static_cast<int>(LEASE_SIZE - 2));
+
+  // lease expired: remainder returned
+  container->fail_return(false);
+  container->return_leases();
+
+  CHECK_EQUAL(TEST, static_cast<int>(lease->bids), 0);
+  CHECK_EQUAL(TEST, container->budget(), RevenueDecimal(false, 98, 0));
+  CHECK_EQUAL(TEST, container->return_calls(), 2u);
+
+  // nothing to return
+  container->return_leases();
+
+  CHECK_EQUAL(TEST, container->return_calls(), 2u);
+  CHECK_EQUAL(TEST, container->budget(), RevenueDecimal(false, 98, 0));
+
+  destroy_container(container);
+
+  return result;
+}
+
+// fractional delivery of bids (imps, clicks rates) isn't lost on return
+int
+fractional_delivery_test(const TestContext& context)
+{
+  static const char* TEST = "fractional_delivery_test";
+
+  int result = 0;
+
+  TestBillingStateContainer_var container = create_container(
+    context, RevenueDecimal(false, 100, 0));
+
+  TestBillingStateContainer::CCGLease_var lease =
+    container->create_lease(RevenueDecimal(false, 1, 0));
+
+  for(unsigned long i = 0; i < 3; ++i)
+  {
+    CHECK_EQUAL(TEST, container->confirm_delivery(
+      lease, RevenueDecimal("0.5"), RevenueDecimal("0.01")), true);
+  }
+
+  container->return_leases();
+
+  CHECK_EQUAL(TEST, container->returned_imps(), RevenueDecimal("1.5"));
+  CHECK_EQUAL(TEST, container->returned_clicks(), RevenueDecimal("0.03"));
+
+  // failed return keeps delivery for next return
+  CHECK_EQUAL(TEST, container->confirm_delivery(
+    lease, RevenueDecimal("0.25"), RevenueDecimal::ZERO), true);
+  container->fail_return(true);
+  container->return_leases();
+  container->fail_return(false);
+  container->return_leases();
+
+  CHECK_EQUAL(TEST, container->returned_imps(), RevenueDecimal("1.75"));
+  CHECK_EQUAL(TEST, container->returned_clicks(), RevenueDecimal("0.03"));
+
+  destroy_container(container);
+
+  return result;
+}
+
+int
+main() throw ()
+{
+  int result = 0;
+
+  try
+  {
+    TestContext context;
+    context.logger = new Logging::OStream::Logger(
+      Logging::OStream::Config(std::cerr));
+    context.callback = new Logging::ActiveObjectCallbackImpl(
+      context.logger,
+      "BillingStateContainerTest::main()",
+      "BillingStateContainerTest",
+      "");
+    context.billing_server_refs.push_back(CORBACommons::CorbaObjectRef());
+    context.lease_config.size = LEASE_SIZE;
+    context.lease_config.refill_size = REFILL_SIZE;
+    context.lease_config.max_overspend = MAX_OVERSPEND;
+    // periodic return is called by test
+    context.lease_config.return_period = Generics::Time::ONE_DAY;
+
+    result += lease_refill_test(context);
+    result += partial_lease_test(context);
+    result += overspend_test(context);
+    result += return_test(context);
+    result += fractional_delivery_test(context);
+  }
+  catch (const eh::Exception& ex)
+  {
+    std::cerr << ex.what() << std::endl;
+    result = 1;
+  }
+
+  return result;
+}
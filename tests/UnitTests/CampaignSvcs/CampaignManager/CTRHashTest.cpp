@@ -0,0 +1,316 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+// @file CampaignManager/CTRHashTest.cpp
+// CTR feature hashing: batch murmur hashing is bit exact with
+// Generics::Murmur32v3Hasher, hash mapping (HashMap) lookups
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include <Generics/Hash.hpp>
+
+#include <CampaignSvcs/CampaignManager/CTRMurmurHash.hpp>
+#include <CampaignSvcs/CampaignManager/CTRFeatureCalculators.hpp>
+
+using namespace AdServer::CampaignSvcs;
+
+#define CHECK_EQUAL(TEST, EXPR, EXPECTED) \
+  if(!((EXPR) == (EXPECTED))) \
+  { \
+    std::cerr << TEST << ": " #EXPR " = " << (EXPR) << \
+      " instead " << (EXPECTED) << std::endl; \
+    ++result; \
+  }
+
+namespace
+{
+  const std::size_t SEEDS[] = { 0, 1, 0x9747b28c, 0xffffffff };
+
+  std::vector<unsigned char>
+  random_bytes(std::size_t size)
+  {
+    std::vector<unsigned char> res(size);
+
+    for(std::size_t i = 0; i < size; ++i)
+    {
+      res[i] = static_cast<unsigned char>(::rand());
+    }
+
+    return res;
+  }
+
+  uint32_t
+  generics_hash(
+    std::size_t seed,
+    const unsigned char* data,
+    std::size_t size)
+  {
+    Generics::Murmur32v3Hasher hasher(seed);
+    hasher.add(data, size);
+    return hasher.finalize();
+  }
+
+  // HashMap with open cell index
+  class TestHashMap: public CTR::HashMap
+  {
+  public:
+    using CTR::HashMap::cell_index_;
+
+    std::size_t
+    capacity() const
+    {
+      return cells_.size();
+    }
+  };
+}
+
+// incremental hashing (by chunks of any size) is equal to
+// Generics::Murmur32v3Hasher
+int
+hasher_test()
+{
+  static const char* TEST = "hasher_test";
+  int result = 0;
+
+  for(std::size_t seed_i = 0; seed_i < sizeof(SEEDS) / sizeof(SEEDS[0]);
+      ++seed_i)
+  {
+    for(std::size_t size = 0; size < 64; ++size)
+    {
+      const std::vector<unsigned char> data = random_bytes(size);
+      const uint32_t standard = generics_hash(SEEDS[seed_i], data.data(), size);
+
+      {
+        CTR::Murmur32v3BatchHasher hasher(SEEDS[seed_i]);
+        hasher.add(data.data(), size);
+        CHECK_EQUAL(TEST, hasher.finalize(), standard);
+      }
+
+      {
+        // add by random chunks
+        CTR::Murmur32v3BatchHasher hasher(SEEDS[seed_i]);
+        std::size_t pos = 0;
+
+        while(pos < size)
+        {
+          const std::size_t chunk_size = std::min<std::size_t>(
+            ::rand() % 7, size - pos);
+          hasher.add(data.data() + pos, chunk_size);
+          pos += chunk_size;
+        }
+
+        CHECK_EQUAL(TEST, hasher.finalize(), standard);
+      }
+    }
+  }
+
+  // features hashing: seed, uint32 fields, string
+  {
+    CTR::Murmur32v3Adapter adapter(SEEDS[2]);
+    adapter.add(static_cast<uint32_t>(12345));
+    adapter.add(std::string("www.test.com"));
+    adapter.add(static_cast<uint32_t>(7));
+
+    Generics::Murmur32v3Hasher hasher(SEEDS[2]);
+    const uint32_t first = 12345;
+    const uint32_t last = 7;
+    hasher.add(&first, sizeof(first));
+    hasher.add("www.test.com", 12);
+    hasher.add(&last, sizeof(last));
+
+    CHECK_EQUAL(TEST, adapter.finalize(), hasher.finalize());
+  }
+
+  return result;
+}
+
+// batch finalization is equal to scalar finalization (and Generics hasher)
+// for any prefix tail size and any batch size (SIMD lanes and remainder)
+int
+batch_test()
+{
+  static const char* TEST = "batch_test";
+  int result = 0;
+
+  for(std::size_t seed_i = 0; seed_i < sizeof(SEEDS) / sizeof(SEEDS[0]);
+      ++seed_i)
+  {
+    for(std::size_t prefix_size = 0; prefix_size < 12; ++prefix_size)
+    {
+      const std::vector<unsigned char> prefix = random_bytes(prefix_size);
+
+      CTR::Murmur32v3BatchHasher hasher(SEEDS[seed_i]);
+      hasher.add(prefix.data(), prefix_size);
+
+      for(std::size_t count = 0; count < 40; ++count)
+      {
+        std::vector<uint32_t> values(count);
+        for(std::size_t i = 0; i < count; ++i)
+        {
+          values[i] = i % 3 ? static_cast<uint32_t>(::rand()) :
+            static_cast<uint32_t>(i == 0 ? 0 : 0xffffffff - i);
+        }
+
+        std::vector<uint32_t> hashes(count + 1, 0);
+        hasher.finalize_batch(hashes.data(), values.data(), count);
+
+        for(std::size_t i = 0; i < count; ++i)
+        {
+          CTR::Murmur32v3BatchHasher scalar_hasher(hasher);
+          scalar_hasher.add(&values[i], sizeof(values[i]));
+          CHECK_EQUAL(TEST, hashes[i], scalar_hasher.finalize());
+
+          std::vector<unsigned char> data(prefix);
+          const unsigned char* value_ptr =
+            reinterpret_cast<const unsigned char*>(&values[i]);
+          data.insert(data.end(), value_ptr, value_ptr + sizeof(values[i]));
+          CHECK_EQUAL(TEST, hashes[i],
+            generics_hash(SEEDS[seed_i], data.data(), data.size()));
+        }
+
+        // result isn't written out of count
+        CHECK_EQUAL(TEST, hashes[count], 0u);
+      }
+    }
+  }
+
+  return result;
+}
+
+int
+hash_map_test()
+{
+  static const char* TEST = "hash_map_test";
+  int result = 0;
+
+  TestHashMap hash_map;
+  uint32_t value = 0;
+
+  CHECK_EQUAL(TEST, hash_map.size(), 0u);
+  CHECK_EQUAL(TEST, hash_map.find(value, 1), false);
+  CHECK_EQUAL(TEST, hash_map.find(value, 0), false);
+
+  // insert, duplicate key keep first value
+  hash_map.insert(1, 10);
+  hash_map.insert(1, 11);
+  CHECK_EQUAL(TEST, hash_map.size(), 1u);
+  CHECK_EQUAL(TEST, hash_map.find(value, 1), true);
+  CHECK_EQUAL(TEST, value, 10u);
+  CHECK_EQUAL(TEST, hash_map.find(value, 2), false);
+
+  // zero key (kept out of table)
+  hash_map.insert(0, 20);
+  hash_map.insert(0, 21);
+  CHECK_EQUAL(TEST, hash_map.size(), 2u);
+  CHECK_EQUAL(TEST, hash_map.find(value, 0), true);
+  CHECK_EQUAL(TEST, value, 20u);
+
+  // collisions: keys with equal cell index are found after probing,
+  // absent key with same cell index isn't found
+  const std::size_t capacity = hash_map.capacity();
+  const std::size_t cell_index = hash_map.cell_index_(1);
+  // keys that can be inserted without rehash (+ one absent key)
+  const std::size_t colliding_count = capacity / 2 - hash_map.size() + 1;
+  std::vector<uint32_t> colliding_keys;
+
+  for(uint32_t key = 2; colliding_keys.size() < colliding_count; ++key)
+  {
+    if(hash_map.cell_index_(key) == cell_index)
+    {
+      colliding_keys.push_back(key);
+    }
+  }
+
+  const uint32_t absent_key = colliding_keys.back();
+  colliding_keys.pop_back();
+
+  for(std::size_t i = 0; i < colliding_keys.size(); ++i)
+  {
+    hash_map.insert(colliding_keys[i], 100 + i);
+  }
+
+  CHECK_EQUAL(TEST, hash_map.capacity(), capacity);
+
+  for(std::size_t i = 0; i < colliding_keys.size(); ++i)
+  {
+    CHECK_EQUAL(TEST, hash_map.find(value, colliding_keys[i]), true);
+    CHECK_EQUAL(TEST, value, 100 + i);
+  }
+
+  CHECK_EQUAL(TEST, hash_map.find(value, absent_key), false);
+  CHECK_EQUAL(TEST, hash_map.find(value, 1), true);
+  CHECK_EQUAL(TEST, value, 10u);
+
+  // rehash: all keys are kept, load factor <= 0.5
+  std::map<uint32_t, uint32_t> standard;
+  standard[0] = 20;
+  standard[1] = 10;
+
+  for(std::size_t i = 0; i < colliding_keys.size(); ++i)
+  {
+    standard[colliding_keys[i]] = 100 + i;
+  }
+
+  for(uint32_t i = 0; i < 10000; ++i)
+  {
+    // shifted hashes as in weight index mapping
+    const uint32_t key = (static_cast<uint32_t>(::rand()) >> 8) + 1;
+    hash_map.insert(key, i);
+    standard.insert(std::make_pair(key, i));
+  }
+
+  CHECK_EQUAL(TEST, hash_map.size(), standard.size());
+  CHECK_EQUAL(TEST, hash_map.capacity() > capacity, true);
+  CHECK_EQUAL(TEST, hash_map.capacity() >= hash_map.size() * 2, true);
+
+  for(auto it = standard.begin(); it != standard.end(); ++it)
+  {
+    CHECK_EQUAL(TEST, hash_map.find(value, it->first), true);
+    CHECK_EQUAL(TEST, value, it->second);
+  }
+
+  CHECK_EQUAL(TEST, hash_map.find(value, 0xffffffff), false);
+
+  return result;
+}
+
+int
+main() throw ()
+{
+  int result = 0;
+
+  try
+  {
+    ::srand(0);
+
+    result += hasher_test();
+    result += batch_test();
+    result += hash_map_test();
+  }
+  catch (const eh::Exception& ex)
+  {
+    std::cerr << ex.what() << std::endl;
+    result = 1;
+  }
+
+  return result;
+}
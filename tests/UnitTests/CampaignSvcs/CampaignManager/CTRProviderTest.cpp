@@ -249,6 +249,94 @@ int main(int argc, char** argv) throw ()
         std::cout << "selected default ctr algorithm" << std::endl;
       }
     }
+    else if(command == "batch-test")
+    {
+      // ctr evaluated for all candidates at once should be equal
+      // to ctr evaluated for each candidate
+      CTRProvider_var ctr_provider(new CTRProvider(config, Generics::Time::ZERO, nullptr));
+
+      CampaignSelectParams_var request_params_ptr = new CampaignSelectParams(
+        true, // profiling_available
+        FreqCapIdSet(),
+        SeqOrderMap(),
+        0,
+        0,
+        Tag::SizeMap(),
+        false,
+        -1, // visibility
+        -1 // viewability
+        );
+
+      CampaignSelectParams& request_params = *request_params_ptr;
+
+      init_campaign_select_params(
+        holder,
+        request_params,
+        1, // colo_id
+        1, // publisher_id
+        1,  // tag_id
+        1,
+        "protocol_name"
+        );
+
+      const unsigned long CANDIDATES_NUM = 200;
+
+      std::list<Campaign_var> campaigns;
+      std::list<Creative_var> creatives;
+      CTRProvider::CalculationContext::ConstCreativeArray creative_ptrs;
+
+      for(unsigned long i = 0; i < CANDIDATES_NUM; ++i)
+      {
+        Campaign_var campaign;
+        creatives.push_back(create_creative(
+          campaign, i % 7 + 1, i % 5 + 1, i % 11 + 1, i + 1, i % 13 + 1, i + 1));
+        campaigns.push_back(campaign);
+        creative_ptrs.push_back(creatives.back());
+      }
+
+      CTRProvider::Calculation_var calculation =
+        ctr_provider->create_calculation(request_params_ptr);
+
+      if(calculation.in())
+      {
+        CTRProvider::CalculationContext::CTRArray batch_ctrs;
+
+        {
+          CTRProvider::CalculationContext_var calculation_context =
+            calculation->create_context(request_params.tag->sizes.begin()->second);
+          calculation_context->get_ctrs(batch_ctrs, creative_ptrs);
+        }
+
+        CTRProvider::CalculationContext_var calculation_context =
+          calculation->create_context(request_params.tag->sizes.begin()->second);
+
+        if(batch_ctrs.size() != creative_ptrs.size())
+        {
+          std::cerr << "batch-test: unexpected result size " <<
+            batch_ctrs.size() << " instead " << creative_ptrs.size() << std::endl;
+          return -1;
+        }
+
+        for(std::size_t i = 0; i < creative_ptrs.size(); ++i)
+        {
+          const RevenueDecimal ctr = calculation_context->get_ctr(creative_ptrs[i]);
+
+          if(ctr != batch_ctrs[i])
+          {
+            std::cerr << "batch-test: ctr mismatch for candidate #" << i <<
+              ": " << batch_ctrs[i] << " instead " << ctr << std::endl;
+            return -1;
+          }
+        }
+
+        std::cout << "batch-test: " << creative_ptrs.size() <<
+          " candidates evaluated" << std::endl;
+      }
+      else
+      {
+        std::cout << "selected default ctr algorithm" << std::endl;
+      }
+    }
     else if(command == "thread-test")
     {
       std::unique_ptr<MT::Context> context(new MT::Context());
@@ -19,6 +19,8 @@
  */
 
 /// @file CampaignSelectionIndexTest.cpp
+#include <sstream>
+#include <regex>
 #include "malloc.h"
 #include <Logger/StreamLogger.hpp>
 #include <Commons/Algs.hpp>
@@ -39,6 +41,31 @@ create_simple_colocation(unsigned long id, AccountDef* acc)
   return colo;
 }
 
+void add_creative_template_(
+  CampaignConfig& new_config,
+  char status)
+{
+  ::system("echo TEST > ~test-template-file");
+
+  CreativeTemplate c_templ(
+    "~test-template-file",
+    CreativeTemplateFactory::Handler::CTT_TEXT,
+    "mime-format",
+    false,
+    0, // tokens
+    0, // hidden tokens
+    Generics::Time::ZERO);
+
+  c_templ.status = status;
+
+  new_config.creative_templates.insert(
+    CreativeTemplateKey(
+      "test-format",
+      "test-size",
+      "test-appformat"),
+    c_templ);
+}
+
 void add_campaign_(
   CampaignConfig& new_config,
   AccountDef* p_acc,
@@ -78,25 +105,7 @@ void add_campaign_(
   campaign->end_user_group_id = MAX_TARGET_USERS_GROUPS;
   campaign->marketplace = 'A';
 
-  ::system("echo TEST > ~test-template-file");
-
-  CreativeTemplate c_templ(
-    "~test-template-file",
-    CreativeTemplateFactory::Handler::CTT_TEXT,
-    "mime-format",
-    false,
-    0, // tokens
-    0, // hidden tokens
-    Generics::Time::ZERO);
-
-  c_templ.status = 'A';
-
-  new_config.creative_templates.insert(
-    CreativeTemplateKey(
-      "test-format",
-      "test-size",
-      "test-appformat"),
-    c_templ);
+  add_creative_template_(new_config, 'A');
 
   Creative_var creative(
     new Creative(
@@ -386,6 +395,538 @@ namespace Test1
   }
 }
 
+namespace Test2
+{
+  // incremental indexing: index relinked from previous configuration
+  // must select same campaigns as fully reindexed
+  static const char TEST_NAME[] = "IncrementalIndexingTest";
+
+  void fill(CampaignConfig& new_config)
+  {
+    Test1::fill(new_config);
+
+    Account_var p_acc = new_config.accounts[1];
+    Size_var size = create_size_();
+
+    for(unsigned long i = 3; i <= 10; ++i)
+    {
+      add_campaign_(new_config, p_acc, size, i, 100 * i);
+    }
+  }
+
+  void
+  print_cell(
+    std::ostream& ostr,
+    CampaignConfig* campaign_config,
+    const CampaignSelectionCell& cell)
+  {
+    bool actual_tag_pricing =
+      (cell.tag_pricing == &Tag::TagPricing::DEFAULT);
+
+    for(TagMap::const_iterator tag_it = campaign_config->tags.begin();
+        tag_it != campaign_config->tags.end() && !actual_tag_pricing;
+        ++tag_it)
+    {
+      for(Tag::TagPricings::const_iterator tp_it =
+            tag_it->second->tag_pricings.begin();
+          tp_it != tag_it->second->tag_pricings.end(); ++tp_it)
+      {
+        actual_tag_pricing |= (&tp_it->second == cell.tag_pricing);
+      }
+    }
+
+    ostr << " " << cell.campaign->campaign_id << "(ecpm = " << cell.ecpm <<
+      ", cpm = " << cell.tag_pricing->cpm <<
+      (actual_tag_pricing ? "" : ", tag pricing not relinked") << ")";
+  }
+
+  void
+  print_cell(
+    std::ostream& ostr,
+    CampaignConfig* /*campaign_config*/,
+    const CampaignCell& cell)
+  {
+    ostr << " " << cell.campaign->campaign_id;
+  }
+
+  // cells in selection order, with check that cells refer actual
+  // configuration objects
+  template<typename CellPtrListType>
+  void
+  print_cells(
+    std::ostream& ostr,
+    CampaignConfig* campaign_config,
+    const CellPtrListType& cells)
+  {
+    for(typename CellPtrListType::const_iterator it = cells.begin();
+        it != cells.end(); ++it)
+    {
+      if((*it)->campaign.in() !=
+         campaign_config->campaigns[(*it)->campaign->campaign_id].in())
+      {
+        ostr << " (not relinked)";
+      }
+
+      print_cell(ostr, campaign_config, **it);
+    }
+  }
+
+  std::string
+  select_all(
+    CampaignConfig* campaign_config,
+    CampaignIndex* campaign_index)
+  {
+    const UserStatus USER_STATUSES[] = { US_OPTIN, US_OPTOUT, US_UNDEFINED };
+    std::ostringstream ostr;
+
+    for(TagMap::const_iterator tag_it = campaign_config->tags.begin();
+        tag_it != campaign_config->tags.end(); ++tag_it)
+    {
+      for(unsigned long i = 0;
+          i < sizeof(USER_STATUSES) / sizeof(USER_STATUSES[0]); ++i)
+      {
+        CampaignIndex::Key key(tag_it->second);
+        key.country_code = "ru";
+        key.format = "test-appformat";
+        key.user_status = USER_STATUSES[i];
+        key.none_user_status = true;
+        key.test_request = false;
+
+        CampaignIndex::CampaignSelectionCellPtrList wg_ch_cmps;
+        CampaignIndex::CampaignSelectionCellPtrList ch_cmps;
+        CampaignIndex::CampaignCellPtrList text_cmps;
+        CampaignIndex::CampaignCellPtrList kw_cmps;
+
+        campaign_index->get_campaigns(
+          key,
+          wg_ch_cmps,
+          ch_cmps,
+          text_cmps,
+          kw_cmps,
+          0,
+          0);
+
+        ostr << tag_it->first << "/" << USER_STATUSES[i] << ":" <<
+          std::endl << "  wg:";
+        print_cells(ostr, campaign_config, wg_ch_cmps);
+        ostr << std::endl << "  display:";
+        print_cells(ostr, campaign_config, ch_cmps);
+        ostr << std::endl << "  text:";
+        print_cells(ostr, campaign_config, text_cmps);
+        ostr << std::endl << "  keyword:";
+        print_cells(ostr, campaign_config, kw_cmps);
+        ostr << std::endl;
+      }
+    }
+
+    return ostr.str();
+  }
+
+  int run()
+  {
+    Logging::Logger_var logger(
+      new Logging::OStream::Logger(Logging::OStream::Config(std::cout)));
+
+    CampaignConfig_var prev_config(new CampaignConfig());
+    fill(*prev_config);
+
+    CampaignIndex_var prev_index(new CampaignIndex(prev_config, logger));
+    prev_index->index_campaigns();
+
+    // campaign 3 changed, campaign 4 deleted, campaign 11 added
+    CampaignConfig_var new_config(new CampaignConfig());
+    fill(*new_config);
+    new_config->campaigns[3]->ecpm_ = RevenueDecimal(10000);
+    new_config->campaigns.erase(4);
+    add_campaign_(
+      *new_config,
+      new_config->accounts[1],
+      create_size_(),
+      11,
+      1100);
+
+    CampaignIndex_var incremental_index(new CampaignIndex(new_config, logger));
+    incremental_index->index_campaigns(0, 0, prev_index);
+
+    CampaignIndex_var full_index(new CampaignIndex(new_config, logger));
+    full_index->index_campaigns();
+
+    const std::string incremental_result = select_all(
+      new_config, incremental_index);
+    const std::string full_result = select_all(
+      new_config, full_index);
+
+    if(incremental_result != full_result)
+    {
+      std::cerr << TEST_NAME << ": incremental index selection:" << std::endl <<
+        incremental_result << std::endl <<
+        "full index selection:" << std::endl <<
+        full_result << std::endl;
+      return 1;
+    }
+
+    // campaigns isn't changed, but template become unavailable:
+    // creatives that use it can't be relinked
+    CampaignConfig_var templ_config(new CampaignConfig());
+    fill(*templ_config);
+    add_creative_template_(*templ_config, 'W');
+
+    CampaignIndex_var templ_incremental_index(
+      new CampaignIndex(templ_config, logger));
+    templ_incremental_index->index_campaigns(0, 0, prev_index);
+
+    CampaignIndex_var templ_full_index(new CampaignIndex(templ_config, logger));
+    templ_full_index->index_campaigns();
+
+    const std::string templ_incremental_result = select_all(
+      templ_config, templ_incremental_index);
+    const std::string templ_full_result = select_all(
+      templ_config, templ_full_index);
+
+    if(templ_incremental_result != templ_full_result)
+    {
+      std::cerr << TEST_NAME << ": incremental index selection "
+        "after template change:" << std::endl <<
+        templ_incremental_result << std::endl <<
+        "full index selection:" << std::endl <<
+        templ_full_result << std::endl;
+      return 1;
+    }
+
+    std::cout << TEST_NAME << ": success." << std::endl;
+    return 0;
+  }
+}
+
+namespace Test3
+{
+  // parallel indexing must build same tree as single thread indexing
+  static const char TEST_NAME[] = "ParallelIndexingTest";
+
+  void fill(CampaignConfig& new_config)
+  {
+    Test1::fill(new_config);
+
+    Account_var p_acc = new_config.accounts[1];
+    Size_var size = create_size_();
+
+    for(unsigned long i = 3; i <= 200; ++i)
+    {
+      // equal ecpm's for check order of cells with equal ecpm
+      add_campaign_(new_config, p_acc, size, i, 100 * (i % 7 + 1));
+    }
+
+    for(unsigned long i = 3; i <= 20; ++i)
+    {
+      add_tag_(new_config, p_acc, size, i);
+    }
+  }
+
+  std::string
+  trace_tree(CampaignIndex* campaign_index)
+  {
+    std::ostringstream ostr;
+    campaign_index->trace_tree(ostr);
+
+    // cell lists addresses differ in different indexes
+    return std::regex_replace(
+      ostr.str(),
+      std::regex("\\((0x[0-9a-f]+|0)\\): "),
+      "(): ");
+  }
+
+  int run()
+  {
+    const unsigned long THREADS = 4;
+
+    Logging::Logger_var logger(
+      new Logging::OStream::Logger(Logging::OStream::Config(std::cout)));
+
+    CampaignConfig_var campaign_config(new CampaignConfig());
+    fill(*campaign_config);
+
+    CampaignIndex_var single_thread_index(
+      new CampaignIndex(campaign_config, logger));
+    single_thread_index->index_campaigns();
+
+    CampaignIndex_var parallel_index(
+      new CampaignIndex(campaign_config, logger));
+    parallel_index->index_campaigns(0, 0, 0, THREADS);
+
+    const std::string single_thread_tree = trace_tree(single_thread_index);
+    const std::string parallel_tree = trace_tree(parallel_index);
+
+    if(single_thread_tree != parallel_tree)
+    {
+      std::cerr << TEST_NAME << ": single thread index tree:" << std::endl <<
+        single_thread_tree << std::endl <<
+        "parallel index tree:" << std::endl <<
+        parallel_tree << std::endl;
+      return 1;
+    }
+
+    std::cout << TEST_NAME << ": success." << std::endl;
+    return 0;
+  }
+}
+
+namespace Test4
+{
+  // get_campaigns with prefilter (Key::init_filter) must give
+  // same candidates after check_campaign as without it
+  static const char TEST_NAME[] = "PrefilterTest";
+
+  const unsigned long WEEK_MINUTES = 7 * 24 * 60;
+
+  void fill(CampaignConfig& new_config)
+  {
+    Test1::fill(new_config);
+
+    Account_var p_acc = new_config.accounts[1];
+    Size_var size = create_size_();
+
+    // 64 campaigns: lists of tag candidates are compiled into filters
+    for(unsigned long i = 3; i <= 66; ++i)
+    {
+      add_campaign_(new_config, p_acc, size, i, 100 * (i % 11 + 1));
+
+      Campaign* campaign = new_config.campaigns[i];
+
+      if(i % 3 != 0)
+      {
+        // intervals with not aligned to hour bounds
+        const unsigned long start = (i % 7) * 24 * 60 + (i % 24) * 60 + i % 60;
+        campaign->weekly_run_intervals.insert(
+          WeeklyRunIntervalDef(start, start + 60 * (i % 5 + 1) + 17));
+        const unsigned long add_start = i * 131 % WEEK_MINUTES;
+        campaign->weekly_run_intervals.insert(
+          WeeklyRunIntervalDef(add_start, add_start + 45));
+        campaign->weekly_run_intervals.normalize(0, WEEK_MINUTES);
+      }
+
+      if(i % 4 == 1)
+      {
+        campaign->colocations.insert(1);
+      }
+      else if(i % 4 == 2)
+      {
+        campaign->colocations.insert(1);
+        campaign->colocations.insert(2);
+      }
+      else if(i % 8 == 3)
+      {
+        campaign->colocations.insert(2);
+      }
+
+      if(i % 5 == 0)
+      {
+        campaign->start_user_group_id = i % 50;
+        campaign->end_user_group_id = i % 50 + 30;
+      }
+      else if(i % 5 == 1)
+      {
+        campaign->end_user_group_id = MAX_TARGET_USERS_GROUPS / 2;
+      }
+    }
+
+    for(unsigned long i = 3; i <= 5; ++i)
+    {
+      add_tag_(new_config, p_acc, size, i);
+    }
+
+    for(CampaignConfig::CampaignMap::iterator cmp_it =
+          new_config.campaigns.begin();
+        cmp_it != new_config.campaigns.end(); ++cmp_it)
+    {
+      cmp_it->second->delivery_coef = 1;
+      cmp_it->second->min_uid_age = Generics::Time::ZERO;
+    }
+  }
+
+  // candidates that pass check_campaign
+  template<typename CellPtrListType>
+  std::vector<const void*>
+  check_cells(
+    CampaignIndex* campaign_index,
+    const CampaignIndex::Key& key,
+    const CellPtrListType& cells,
+    const Generics::Time& time,
+    unsigned long colo_id,
+    const AdServer::Commons::UserId& user_id)
+  {
+    std::vector<const void*> result;
+
+    for(typename CellPtrListType::const_iterator it = cells.begin();
+        it != cells.end(); ++it)
+    {
+      if(campaign_index->check_campaign(
+           key,
+           (*it)->campaign,
+           time,
+           true, // profiling_available
+           FreqCapIdSet(),
+           colo_id,
+           Generics::Time::ZERO, // user_create_time
+           user_id,
+           0))
+      {
+        result.push_back(*it);
+      }
+    }
+
+    return result;
+  }
+
+  template<typename CellPtrListType>
+  int
+  compare_cells(
+    const char* list_name,
+    const CampaignIndex::Key& key,
+    CampaignIndex* campaign_index,
+    const CellPtrListType& filtered_cells,
+    const CellPtrListType& cells,
+    const Generics::Time& time,
+    unsigned long colo_id,
+    const AdServer::Commons::UserId& user_id)
+  {
+    if(check_cells(campaign_index, key, filtered_cells, time, colo_id, user_id) !=
+       check_cells(campaign_index, key, cells, time, colo_id, user_id))
+    {
+      std::cerr << TEST_NAME << ": " << list_name <<
+        " candidates differ for tag = " << key.tag->tag_id <<
+        ", user status = " << key.user_status <<
+        ", time = " << time.gm_ft() <<
+        ", colo = " << colo_id <<
+        ", user group = " << key.user_group << std::endl;
+      return 1;
+    }
+
+    return 0;
+  }
+
+  int run()
+  {
+    const UserStatus USER_STATUSES[] = { US_OPTIN, US_OPTOUT, US_UNDEFINED };
+    const unsigned long COLOS[] = { 1, 2, 3 };
+    const unsigned long USERS = 4;
+    // monday 00:00 (GMT)
+    const Generics::Time WEEK_START(String::SubString("2024-01-01"), "%Y-%m-%d");
+
+    Logging::Logger_var logger(
+      new Logging::OStream::Logger(Logging::OStream::Config(std::cout)));
+
+    CampaignConfig_var campaign_config(new CampaignConfig());
+    fill(*campaign_config);
+
+    CampaignIndex_var campaign_index(
+      new CampaignIndex(campaign_config, logger));
+    campaign_index->index_campaigns();
+
+    std::vector<AdServer::Commons::UserId> user_ids;
+    for(unsigned long i = 0; i < USERS; ++i)
+    {
+      user_ids.push_back(AdServer::Commons::UserId::create_random_based());
+    }
+
+    int ret = 0;
+    unsigned long filtered_requests = 0;
+
+    for(TagMap::const_iterator tag_it = campaign_config->tags.begin();
+        tag_it != campaign_config->tags.end(); ++tag_it)
+    {
+      for(unsigned long status_i = 0;
+          status_i < sizeof(USER_STATUSES) / sizeof(USER_STATUSES[0]);
+          ++status_i)
+      {
+        CampaignIndex::Key key(tag_it->second);
+        key.country_code = "ru";
+        key.format = "test-appformat";
+        key.user_status = USER_STATUSES[status_i];
+        key.none_user_status = true;
+        key.test_request = false;
+        key.tag_delivery_factor = 0;
+        key.ccg_delivery_factor = 0;
+
+        CampaignIndex::CampaignSelectionCellPtrList wg_cmps;
+        CampaignIndex::CampaignSelectionCellPtrList display_cmps;
+        CampaignIndex::CampaignCellPtrList text_cmps;
+        CampaignIndex::CampaignCellPtrList kw_cmps;
+
+        campaign_index->get_campaigns(
+          key, wg_cmps, display_cmps, text_cmps, kw_cmps, 0, 0);
+
+        // each hour of week with minute that cross interval bounds
+        for(unsigned long hour = 0; hour < 7 * 24; ++hour)
+        {
+          const Generics::Time time = WEEK_START +
+            Generics::Time::ONE_HOUR * hour +
+            Generics::Time::ONE_MINUTE * (hour * 37 % 60);
+
+          for(unsigned long colo_i = 0;
+              colo_i < sizeof(COLOS) / sizeof(COLOS[0]); ++colo_i)
+          {
+            for(auto user_it = user_ids.begin();
+                user_it != user_ids.end(); ++user_it)
+            {
+              CampaignIndex::Key filter_key(key);
+              filter_key.init_filter(time, COLOS[colo_i], *user_it);
+
+              CampaignIndex::CampaignSelectionCellPtrList filtered_wg_cmps;
+              CampaignIndex::CampaignSelectionCellPtrList filtered_display_cmps;
+              CampaignIndex::CampaignCellPtrList filtered_text_cmps;
+              CampaignIndex::CampaignCellPtrList filtered_kw_cmps;
+
+              campaign_index->get_campaigns(
+                filter_key,
+                filtered_wg_cmps,
+                filtered_display_cmps,
+                filtered_text_cmps,
+                filtered_kw_cmps,
+                0,
+                0);
+
+              if(filtered_display_cmps.size() < display_cmps.size())
+              {
+                ++filtered_requests;
+              }
+
+              ret += compare_cells(
+                "wg", filter_key, campaign_index,
+                filtered_wg_cmps, wg_cmps,
+                time, COLOS[colo_i], *user_it);
+              ret += compare_cells(
+                "display", filter_key, campaign_index,
+                filtered_display_cmps, display_cmps,
+                time, COLOS[colo_i], *user_it);
+              ret += compare_cells(
+                "text", filter_key, campaign_index,
+                filtered_text_cmps, text_cmps,
+                time, COLOS[colo_i], *user_it);
+              ret += compare_cells(
+                "keyword", filter_key, campaign_index,
+                filtered_kw_cmps, kw_cmps,
+                time, COLOS[colo_i], *user_it);
+            }
+          }
+        }
+      }
+    }
+
+    if(filtered_requests == 0)
+    {
+      std::cerr << TEST_NAME << ": candidates wasn't prefiltered" << std::endl;
+      ++ret;
+    }
+
+    if(ret == 0)
+    {
+      std::cout << TEST_NAME << ": success." << std::endl;
+    }
+
+    return ret;
+  }
+}
+
 void fill_test_campaign_config(
   CampaignConfig& new_config,
   unsigned long colocation_count,
@@ -533,6 +1074,146 @@ void fill_test_campaign_config(
   }
 }
 
+namespace Test5
+{
+  // get_tag_countries must report all (tag, country) pairs, that
+  // can be selected by get_campaigns (bid eligibility precheck
+  // can't filter selectable requests)
+  static const char TEST_NAME[] = "TagCountriesTest";
+
+  bool selectable_(
+    CampaignConfig* campaign_config,
+    AdServer::CampaignSvcs::CampaignIndex* campaign_index,
+    unsigned long tag_id,
+    const char* country_code)
+  {
+    const UserStatus USER_STATUSES[] = { US_UNDEFINED, US_OPTIN, US_OPTOUT };
+
+    TagMap::const_iterator tag_it = campaign_config->tags.find(tag_id);
+
+    for(unsigned long status_i = 0;
+        status_i < sizeof(USER_STATUSES) / sizeof(USER_STATUSES[0]);
+        ++status_i)
+    {
+      CampaignIndex::Key key(tag_it->second);
+      key.country_code = country_code;
+      key.format = "test-appformat";
+      key.user_status = USER_STATUSES[status_i];
+      key.none_user_status = true;
+      key.test_request = false;
+
+      CampaignIndex::CampaignSelectionCellPtrList wg_ch_cmps;
+      CampaignIndex::CampaignSelectionCellPtrList ch_cmps;
+      CampaignIndex::CampaignCellPtrList text_cmps;
+      CampaignIndex::CampaignCellPtrList kw_cmps;
+
+      campaign_index->get_campaigns(
+        key,
+        wg_ch_cmps,
+        ch_cmps,
+        text_cmps,
+        kw_cmps,
+        0,
+        0);
+
+      if(!wg_ch_cmps.empty() || !ch_cmps.empty() ||
+         !text_cmps.empty() || !kw_cmps.empty())
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  int run()
+  {
+    CampaignConfig_var campaign_config(new CampaignConfig());
+
+    Test1::fill(*campaign_config);
+
+    Logging::Logger_var logger(
+      new Logging::OStream::Logger(Logging::OStream::Config(std::cout)));
+
+    CampaignIndex_var campaign_index(
+      new CampaignIndex(campaign_config, logger));
+
+    campaign_index->index_campaigns();
+
+    CampaignIndex::TagCountryMap tag_countries;
+    campaign_index->get_tag_countries(tag_countries);
+
+    const char* COUNTRIES[] = { "ru", "us", "" };
+
+    int ret = 0;
+
+    for(TagMap::const_iterator tag_it = campaign_config->tags.begin();
+        tag_it != campaign_config->tags.end(); ++tag_it)
+    {
+      CampaignIndex::TagCountryMap::const_iterator countries_it =
+        tag_countries.find(tag_it->first);
+
+      for(unsigned long country_i = 0;
+          country_i < sizeof(COUNTRIES) / sizeof(COUNTRIES[0]);
+          ++country_i)
+      {
+        const bool reported = countries_it != tag_countries.end() &&
+          countries_it->second.find(COUNTRIES[country_i]) !=
+            countries_it->second.end();
+
+        if(selectable_(
+             campaign_config,
+             campaign_index,
+             tag_it->first,
+             COUNTRIES[country_i]) && !reported)
+        {
+          std::cerr << TEST_NAME << ": tag " << tag_it->first <<
+            " country '" << COUNTRIES[country_i] <<
+            "' is selectable, but isn't reported" << std::endl;
+          ++ret;
+        }
+      }
+
+      // campaigns of config target "ru" only
+      if(countries_it == tag_countries.end() ||
+         countries_it->second.find("ru") == countries_it->second.end())
+      {
+        std::cerr << TEST_NAME << ": tag " << tag_it->first <<
+          " country 'ru' isn't reported" << std::endl;
+        ++ret;
+      }
+
+      if(countries_it != tag_countries.end() &&
+         countries_it->second.find("us") != countries_it->second.end())
+      {
+        std::cerr << TEST_NAME << ": tag " << tag_it->first <<
+          " country 'us' reported without campaigns" << std::endl;
+        ++ret;
+      }
+    }
+
+    for(CampaignIndex::TagCountryMap::const_iterator countries_it =
+          tag_countries.begin();
+        countries_it != tag_countries.end(); ++countries_it)
+    {
+      if(campaign_config->tags.find(countries_it->first) ==
+           campaign_config->tags.end())
+      {
+        std::cerr << TEST_NAME << ": unknown tag " <<
+          countries_it->first << " reported" << std::endl;
+        ++ret;
+      }
+    }
+
+    if(ret == 0)
+    {
+      std::cout << TEST_NAME << ": success." << std::endl;
+    }
+
+    return ret;
+  }
+}
+
 /*
 void index(const char* name, CampaignConfig* campaign_config)
 {
@@ -680,6 +1361,10 @@ int main() throw ()
 
   int ret = 0;
   ret += Test1::run();
+  ret += Test2::run();
+  ret += Test3::run();
+  ret += Test4::run();
+  ret += Test5::run();
 
   return ret;
 }
@@ -0,0 +1,366 @@
+/*
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @file CampaignManager/CampaignSelectorDeadlineTest.cpp
+// request time budget: conversion between caller and server clocks and
+// campaign selection stop after request deadline
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include <Logger/StreamLogger.hpp>
+
+#include <Commons/CorbaAlgs.hpp>
+#include <CampaignSvcs/CampaignManager/CampaignSelector.hpp>
+
+using namespace AdServer::CampaignSvcs;
+
+namespace
+{
+  const char TEMPLATE_FILE[] = "~campaign-selector-deadline-template";
+  const unsigned long TAG_ID = 1;
+  const unsigned long COLO_ID = 1;
+  const unsigned long CAMPAIGN_ID = 1;
+}
+
+#define CHECK_EQUAL(TEST, EXPR, EXPECTED) \
+  if(!((EXPR) == (EXPECTED))) \
+  { \
+    std::cerr << TEST << ": " #EXPR " = " << (EXPR) << \
+      " instead " << (EXPECTED) << std::endl; \
+    ++result; \
+  }
+
+// config with one display campaign that can be selected for tag
+CampaignConfig_var
+generate_config()
+{
+  CampaignConfig_var new_config = new CampaignConfig();
+
+  Currency_var currency = new Currency();
+  currency->currency_id = 1;
+  currency->currency_exchange_id = 1;
+  currency->effective_date = 0;
+  currency->rate = RevenueDecimal(false, 1, 0);
+  currency->fixed_rate = FixedRevenue::from_decimal(currency->rate);
+  currency->fraction = 1;
+  new_config->currencies[currency->currency_id] = currency;
+
+  Account_var account = new AccountDef();
+  account->account_id = 1;
+  account->internal_account_id = 1;
+  account->flags = 0;
+  account->at_flags = 0;
+  account->text_adserving = 'A';
+  account->currency = currency;
+  account->country = "ru";
+  account->time_offset = Generics::Time::ZERO;
+  account->commision = RevenueDecimal::ZERO;
+  account->budget = RevenueDecimal::ZERO;
+  account->paid_amount = RevenueDecimal::ZERO;
+  account->status = 'A';
+  account->eval_status = 'A';
+  new_config->accounts[account->account_id] = account;
+
+  Colocation_var colo = new Colocation();
+  colo->colo_id = COLO_ID;
+  colo->colo_rate_id = COLO_ID;
+  colo->at_flags = 0;
+  colo->account = account;
+  colo->revenue_share = RevenueDecimal::ZERO;
+  colo->ad_serving = CS_ALL;
+  new_config->colocations.insert(std::make_pair(COLO_ID, colo));
+
+  Size_var size = new Size();
+  size->size_id = 1;
+  size->protocol_name = "test-size";
+  size->width = 1;
+  size->height = 1;
+
+  std::ofstream(TEMPLATE_FILE) << "TEST" << std::endl;
+
+  CreativeTemplate c_templ(
+    TEMPLATE_FILE,
+    CreativeTemplateFactory::Handler::CTT_TEXT,
+    "mime-format",
+    false,
+    0, // tokens
+    0, // hidden tokens
+    Generics::Time::ZERO);
+  c_templ.status = 'A';
+
+  new_config->creative_templates.insert(
+    CreativeTemplateKey("test-format", "test-size", "test-appformat"),
+    c_templ);
+
+  Site_var site = new Site();
+  site->site_id = TAG_ID;
+  site->account = account;
+  site->freq_cap_id = 0;
+  site->noads_timeout = 0;
+  site->status = 'A';
+  site->flags = 0;
+  new_config->sites[site->site_id] = site;
+
+  Tag_var tag = new Tag();
+  tag->tag_id = TAG_ID;
+  tag->site = site;
+  tag->adjustment = RevenueDecimal(false, 1, 0);
+  tag->fixed_adjustment = FixedRevenue::from_decimal(tag->adjustment);
+  tag->marketplace = 'A';
+
+  Tag::Size_var tag_size = new Tag::Size();
+  tag_size->size = size;
+  tag_size->max_text_creatives = 0;
+  tag->sizes.insert(std::make_pair(size->size_id, tag_size));
+
+  Tag::TagPricing tag_pricing;
+  tag_pricing.site_rate_id = 0;
+  tag_pricing.cpm = RevenueDecimal::ZERO;
+  tag->tag_pricings.insert(std::make_pair(
+    Tag::TagPricingKey("", CT_ALL, CR_ALL), tag_pricing));
+  tag->country_tag_pricings.insert(std::make_pair("", tag_pricing));
+  new_config->tags[tag->tag_id] = tag;
+
+  Campaign_var campaign = new Campaign();
+  campaign->campaign_id = CAMPAIGN_ID;
+  campaign->campaign_group_id = CAMPAIGN_ID;
+  campaign->account = account;
+  campaign->advertiser = account;
+  campaign->fc_id = 0;
+  campaign->group_fc_id = 0;
+  campaign->flags = CampaignFlags::US_NONE;
+  campaign->mode = CM_NON_RANDOM;
+  campaign->imp_revenue = RevenueDecimal::ZERO;
+  campaign->click_revenue = RevenueDecimal(false, 1, 0);
+  campaign->click_sys_revenue = campaign->click_revenue;
+  campaign->commision = RevenueDecimal::ZERO;
+  campaign->ccg_rate_id = 0;
+  campaign->ccg_rate_type = CR_CPC;
+  campaign->ctr = RevenueDecimal(false, 0, 10000000);
+  campaign->ecpm_ = RevenueDecimal(false, 10, 0);
+  campaign->fixed_ctr = FixedRevenue::from_decimal(campaign->ctr);
+  campaign->fixed_click_sys_revenue = FixedRevenue::from_decimal(
+    campaign->click_sys_revenue);
+  campaign->bid_strategy = BS_MAX_REACH;
+  campaign->delivery_coef = 1;
+  campaign->min_uid_age = Generics::Time::ZERO;
+  campaign->status = 'A';
+  campaign->eval_status = 'A';
+  campaign->ccg_type = CT_DISPLAY;
+  campaign->targeting_type = 'C';
+  campaign->country = "ru";
+  campaign->start_user_group_id = 0;
+  campaign->end_user_group_id = MAX_TARGET_USERS_GROUPS;
+  campaign->marketplace = 'A';
+
+  Creative_var creative(
+    new Creative(
+      campaign,
+      1, // ccid
+      1, // creative id
+      0, // fc_id
+      1, // weight
+      "test-format",
+      "",
+      OptionValue(0, "test-url"),
+      "test-url",
+      "test-url",
+      Creative::CategorySet()));
+
+  Creative::Size creative_size;
+  creative_size.size = size;
+  creative_size.up_expand_space = 0;
+  creative_size.right_expand_space = 0;
+  creative_size.down_expand_space = 0;
+  creative_size.left_expand_space = 0;
+  creative_size.expandable = false;
+  creative_size.available_appformats.insert("test-appformat");
+  creative->sizes.insert(std::make_pair(size->size_id, creative_size));
+
+  campaign->add_creative(creative);
+  new_config->campaigns.insert(std::make_pair(CAMPAIGN_ID, campaign));
+
+  return new_config;
+}
+
+// select campaign with request deadline, return selected campaign id
+// (0 if campaign isn't selected)
+unsigned long
+select(
+  const CampaignIndex* campaign_index,
+  const Generics::Time& deadline)
+{
+  const ConstCampaignConfig_var config = campaign_index->configuration();
+  const Tag* tag = config->tags.find(TAG_ID)->second;
+  const Colocation* colocation = config->colocations.find(COLO_ID)->second;
+
+  const FreqCapIdSet full_freq_caps;
+  const SeqOrderMap seq_orders;
+  const ChannelIdHashSet channels;
+  const CampaignKeywordMap hit_keywords;
+
+  CampaignSelectParams_var request_params = new CampaignSelectParams(
+    true, // profiling available
+    full_freq_caps,
+    seq_orders,
+    colocation,
+    tag,
+    tag->sizes,
+    false, // filter empty destination
+    -1, // tag visibility
+    -1 // tag predicted viewability
+    );
+
+  request_params->user_id = AdServer::Commons::UserId::create_random_based();
+  request_params->country_code = "ru";
+  request_params->format = "test-appformat";
+  request_params->user_status = US_OPTIN;
+  request_params->time = Generics::Time::get_time_of_day();
+  request_params->only_display_ad = true;
+  request_params->deadline = deadline;
+
+  CampaignSelector campaign_selector(campaign_index, 0, 0);
+  CampaignSelector::WeightedCampaignKeywordListPtr weighted_campaign_keywords;
+  CampaignSelector::WeightedCampaignPtr weighted_campaign;
+  AdSelectionResult select_result;
+
+  campaign_selector.select_campaigns(
+    AT_MAX_ECPM,
+    AT_MAX_ECPM,
+    request_params,
+    channels,
+    hit_keywords,
+    false, // collect lost
+    weighted_campaign_keywords,
+    weighted_campaign,
+    select_result);
+
+  return weighted_campaign.get() ?
+    weighted_campaign->campaign->campaign_id : 0;
+}
+
+// budget is relative: deadline is restored by server clock
+int
+time_budget_test()
+{
+  static const char* TEST = "time_budget_test";
+
+  int result = 0;
+
+  const Generics::Time caller_now(1000000);
+  // server clock is behind of caller clock
+  const Generics::Time server_now(999000);
+
+  // deadline isn't defined: empty budget, unbounded processing
+  const CORBACommons::TimestampInfo no_budget =
+    CorbaAlgs::pack_time_budget(Generics::Time::ZERO, caller_now);
+
+  CHECK_EQUAL(TEST, no_budget.length(), 0u);
+  CHECK_EQUAL(TEST,
+    CorbaAlgs::unpack_time_budget(no_budget, server_now),
+    Generics::Time::ZERO);
+  CHECK_EQUAL(TEST,
+    CorbaAlgs::deadline_reached(Generics::Time::ZERO, server_now),
+    false);
+
+  // not expired budget
+  const CORBACommons::TimestampInfo budget =
+    CorbaAlgs::pack_time_budget(caller_now + Generics::Time(0, 50000), caller_now);
+  const Generics::Time server_deadline =
+    CorbaAlgs::unpack_time_budget(budget, server_now);
+
+  CHECK_EQUAL(TEST, server_deadline, server_now + Generics::Time(0, 50000));
+  CHECK_EQUAL(TEST,
+    CorbaAlgs::deadline_reached(server_deadline, server_now),
+    false);
+  CHECK_EQUAL(TEST,
+    CorbaAlgs::deadline_reached(
+      server_deadline, server_now + Generics::Time(0, 50000)),
+    true);
+
+  // expired before sending: zero budget
+  const CORBACommons::TimestampInfo expired_budget =
+    CorbaAlgs::pack_time_budget(caller_now - Generics::Time(1), caller_now);
+
+  CHECK_EQUAL(TEST,
+    CorbaAlgs::unpack_time(expired_budget),
+    Generics::Time::ZERO);
+  CHECK_EQUAL(TEST,
+    CorbaAlgs::deadline_reached(
+      CorbaAlgs::unpack_time_budget(expired_budget, server_now),
+      server_now),
+    true);
+
+  return result;
+}
+
+// campaign is selected without deadline and before it,
+// after deadline selection is stopped without bid
+int
+select_deadline_test(const CampaignIndex* campaign_index)
+{
+  static const char* TEST = "select_deadline_test";
+
+  int result = 0;
+
+  const Generics::Time now = Generics::Time::get_time_of_day();
+
+  CHECK_EQUAL(TEST,
+    select(campaign_index, Generics::Time::ZERO),
+    CAMPAIGN_ID);
+  CHECK_EQUAL(TEST,
+    select(campaign_index, now + Generics::Time::ONE_DAY),
+    CAMPAIGN_ID);
+  CHECK_EQUAL(TEST,
+    select(campaign_index, now - Generics::Time::ONE_SECOND),
+    0ul);
+
+  return result;
+}
+
+int
+main() throw ()
+{
+  int result = 0;
+
+  try
+  {
+    Logging::Logger_var logger = new Logging::OStream::Logger(
+      Logging::OStream::Config(std::cerr));
+
+    CampaignConfig_var config = generate_config();
+    CampaignIndex_var campaign_index = new CampaignIndex(config, logger);
+    campaign_index->index_campaigns();
+
+    result += time_budget_test();
+    result += select_deadline_test(campaign_index);
+  }
+  catch (const eh::Exception& ex)
+  {
+    std::cerr << ex.what() << std::endl;
+    result = 1;
+  }
+
+  std::remove(TEMPLATE_FILE);
+
+  return result;
+}
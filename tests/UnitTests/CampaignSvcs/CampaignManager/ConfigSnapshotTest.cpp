@@ -0,0 +1,428 @@
+/*
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @file CampaignManager/ConfigSnapshotTest.cpp
+// config snapshot: config loaded from saved snapshot is equal to
+// received config, snapshots of other versions are ignored,
+// snapshot is saved only at config changes
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include <Logger/StreamLogger.hpp>
+
+#include <Commons/CorbaAlgs.hpp>
+#include <CampaignSvcs/CampaignManager/CampaignConfigSource.hpp>
+
+using namespace AdServer::CampaignSvcs;
+
+namespace
+{
+  const char SNAPSHOT_FILE[] = "~campaign-config-snapshot";
+
+  // SnapshotHeader field offsets
+  const std::size_t SNAPSHOT_VERSION_OFFSET = 8;
+  const std::size_t SNAPSHOT_SCHEMA_HASH_OFFSET = 20;
+
+  const Generics::Time MASTER_STAMP(1704844800); // 2024-01-10
+  const Generics::Time GEO_CHANNELS_STAMP(1704758400); // 2024-01-09
+}
+
+#define CHECK_EQUAL(TEST, EXPR, EXPECTED) \
+  if(!((EXPR) == (EXPECTED))) \
+  { \
+    std::cerr << TEST << ": " #EXPR " = " << (EXPR) << \
+      " instead " << (EXPECTED) << std::endl; \
+    ++result; \
+  }
+
+class TestConfigSource: public CampaignConfigSource
+{
+public:
+  TestConfigSource(Logging::Logger* logger)
+    throw(Exception)
+    : CampaignConfigSource(
+        logger,
+        0, // domain parser isn't used without creatives
+        CORBACommons::CorbaObjectRefList(),
+        "A",
+        "",
+        "",
+        "ConfigSnapshotTest",
+        CreativeInstantiateRuleMap(),
+        false,
+        SNAPSHOT_FILE)
+  {}
+
+  // build config as update do it
+  CampaignConfig_var
+  build_config(const ConfigUpdateInfoList& update_infos)
+    throw(Exception)
+  {
+    CampaignConfig_var config = new CampaignConfig();
+    ConfigUpdateLinks config_update_links;
+
+    for(ConfigUpdateInfoList::const_iterator it = update_infos.begin();
+        it != update_infos.end(); ++it)
+    {
+      apply_config_update_(*config, config_update_links, **it, 0);
+    }
+
+    finalize_config_(
+      *config, config_update_links, 0, Generics::Time::get_time_of_day());
+
+    return config;
+  }
+
+  using CampaignConfigSource::ConfigUpdateInfoList;
+  using CampaignConfigSource::save_snapshot_;
+  using CampaignConfigSource::snapshot_save_required_;
+  using CampaignConfigSource::set_snapshot_state_;
+
+protected:
+  virtual
+  ~TestConfigSource() throw ()
+  {}
+};
+
+typedef ReferenceCounting::SmartPtr<TestConfigSource> TestConfigSource_var;
+
+CampaignConfigUpdateInfo*
+generate_update_info(unsigned long portion)
+{
+  CampaignConfigUpdateInfo_var update_info = new CampaignConfigUpdateInfo();
+  update_info->server_id = 0;
+  update_info->master_stamp = CorbaAlgs::pack_time(MASTER_STAMP);
+  update_info->first_load_stamp = CorbaAlgs::pack_time(MASTER_STAMP);
+  update_info->finish_load_stamp = CorbaAlgs::pack_time(MASTER_STAMP);
+  update_info->current_time = CorbaAlgs::pack_time(MASTER_STAMP);
+  update_info->global_freq_cap_id = 0;
+  update_info->currency_exchange_id = 7;
+  update_info->max_keyword_ecpm = 0;
+  update_info->google_publisher_account_id = 0;
+  update_info->fraud_user_deactivate_period =
+    CorbaAlgs::pack_time(Generics::Time::ONE_DAY);
+  update_info->cost_limit = CorbaAlgs::pack_decimal(RevenueDecimal("0.5"));
+  update_info->global_params_timestamp = CorbaAlgs::pack_time(MASTER_STAMP);
+  update_info->geo_channels_timestamp =
+    CorbaAlgs::pack_time(GEO_CHANNELS_STAMP);
+
+  update_info->sizes.length(1);
+  SizeInfo& size_info = update_info->sizes[0];
+  size_info.size_id = portion + 1;
+  size_info.protocol_name = portion ? "728x90" : "300x250";
+  size_info.size_type_id = 1;
+  size_info.width = portion ? 728 : 300;
+  size_info.height = portion ? 90 : 250;
+  size_info.timestamp = CorbaAlgs::pack_time(MASTER_STAMP);
+
+  update_info->countries.length(1);
+  CountryInfo& country_info = update_info->countries[0];
+  country_info.country_code = portion ? "us" : "ru";
+  country_info.timestamp = CorbaAlgs::pack_time(MASTER_STAMP);
+
+  // geo channels are spread between portions
+  update_info->activate_geo_channels.length(1);
+  GeoChannelInfo& geo_channel_info = update_info->activate_geo_channels[0];
+  geo_channel_info.channel_id = 100 + portion;
+  geo_channel_info.timestamp = CorbaAlgs::pack_time(GEO_CHANNELS_STAMP);
+
+  if(portion)
+  {
+    geo_channel_info.country = "us";
+    geo_channel_info.geoip_targets.length(2);
+    geo_channel_info.geoip_targets[0].region = "ca";
+    geo_channel_info.geoip_targets[0].city = "san francisco";
+    geo_channel_info.geoip_targets[1].region = "ny";
+    geo_channel_info.geoip_targets[1].city = "new york";
+  }
+  else
+  {
+    geo_channel_info.country = "ru";
+  }
+
+  return update_info._retn();
+}
+
+void
+fill_update_infos(TestConfigSource::ConfigUpdateInfoList& update_infos)
+{
+  for(unsigned long portion = 0; portion < 2; ++portion)
+  {
+    update_infos.emplace_back(generate_update_info(portion));
+  }
+}
+
+int
+compare_configs(
+  const char* TEST,
+  const CampaignConfig& config,
+  const CampaignConfig& loaded_config)
+{
+  int result = 0;
+
+  CHECK_EQUAL(TEST, loaded_config.master_stamp, config.master_stamp);
+  CHECK_EQUAL(TEST, loaded_config.first_load_stamp, config.first_load_stamp);
+  CHECK_EQUAL(TEST, loaded_config.finish_load_stamp, config.finish_load_stamp);
+  CHECK_EQUAL(TEST, loaded_config.global_params_timestamp,
+    config.global_params_timestamp);
+  CHECK_EQUAL(TEST, loaded_config.currency_exchange_id,
+    config.currency_exchange_id);
+  CHECK_EQUAL(TEST, loaded_config.fraud_user_deactivate_period,
+    config.fraud_user_deactivate_period);
+  CHECK_EQUAL(TEST, loaded_config.cost_limit, config.cost_limit);
+
+  CHECK_EQUAL(TEST, loaded_config.sizes.size(), config.sizes.size());
+
+  for(SizeMap::const_iterator it = config.sizes.begin();
+      it != config.sizes.end(); ++it)
+  {
+    SizeMap::const_iterator loaded_it = loaded_config.sizes.find(it->first);
+
+    if(loaded_it == loaded_config.sizes.end())
+    {
+      std::cerr << TEST << ": size #" << it->first << " isn't loaded" <<
+        std::endl;
+      ++result;
+      continue;
+    }
+
+    CHECK_EQUAL(TEST, loaded_it->second->protocol_name,
+      it->second->protocol_name);
+    CHECK_EQUAL(TEST, loaded_it->second->width, it->second->width);
+    CHECK_EQUAL(TEST, loaded_it->second->height, it->second->height);
+    CHECK_EQUAL(TEST, loaded_it->second->timestamp, it->second->timestamp);
+  }
+
+  CHECK_EQUAL(TEST, loaded_config.countries.size(), config.countries.size());
+
+  for(CampaignConfig::CountryMap::const_iterator it = config.countries.begin();
+      it != config.countries.end(); ++it)
+  {
+    CampaignConfig::CountryMap::const_iterator loaded_it =
+      loaded_config.countries.find(it->first);
+
+    if(loaded_it == loaded_config.countries.end())
+    {
+      std::cerr << TEST << ": country '" << it->first << "' isn't loaded" <<
+        std::endl;
+      ++result;
+      continue;
+    }
+
+    CHECK_EQUAL(TEST, loaded_it->second->timestamp, it->second->timestamp);
+  }
+
+  CHECK_EQUAL(TEST, loaded_config.geo_channels_timestamp,
+    config.geo_channels_timestamp);
+
+  const GeoChannelIndex::GeoChannelMap& geo_channels =
+    config.geo_channels->channels();
+  const GeoChannelIndex::GeoChannelMap& loaded_geo_channels =
+    loaded_config.geo_channels->channels();
+
+  CHECK_EQUAL(TEST, loaded_geo_channels.size(), geo_channels.size());
+
+  for(GeoChannelIndex::GeoChannelMap::const_iterator it = geo_channels.begin();
+      it != geo_channels.end(); ++it)
+  {
+    GeoChannelIndex::GeoChannelMap::const_iterator loaded_it =
+      loaded_geo_channels.find(it->first);
+
+    if(loaded_it == loaded_geo_channels.end())
+    {
+      std::cerr << TEST << ": geo channel (" << it->first.country() <<
+        ", " << it->first.region() << ", " << it->first.city() <<
+        ") isn't loaded" << std::endl;
+      ++result;
+      continue;
+    }
+
+    CHECK_EQUAL(TEST, loaded_it->second, it->second);
+  }
+
+  return result;
+}
+
+// overwrite uint32_t field of saved snapshot header
+void
+patch_snapshot_header(std::size_t offset, uint32_t value)
+{
+  std::fstream file(
+    SNAPSHOT_FILE,
+    std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+  file.seekp(offset);
+  file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+uint32_t
+read_snapshot_header(std::size_t offset)
+{
+  uint32_t value = 0;
+  std::ifstream file(SNAPSHOT_FILE, std::ios_base::binary);
+  file.seekg(offset);
+  file.read(reinterpret_cast<char*>(&value), sizeof(value));
+  return value;
+}
+
+int
+round_trip_test(Logging::Logger* logger)
+{
+  static const char* TEST = "round_trip_test";
+  int result = 0;
+
+  TestConfigSource_var source = new TestConfigSource(logger);
+  TestConfigSource::ConfigUpdateInfoList update_infos;
+  fill_update_infos(update_infos);
+
+  CampaignConfig_var config = source->build_config(update_infos);
+
+  CHECK_EQUAL(TEST, config->geo_channels->channels().size(), 3u);
+
+  source->save_snapshot_(update_infos, *config);
+
+  CampaignConfig_var loaded_config = source->load_snapshot();
+
+  if(!loaded_config.in())
+  {
+    std::cerr << TEST << ": snapshot isn't loaded" << std::endl;
+    return result + 1;
+  }
+
+  result += compare_configs(TEST, *config, *loaded_config);
+
+  // loaded config saved again gives same snapshot
+  TestConfigSource::ConfigUpdateInfoList reload_update_infos;
+  fill_update_infos(reload_update_infos);
+  source->save_snapshot_(reload_update_infos, *loaded_config);
+
+  CampaignConfig_var reloaded_config = source->load_snapshot();
+
+  if(!reloaded_config.in())
+  {
+    std::cerr << TEST << ": snapshot isn't reloaded" << std::endl;
+    return result + 1;
+  }
+
+  result += compare_configs(TEST, *config, *reloaded_config);
+
+  return result;
+}
+
+int
+version_test(Logging::Logger* logger)
+{
+  static const char* TEST = "version_test";
+  int result = 0;
+
+  TestConfigSource_var source = new TestConfigSource(logger);
+  TestConfigSource::ConfigUpdateInfoList update_infos;
+  fill_update_infos(update_infos);
+
+  CampaignConfig_var config = source->build_config(update_infos);
+  source->save_snapshot_(update_infos, *config);
+
+  const uint32_t version = read_snapshot_header(SNAPSHOT_VERSION_OFFSET);
+  const uint32_t schema_hash = read_snapshot_header(
+    SNAPSHOT_SCHEMA_HASH_OFFSET);
+
+  CHECK_EQUAL(TEST, source->load_snapshot().in() != 0, true);
+
+  // old and unknown snapshot formats
+  patch_snapshot_header(SNAPSHOT_VERSION_OFFSET, version - 1);
+  CHECK_EQUAL(TEST, source->load_snapshot().in() == 0, true);
+  patch_snapshot_header(SNAPSHOT_VERSION_OFFSET, version + 1);
+  CHECK_EQUAL(TEST, source->load_snapshot().in() == 0, true);
+  patch_snapshot_header(SNAPSHOT_VERSION_OFFSET, version);
+  CHECK_EQUAL(TEST, source->load_snapshot().in() != 0, true);
+
+  // snapshot saved with other CampaignConfigUpdateInfo schema
+  patch_snapshot_header(SNAPSHOT_SCHEMA_HASH_OFFSET, schema_hash + 1);
+  CHECK_EQUAL(TEST, source->load_snapshot().in() == 0, true);
+
+  std::remove(SNAPSHOT_FILE);
+  CHECK_EQUAL(TEST, source->load_snapshot().in() == 0, true);
+
+  return result;
+}
+
+int
+save_required_test(Logging::Logger* logger)
+{
+  static const char* TEST = "save_required_test";
+  int result = 0;
+
+  TestConfigSource_var source = new TestConfigSource(logger);
+  TestConfigSource::ConfigUpdateInfoList update_infos;
+  fill_update_infos(update_infos);
+
+  CampaignConfig_var config = source->build_config(update_infos);
+  const Generics::Time now = Generics::Time::get_time_of_day();
+
+  // first config is saved
+  CHECK_EQUAL(TEST, source->snapshot_save_required_(*config, now), true);
+
+  source->set_snapshot_state_(*config, now);
+
+  // config isn't changed
+  CHECK_EQUAL(TEST, source->snapshot_save_required_(*config, now), false);
+  CHECK_EQUAL(TEST, source->snapshot_save_required_(
+    *config, now + Generics::Time::ONE_DAY), false);
+
+  // changed config is saved not often than once per 5 minutes
+  config->master_stamp += Generics::Time::ONE_SECOND;
+  CHECK_EQUAL(TEST, source->snapshot_save_required_(
+    *config, now + Generics::Time::ONE_SECOND), false);
+  CHECK_EQUAL(TEST, source->snapshot_save_required_(
+    *config, now + Generics::Time::ONE_DAY), true);
+
+  config->master_stamp -= Generics::Time::ONE_SECOND;
+  config->geo_channels_timestamp += Generics::Time::ONE_SECOND;
+  CHECK_EQUAL(TEST, source->snapshot_save_required_(
+    *config, now + Generics::Time::ONE_DAY), true);
+
+  return result;
+}
+
+int
+main() throw ()
+{
+  int result = 0;
+
+  try
+  {
+    Logging::Logger_var logger = new Logging::OStream::Logger(
+      Logging::OStream::Config(std::cerr));
+
+    result += round_trip_test(logger);
+    result += version_test(logger);
+    result += save_required_test(logger);
+  }
+  catch (const eh::Exception& ex)
+  {
+    std::cerr << ex.what() << std::endl;
+    result = 1;
+  }
+
+  std::remove(SNAPSHOT_FILE);
+
+  return result;
+}
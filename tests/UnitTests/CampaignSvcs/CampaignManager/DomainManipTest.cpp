@@ -27,6 +27,8 @@
 #include <Commons/ErrorHandler.hpp>
 #include <xsd/CampaignSvcs/DomainConfig.hpp>
 #include <CampaignSvcs/CampaignManager/DomainParser.hpp>
+#include <CampaignSvcs/CampaignManager/DomainSet.hpp>
+#include <CampaignSvcs/CampaignManager/CampaignIndex.hpp>
 
 using namespace AdServer::CampaignSvcs;
 
@@ -214,6 +216,137 @@ total_test(DomainParser_var& domain_parser)
   return res;
 }
 
+int
+check_domain_set(
+  const DomainSet& domain_set,
+  const char* domain,
+  bool standard)
+{
+  if (domain_set.contains(String::SubString(domain)) != standard)
+  {
+    std::cerr << "DomainSet::contains() return '" << !standard <<
+      "' instead '" << standard <<
+      "' for '" << domain << "'" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int
+domain_set_test()
+{
+  int res = 0;
+
+  DomainSet domain_set;
+  res += check_domain_set(domain_set, "test.com", false);
+
+  domain_set.insert(String::SubString("test.com"));
+  domain_set.insert(String::SubString("b.co.kr"));
+  domain_set.insert(String::SubString("test.com"));
+
+  if (domain_set.size() != 2)
+  {
+    std::cerr << "DomainSet::size() return " << domain_set.size() <<
+      " instead 2" << std::endl;
+    ++res;
+  }
+
+  DomainSet copy_domain_set(domain_set);
+
+  // exact domains only
+  res += check_domain_set(domain_set, "test.com", true);
+  res += check_domain_set(copy_domain_set, "test.com", true);
+  res += check_domain_set(domain_set, "b.co.kr", true);
+  res += check_domain_set(domain_set, "www.test.com", false);
+  res += check_domain_set(domain_set, "a.b.test.com", false);
+  res += check_domain_set(domain_set, "atest.com", false);
+  res += check_domain_set(domain_set, "test.com.ru", false);
+  res += check_domain_set(domain_set, "com", false);
+  res += check_domain_set(domain_set, "", false);
+  res += check_domain_set(domain_set, "a.b.co.kr", false);
+  res += check_domain_set(domain_set, "co.kr", false);
+
+  return res;
+}
+
+int
+check_tag_domain_exclusion(
+  const Tag* tag,
+  const char* url,
+  bool standard)
+{
+  if (CampaignIndex::check_tag_domain_exclusion(
+        String::SubString(url), tag) != standard)
+  {
+    std::cerr << "CampaignIndex::check_tag_domain_exclusion() return '" <<
+      !standard << "' instead '" << standard <<
+      "' for '" << url << "'" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int
+tag_domain_exclusion_test()
+{
+  int res = 0;
+
+  Tag_var tag = new Tag();
+  res += check_tag_domain_exclusion(tag, "http://test.com/", true);
+
+  tag->exclude_creative_domains.insert(String::SubString("test.com"));
+
+  // exact host with cut "www." prefix is excluded, subdomains isn't
+  res += check_tag_domain_exclusion(tag, "http://test.com/", false);
+  res += check_tag_domain_exclusion(tag, "http://www.test.com/a", false);
+  res += check_tag_domain_exclusion(tag, "https://TEST.Com/", false);
+  res += check_tag_domain_exclusion(tag, "http://a.test.com/", true);
+  res += check_tag_domain_exclusion(tag, "http://www.a.test.com/", true);
+  res += check_tag_domain_exclusion(tag, "http://www.www.test.com/", true);
+  res += check_tag_domain_exclusion(tag, "http://atest.com/", true);
+  res += check_tag_domain_exclusion(tag, "http://test.com.ru/", true);
+  res += check_tag_domain_exclusion(tag, "bad url", true);
+
+  return res;
+}
+
+int
+check_match_domain(
+  const char* domain,
+  const char* referer_hostname,
+  bool standard)
+{
+  if (CampaignIndex::match_domain(
+        domain, String::SubString(referer_hostname)) != standard)
+  {
+    std::cerr << "CampaignIndex::match_domain() return '" << !standard <<
+      "' instead '" << standard << "' for '" << domain <<
+      "', '" << referer_hostname << "'" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int
+match_domain_test()
+{
+  int res = 0;
+
+  // referer host suffix matching
+  res += check_match_domain("test.com", "test.com", true);
+  res += check_match_domain("test.com", "www.test.com", true);
+  res += check_match_domain("test.com", "a.b.test.com", true);
+  res += check_match_domain("test.com", "atest.com", true);
+  res += check_match_domain("test.com", "test.com.ru", false);
+  res += check_match_domain("test.com", "est.com", false);
+  res += check_match_domain("", "test.com", false);
+
+  return res;
+}
+
 int
 main(int argc, char* argv[]) throw ()
 {
@@ -304,6 +437,13 @@ main(int argc, char* argv[]) throw ()
       String::SubString("fedora.wiki.brAdditionalTextWithoutZero", 14),
         "fedora.wiki.br");
 
+    std::cout << "DomainSet testing.." << std::endl;
+    res += domain_set_test();
+
+    std::cout << "Domain exclusion testing.." << std::endl;
+    res += tag_domain_exclusion_test();
+    res += match_domain_test();
+
     std::cout << "Some cases testing.." << std::endl;
 
     res += check_specific_domain(domain_parser, "www", "www");
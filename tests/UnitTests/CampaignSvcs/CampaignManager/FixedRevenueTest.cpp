@@ -0,0 +1,208 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// @file CampaignManager/FixedRevenueTest.cpp
+
+#include <iostream>
+#include <Generics/Rand.hpp>
+#include <CampaignSvcs/CampaignManager/FixedRevenue.hpp>
+
+using namespace AdServer::CampaignSvcs;
+
+namespace
+{
+  const unsigned long CHECK_COUNT = 100000;
+
+  // random value with random digits number (1 .. 18)
+  FixedRevenue::Value
+  random_value()
+  {
+    const unsigned long digits = Generics::safe_rand(18) + 1;
+    FixedRevenue::Value bound = 1;
+    for(unsigned long i = 0; i < digits; ++i)
+    {
+      bound *= 10;
+    }
+
+    const FixedRevenue::Value value =
+      static_cast<FixedRevenue::Value>(Generics::safe_rand(1000000000)) *
+        1000000000 + Generics::safe_rand(1000000000);
+
+    return value % bound;
+  }
+}
+
+int
+convert_test()
+{
+  int result = 0;
+
+  for(unsigned long i = 0; i < CHECK_COUNT; ++i)
+  {
+    const FixedRevenue::Value value = random_value();
+    const RevenueDecimal dec_value = FixedRevenue::to_decimal(value);
+
+    if(FixedRevenue::from_decimal(dec_value) != value)
+    {
+      std::cerr << "from_decimal(" << dec_value << ") = " <<
+        FixedRevenue::from_decimal(dec_value) <<
+        " instead " << value << std::endl;
+      ++result;
+    }
+  }
+
+  if(FixedRevenue::from_decimal(RevenueDecimal(true, 1, 0)) !=
+       FixedRevenue::INVALID)
+  {
+    std::cerr << "from_decimal(-1) isn't INVALID" << std::endl;
+    ++result;
+  }
+
+  return result;
+}
+
+int
+mul_test()
+{
+  int result = 0;
+
+  for(unsigned long i = 0; i < CHECK_COUNT; ++i)
+  {
+    const FixedRevenue::Value left = random_value();
+    const FixedRevenue::Value right = random_value();
+
+    FixedRevenue::Value res;
+    const bool fixed_defined = FixedRevenue::mul(res, left, right);
+
+    try
+    {
+      const RevenueDecimal dec_res = RevenueDecimal::mul(
+        FixedRevenue::to_decimal(left),
+        FixedRevenue::to_decimal(right),
+        Generics::DMR_FLOOR);
+
+      if(!fixed_defined || FixedRevenue::to_decimal(res) != dec_res)
+      {
+        std::cerr << "mul(" << FixedRevenue::to_decimal(left) << ", " <<
+          FixedRevenue::to_decimal(right) << ") = ";
+        if(fixed_defined)
+        {
+          std::cerr << FixedRevenue::to_decimal(res);
+        }
+        else
+        {
+          std::cerr << "overflow";
+        }
+        std::cerr << " instead " << dec_res << std::endl;
+        ++result;
+      }
+    }
+    catch(const RevenueDecimal::Overflow&)
+    {
+      // fixed point value can be defined only if RevenueDecimal defined
+      if(fixed_defined)
+      {
+        std::cerr << "mul(" << FixedRevenue::to_decimal(left) << ", " <<
+          FixedRevenue::to_decimal(right) << ") defined as " <<
+          FixedRevenue::to_decimal(res) << " instead overflow" << std::endl;
+        ++result;
+      }
+    }
+  }
+
+  return result;
+}
+
+int
+div_test()
+{
+  int result = 0;
+
+  for(unsigned long i = 0; i < CHECK_COUNT; ++i)
+  {
+    const FixedRevenue::Value left = random_value();
+    const FixedRevenue::Value right = random_value();
+
+    if(right == 0)
+    {
+      continue;
+    }
+
+    FixedRevenue::Value res;
+    const bool fixed_defined = FixedRevenue::div(res, left, right);
+
+    try
+    {
+      const RevenueDecimal dec_res = RevenueDecimal::div(
+        FixedRevenue::to_decimal(left),
+        FixedRevenue::to_decimal(right),
+        Generics::DDR_FLOOR);
+
+      if(!fixed_defined || FixedRevenue::to_decimal(res) != dec_res)
+      {
+        std::cerr << "div(" << FixedRevenue::to_decimal(left) << ", " <<
+          FixedRevenue::to_decimal(right) << ") = ";
+        if(fixed_defined)
+        {
+          std::cerr << FixedRevenue::to_decimal(res);
+        }
+        else
+        {
+          std::cerr << "overflow";
+        }
+        std::cerr << " instead " << dec_res << std::endl;
+        ++result;
+      }
+    }
+    catch(const RevenueDecimal::Overflow&)
+    {
+      if(fixed_defined)
+      {
+        std::cerr << "div(" << FixedRevenue::to_decimal(left) << ", " <<
+          FixedRevenue::to_decimal(right) << ") defined as " <<
+          FixedRevenue::to_decimal(res) << " instead overflow" << std::endl;
+        ++result;
+      }
+    }
+  }
+
+  return result;
+}
+
+int
+main() throw ()
+{
+  int result = 0;
+
+  try
+  {
+    result += convert_test();
+    result += mul_test();
+    result += div_test();
+  }
+  catch (const eh::Exception& ex)
+  {
+    std::cerr << ex.what() << std::endl;
+    result = 1;
+  }
+
+  return result;
+}
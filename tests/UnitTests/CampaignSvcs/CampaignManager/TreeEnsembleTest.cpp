@@ -0,0 +1,369 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include <Generics/AppUtils.hpp>
+#include <String/StringManip.hpp>
+
+#include <CampaignSvcs/CampaignManager/TreeEnsemble.hpp>
+#include <CampaignSvcs/CampaignManager/XGBoostPredictor.hpp>
+
+using namespace AdServer::CampaignSvcs;
+
+namespace
+{
+  const char USAGE[] =
+    "TreeEnsembleTest [<command>] [OPTIONS]\n"
+    "  without command: check native evaluation of constructed ensemble and\n"
+    "    compare native predictions of model with recorded predictions\n"
+    "  record: print svm rows with xgboost predictions instead labels\n"
+    "  check: compare native predictions with recorded predictions\n"
+    "OPTIONS:\n"
+    "  -m, --model : model file\n"
+    "  -s, --svm : svm file with recorded predictions as labels\n";
+
+  // small binary:logistic model (3 trees over 8 features, missed values,
+  // default left and right branches) and its xgboost predictions
+  const char DEFAULT_DATA_PATH[] =
+    "../../../../../tests/UnitTests/CampaignSvcs/CampaignManager/Data/";
+
+  Generics::AppUtils::Option<std::string> opt_model(
+    std::string(DEFAULT_DATA_PATH) + "TreeEnsembleModel.bin");
+  Generics::AppUtils::Option<std::string> opt_svm(
+    std::string(DEFAULT_DATA_PATH) + "TreeEnsembleModel.svm");
+
+  CTR::TreeEnsemble::SourceNode
+  split_node(uint32_t feature, float cond, long left, long right, bool default_left)
+  {
+    CTR::TreeEnsemble::SourceNode node;
+    node.leaf = false;
+    node.value = cond;
+    node.feature = feature;
+    node.left = left;
+    node.right = right;
+    node.default_left = default_left;
+    return node;
+  }
+
+  CTR::TreeEnsemble::SourceNode
+  leaf_node(float value)
+  {
+    CTR::TreeEnsemble::SourceNode node;
+    node.value = value;
+    return node;
+  }
+
+  bool
+  check_prediction(
+    const char* test_name,
+    float result,
+    float expected)
+  {
+    if(result != expected)
+    {
+      std::cerr << test_name << ": unexpected prediction " <<
+        std::setprecision(9) << result << " instead " << expected << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  // model features are indexes - 1 of hashes
+  bool
+  constructed_ensemble_test()
+  {
+    CTR::TreeEnsemble::SourceTreeArray trees(2);
+
+    // tree #0: f1 < 0.5 ? (f2 < 2 ? 0.25 : -0.5) : 1 (missed f1 -> right)
+    // nodes defined in not level order
+    trees[0].push_back(split_node(1, 0.5, 3, 1, false)); // 0
+    trees[0].push_back(leaf_node(1.0)); // 1
+    trees[0].push_back(leaf_node(0.25)); // 2
+    trees[0].push_back(split_node(2, 2.0, 2, 4, true)); // 3
+    trees[0].push_back(leaf_node(-0.5)); // 4
+
+    // tree #1: f7 < 1 ? -0.125 : 0.375 (missed f7 -> left)
+    trees[1].push_back(split_node(7, 1.0, 1, 2, true));
+    trees[1].push_back(leaf_node(-0.125));
+    trees[1].push_back(leaf_node(0.375));
+
+    const float BASE_SCORE = 0.5;
+
+    CTR::TreeEnsemble_var identity_ensemble = new CTR::TreeEnsemble(
+      trees, BASE_SCORE, CTR::TreeEnsemble::T_IDENTITY);
+    CTR::TreeEnsemble_var logistic_ensemble = new CTR::TreeEnsemble(
+      trees, BASE_SCORE, CTR::TreeEnsemble::T_LOGISTIC);
+
+    if(identity_ensemble->tree_count() != 2 ||
+       identity_ensemble->feature_count() != 3)
+    {
+      std::cerr << "constructed ensemble: unexpected tree count = " <<
+        identity_ensemble->tree_count() << " or feature count = " <<
+        identity_ensemble->feature_count() << std::endl;
+      return false;
+    }
+
+    struct Case
+    {
+      CTR::HashArray hashes;
+      float margin;
+    };
+
+    std::vector<Case> cases(5);
+    // all features missed
+    cases[0].margin = 1.0f + -0.125f + BASE_SCORE;
+    // f1 = 0, f2 missed, f7 = 3
+    cases[1].hashes.push_back(std::make_pair(2, 0));
+    cases[1].hashes.push_back(std::make_pair(8, 3));
+    cases[1].margin = 0.25f + 0.375f + BASE_SCORE;
+    // f1 = 0, f2 = 2, unused feature
+    cases[2].hashes.push_back(std::make_pair(2, 0));
+    cases[2].hashes.push_back(std::make_pair(3, 2));
+    cases[2].hashes.push_back(std::make_pair(100, 1));
+    cases[2].margin = -0.5f + -0.125f + BASE_SCORE;
+    // f1 = 1, f7 = 0
+    cases[3].hashes.push_back(std::make_pair(2, 1));
+    cases[3].hashes.push_back(std::make_pair(8, 0));
+    cases[3].margin = 1.0f + -0.125f + BASE_SCORE;
+    // duplicated feature: last value used (f1 = 0)
+    cases[4].hashes.push_back(std::make_pair(2, 1));
+    cases[4].hashes.push_back(std::make_pair(2, 0));
+    cases[4].margin = 0.25f + -0.125f + BASE_SCORE;
+
+    CTR::TreeEnsemble::FeatureVector feature_vector;
+    bool result = true;
+
+    for(std::size_t case_i = 0; case_i < cases.size(); ++case_i)
+    {
+      const float margin = cases[case_i].margin;
+
+      result &= check_prediction(
+        "identity",
+        identity_ensemble->predict(feature_vector, cases[case_i].hashes),
+        margin);
+
+      result &= check_prediction(
+        "logistic",
+        logistic_ensemble->predict(feature_vector, cases[case_i].hashes),
+        1.0f / (1.0f + std::exp(-margin)));
+    }
+
+    // batch: shared f1 = 0, rows define f2, f7 (more rows than one block)
+    CTR::HashArray shared_hashes;
+    shared_hashes.push_back(std::make_pair(2, 0));
+
+    std::vector<CTR::HashArray> row_hashes(20);
+    CTR::TreeEnsemble::BatchRowArray rows;
+
+    for(std::size_t row_i = 0; row_i < row_hashes.size(); ++row_i)
+    {
+      row_hashes[row_i].push_back(std::make_pair(3, row_i % 4));
+      if(row_i % 3)
+      {
+        row_hashes[row_i].push_back(std::make_pair(8, row_i % 2));
+      }
+    }
+
+    for(std::size_t row_i = 0; row_i < row_hashes.size(); ++row_i)
+    {
+      rows.push_back(CTR::TreeEnsemble::BatchRow(&row_hashes[row_i]));
+    }
+
+    CTR::TreeEnsemble::PredictionArray predictions;
+    logistic_ensemble->predict(predictions, feature_vector, rows, shared_hashes);
+
+    if(predictions.size() != rows.size())
+    {
+      std::cerr << "batch: unexpected result size" << std::endl;
+      return false;
+    }
+
+    for(std::size_t row_i = 0; row_i < row_hashes.size(); ++row_i)
+    {
+      result &= check_prediction(
+        "batch",
+        predictions[row_i],
+        logistic_ensemble->predict(
+          feature_vector, shared_hashes, &row_hashes[row_i]));
+    }
+
+    return result;
+  }
+
+  // svm line: <label> <index>:<value> ...
+  bool
+  parse_svm_line(
+    float& label,
+    CTR::HashArray& hashes,
+    const std::string& line)
+  {
+    std::istringstream istr(line);
+    std::string token;
+
+    if(!(istr >> label))
+    {
+      return false;
+    }
+
+    while(istr >> token)
+    {
+      std::string::size_type pos = token.find(':');
+      uint32_t index;
+      uint32_t value;
+
+      if(pos == std::string::npos ||
+         !String::StringManip::str_to_int(
+           String::SubString(token.data(), pos), index) ||
+         !String::StringManip::str_to_int(
+           String::SubString(token.data() + pos + 1, token.size() - pos - 1), value))
+      {
+        return false;
+      }
+
+      hashes.push_back(std::make_pair(index, value));
+    }
+
+    return true;
+  }
+
+  int
+  process_svm(
+    const std::string& command,
+    const std::string& model_file,
+    const std::string& svm_file)
+  {
+    const bool record = (command == "record");
+
+    CTR::XGBoostPredictorPool_var pool = new CTR::XGBoostPredictorPool(
+      model_file, !record);
+
+    if(!record && !pool->tree_ensemble())
+    {
+      std::cerr << "model isn't converted for native evaluation" << std::endl;
+      return 1;
+    }
+
+    CTR::XGBoostPredictorPool::Predictor_var predictor = pool->get_predictor();
+
+    std::ifstream svm(svm_file.c_str());
+    if(!svm.is_open())
+    {
+      std::cerr << "can't open '" << svm_file << "'" << std::endl;
+      return 1;
+    }
+
+    unsigned long line_i = 0;
+    unsigned long mismatches = 0;
+    std::string line;
+
+    while(std::getline(svm, line))
+    {
+      ++line_i;
+
+      if(line.empty())
+      {
+        continue;
+      }
+
+      float label;
+      CTR::HashArray hashes;
+
+      if(!parse_svm_line(label, hashes, line))
+      {
+        std::cerr << "invalid line #" << line_i << std::endl;
+        return 1;
+      }
+
+      const float prediction = predictor->predict(hashes);
+
+      if(record)
+      {
+        std::cout << std::setprecision(9) << prediction <<
+          line.substr(line.find(' ') == std::string::npos ?
+            line.size() : line.find(' ')) << std::endl;
+      }
+      else if(prediction != label)
+      {
+        std::cerr << "line #" << line_i << ": " << std::setprecision(9) <<
+          prediction << " instead " << label << std::endl;
+        ++mismatches;
+      }
+    }
+
+    if(!record)
+    {
+      std::cout << "checked " << line_i << " lines, mismatches: " <<
+        mismatches << std::endl;
+    }
+
+    return mismatches ? 1 : 0;
+  }
+}
+
+int main(int argc, char** argv) throw ()
+{
+  try
+  {
+    Generics::AppUtils::Args args(-1);
+
+    args.add(
+      Generics::AppUtils::equal_name("model") ||
+      Generics::AppUtils::short_name("m"),
+      opt_model);
+
+    args.add(
+      Generics::AppUtils::equal_name("svm") ||
+      Generics::AppUtils::short_name("s"),
+      opt_svm);
+
+    args.parse(argc - 1, argv + 1);
+    const Generics::AppUtils::Args::CommandList& commands = args.commands();
+
+    if(commands.empty())
+    {
+      int ret = constructed_ensemble_test() ? 0 : 1;
+      ret += process_svm("check", *opt_model, *opt_svm);
+      return ret;
+    }
+
+    const std::string command = *commands.begin();
+
+    if(commands.size() != 1 ||
+       (command != "record" && command != "check"))
+    {
+      std::cerr << USAGE;
+      return 1;
+    }
+
+    return process_svm(command, *opt_model, *opt_svm);
+  }
+  catch(const eh::Exception& ex)
+  {
+    std::cerr << "Caught eh::Exception: " << ex.what() << std::endl;
+  }
+
+  return 1;
+}
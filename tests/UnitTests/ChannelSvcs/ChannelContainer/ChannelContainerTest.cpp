@@ -190,7 +190,7 @@ namespace AdServer
       return 1;
     }
 
-    int ChannelContainerTest::check_match_() throw()
+    int ChannelContainerTest::check_match_(bool compiled_matching) throw()
     {
       const char* FN = "ChannelContainerTest::check_match_:";
       try
@@ -221,12 +221,16 @@ namespace AdServer
           {15, "www.int.ua/path/p", true, true},
           {16, "www.int.ua/path/p", true, true},
           {15, "www.int.ua/p", true, true},
-          {16, "www.int.ua/p", true, false}
+          {16, "www.int.ua/p", true, false},
+          {16, "www.int.ua/PATH/Long_Upper_Case_Segment", true, true}
         };
         const size_t size_match = sizeof(match_cases)/sizeof(match_cases[0]);
         log_action_(" started.", 0, FN);
-        ContPtr base(new ChannelContainer(count_chunks_));
-        log_action_("Container was created");
+        ContPtr base(
+          new ChannelContainer(count_chunks_, false, compiled_matching));
+        log_action_(compiled_matching ?
+          "Container with compiled matching was created" :
+          "Container was created");
         init_triggers_(
           triggers,
           sizeof(triggers)/sizeof(triggers[0]),
@@ -331,6 +335,47 @@ namespace AdServer
             log_action_(" PASSED.", 2, FN);
           }
         }
+
+        // batch matching of all cases must give same results
+        ChannelContainer::MatchQueryArray queries(size_match);
+        for(size_t j = 0; j < size_match; j++)
+        {
+          ChannelContainer::MatchQuery& query = queries[j];
+          query.flags = MF_ACTIVE;
+          if(match_cases[j].flag)//url
+          {
+            HTTP::BrowserAddress url(String::SubString(match_cases[j].trigger));
+            ChannelContainer::match_parse_refer(
+              url.url(),
+              ports,
+              false, //non strict
+              query.url_words,
+              0);
+          }
+          else
+          {
+            ChannelSvcs::parse_keywords<ChannelSvcs::MatchBreakSeparators>(
+              String::SubString(match_cases[j].trigger),
+              query.match_words[CT_PAGE],
+              PM_SIMPLIFY);
+          }
+        }
+        ChannelContainer::TriggerMatchResArray batch_res;
+        base->match_batch(queries, batch_res);
+        for(size_t j = 0; j < size_match; j++)
+        {
+          const bool pass =
+            batch_res[j].find(match_cases[j].id) != batch_res[j].end();
+          if(pass != match_cases[j].match)
+          {
+            Stream::Error err;
+            err << FN << "BUG: batch matching, atom id = " <<
+              match_cases[j].id << " for trigger = '" <<
+              match_cases[j].trigger << "'" << std::endl;
+            throw ErrorDescriptor(err);
+          }
+        }
+        log_action_(" batch PASSED.", 2, FN);
         log_action_(" finished.", 0, FN);
         return 0;
       }
@@ -1011,7 +1056,8 @@ namespace AdServer
         }
         if(cases_ & TC_MATCH)
         {
-          ret_value += check_match_();
+          ret_value += check_match_(false);
+          ret_value += check_match_(true);
         }
         if(cases_ & TC_UPDATE)
         {
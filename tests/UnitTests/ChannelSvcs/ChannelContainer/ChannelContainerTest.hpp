@@ -139,7 +139,7 @@ namespace AdServer
       int check_constructor_() throw();
       int check_add_trigger_() throw();
       int check_merge_() throw();
-      int check_match_() throw();
+      int check_match_(bool compiled_matching) throw();
       int check_update_() throw();
       int check_uids_() throw ();
 
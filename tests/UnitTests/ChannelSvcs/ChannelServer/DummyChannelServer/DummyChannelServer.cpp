@@ -138,6 +138,16 @@ namespace AdServer
       }
     }
 
+    void DummyChannelServer::match_batch(
+      const ::AdServer::ChannelSvcs::ChannelServer::MatchQuerySeq& /*queries*/,
+      ::AdServer::ChannelSvcs::ChannelServer::MatchResultSeq_out /*results*/)
+    throw(AdServer::ChannelSvcs::ImplementationException,
+          AdServer::ChannelSvcs::NotConfigured)
+    {
+      throw AdServer::ChannelSvcs::ImplementationException(
+        "Not implemented");
+    }
+
     void DummyChannelServer::get_ccg_traits(
       const ::AdServer::ChannelSvcs::ChannelIdSeq& /*query*/,
       ::AdServer::ChannelSvcs::ChannelServer::TraitsResult_out /*result*/)
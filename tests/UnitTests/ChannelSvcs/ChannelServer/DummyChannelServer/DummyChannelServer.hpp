@@ -62,6 +62,16 @@ namespace AdServer
         ::AdServer::ChannelSvcs::ChannelServer::MatchResult_out result)
         throw(AdServer::ChannelSvcs::ImplementationException);
 
+      //
+      // IDL:AdServer/ChannelSvcs/ChannelServer/match_batch:1.0
+      //
+      virtual void
+        match_batch(
+          const ::AdServer::ChannelSvcs::ChannelServer::MatchQuerySeq& queries,
+          ::AdServer::ChannelSvcs::ChannelServer::MatchResultSeq_out results)
+        throw(AdServer::ChannelSvcs::ImplementationException,
+              AdServer::ChannelSvcs::NotConfigured);
+
       //
       // IDL:AdServer/ChannelSvcs/ChannelServer/match:1.0
       //
@@ -0,0 +1,403 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compare url matching of ChannelContainer by probes of url map
+ * (compiled_matching = false) and by UrlTriggerAutomaton
+ * (compiled_matching = true): results should be equal, time of matching
+ * is printed for both containers.
+ * Triggers and referers can be read from files (one per line),
+ * otherwise they are generated.
+ */
+
+#include <getopt.h>
+#include <limits.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <Generics/Rand.hpp>
+#include <Generics/Time.hpp>
+#include <Stream/MemoryStream.hpp>
+#include <ChannelSvcs/ChannelCommons/CommonTypes.hpp>
+#include <ChannelSvcs/ChannelCommons/TriggerParser.hpp>
+#include <ChannelSvcs/ChannelServer/ChannelContainer.hpp>
+#include <ChannelSvcs/ChannelServer/UpdateContainer.hpp>
+#include <tests/UnitTests/ChannelSvcs/Commons/ChannelServerTestCommons.hpp>
+
+using namespace AdServer;
+using namespace AdServer::ChannelSvcs;
+using AdServer::UnitTests::ChannelServerTestCommons;
+
+namespace
+{
+  typedef std::vector<std::string> Lines;
+
+  struct Options
+  {
+    Options()
+      : count_triggers(10000),
+        count_referers(10000),
+        count_chunks(32),
+        repeat(10),
+        non_strict(false)
+    {}
+
+    std::string triggers_file;
+    std::string referers_file;
+    unsigned long count_triggers;
+    unsigned long count_referers;
+    unsigned long count_chunks;
+    unsigned long repeat;
+    bool non_strict;
+  };
+
+  void
+  usage()
+  {
+    std::cout << "UrlMatchPerformanceTest [options]" << std::endl
+      << "options:" << std::endl
+      << "  -T[--triggers] FILE - url triggers, one per line" << std::endl
+      << "  -R[--referers] FILE - captured referers, one per line" << std::endl
+      << "  -u[--count-urls] N - count of generated url triggers" << std::endl
+      << "  -q[--quires] N - count of generated referers" << std::endl
+      << "  -c[--chunks] N - count of chunks in container" << std::endl
+      << "  -r[--repeat] N - count of passes over referers" << std::endl
+      << "  -n[--non-strict] - non strict url matching" << std::endl;
+  }
+
+  bool
+  parse_arguments(int argc, char* argv[], Options& options)
+  {
+    struct option long_options[] =
+    {
+      {"triggers", required_argument, 0, 'T'},
+      {"referers", required_argument, 0, 'R'},
+      {"count-urls", required_argument, 0, 'u'},
+      {"quires", required_argument, 0, 'q'},
+      {"chunks", required_argument, 0, 'c'},
+      {"repeat", required_argument, 0, 'r'},
+      {"non-strict", no_argument, 0, 'n'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}
+    };
+
+    int opt, index = 0;
+    while((opt = getopt_long(
+      argc, argv, "T:R:u:q:c:r:nh", long_options, &index)) != -1)
+    {
+      switch(opt)
+      {
+        case 'T':
+          options.triggers_file = optarg;
+          break;
+        case 'R':
+          options.referers_file = optarg;
+          break;
+        case 'u':
+          UnitTests::read_number(optarg, 1UL, ULONG_MAX, options.count_triggers);
+          break;
+        case 'q':
+          UnitTests::read_number(optarg, 1UL, ULONG_MAX, options.count_referers);
+          break;
+        case 'c':
+          UnitTests::read_number(optarg, 1UL, 1024UL, options.count_chunks);
+          break;
+        case 'r':
+          UnitTests::read_number(optarg, 1UL, ULONG_MAX, options.repeat);
+          break;
+        case 'n':
+          options.non_strict = true;
+          break;
+        default:
+          usage();
+          return false;
+      }
+    }
+
+    return true;
+  }
+
+  void
+  read_lines(const std::string& file_name, Lines& lines)
+  {
+    std::ifstream file(file_name.c_str());
+    if(!file)
+    {
+      Stream::Error ostr;
+      ostr << "Can't open file '" << file_name << "'";
+      throw eh::DescriptiveException(ostr);
+    }
+
+    std::string line;
+    while(std::getline(file, line))
+    {
+      if(!line.empty())
+      {
+        lines.push_back(line);
+      }
+    }
+  }
+
+  void
+  generate_urls(size_t count, Lines& lines)
+  {
+    lines.reserve(count);
+    for(size_t i = 0; i < count; ++i)
+    {
+      std::string url;
+      ChannelServerTestCommons::generate_url(
+        url,
+        Generics::safe_rand(1, 3),
+        Generics::safe_rand(0, 6),
+        Generics::safe_rand(1, 4));
+      lines.push_back(url);
+    }
+  }
+
+  void
+  fill_container(
+    ChannelContainer& container,
+    const Lines& triggers)
+  {
+    UpdateContainer update_container(&container, 0);
+    ChannelIdToMatchInfo_var info = new ChannelIdToMatchInfo;
+    std::set<unsigned short> empty;
+    const size_t TRIGGERS_PER_CHANNEL = 10;
+
+    for(size_t i = 0; i < triggers.size(); i += TRIGGERS_PER_CHANNEL)
+    {
+      const unsigned int id = i / TRIGGERS_PER_CHANNEL + 1;
+      TriggerList channel_triggers;
+
+      for(size_t j = i; j < triggers.size() && j < i + TRIGGERS_PER_CHANNEL; ++j)
+      {
+        channel_triggers.push_back(Trigger());
+        Trigger& trigger = channel_triggers.back();
+        trigger.channel_trigger_id = j + 1;
+        trigger.type = 'U';
+        trigger.negative = false;
+        trigger.trigger = triggers[j];
+      }
+
+      MatchInfo& match_info = (*info)[id];
+      match_info.channel = Channel(id);
+      match_info.channel.mark_type(CT_URL);
+      match_info.channel.mark_type(Channel::CT_ACTIVE);
+
+      TriggerParser::TriggerParser::parse_triggers(
+        id,
+        "",
+        channel_triggers,
+        0,
+        empty,
+        &update_container,
+        Commons::DEFAULT_MAX_HARD_WORD_SEQ);
+    }
+
+    container.merge(update_container, *info, true);
+  }
+
+  void
+  parse_referers(
+    const Lines& referers,
+    bool non_strict,
+    std::vector<MatchUrls>& urls)
+  {
+    std::set<unsigned short> ports;
+    urls.resize(referers.size());
+    for(size_t i = 0; i < referers.size(); ++i)
+    {
+      try
+      {
+        ChannelContainer::match_parse_refer(
+          String::SubString(referers[i]),
+          ports,
+          non_strict,
+          urls[i],
+          0);
+      }
+      catch(const eh::Exception&)
+      {
+        urls[i].clear();
+      }
+    }
+  }
+
+  void
+  match(
+    ChannelContainer& container,
+    const MatchUrls& urls,
+    bool non_strict,
+    TriggerMatchRes& res)
+  {
+    MatchWords words[CT_MAX];
+    container.match(
+      urls,
+      MatchUrls(),
+      words,
+      MatchWords(),
+      StringVector(),
+      Generics::Uuid(),
+      MF_ACTIVE | (non_strict ? MF_NONSTRICTURL : MF_NONE),
+      res);
+  }
+
+  bool
+  equal_results(const TriggerMatchRes& left, const TriggerMatchRes& right)
+  {
+    if(left.size() != right.size())
+    {
+      return false;
+    }
+
+    for(TriggerMatchRes::const_iterator left_it = left.begin(),
+          right_it = right.begin();
+        left_it != left.end(); ++left_it, ++right_it)
+    {
+      if(left_it->first != right_it->first ||
+         left_it->second.flags != right_it->second.flags ||
+         left_it->second.trigger_ids[CT_URL] !=
+           right_it->second.trigger_ids[CT_URL])
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  Generics::Time
+  measure(
+    ChannelContainer& container,
+    const std::vector<MatchUrls>& urls,
+    const Options& options,
+    size_t& matched)
+  {
+    Generics::CPUTimer timer;
+    timer.start();
+    for(size_t pass = 0; pass < options.repeat; ++pass)
+    {
+      for(std::vector<MatchUrls>::const_iterator it = urls.begin();
+          it != urls.end(); ++it)
+      {
+        TriggerMatchRes res;
+        match(container, *it, options.non_strict, res);
+        matched += res.size();
+      }
+    }
+    timer.stop();
+    return timer.elapsed_time();
+  }
+}
+
+int
+main(int argc, char* argv[])
+{
+  try
+  {
+    Options options;
+    if(!parse_arguments(argc, argv, options))
+    {
+      return 1;
+    }
+
+    Lines triggers;
+    Lines referers;
+
+    if(!options.triggers_file.empty())
+    {
+      read_lines(options.triggers_file, triggers);
+    }
+    else
+    {
+      generate_urls(options.count_triggers, triggers);
+    }
+
+    if(!options.referers_file.empty())
+    {
+      read_lines(options.referers_file, referers);
+    }
+    else
+    {
+      generate_urls(options.count_referers, referers);
+      // make part of referers matched
+      for(size_t i = 0; !triggers.empty() && i < referers.size(); i += 3)
+      {
+        referers[i] = triggers[Generics::safe_rand() % triggers.size()] +
+          (i % 2 ? "/path" : "");
+      }
+    }
+
+    ChannelContainer probe_container(
+      options.count_chunks, options.non_strict, false);
+    ChannelContainer automaton_container(
+      options.count_chunks, options.non_strict, true);
+
+    fill_container(probe_container, triggers);
+    fill_container(automaton_container, triggers);
+
+    std::vector<MatchUrls> urls;
+    parse_referers(referers, options.non_strict, urls);
+
+    for(size_t i = 0; i < urls.size(); ++i)
+    {
+      TriggerMatchRes probe_res;
+      TriggerMatchRes automaton_res;
+      match(probe_container, urls[i], options.non_strict, probe_res);
+      match(automaton_container, urls[i], options.non_strict, automaton_res);
+
+      if(!equal_results(probe_res, automaton_res))
+      {
+        std::cerr << "Results differ for referer '" << referers[i] << "':" <<
+          std::endl << "probes: ";
+        ChannelServerTestCommons::print_result(std::cerr, probe_res);
+        std::cerr << std::endl << "automaton: ";
+        ChannelServerTestCommons::print_result(std::cerr, automaton_res);
+        std::cerr << std::endl;
+        return 1;
+      }
+    }
+
+    size_t probe_matched = 0;
+    size_t automaton_matched = 0;
+    const Generics::Time probe_time =
+      measure(probe_container, urls, options, probe_matched);
+    const Generics::Time automaton_time =
+      measure(automaton_container, urls, options, automaton_matched);
+    const size_t count_matches = urls.size() * options.repeat;
+
+    std::cout << "triggers: " << triggers.size() <<
+      ", referers: " << referers.size() <<
+      ", matches: " << count_matches << std::endl <<
+      "url map probes: " << probe_time <<
+      " (matched channels " << probe_matched << ")" << std::endl <<
+      "url automaton: " << automaton_time <<
+      " (matched channels " << automaton_matched << ")" << std::endl;
+
+    return 0;
+  }
+  catch(const eh::Exception& e)
+  {
+    std::cerr << "Caught eh::Exception: " << e.what() << std::endl;
+  }
+
+  return 1;
+}
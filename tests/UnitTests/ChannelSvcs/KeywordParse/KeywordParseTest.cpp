@@ -0,0 +1,340 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Keyword parsing test:
+ *   MatchWordSplitter splits words equal to plain separators scan,
+ *   MatchWords insert, find and clear keep set semantic,
+ *   parse_keywords filling of cleared MatchWords (as ChannelServer
+ *   match do it for thread query) don't allocate memory:
+ *   allocations are counted by operator new.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <Generics/Rand.hpp>
+#include <ChannelSvcs/ChannelCommons/CommonTypes.hpp>
+#include <ChannelSvcs/ChannelCommons/ChannelUtils.hpp>
+
+namespace
+{
+  unsigned long allocations = 0;
+}
+
+void*
+operator new(std::size_t size) throw (std::bad_alloc)
+{
+  ++allocations;
+
+  void* ptr = ::malloc(size ? size : 1);
+
+  if(!ptr)
+  {
+    throw std::bad_alloc();
+  }
+
+  return ptr;
+}
+
+void
+operator delete(void* ptr) throw ()
+{
+  ::free(ptr);
+}
+
+using namespace AdServer::ChannelSvcs;
+
+namespace
+{
+  const unsigned long PARSE_ITERATIONS = 100;
+
+  const char PAGE_WORDS[] =
+    "buy cheap\tflights to london\n"
+    "hotel  booking\n"
+    "\t weekend in paris ";
+
+  const char SEARCH_WORDS[] =
+    "cheap flights\n"
+    "rome";
+
+  // plain scan by separators
+  void
+  split_words(std::vector<std::string>& words, const std::string& text)
+  {
+    std::string word;
+    for(std::string::const_iterator it = text.begin(); it != text.end(); ++it)
+    {
+      if(*it == ' ' || *it == '\t')
+      {
+        if(!word.empty())
+        {
+          words.push_back(word);
+          word.clear();
+        }
+      }
+      else
+      {
+        word.push_back(*it);
+      }
+    }
+
+    if(!word.empty())
+    {
+      words.push_back(word);
+    }
+  }
+
+  int
+  splitter_test()
+  {
+    static const char SYMBOLS[] = "ab \tc";
+
+    int result = 0;
+
+    for(unsigned long i = 0; i < 10000; ++i)
+    {
+      std::string text;
+      const unsigned long size = Generics::safe_rand(40);
+      for(unsigned long sym_i = 0; sym_i < size; ++sym_i)
+      {
+        text.push_back(SYMBOLS[Generics::safe_rand(sizeof(SYMBOLS) - 1)]);
+      }
+
+      std::vector<std::string> check_words;
+      split_words(check_words, text);
+
+      std::vector<std::string> words;
+      MatchWordSplitter splitter((String::SubString(text)));
+      String::SubString token;
+      while(splitter.get_token(token))
+      {
+        words.push_back(token.str());
+      }
+
+      if(words != check_words)
+      {
+        std::cerr << "splitter_test: unexpected words for '" << text <<
+          "': " << words.size() << " instead " << check_words.size() <<
+          std::endl;
+        result = 1;
+      }
+    }
+
+    return result;
+  }
+
+  int
+  match_words_test()
+  {
+    int result = 0;
+
+    std::vector<std::string> holder;
+    for(unsigned long i = 0; i < 1000; ++i)
+    {
+      holder.push_back(std::string("word") + std::to_string(i));
+    }
+
+    MatchWords match_words;
+    std::set<std::string> check_words;
+
+    // filled twice: second fill reuse cleared object
+    for(unsigned long fill_i = 0; fill_i < 2; ++fill_i)
+    {
+      match_words.clear();
+      check_words.clear();
+
+      if(!match_words.empty() ||
+         match_words.find(String::SubString(holder[0])) != match_words.end())
+      {
+        std::cerr << "match_words_test: cleared words aren't empty" <<
+          std::endl;
+        result = 1;
+      }
+
+      for(unsigned long i = 0; i < 3000; ++i)
+      {
+        const std::string& word = holder[Generics::safe_rand(500)];
+        const bool inserted = match_words.insert(
+          String::SubString(word)).second;
+
+        if(inserted != check_words.insert(word).second)
+        {
+          std::cerr << "match_words_test: unexpected insert result for '" <<
+            word << "'" << std::endl;
+          result = 1;
+        }
+      }
+
+      if(match_words.size() != check_words.size())
+      {
+        std::cerr << "match_words_test: size = " << match_words.size() <<
+          " instead " << check_words.size() << std::endl;
+        result = 1;
+      }
+
+      for(std::vector<std::string>::const_iterator it = holder.begin();
+          it != holder.end(); ++it)
+      {
+        MatchWords::const_iterator fnd_it =
+          match_words.find(String::SubString(*it));
+        const bool found = fnd_it != match_words.end();
+
+        if(found != (check_words.find(*it) != check_words.end()) ||
+           (found && fnd_it->text().str() != *it))
+        {
+          std::cerr << "match_words_test: unexpected find result for '" <<
+            *it << "'" << std::endl;
+          result = 1;
+        }
+      }
+
+      std::set<std::string> iterated_words;
+      for(MatchWords::const_iterator it = match_words.begin();
+          it != match_words.end(); ++it)
+      {
+        iterated_words.insert(it->text().str());
+      }
+
+      if(iterated_words != check_words)
+      {
+        std::cerr << "match_words_test: unexpected iterated words" <<
+          std::endl;
+        result = 1;
+      }
+    }
+
+    return result;
+  }
+
+  void
+  parse_query(MatchWords match_words[CT_MAX], StringVector& exact_words)
+  {
+    static MatchBreakSeparators separators;
+
+    parse_keywords(
+      String::SubString(SEARCH_WORDS),
+      match_words[CT_SEARCH],
+      PM_NO_SIMPLIFY,
+      &separators,
+      AdServer::Commons::DEFAULT_MAX_HARD_WORD_SEQ,
+      &exact_words);
+
+    parse_keywords(
+      String::SubString(PAGE_WORDS),
+      match_words[CT_PAGE],
+      PM_NO_SIMPLIFY,
+      &separators);
+  }
+
+  int
+  parse_allocations_test()
+  {
+    int result = 0;
+
+    MatchWords match_words[CT_MAX];
+    StringVector exact_words;
+
+    // first query reserve memory
+    parse_query(match_words, exact_words);
+
+    const MatchWords& page_words = match_words[CT_PAGE];
+
+    if(page_words.find(String::SubString("cheap flights")) == page_words.end() ||
+       page_words.find(String::SubString("hotel booking")) == page_words.end() ||
+       page_words.find(String::SubString("weekend in paris")) ==
+         page_words.end() ||
+       page_words.find(String::SubString("london hotel")) != page_words.end() ||
+       page_words.find(String::SubString("")) != page_words.end())
+    {
+      std::cerr << "parse_allocations_test: unexpected page words" <<
+        std::endl;
+      result = 1;
+    }
+
+    if(exact_words.size() != 3)
+    {
+      std::cerr << "parse_allocations_test: " << exact_words.size() <<
+        " exact words instead 3" << std::endl;
+      result = 1;
+    }
+
+    const unsigned long page_words_count = page_words.size();
+    const unsigned long start_allocations = allocations;
+
+    for(unsigned long i = 0; i < PARSE_ITERATIONS; ++i)
+    {
+      for(unsigned int type_i = 0; type_i < CT_MAX; ++type_i)
+      {
+        match_words[type_i].clear();
+      }
+
+      exact_words.clear();
+      parse_query(match_words, exact_words);
+    }
+
+    const unsigned long query_allocations = allocations - start_allocations;
+
+    if(query_allocations)
+    {
+      std::cerr << "parse_allocations_test: " << query_allocations <<
+        " allocations for " << PARSE_ITERATIONS << " queries" << std::endl;
+      result = 1;
+    }
+
+    if(page_words.size() != page_words_count)
+    {
+      std::cerr << "parse_allocations_test: " << page_words.size() <<
+        " page words instead " << page_words_count << std::endl;
+      result = 1;
+    }
+
+    return result;
+  }
+}
+
+int
+main()
+{
+  int result = 0;
+
+  try
+  {
+    result += splitter_test();
+    result += match_words_test();
+    result += parse_allocations_test();
+  }
+  catch(const eh::Exception& ex)
+  {
+    std::cerr << "Caught eh::Exception: " << ex.what() << std::endl;
+    return 1;
+  }
+
+  if(!result)
+  {
+    std::cout << "SUCCESS" << std::endl;
+  }
+
+  return result;
+}
@@ -0,0 +1,338 @@
+/*
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Contention benchmark of snapshot acquisition: rw lock + add_ref
+ * (as was used by ChannelContainer, CampaignManagerImpl, ChannelMatcher)
+ * against SnapshotHolder::get() and SnapshotHolder::ReadGuard,
+ * for 1, 2, 4 ... max_threads readers and one writer that replaces
+ * snapshot while readers work.
+ * Readers check that loaded snapshot isn't destroyed.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <iomanip>
+
+#include <ReferenceCounting/AtomicImpl.hpp>
+#include <ReferenceCounting/SmartPtr.hpp>
+#include <Sync/SyncPolicy.hpp>
+#include <Generics/ThreadRunner.hpp>
+#include <Generics/Time.hpp>
+
+#include <Commons/AtomicInt.hpp>
+#include <Commons/SnapshotHolder.hpp>
+
+namespace
+{
+  const unsigned long ALIVE = 0x5A5A5A5A;
+  const unsigned long DESTROYED = 0xDEADBEEF;
+  const unsigned long WRITER_PERIOD = 1000; // usec
+
+  class Snapshot: public ReferenceCounting::AtomicImpl
+  {
+  public:
+    Snapshot(unsigned long value_val) throw()
+      : state(ALIVE),
+        value(value_val)
+    {}
+
+    volatile unsigned long state;
+    const unsigned long value;
+
+  protected:
+    virtual
+    ~Snapshot() throw()
+    {
+      state = DESTROYED;
+    }
+  };
+
+  typedef ReferenceCounting::SmartPtr<Snapshot> Snapshot_var;
+  typedef AdServer::Commons::SnapshotHolder<Snapshot> SnapshotHolder;
+
+  // holder of snapshot that was used before SnapshotHolder
+  class LockSnapshotHolder
+  {
+  public:
+    LockSnapshotHolder() throw()
+      : snapshot_(new Snapshot(0))
+    {}
+
+    Snapshot_var
+    get() const throw()
+    {
+      Sync::PosixRGuard lock(lock_);
+      return snapshot_;
+    }
+
+    void
+    swap(Snapshot_var& snapshot) throw()
+    {
+      Sync::PosixWGuard lock(lock_);
+      snapshot_.swap(snapshot);
+    }
+
+  private:
+    mutable Sync::PosixRWLock lock_;
+    Snapshot_var snapshot_;
+  };
+
+  enum Method
+  {
+    M_RWLOCK = 0,
+    M_GET,
+    M_READ_GUARD,
+    M_MAX
+  };
+
+  const char* METHOD_NAMES[] =
+  {
+    "rwlock + add_ref",
+    "SnapshotHolder::get",
+    "SnapshotHolder::ReadGuard"
+  };
+
+  class ReadJob: public Generics::ThreadJob
+  {
+  public:
+    ReadJob(
+      Method method,
+      unsigned long iterations,
+      const LockSnapshotHolder& lock_holder,
+      const SnapshotHolder& holder)
+      throw()
+      : method_(method),
+        iterations_(iterations),
+        lock_holder_(lock_holder),
+        holder_(holder),
+        errors_(0)
+    {}
+
+    virtual void
+    work() throw()
+    {
+      unsigned long errors = 0;
+      unsigned long sum = 0;
+
+      for(unsigned long i = 0; i < iterations_; ++i)
+      {
+        if(method_ == M_READ_GUARD)
+        {
+          SnapshotHolder::ReadGuard guard(holder_);
+          errors += (guard->state != ALIVE);
+          sum += guard->value;
+        }
+        else
+        {
+          Snapshot_var snapshot = method_ == M_RWLOCK ?
+            lock_holder_.get() : holder_.get();
+          errors += (snapshot->state != ALIVE);
+          sum += snapshot->value;
+        }
+      }
+
+      errors_ += errors;
+      sum_ = sum;
+    }
+
+    unsigned long
+    errors() const throw()
+    {
+      return errors_;
+    }
+
+  protected:
+    virtual
+    ~ReadJob() throw()
+    {}
+
+  private:
+    const Method method_;
+    const unsigned long iterations_;
+    const LockSnapshotHolder& lock_holder_;
+    const SnapshotHolder& holder_;
+    Algs::AtomicInt errors_;
+    volatile unsigned long sum_;
+  };
+
+  class WriteJob: public Generics::ThreadJob
+  {
+  public:
+    WriteJob(
+      Method method,
+      LockSnapshotHolder& lock_holder,
+      SnapshotHolder& holder)
+      throw()
+      : method_(method),
+        lock_holder_(lock_holder),
+        holder_(holder),
+        stopped_(false),
+        swaps_(0)
+    {}
+
+    virtual void
+    work() throw()
+    {
+      while(!stopped_)
+      {
+        Snapshot_var snapshot(new Snapshot(++swaps_));
+
+        if(method_ == M_RWLOCK)
+        {
+          lock_holder_.swap(snapshot);
+        }
+        else
+        {
+          holder_.swap(snapshot);
+        }
+
+        // old snapshot destroyed here if readers don't keep it
+        snapshot.reset();
+        ::usleep(WRITER_PERIOD);
+      }
+    }
+
+    void
+    stop() throw()
+    {
+      stopped_ = true;
+    }
+
+    unsigned long
+    swaps() const throw()
+    {
+      return swaps_;
+    }
+
+  protected:
+    virtual
+    ~WriteJob() throw()
+    {}
+
+  private:
+    const Method method_;
+    LockSnapshotHolder& lock_holder_;
+    SnapshotHolder& holder_;
+    volatile bool stopped_;
+    volatile unsigned long swaps_;
+  };
+
+  // return count of errors
+  unsigned long
+  run(Method method, unsigned long threads, unsigned long iterations)
+  {
+    LockSnapshotHolder lock_holder;
+    SnapshotHolder holder(new Snapshot(0));
+
+    ReferenceCounting::SmartPtr<ReadJob> read_job(
+      new ReadJob(method, iterations, lock_holder, holder));
+    ReferenceCounting::SmartPtr<WriteJob> write_job(
+      new WriteJob(method, lock_holder, holder));
+
+    Generics::Timer timer;
+
+    {
+      Generics::ThreadRunner write_runner(write_job.in(), 1);
+      write_runner.start();
+
+      {
+        Generics::ThreadRunner read_runner(read_job.in(), threads);
+        timer.start();
+        read_runner.start();
+        read_runner.wait_for_completion();
+        timer.stop();
+      }
+
+      write_job->stop();
+      write_runner.wait_for_completion();
+    }
+
+    const Generics::Time elapsed = timer.elapsed_time();
+    const double seconds = elapsed.tv_sec +
+      static_cast<double>(elapsed.tv_usec) / 1000000;
+    const double ops = static_cast<double>(threads) * iterations;
+
+    std::cout << std::setw(27) << std::left << METHOD_NAMES[method] <<
+      std::right <<
+      " threads = " << std::setw(2) << threads <<
+      ", time = " << elapsed <<
+      ", " << std::fixed << std::setprecision(1) <<
+      (seconds > 0 ? ops / seconds / 1000000 : 0) << " Mreads/s" <<
+      ", " << std::setprecision(2) <<
+      (ops > 0 ? seconds * 1000000000 * threads / ops : 0) <<
+      " ns/read per thread, swaps = " << write_job->swaps() <<
+      std::endl;
+
+    return read_job->errors();
+  }
+}
+
+int
+main(int argc, char* argv[])
+{
+  unsigned long max_threads = 64;
+  unsigned long iterations = 1000000;
+
+  if(argc > 1)
+  {
+    max_threads = atol(argv[1]);
+    if(argc > 2)
+    {
+      iterations = atol(argv[2]);
+    }
+  }
+
+  if(!max_threads || max_threads > 1024)
+  {
+    std::cerr << "Usage: SnapshotHolderTest [max_threads [iterations]]" <<
+      std::endl;
+    return 1;
+  }
+
+  try
+  {
+    unsigned long errors = 0;
+
+    for(unsigned long threads = 1; threads <= max_threads; threads *= 2)
+    {
+      for(unsigned long method = 0; method < M_MAX; ++method)
+      {
+        errors += run(static_cast<Method>(method), threads, iterations);
+      }
+    }
+
+    if(errors)
+    {
+      std::cerr << "FAIL: " << errors <<
+        " reads of destroyed snapshot" << std::endl;
+      return 1;
+    }
+
+    return 0;
+  }
+  catch(const eh::Exception& ex)
+  {
+    std::cerr << "Caught eh::Exception: " << ex.what() << std::endl;
+  }
+
+  return 1;
+}
@@ -0,0 +1,304 @@
+/* 
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string>
+
+#include <Generics/Time.hpp>
+#include <CampaignSvcs/CampaignCommons/CampaignTypes.hpp>
+#include <Commons/CorbaAlgs.hpp>
+
+#include "../../TestHelpers.hpp"
+
+#include <Frontends/Modules/BiddingFrontend/BidEligibility.hpp>
+
+using AdServer::Bidding::BidEligibility;
+using AdServer::Bidding::BidEligibility_var;
+using AdServer::CampaignSvcs::CampaignManager::BidEligibilityInfo;
+using AdServer::CampaignSvcs::CampaignManager::RequestParams;
+
+namespace
+{
+  const unsigned long SITE_ID = 10;
+  const unsigned long ACCOUNT_ID = 20;
+  const unsigned long SITE_TAG_ID = 100;
+  const unsigned long ACCOUNT_TAG_ID = 200;
+  const unsigned long NOGEO_TAG_ID = 300;
+  const unsigned long NOGEO_SITE_ID = 30;
+
+  // expose tag_eligible_ for direct checks on site tags
+  class TestBidEligibility: public BidEligibility
+  {
+  public:
+    TestBidEligibility(const BidEligibilityInfo& info)
+      : BidEligibility(info)
+    {
+      fill_tags_(site_tags_, info.site_tags);
+    }
+
+    bool
+    site_tag_eligible(
+      unsigned long site_id,
+      const AdServer::CampaignSvcs::StringSeq& sizes,
+      const std::string& country)
+      const
+    {
+      return tag_eligible_(site_tags_, site_id, sizes, country);
+    }
+
+  protected:
+    virtual
+    ~TestBidEligibility() throw()
+    {}
+
+  private:
+    IdSizeTagMap site_tags_;
+  };
+
+  void
+  add_tag_key(
+    AdServer::CampaignSvcs::CampaignManager::BidEligibilityTagKeySeq& keys,
+    unsigned long id,
+    const char* size,
+    unsigned long tag_id)
+  {
+    keys.length(keys.length() + 1);
+    keys[keys.length() - 1].id = id;
+    keys[keys.length() - 1].size << size;
+    keys[keys.length() - 1].tag_ids.length(1);
+    keys[keys.length() - 1].tag_ids[0] = tag_id;
+  }
+
+  void
+  add_tag(
+    BidEligibilityInfo& info,
+    unsigned long tag_id,
+    const char* country)
+  {
+    info.tags.length(info.tags.length() + 1);
+    info.tags[info.tags.length() - 1].tag_id = tag_id;
+    info.tags[info.tags.length() - 1].countries.length(1);
+    info.tags[info.tags.length() - 1].countries[0] << country;
+  }
+
+  // site 10 (300x250) -> tag 100 (ru),
+  // account 20 (728x90) -> tag 200 (us),
+  // site 30 (300x250) -> tag 300 (campaigns without country)
+  void
+  fill_info(BidEligibilityInfo& info, const Generics::Time& version)
+  {
+    info.version = CorbaAlgs::pack_time(version);
+    info.changed = true;
+    add_tag_key(info.site_tags, SITE_ID, "300x250", SITE_TAG_ID);
+    add_tag_key(info.site_tags, NOGEO_SITE_ID, "300x250", NOGEO_TAG_ID);
+    add_tag_key(info.account_tags, ACCOUNT_ID, "728x90", ACCOUNT_TAG_ID);
+    add_tag(info, SITE_TAG_ID, "ru");
+    add_tag(info, ACCOUNT_TAG_ID, "us");
+    add_tag(info, NOGEO_TAG_ID, "");
+  }
+
+  void
+  fill_request(
+    RequestParams& request_params,
+    unsigned long site_id,
+    unsigned long account_id,
+    const char* size,
+    const char* country)
+  {
+    request_params.common_info.request_type = AdServer::CampaignSvcs::AR_OPENRTB;
+    request_params.publisher_site_id = site_id;
+    request_params.publisher_account_ids.length(account_id ? 1 : 0);
+    if(account_id)
+    {
+      request_params.publisher_account_ids[0] = account_id;
+    }
+
+    request_params.common_info.location.length(country ? 1 : 0);
+    if(country)
+    {
+      request_params.common_info.location[0].country << country;
+    }
+
+    request_params.ad_slots.length(1);
+    request_params.ad_slots[0].sizes.length(1);
+    request_params.ad_slots[0].sizes[0] << size;
+  }
+
+  BidEligibility_var
+  create_bid_eligibility(const Generics::Time& version)
+  {
+    BidEligibilityInfo info;
+    fill_info(info, version);
+    return new BidEligibility(info);
+  }
+}
+
+TEST(tag_eligible)
+{
+  BidEligibilityInfo info;
+  fill_info(info, Generics::Time(1));
+  ReferenceCounting::SmartPtr<TestBidEligibility> bid_eligibility =
+    new TestBidEligibility(info);
+
+  AdServer::CampaignSvcs::StringSeq sizes;
+  sizes.length(2);
+  sizes[0] << "728x90";
+  sizes[1] << "300x250";
+
+  ASSERT_TRUE(bid_eligibility->site_tag_eligible(SITE_ID, sizes, "ru"));
+  ASSERT_FALSE(bid_eligibility->site_tag_eligible(SITE_ID, sizes, "us"));
+  ASSERT_FALSE(bid_eligibility->site_tag_eligible(SITE_ID + 1, sizes, "ru"));
+
+  sizes.length(1);
+  ASSERT_FALSE(bid_eligibility->site_tag_eligible(SITE_ID, sizes, "ru"));
+}
+
+TEST(site_tag)
+{
+  BidEligibility_var bid_eligibility = create_bid_eligibility(Generics::Time(1));
+
+  {
+    RequestParams request_params;
+    fill_request(request_params, SITE_ID, 0, "300x250", "ru");
+    ASSERT_TRUE(bid_eligibility->eligible(request_params));
+  }
+
+  {
+    // country without campaigns
+    RequestParams request_params;
+    fill_request(request_params, SITE_ID, 0, "300x250", "us");
+    ASSERT_FALSE(bid_eligibility->eligible(request_params));
+  }
+
+  {
+    // size without tag
+    RequestParams request_params;
+    fill_request(request_params, SITE_ID, 0, "728x90", "ru");
+    ASSERT_FALSE(bid_eligibility->eligible(request_params));
+  }
+
+  {
+    // unknown site
+    RequestParams request_params;
+    fill_request(request_params, SITE_ID + 1, 0, "300x250", "ru");
+    ASSERT_FALSE(bid_eligibility->eligible(request_params));
+  }
+}
+
+TEST(account_tag)
+{
+  BidEligibility_var bid_eligibility = create_bid_eligibility(Generics::Time(1));
+
+  {
+    // site isn't defined
+    RequestParams request_params;
+    fill_request(request_params, 0, ACCOUNT_ID, "728x90", "us");
+    ASSERT_TRUE(bid_eligibility->eligible(request_params));
+  }
+
+  {
+    // site tag don't match, account tag match
+    RequestParams request_params;
+    fill_request(request_params, SITE_ID, ACCOUNT_ID, "728x90", "us");
+    ASSERT_TRUE(bid_eligibility->eligible(request_params));
+  }
+
+  {
+    RequestParams request_params;
+    fill_request(request_params, 0, ACCOUNT_ID, "728x90", "ru");
+    ASSERT_FALSE(bid_eligibility->eligible(request_params));
+  }
+
+  {
+    // account tags isn't checked by site id
+    RequestParams request_params;
+    fill_request(request_params, ACCOUNT_ID, 0, "728x90", "us");
+    ASSERT_FALSE(bid_eligibility->eligible(request_params));
+  }
+}
+
+TEST(no_location)
+{
+  BidEligibility_var bid_eligibility = create_bid_eligibility(Generics::Time(1));
+
+  {
+    // request without location match only campaigns without country
+    RequestParams request_params;
+    fill_request(request_params, SITE_ID, 0, "300x250", 0);
+    ASSERT_FALSE(bid_eligibility->eligible(request_params));
+  }
+
+  {
+    RequestParams request_params;
+    fill_request(request_params, NOGEO_SITE_ID, 0, "300x250", 0);
+    ASSERT_TRUE(bid_eligibility->eligible(request_params));
+  }
+}
+
+TEST(normal_request)
+{
+  BidEligibility_var bid_eligibility = create_bid_eligibility(Generics::Time(1));
+
+  // tag defined explicitly: request isn't filtered
+  RequestParams request_params;
+  fill_request(request_params, SITE_ID + 1, 0, "1x1", "us");
+  request_params.common_info.request_type = AdServer::CampaignSvcs::AR_NORMAL;
+  ASSERT_TRUE(bid_eligibility->eligible(request_params));
+}
+
+TEST(update)
+{
+  BidEligibilityInfo empty_info;
+  empty_info.changed = false;
+  BidEligibility_var bid_eligibility = BidEligibility::update(0, empty_info);
+  ASSERT_TRUE(!bid_eligibility.in());
+
+  BidEligibilityInfo info;
+  fill_info(info, Generics::Time(1));
+  bid_eligibility = BidEligibility::update(0, info);
+  ASSERT_TRUE(bid_eligibility.in());
+  ASSERT_EQUALS(bid_eligibility->version(), Generics::Time(1));
+
+  {
+    // campaign manager report that index isn't changed
+    BidEligibilityInfo unchanged_info;
+    unchanged_info.version = CorbaAlgs::pack_time(Generics::Time(1));
+    unchanged_info.changed = false;
+    BidEligibility_var res = BidEligibility::update(
+      bid_eligibility, unchanged_info);
+    ASSERT_TRUE(res.in() == bid_eligibility.in());
+  }
+
+  {
+    // full info with same version
+    BidEligibility_var res = BidEligibility::update(bid_eligibility, info);
+    ASSERT_TRUE(res.in() == bid_eligibility.in());
+  }
+
+  {
+    BidEligibilityInfo new_info;
+    fill_info(new_info, Generics::Time(2));
+    BidEligibility_var res = BidEligibility::update(bid_eligibility, new_info);
+    ASSERT_TRUE(res.in() != bid_eligibility.in());
+    ASSERT_EQUALS(res->version(), Generics::Time(2));
+  }
+}
+
+RUN_TESTS
@@ -138,4 +138,60 @@ TEST(parse_number)
   }
 }
 
+// json placed in receive buffer: it is followed by FCGI records
+// (not null terminated), parsing is limited by end of body
+TEST(parse_bounded)
+{
+  const std::string json = "{\"id\":\"req\\u0041\",\"imp\":[{\"bidfloor\":1.5e1}],\"test\":true}";
+  const std::string tail("\x01\x05\x00\x01\x00\x00\x00\x00" "123", 11);
+
+  {
+    std::string buf = json + tail;
+    JsonValue root_value;
+    JsonAllocator json_allocator;
+    char* parse_end = 0;
+
+    JsonParseStatus status = json_parse(
+      &buf[0],
+      &buf[0] + json.size(),
+      &parse_end,
+      &root_value,
+      json_allocator);
+
+    ASSERT_TRUE (status == JSON_PARSE_OK);
+    // data after body isn't modified
+    ASSERT_EQUALS (buf.substr(json.size()), tail);
+
+    JsonIterator it = begin(root_value);
+    ASSERT_EQUALS (it->key, std::string("id"));
+    ASSERT_EQUALS (it->value.toString(), std::string("reqA"));
+
+    ++it;
+    ASSERT_EQUALS (it->key, std::string("imp"));
+    JsonIterator imp_it = begin(begin(it->value)->value);
+    ASSERT_EQUALS (imp_it->key, std::string("bidfloor"));
+    ASSERT_EQUALS (imp_it->value.toNumber(), 15);
+
+    ++it;
+    ASSERT_EQUALS (it->key, std::string("test"));
+    ASSERT_TRUE (it->value.toBool());
+  }
+
+  // truncated body isn't completed by data after it
+  for(size_t size = 0; size < json.size(); ++size)
+  {
+    std::string buf = json + "\"}]}";
+    JsonValue root_value;
+    JsonAllocator json_allocator;
+    char* parse_end = 0;
+
+    ASSERT_FALSE (json_parse(
+      &buf[0],
+      &buf[0] + size,
+      &parse_end,
+      &root_value,
+      json_allocator) == JSON_PARSE_OK);
+  }
+}
+
 RUN_TESTS
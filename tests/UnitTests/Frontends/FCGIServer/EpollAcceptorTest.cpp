@@ -0,0 +1,469 @@
+/*
+ * This file is part of the RTBServer distribution (https://github.com/yoori/rtbserver).
+ * RTBServer is DSP server that allow to bid (see RTB auction) targeted ad
+ * via RTB protocols (OpenRTB, Google AdExchange, Yandex RTB)
+ *
+ * Copyright (c) 2014 Yuri Kuznecov <yuri.kuznecov@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @file FCGIServer/EpollAcceptorTest.cpp
+// FCGI request framing and EpollAcceptor over unix socket:
+// partial reads, partial writes, pipelined requests
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <iostream>
+
+#include <Logger/StreamLogger.hpp>
+#include <Logger/ActiveObjectCallback.hpp>
+
+#include <Frontends/FrontendCommons/FCGI.hpp>
+#include <Frontends/FrontendCommons/tinyfcgi/tinyfcgi.hpp>
+#include <Frontends/FCGIServer/EpollAcceptor.hpp>
+
+using namespace AdServer::Frontends;
+
+namespace
+{
+  const char SOCKET_PATH[] = "./EpollAcceptorTest.sock";
+  const char BIG_URI[] = "/big";
+  // much more then unix socket buffers
+  const size_t BIG_RESPONSE_SIZE = 8 * 1024 * 1024;
+  const int CLIENT_RECV_BUF_SIZE = 4 * 1024;
+  const int RECV_TIMEOUT = 10; // seconds
+}
+
+#define CHECK_EQUAL(TEST, EXPR, EXPECTED) \
+  if(!((EXPR) == (EXPECTED))) \
+  { \
+    std::cerr << TEST << ": " #EXPR " = " << (EXPR) << \
+      " instead " << (EXPECTED) << std::endl; \
+    ++result; \
+  }
+
+// echo uri and body, BIG_URI reply with BIG_RESPONSE_SIZE body
+class TestFrontend:
+  public FrontendCommons::FrontendInterface,
+  public ReferenceCounting::AtomicImpl
+{
+public:
+  virtual bool
+  will_handle(const String::SubString& /*uri*/) throw ()
+  {
+    return true;
+  }
+
+  virtual int
+  handle_request(
+    const FCGI::HttpRequest& /*request*/,
+    FCGI::HttpResponse& /*response*/) throw()
+  {
+    return 0;
+  }
+
+  virtual int
+  handle_request_noparams(
+    FCGI::HttpRequest& request,
+    FCGI::HttpResponse& response)
+    throw(eh::Exception)
+  {
+    if(request.uri() == String::SubString(BIG_URI))
+    {
+      response.write_owned(std::string(BIG_RESPONSE_SIZE, 'x'));
+    }
+    else
+    {
+      std::string res;
+      request.uri().assign_to(res);
+      res += ':';
+      res.append(request.body().data(), request.body().size());
+      response.write_owned(std::move(res));
+    }
+
+    return 0;
+  }
+
+  virtual void
+  init() throw(eh::Exception)
+  {}
+
+  virtual void
+  shutdown() throw()
+  {}
+
+protected:
+  virtual
+  ~TestFrontend() throw()
+  {}
+};
+
+std::string
+make_request(uint16_t id, const char* uri, const char* body)
+{
+  char buf[64 * 1024];
+  tinyfcgi::message m(id, buf, sizeof(buf));
+  m.begin_request(FCGI_RESPONDER, FCGI_KEEP_CONN)
+    .add_param("REQUEST_METHOD", "POST")
+    .add_param("REQUEST_URI", uri);
+
+  if(*body)
+  {
+    m.append(FCGI_STDIN, body);
+  }
+
+  m.end_stream(FCGI_STDIN);
+
+  return std::string(m.data(), m.size());
+}
+
+int
+connect_acceptor()
+{
+  int sock = ::socket(AF_LOCAL, SOCK_STREAM, 0);
+
+  timeval tv;
+  tv.tv_sec = RECV_TIMEOUT;
+  tv.tv_usec = 0;
+  ::setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  sockaddr_un addr;
+  ::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  ::strncpy(addr.sun_path, SOCKET_PATH, sizeof(addr.sun_path) - 1);
+
+  if(::connect(sock, (sockaddr*)&addr, sizeof(addr)) == -1)
+  {
+    ::close(sock);
+    return -1;
+  }
+
+  return sock;
+}
+
+bool
+send_all(int sock, const char* data, size_t size)
+{
+  while(size)
+  {
+    ssize_t res = ::send(sock, data, size, MSG_NOSIGNAL);
+    if(res <= 0)
+    {
+      return false;
+    }
+    data += res;
+    size -= res;
+  }
+
+  return true;
+}
+
+// read records up to FCGI_END_REQUEST, body is STDOUT content
+// after headers, return false on error or timeout
+bool
+read_response(int sock, std::string& body)
+{
+  std::string buf;
+  std::string out;
+  size_t pos = 0;
+  char recv_buf[64 * 1024];
+
+  while(true)
+  {
+    while(buf.size() - pos >= FCGI_HEADER_LEN)
+    {
+      const FCGI_Header* h =
+        reinterpret_cast<const FCGI_Header*>(buf.data() + pos);
+      const size_t content_size =
+        (h->contentLengthB1 << 8) + h->contentLengthB0;
+      const size_t record_size =
+        FCGI_HEADER_LEN + content_size + h->paddingLength;
+
+      if(buf.size() - pos < record_size)
+      {
+        break;
+      }
+
+      if(h->type == FCGI_STDOUT)
+      {
+        out.append(buf.data() + pos + FCGI_HEADER_LEN, content_size);
+      }
+
+      pos += record_size;
+
+      if(h->type == FCGI_END_REQUEST)
+      {
+        const size_t headers_end = out.find("\r\n\r\n");
+        if(headers_end == std::string::npos ||
+          out.compare(0, 11, "Status: 200") != 0)
+        {
+          return false;
+        }
+
+        body = out.substr(headers_end + 4);
+        // responses are read one by one: no data after end request
+        return pos == buf.size();
+      }
+    }
+
+    ssize_t res = ::recv(sock, recv_buf, sizeof(recv_buf), 0);
+    if(res <= 0)
+    {
+      return false;
+    }
+
+    buf.append(recv_buf, res);
+  }
+}
+
+int
+scanner_test()
+{
+  static const char* TEST = "scanner_test";
+
+  int result = 0;
+
+  const std::string req1 = make_request(1, "/first", "body");
+  const std::string req2 = make_request(1, "/second", "");
+  const std::string pipelined = req1 + req2;
+
+  {
+    // record by record framing: request complete only with last byte
+    FCGI::RequestScanner scanner;
+    size_t request_size = 0;
+
+    for(size_t i = 1; i < req1.size(); ++i)
+    {
+      if(scanner.scan(req1.data(), i, request_size) != FCGI::PARSE_NEED_MORE)
+      {
+        std::cerr << TEST << ": unexpected result for size " << i << std::endl;
+        ++result;
+        break;
+      }
+    }
+
+    CHECK_EQUAL(TEST,
+      static_cast<int>(scanner.scan(req1.data(), req1.size(), request_size)),
+      static_cast<int>(FCGI::PARSE_OK));
+    CHECK_EQUAL(TEST, request_size, req1.size());
+  }
+
+  {
+    // data of next request isn't included into request
+    FCGI::RequestScanner scanner;
+    size_t request_size = 0;
+
+    CHECK_EQUAL(TEST,
+      static_cast<int>(scanner.scan(
+        pipelined.data(), pipelined.size(), request_size)),
+      static_cast<int>(FCGI::PARSE_OK));
+    CHECK_EQUAL(TEST, request_size, req1.size());
+
+    scanner.reset();
+    const size_t next_size = pipelined.size() - request_size;
+
+    CHECK_EQUAL(TEST,
+      static_cast<int>(scanner.scan(
+        pipelined.data() + request_size, next_size, request_size)),
+      static_cast<int>(FCGI::PARSE_OK));
+    CHECK_EQUAL(TEST, request_size, req2.size());
+  }
+
+  {
+    FCGI::RequestScanner scanner;
+    size_t request_size = 0;
+    const std::string garbage(64, 'x');
+
+    CHECK_EQUAL(TEST,
+      static_cast<int>(scanner.scan(
+        garbage.data(), garbage.size(), request_size)),
+      static_cast<int>(FCGI::PARSE_INVALID_HEADER));
+  }
+
+  return result;
+}
+
+// request sent byte by byte: acceptor read it with many recv calls
+int
+partial_read_test()
+{
+  static const char* TEST = "partial_read_test";
+
+  int result = 0;
+
+  int sock = connect_acceptor();
+  if(sock == -1)
+  {
+    std::cerr << TEST << ": can't connect" << std::endl;
+    return 1;
+  }
+
+  const std::string req = make_request(1, "/partial", "partial body");
+
+  for(size_t i = 0; i < req.size(); ++i)
+  {
+    send_all(sock, req.data() + i, 1);
+    ::usleep(1000);
+  }
+
+  std::string body;
+  CHECK_EQUAL(TEST, read_response(sock, body), true);
+  CHECK_EQUAL(TEST, body, std::string("/partial:partial body"));
+
+  ::close(sock);
+
+  return result;
+}
+
+// response bigger then socket buffers and client don't read it:
+// worker return, io thread write response when client read it,
+// next request on same connection processed after it
+int
+partial_write_test()
+{
+  static const char* TEST = "partial_write_test";
+
+  int result = 0;
+
+  int sock = connect_acceptor();
+  if(sock == -1)
+  {
+    std::cerr << TEST << ": can't connect" << std::endl;
+    return 1;
+  }
+
+  ::setsockopt(
+    sock, SOL_SOCKET, SO_RCVBUF,
+    &CLIENT_RECV_BUF_SIZE, sizeof(CLIENT_RECV_BUF_SIZE));
+
+  const std::string big_req = make_request(1, BIG_URI, "");
+  send_all(sock, big_req.data(), big_req.size());
+
+  // wait while worker fill socket buffers
+  ::usleep(200000);
+
+  {
+    // only one worker: other connection is served only
+    // if worker don't wait slow client
+    int other_sock = connect_acceptor();
+    const std::string req = make_request(1, "/other", "");
+    send_all(other_sock, req.data(), req.size());
+
+    std::string body;
+    CHECK_EQUAL(TEST, read_response(other_sock, body), true);
+    CHECK_EQUAL(TEST, body, std::string("/other:"));
+    ::close(other_sock);
+  }
+
+  std::string body;
+  CHECK_EQUAL(TEST, read_response(sock, body), true);
+  CHECK_EQUAL(TEST, body.size(), BIG_RESPONSE_SIZE);
+  CHECK_EQUAL(TEST, body.find_first_not_of('x'), std::string::npos);
+
+  const std::string req = make_request(1, "/next", "after big");
+  send_all(sock, req.data(), req.size());
+
+  CHECK_EQUAL(TEST, read_response(sock, body), true);
+  CHECK_EQUAL(TEST, body, std::string("/next:after big"));
+
+  ::close(sock);
+
+  return result;
+}
+
+// two requests in one send: second isn't dropped
+int
+pipelined_test()
+{
+  static const char* TEST = "pipelined_test";
+
+  int result = 0;
+
+  int sock = connect_acceptor();
+  if(sock == -1)
+  {
+    std::cerr << TEST << ": can't connect" << std::endl;
+    return 1;
+  }
+
+  const std::string reqs =
+    make_request(1, "/first", "1") +
+    make_request(1, "/second", "2") +
+    make_request(1, "/third", "");
+
+  send_all(sock, reqs.data(), reqs.size());
+
+  std::string body;
+  CHECK_EQUAL(TEST, read_response(sock, body), true);
+  CHECK_EQUAL(TEST, body, std::string("/first:1"));
+  CHECK_EQUAL(TEST, read_response(sock, body), true);
+  CHECK_EQUAL(TEST, body, std::string("/second:2"));
+  CHECK_EQUAL(TEST, read_response(sock, body), true);
+  CHECK_EQUAL(TEST, body, std::string("/third:"));
+
+  ::close(sock);
+
+  return result;
+}
+
+int
+main() throw ()
+{
+  int result = 0;
+
+  try
+  {
+    Logging::Logger_var logger = new Logging::OStream::Logger(
+      Logging::OStream::Config(std::cerr));
+    Generics::ActiveObjectCallback_var callback =
+      new Logging::ActiveObjectCallbackImpl(
+        logger,
+        "EpollAcceptorTest::main()",
+        "EpollAcceptorTest",
+        "");
+
+    result += scanner_test();
+
+    FrontendCommons::Frontend_var frontend = new TestFrontend();
+
+    EpollAcceptor_var acceptor = new EpollAcceptor(
+      logger,
+      frontend,
+      callback,
+      SOCKET_PATH,
+      100, // backlog
+      1, // io threads
+      1, // worker threads
+      100 // max pending requests
+      );
+
+    acceptor->activate_object();
+
+    result += partial_read_test();
+    result += partial_write_test();
+    result += pipelined_test();
+
+    acceptor->deactivate_object();
+    acceptor->wait_object();
+  }
+  catch (const eh::Exception& ex)
+  {
+    std::cerr << ex.what() << std::endl;
+    result = 1;
+  }
+
+  return result;
+}